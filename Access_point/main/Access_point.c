@@ -2,6 +2,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_mac.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
@@ -11,6 +12,9 @@
 #include "esp_netif.h"
 #include "lwip/sockets.h"
 #include "driver/uart.h"
+#include "link_mux.h"
+#include "link_tls.h"
+#include "link_mirror.h"
 
 /*Definitions*/
 #define SSID "Terminal_AP"
@@ -36,6 +40,20 @@ int sock;
 int sockl;
 static char read_buffer[255];
 
+// logical channels multiplexed over sockl
+static mux_tx_t link_tx;
+static mux_rx_t link_rx;
+
+// viewer of the Station's display, messages on MUX_CH_MIRROR go to it
+static volatile int mirror_viewer = -1;
+static volatile uint8_t mirror_request = 0;    // MIRROR_MSG_REFRESH or _STOP waiting to go to the Station
+
+#if LINK_USE_TLS
+static link_tls_t link_tls;
+static SemaphoreHandle_t tls_lock; // one mbedTLS context shared by the reader and writer task
+static bool link_secure = false;   // a key is provisioned, the link runs TLS
+#endif
+
 // AP event handler
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                     int32_t event_id, void* event_data)
@@ -91,6 +109,90 @@ void init_ap(void){
              SSID, PASS, CHANNEL);
 }
 
+/*Link security*/
+// Without a key in NVS the link runs over plain TCP, the other side has to have none either
+esp_err_t link_security_initialize(void){
+#if LINK_USE_TLS
+    uint8_t psk[LINK_TLS_PSK_MAX];
+    size_t psk_len;
+    char identity[LINK_TLS_IDENTITY_MAX];
+    if(!link_tls_load_key(psk, &psk_len, identity)){
+        ESP_LOGW(TCP_TAG, "No link key provisioned in NVS, linking over plain TCP");
+        return ESP_OK;
+    }
+    tls_lock = xSemaphoreCreateMutex();
+    int ret = link_tls_init(&link_tls, true, psk, psk_len, identity);
+    memset(psk, 0, sizeof(psk));
+    if(tls_lock == NULL || ret != 0){
+        ESP_LOGE(TCP_TAG, "TLS setup failed: -0x%04x", -ret);
+        return ESP_FAIL;
+    }
+    link_secure = true;
+#endif
+    return ESP_OK;
+}
+
+// Secure freshly accepted sockl, returns 0 on success
+static int link_open(void){
+#if LINK_USE_TLS
+    if(!link_secure){
+        return 0;
+    }
+    int ret = link_tls_handshake(&link_tls, sockl);
+    if(ret != 0){
+        ESP_LOGE(TCP_TAG, "TLS handshake failed: -0x%04x", -ret);
+        return -1;
+    }
+    ESP_LOGI(TCP_TAG, "TLS handshake took %lld ms", link_tls.handshake_us / 1000);
+#endif
+    return 0;
+}
+
+static void link_close(void){
+#if LINK_USE_TLS
+    if(link_secure){
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        link_tls_close(&link_tls);
+        xSemaphoreGive(tls_lock);
+    }
+#endif
+    close(sockl);
+}
+
+static int link_write(const void *data, size_t length){
+#if LINK_USE_TLS
+    if(link_secure){
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        int w = link_tls_write(&link_tls, data, length);
+        xSemaphoreGive(tls_lock);
+        return w;
+    }
+#endif
+    return write(sockl, data, length);
+}
+
+static int link_read(void *data, size_t length){
+#if LINK_USE_TLS
+    if(link_secure){
+        // wait outside the lock so the writer is not blocked by an idle link
+        if(link_tls_pending(&link_tls) == 0){
+            fd_set readable;
+            struct timeval timeout = { .tv_sec = 0, .tv_usec = 100 * 1000 };
+            FD_ZERO(&readable);
+            FD_SET(sockl, &readable);
+            if(select(sockl + 1, &readable, NULL, NULL, &timeout) <= 0){
+                return -1;
+            }
+        }
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        int r = link_tls_read(&link_tls, data, length);
+        xSemaphoreGive(tls_lock);
+        return r;
+    }
+#endif
+    return read(sockl, data, length);
+}
+
 void socket_creation(void *arg){
 	struct sockaddr_in server ; 
 	server.sin_family = AF_INET;
@@ -121,7 +223,15 @@ void socket_creation(void *arg){
             if (sockl < 0) {
                 ESP_LOGE(TCP_TAG, "Unable to accept connection: errno %d", errno);                                                                                            
             }
+            else if(link_open() != 0){
+                close(sockl);
+                continue;
+            }
             else{
+                // a new Station connection knows nothing of the viewer yet
+                if(mirror_viewer >= 0){
+                    mirror_request = MIRROR_MSG_REFRESH;
+                }
                 socket_status = 0;
             }
         }
@@ -134,8 +244,8 @@ void socket_creation(void *arg){
         setsockopt(sockl, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
         setsockopt(sockl, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));   
         if (w != 0){
-            close(sockl);
             socket_status = -1;
+            link_close();
         }
         vTaskDelay(1000 / portTICK_PERIOD_MS);
         ESP_LOGI("socket status", "%i", w);     
@@ -156,25 +266,108 @@ void uart_init(void) {
     uart_set_pin(UART_NUM_1, TXD_PIN, RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 }
 
-static void tx_task(void *arg)
+// One viewer at a time, the next one is accepted once the reader lets go of it
+static void mirror_server(void *arg){
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port = htons(MIRROR_VIEWER_PORT),
+    };
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener < 0 || bind(listener, (struct sockaddr *)&server, sizeof(server)) != 0 || listen(listener, 1) != 0){
+        ESP_LOGE(TCP_TAG, "Mirror port %d unavailable", MIRROR_VIEWER_PORT);
+        vTaskDelete(NULL);
+    }
+    while(1){
+        int viewer = accept(listener, NULL, NULL);
+        if(viewer < 0){
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        }
+        else if(mirror_viewer >= 0){
+            close(viewer);
+        }
+        else{
+            ESP_LOGI(TCP_TAG, "Mirror viewer connected");
+            mirror_viewer = viewer;
+            mirror_request = MIRROR_MSG_REFRESH;
+        }
+    }
+}
+
+/**
+ * Display messages from the Station, each behind its length. A viewer that
+ * cannot take one whole loses it and gets the whole screen again, one that
+ * took part of it is cut off so the stream stays in step.
+ */
+static void mirror_forward(const uint8_t *msg, size_t len)
+{
+    static uint8_t out[2 + MUX_MESSAGE_MAX];
+    int viewer = mirror_viewer;
+    if(viewer < 0){
+        return;
+    }
+    out[0] = len;
+    out[1] = len >> 8;
+    memcpy(&out[2], msg, len);
+    int w = send(viewer, out, len + 2, MSG_DONTWAIT);
+    if(w == (int)(len + 2)){
+        return;
+    }
+    if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+        mirror_request = MIRROR_MSG_REFRESH;
+        return;
+    }
+    ESP_LOGI(TCP_TAG, "Mirror viewer gone");
+    mirror_viewer = -1;
+    mirror_request = MIRROR_MSG_STOP;
+    close(viewer);
+}
+
+// Frame reassembled from socket fragments, hand it to the UART device
+static void uart_forward(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
 {
     static const char *TX_TASK_TAG = "TX_TASK";
+    if(channel == MUX_CH_MIRROR){
+        mirror_forward(msg, len);
+        return;
+    }
+    ESP_LOGI("socket", "%u bytes on channel %u", (unsigned)len, channel);
+    const int txBytes = uart_write_bytes(UART_NUM_1, msg, len);
+    ESP_LOGI(TX_TASK_TAG, "\nWrote %d bytes", txBytes);
+}
+
+static void tx_task(void *arg)
+{
+    int rx_sock = -1;
+    mux_rx_init(&link_rx, uart_forward, NULL);
     while(1){
+        if(sockl != rx_sock){
+            // new connection, forget fragments of the old one
+            mux_rx_reset(&link_rx);
+            rx_sock = sockl;
+        }
+        if(socket_status != 0){
+            // nothing to read until the handshake is done
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
         bzero(read_buffer, sizeof(read_buffer));
-        int r = read(sockl, read_buffer, sizeof(read_buffer));
+        int r = link_read(read_buffer, sizeof(read_buffer));
         if (r > 0){
             ESP_LOGI("socket", "%i", r);
-            ESP_LOGI("socket", "%s", read_buffer);
-            const int txBytes = uart_write_bytes(UART_NUM_1, read_buffer, r);
-            ESP_LOGI(TX_TASK_TAG, "\nWrote %d bytes", txBytes);        
+            mux_rx_feed(&link_rx, (uint8_t *)read_buffer, r);
+        }
+        else{
+            vTaskDelay((r == 0 ? 1000 : 10) / portTICK_PERIOD_MS);
         }
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
     }
 }  
 
 static void rx_task(void *arg){
     static const char *RX_TASK_TAG = "RX_TASK";;
+    static uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
     uint8_t* data = (uint8_t*) malloc(RX_BUF_SIZE+1);
+    mux_tx_init(&link_tx);
     while (1) {
         bzero(data, 255);
         const int rxBytes = uart_read_bytes(UART_NUM_1, data, RX_BUF_SIZE, 1000 / portTICK_PERIOD_MS);
@@ -182,13 +375,28 @@ static void rx_task(void *arg){
             data[rxBytes] = 0;
             ESP_LOGI(RX_TASK_TAG, "Read %d bytes: '%s'", rxBytes, data);  
             if(socket_status == 0){
-                int r = write(sockl, data, rxBytes);
+                mux_tx_push(&link_tx, mux_channel_for_frame(data, rxBytes), data, rxBytes);
+                size_t n;
+                while((n = mux_tx_next(&link_tx, fragment)) > 0){
+                    link_write(fragment, n);
+                }
             }
             else{
                 ESP_LOGI(RX_TASK_TAG, "socket is closed");
             }            
             ESP_LOG_BUFFER_HEXDUMP(RX_TASK_TAG, data, rxBytes, ESP_LOG_INFO);           
         }               
+        uint8_t request = mirror_request;
+        if(request != 0 && socket_status == 0){
+            // a viewer came, fell behind or left, the Station starts over or stops mirroring
+            if(mux_tx_push(&link_tx, MUX_CH_MIRROR, &request, 1) && mirror_request == request){
+                mirror_request = 0;
+            }
+            size_t n;
+            while((n = mux_tx_next(&link_tx, fragment)) > 0){
+                link_write(fragment, n);
+            }
+        }
     }
     free(data); 
 }
@@ -203,7 +411,10 @@ void app_main(void)
     ESP_ERROR_CHECK(storage);
     init_ap(); //initialize access point
     uart_init(); // initialize UART
-    xTaskCreate(socket_creation, "socket_task", 1024*2, NULL, configMAX_PRIORITIES, NULL); // Create Task resposnible for socket connection
-    xTaskCreate(rx_task, "uart_rx_task", 1024*2, NULL, configMAX_PRIORITIES-1, NULL); //create task responsible for receiving data through UART
-    xTaskCreate(tx_task, "uart_tx_task", 1024*2, NULL, configMAX_PRIORITIES-2, NULL); // create task responsible for sending data through UART
+    ESP_ERROR_CHECK(link_security_initialize()); // initialize TLS server context, when a key is provisioned
+    // mbedTLS record and handshake code needs the larger stacks
+    xTaskCreate(socket_creation, "socket_task", 1024*6, NULL, configMAX_PRIORITIES, NULL); // Create Task resposnible for socket connection
+    xTaskCreate(rx_task, "uart_rx_task", 1024*4, NULL, configMAX_PRIORITIES-1, NULL); //create task responsible for receiving data through UART
+    xTaskCreate(tx_task, "uart_tx_task", 1024*4, NULL, configMAX_PRIORITIES-2, NULL); // create task responsible for sending data through UART
+    xTaskCreate(mirror_server, "mirror_task", 1024*3, NULL, 1, NULL); // viewers of the Station's display
 }   
@@ -7,6 +7,7 @@
  *      INCLUDES
  *********************/
 #include "lv_draw_sw.h"
+#include "lv_draw_sw_blend_kernel.h"
 #include "../../misc/lv_math.h"
 #include "../../hal/lv_hal_disp.h"
 #include "../../core/lv_refr.h"
@@ -76,20 +77,6 @@ static inline lv_color_t color_blend_true_color_multiply(lv_color_t fg, lv_color
 /**********************
  *      MACROS
  **********************/
-#define FILL_NORMAL_MASK_PX(color)                                                          \
-    if(*mask == LV_OPA_COVER) *dest_buf = color;                                 \
-    else *dest_buf = lv_color_mix(color, *dest_buf, *mask);            \
-    mask++;                                                         \
-    dest_buf++;
-
-#define MAP_NORMAL_MASK_PX(x)                                                          \
-    if(*mask_tmp_x) {          \
-        if(*mask_tmp_x == LV_OPA_COVER) dest_buf[x] = src_buf[x];                                 \
-        else dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], *mask_tmp_x);            \
-    }                                                                                               \
-    mask_tmp_x++;
-
-
 /**********************
  *   GLOBAL FUNCTIONS
  **********************/
@@ -251,7 +238,6 @@ static LV_ATTRIBUTE_FAST_MEM void fill_normal(lv_color_t * dest_buf, const lv_ar
     int32_t w = lv_area_get_width(dest_area);
     int32_t h = lv_area_get_height(dest_area);
 
-    int32_t x;
     int32_t y;
 
     /*No mask*/
@@ -264,118 +250,12 @@ static LV_ATTRIBUTE_FAST_MEM void fill_normal(lv_color_t * dest_buf, const lv_ar
         }
         /*Has opacity*/
         else {
-            lv_color_t last_dest_color = lv_color_black();
-            lv_color_t last_res_color = lv_color_mix(color, last_dest_color, opa);
-
-#if LV_COLOR_MIX_ROUND_OFS == 0 && LV_COLOR_DEPTH == 16
-            /*lv_color_mix work with an optimized algorithm with 16 bit color depth.
-             *However, it introduces some rounded error on opa.
-             *Introduce the same error here too to make lv_color_premult produces the same result */
-            opa = (uint32_t)((uint32_t)opa + 4) >> 3;
-            opa = opa << 3;
-#endif
-
-            uint16_t color_premult[3];
-            lv_color_premult(color, opa, color_premult);
-            lv_opa_t opa_inv = 255 - opa;
-
-            for(y = 0; y < h; y++) {
-                for(x = 0; x < w; x++) {
-                    if(last_dest_color.full != dest_buf[x].full) {
-                        last_dest_color = dest_buf[x];
-                        last_res_color = lv_color_mix_premult(color_premult, dest_buf[x], opa_inv);
-                    }
-                    dest_buf[x] = last_res_color;
-                }
-                dest_buf += dest_stride;
-            }
+            lv_draw_sw_blend_fill_opa(dest_buf, dest_stride, w, h, color, opa);
         }
     }
     /*Masked*/
     else {
-#if LV_COLOR_DEPTH == 16
-        uint32_t c32 = color.full + ((uint32_t)color.full << 16);
-#endif
-        /*Only the mask matters*/
-        if(opa >= LV_OPA_MAX) {
-            int32_t x_end4 = w - 4;
-            for(y = 0; y < h; y++) {
-                for(x = 0; x < w && ((lv_uintptr_t)(mask) & 0x3); x++) {
-                    FILL_NORMAL_MASK_PX(color)
-                }
-
-                for(; x <= x_end4; x += 4) {
-                    uint32_t mask32 = *((uint32_t *)mask);
-                    if(mask32 == 0xFFFFFFFF) {
-#if LV_COLOR_DEPTH == 16
-                        if((lv_uintptr_t)dest_buf & 0x3) {
-                            *(dest_buf + 0) = color;
-                            uint32_t * d = (uint32_t *)(dest_buf + 1);
-                            *d = c32;
-                            *(dest_buf + 3) = color;
-                        }
-                        else {
-                            uint32_t * d = (uint32_t *)dest_buf;
-                            *d = c32;
-                            *(d + 1) = c32;
-                        }
-#else
-                        dest_buf[0] = color;
-                        dest_buf[1] = color;
-                        dest_buf[2] = color;
-                        dest_buf[3] = color;
-#endif
-                        dest_buf += 4;
-                        mask += 4;
-                    }
-                    else if(mask32) {
-                        FILL_NORMAL_MASK_PX(color)
-                        FILL_NORMAL_MASK_PX(color)
-                        FILL_NORMAL_MASK_PX(color)
-                        FILL_NORMAL_MASK_PX(color)
-                    }
-                    else {
-                        mask += 4;
-                        dest_buf += 4;
-                    }
-                }
-
-                for(; x < w ; x++) {
-                    FILL_NORMAL_MASK_PX(color)
-                }
-                dest_buf += (dest_stride - w);
-                mask += (mask_stride - w);
-            }
-        }
-        /*With opacity*/
-        else {
-            /*Buffer the result color to avoid recalculating the same color*/
-            lv_color_t last_dest_color;
-            lv_color_t last_res_color;
-            lv_opa_t last_mask = LV_OPA_TRANSP;
-            last_dest_color.full = dest_buf[0].full;
-            last_res_color.full = dest_buf[0].full;
-            lv_opa_t opa_tmp = LV_OPA_TRANSP;
-
-            for(y = 0; y < h; y++) {
-                for(x = 0; x < w; x++) {
-                    if(*mask) {
-                        if(*mask != last_mask) opa_tmp = *mask == LV_OPA_COVER ? opa :
-                                                             (uint32_t)((uint32_t)(*mask) * opa) >> 8;
-                        if(*mask != last_mask || last_dest_color.full != dest_buf[x].full) {
-                            if(opa_tmp == LV_OPA_COVER) last_res_color = color;
-                            else last_res_color = lv_color_mix(color, dest_buf[x], opa_tmp);
-                            last_mask = *mask;
-                            last_dest_color.full = dest_buf[x].full;
-                        }
-                        dest_buf[x] = last_res_color;
-                    }
-                    mask++;
-                }
-                dest_buf += dest_stride;
-                mask += (mask_stride - w);
-            }
-        }
+        lv_draw_sw_blend_fill_mask(dest_buf, dest_stride, w, h, color, opa, mask, mask_stride);
     }
 }
 
@@ -652,7 +532,6 @@ static void LV_ATTRIBUTE_FAST_MEM map_normal(lv_color_t * dest_buf, const lv_are
     int32_t w = lv_area_get_width(dest_area);
     int32_t h = lv_area_get_height(dest_area);
 
-    int32_t x;
     int32_t y;
 
     /*Simple fill (maybe with opacity), no masking*/
@@ -665,76 +544,12 @@ static void LV_ATTRIBUTE_FAST_MEM map_normal(lv_color_t * dest_buf, const lv_are
             }
         }
         else {
-            for(y = 0; y < h; y++) {
-                for(x = 0; x < w; x++) {
-                    dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa);
-                }
-                dest_buf += dest_stride;
-                src_buf += src_stride;
-            }
+            lv_draw_sw_blend_map_opa(dest_buf, dest_stride, w, h, src_buf, src_stride, opa);
         }
     }
     /*Masked*/
     else {
-        /*Only the mask matters*/
-        if(opa > LV_OPA_MAX) {
-            int32_t x_end4 = w - 4;
-
-            for(y = 0; y < h; y++) {
-                const lv_opa_t * mask_tmp_x = mask;
-#if 0
-                for(x = 0; x < w; x++) {
-                    MAP_NORMAL_MASK_PX(x);
-                }
-#else
-                for(x = 0; x < w && ((lv_uintptr_t)mask_tmp_x & 0x3); x++) {
-                    MAP_NORMAL_MASK_PX(x)
-                }
-
-                uint32_t * mask32 = (uint32_t *)mask_tmp_x;
-                for(; x < x_end4; x += 4) {
-                    if(*mask32) {
-                        if((*mask32) == 0xFFFFFFFF) {
-                            dest_buf[x] = src_buf[x];
-                            dest_buf[x + 1] = src_buf[x + 1];
-                            dest_buf[x + 2] = src_buf[x + 2];
-                            dest_buf[x + 3] = src_buf[x + 3];
-                        }
-                        else {
-                            mask_tmp_x = (const lv_opa_t *)mask32;
-                            MAP_NORMAL_MASK_PX(x)
-                            MAP_NORMAL_MASK_PX(x + 1)
-                            MAP_NORMAL_MASK_PX(x + 2)
-                            MAP_NORMAL_MASK_PX(x + 3)
-                        }
-                    }
-                    mask32++;
-                }
-
-                mask_tmp_x = (const lv_opa_t *)mask32;
-                for(; x < w ; x++) {
-                    MAP_NORMAL_MASK_PX(x)
-                }
-#endif
-                dest_buf += dest_stride;
-                src_buf += src_stride;
-                mask += mask_stride;
-            }
-        }
-        /*Handle opa and mask values too*/
-        else {
-            for(y = 0; y < h; y++) {
-                for(x = 0; x < w; x++) {
-                    if(mask[x]) {
-                        lv_opa_t opa_tmp = mask[x] >= LV_OPA_MAX ? opa : ((opa * mask[x]) >> 8);
-                        dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa_tmp);
-                    }
-                }
-                dest_buf += dest_stride;
-                src_buf += src_stride;
-                mask += mask_stride;
-            }
-        }
+        lv_draw_sw_blend_map_mask(dest_buf, dest_stride, w, h, src_buf, src_stride, opa, mask, mask_stride);
     }
 }
 
@@ -0,0 +1,887 @@
+/**
+ * @file lv_draw_sw_blend_kernel.h
+ * Inner loops of the normal fill and map blending.
+ *
+ * Every loop comes in a scalar variant, which works with any color depth,
+ * and for RGB565 with LV_COLOR_MIX_ROUND_OFS == 0 in two more:
+ * - SWAR: two pixels in a 32 bit word with 32 bit integer operations only
+ *   (no 64 bit types, no division), for Xtensa and other MCUs
+ * - VECTOR: GCC vector extensions, 8 pixels in a 128 bit vector, for hosts with
+ *   SSE2 or NEON
+ *
+ * They produce exactly the pixels of the scalar variant: `lv_color_mix` with
+ * RGB565 only uses `(mix + 4) >> 3` and mixes every channel on its own, so a
+ * channel can be mixed in any lane that has room for it. The premultiplied
+ * fill divides by 255 the way `LV_UDIV255` does. The pixels before and after
+ * the aligned words or whole vectors use the scalar formulas.
+ * Runs of fully transparent or fully covering mask are skipped or copied
+ * 4 (SWAR) or 8 (VECTOR) pixels at once, like the scalar mask only loops do.
+ *
+ * `LV_DRAW_SW_BLEND_KERNEL` selects the variant at compile time. The default
+ * is SCALAR, which builds with any configuration; VECTOR only pays off on
+ * hosts. The Station selects SWAR in main/CMakeLists.txt (STATION_BLEND_KERNEL),
+ * `tests/main.py bench` compares it with SCALAR. Select the others with e.g.
+ * `-DLV_DRAW_SW_BLEND_KERNEL=LV_DRAW_SW_BLEND_KERNEL_SWAR`.
+ */
+
+#ifndef LV_DRAW_SW_BLEND_KERNEL_H
+#define LV_DRAW_SW_BLEND_KERNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../misc/lv_color.h"
+#include "../../misc/lv_area.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define LV_DRAW_SW_BLEND_KERNEL_SCALAR  0
+#define LV_DRAW_SW_BLEND_KERNEL_SWAR    1
+#define LV_DRAW_SW_BLEND_KERNEL_VECTOR  2
+
+#if LV_COLOR_DEPTH == 16 && LV_COLOR_MIX_ROUND_OFS == 0
+#define LV_DRAW_SW_BLEND_RGB565         1
+#else
+#define LV_DRAW_SW_BLEND_RGB565         0
+#endif
+
+/*`__builtin_convertvector` is in GCC since 9 and in every Clang with vector extensions*/
+#if LV_DRAW_SW_BLEND_RGB565 && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 9))
+#define LV_DRAW_SW_BLEND_HAS_VECTOR     1
+#else
+#define LV_DRAW_SW_BLEND_HAS_VECTOR     0
+#endif
+
+#ifndef LV_DRAW_SW_BLEND_KERNEL
+#define LV_DRAW_SW_BLEND_KERNEL LV_DRAW_SW_BLEND_KERNEL_SCALAR
+#endif
+
+#if LV_DRAW_SW_BLEND_KERNEL == LV_DRAW_SW_BLEND_KERNEL_SWAR && !LV_DRAW_SW_BLEND_RGB565
+#error "LV_DRAW_SW_BLEND_KERNEL_SWAR needs LV_COLOR_DEPTH 16 and LV_COLOR_MIX_ROUND_OFS 0"
+#endif
+
+#if LV_DRAW_SW_BLEND_KERNEL == LV_DRAW_SW_BLEND_KERNEL_VECTOR && !LV_DRAW_SW_BLEND_HAS_VECTOR
+#error "LV_DRAW_SW_BLEND_KERNEL_VECTOR needs LV_COLOR_DEPTH 16, LV_COLOR_MIX_ROUND_OFS 0 and GCC 9 or Clang"
+#endif
+
+#if LV_DRAW_SW_BLEND_KERNEL == LV_DRAW_SW_BLEND_KERNEL_VECTOR
+#define lv_draw_sw_blend_fill_opa   lv_draw_sw_blend_fill_opa_vector
+#define lv_draw_sw_blend_fill_mask  lv_draw_sw_blend_fill_mask_vector
+#define lv_draw_sw_blend_map_opa    lv_draw_sw_blend_map_opa_vector
+#define lv_draw_sw_blend_map_mask   lv_draw_sw_blend_map_mask_vector
+#elif LV_DRAW_SW_BLEND_KERNEL == LV_DRAW_SW_BLEND_KERNEL_SWAR
+#define lv_draw_sw_blend_fill_opa   lv_draw_sw_blend_fill_opa_swar
+#define lv_draw_sw_blend_fill_mask  lv_draw_sw_blend_fill_mask_swar
+#define lv_draw_sw_blend_map_opa    lv_draw_sw_blend_map_opa_swar
+#define lv_draw_sw_blend_map_mask   lv_draw_sw_blend_map_mask_swar
+#else
+#define lv_draw_sw_blend_fill_opa   lv_draw_sw_blend_fill_opa_scalar
+#define lv_draw_sw_blend_fill_mask  lv_draw_sw_blend_fill_mask_scalar
+#define lv_draw_sw_blend_map_opa    lv_draw_sw_blend_map_opa_scalar
+#define lv_draw_sw_blend_map_mask   lv_draw_sw_blend_map_mask_scalar
+#endif
+
+/**********************
+ *      MACROS
+ **********************/
+
+#define FILL_NORMAL_MASK_PX(color)                                                          \
+    if(*mask == LV_OPA_COVER) *dest_buf = color;                                 \
+    else *dest_buf = lv_color_mix(color, *dest_buf, *mask);            \
+    mask++;                                                         \
+    dest_buf++;
+
+#define MAP_NORMAL_MASK_PX(x)                                                          \
+    if(*mask_tmp_x) {          \
+        if(*mask_tmp_x == LV_OPA_COVER) dest_buf[x] = src_buf[x];                                 \
+        else dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], *mask_tmp_x);            \
+    }                                                                                               \
+    mask_tmp_x++;
+
+/**********************
+ *   SCALAR KERNELS
+ **********************/
+
+/**
+ * Fill `w` x `h` pixels with `color` mixed with `opa`.
+ * @param dest_buf      the first pixel to fill
+ * @param dest_stride   pixels from one row of `dest_buf` to the next
+ * @param w             width of the area
+ * @param h             height of the area
+ * @param color         the fill color
+ * @param opa           the opacity, below LV_OPA_MAX
+ */
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_opa_scalar(lv_color_t * dest_buf,
+                                                                          lv_coord_t dest_stride,
+                                                                          int32_t w, int32_t h,
+                                                                          lv_color_t color, lv_opa_t opa)
+{
+    int32_t x;
+    int32_t y;
+
+    lv_color_t last_dest_color = lv_color_black();
+    lv_color_t last_res_color = lv_color_mix(color, last_dest_color, opa);
+
+#if LV_COLOR_MIX_ROUND_OFS == 0 && LV_COLOR_DEPTH == 16
+    /*lv_color_mix work with an optimized algorithm with 16 bit color depth.
+     *However, it introduces some rounded error on opa.
+     *Introduce the same error here too to make lv_color_premult produces the same result */
+    opa = (uint32_t)((uint32_t)opa + 4) >> 3;
+    opa = opa << 3;
+#endif
+
+    uint16_t color_premult[3];
+    lv_color_premult(color, opa, color_premult);
+    lv_opa_t opa_inv = 255 - opa;
+
+    for(y = 0; y < h; y++) {
+        for(x = 0; x < w; x++) {
+            if(last_dest_color.full != dest_buf[x].full) {
+                last_dest_color = dest_buf[x];
+                last_res_color = lv_color_mix_premult(color_premult, dest_buf[x], opa_inv);
+            }
+            dest_buf[x] = last_res_color;
+        }
+        dest_buf += dest_stride;
+    }
+}
+
+/**
+ * Fill `w` x `h` pixels with `color` through a mask.
+ * @param dest_buf      the first pixel to fill
+ * @param dest_stride   pixels from one row of `dest_buf` to the next
+ * @param w             width of the area
+ * @param h             height of the area
+ * @param color         the fill color
+ * @param opa           the opacity, from LV_OPA_MAX on only the mask counts
+ * @param mask          the mask of the first pixel
+ * @param mask_stride   bytes from one row of `mask` to the next
+ */
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_mask_scalar(lv_color_t * dest_buf,
+                                                                           lv_coord_t dest_stride,
+                                                                           int32_t w, int32_t h,
+                                                                           lv_color_t color, lv_opa_t opa,
+                                                                           const lv_opa_t * mask,
+                                                                           lv_coord_t mask_stride)
+{
+    int32_t x;
+    int32_t y;
+
+#if LV_COLOR_DEPTH == 16
+    uint32_t c32 = color.full + ((uint32_t)color.full << 16);
+#endif
+    /*Only the mask matters*/
+    if(opa >= LV_OPA_MAX) {
+        int32_t x_end4 = w - 4;
+        for(y = 0; y < h; y++) {
+            for(x = 0; x < w && ((lv_uintptr_t)(mask) & 0x3); x++) {
+                FILL_NORMAL_MASK_PX(color)
+            }
+
+            for(; x <= x_end4; x += 4) {
+                uint32_t mask32 = *((uint32_t *)mask);
+                if(mask32 == 0xFFFFFFFF) {
+#if LV_COLOR_DEPTH == 16
+                    if((lv_uintptr_t)dest_buf & 0x3) {
+                        *(dest_buf + 0) = color;
+                        uint32_t * d = (uint32_t *)(dest_buf + 1);
+                        *d = c32;
+                        *(dest_buf + 3) = color;
+                    }
+                    else {
+                        uint32_t * d = (uint32_t *)dest_buf;
+                        *d = c32;
+                        *(d + 1) = c32;
+                    }
+#else
+                    dest_buf[0] = color;
+                    dest_buf[1] = color;
+                    dest_buf[2] = color;
+                    dest_buf[3] = color;
+#endif
+                    dest_buf += 4;
+                    mask += 4;
+                }
+                else if(mask32) {
+                    FILL_NORMAL_MASK_PX(color)
+                    FILL_NORMAL_MASK_PX(color)
+                    FILL_NORMAL_MASK_PX(color)
+                    FILL_NORMAL_MASK_PX(color)
+                }
+                else {
+                    mask += 4;
+                    dest_buf += 4;
+                }
+            }
+
+            for(; x < w ; x++) {
+                FILL_NORMAL_MASK_PX(color)
+            }
+            dest_buf += (dest_stride - w);
+            mask += (mask_stride - w);
+        }
+    }
+    /*With opacity*/
+    else {
+        /*Buffer the result color to avoid recalculating the same color*/
+        lv_color_t last_dest_color;
+        lv_color_t last_res_color;
+        lv_opa_t last_mask = LV_OPA_TRANSP;
+        last_dest_color.full = dest_buf[0].full;
+        last_res_color.full = dest_buf[0].full;
+        lv_opa_t opa_tmp = LV_OPA_TRANSP;
+
+        for(y = 0; y < h; y++) {
+            for(x = 0; x < w; x++) {
+                if(*mask) {
+                    if(*mask != last_mask) opa_tmp = *mask == LV_OPA_COVER ? opa :
+                                                         (uint32_t)((uint32_t)(*mask) * opa) >> 8;
+                    if(*mask != last_mask || last_dest_color.full != dest_buf[x].full) {
+                        if(opa_tmp == LV_OPA_COVER) last_res_color = color;
+                        else last_res_color = lv_color_mix(color, dest_buf[x], opa_tmp);
+                        last_mask = *mask;
+                        last_dest_color.full = dest_buf[x].full;
+                    }
+                    dest_buf[x] = last_res_color;
+                }
+                mask++;
+            }
+            dest_buf += dest_stride;
+            mask += (mask_stride - w);
+        }
+    }
+}
+
+/**
+ * Mix `w` x `h` pixels of `src_buf` into `dest_buf` with `opa`.
+ * @param dest_buf      the first pixel to blend to
+ * @param dest_stride   pixels from one row of `dest_buf` to the next
+ * @param w             width of the area
+ * @param h             height of the area
+ * @param src_buf       the first pixel to blend
+ * @param src_stride    pixels from one row of `src_buf` to the next
+ * @param opa           the opacity, below LV_OPA_MAX
+ */
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_opa_scalar(lv_color_t * dest_buf,
+                                                                         lv_coord_t dest_stride,
+                                                                         int32_t w, int32_t h,
+                                                                         const lv_color_t * src_buf,
+                                                                         lv_coord_t src_stride, lv_opa_t opa)
+{
+    int32_t x;
+    int32_t y;
+
+    for(y = 0; y < h; y++) {
+        for(x = 0; x < w; x++) {
+            dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa);
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+    }
+}
+
+/**
+ * Mix `w` x `h` pixels of `src_buf` into `dest_buf` through a mask.
+ * @param dest_buf      the first pixel to blend to
+ * @param dest_stride   pixels from one row of `dest_buf` to the next
+ * @param w             width of the area
+ * @param h             height of the area
+ * @param src_buf       the first pixel to blend
+ * @param src_stride    pixels from one row of `src_buf` to the next
+ * @param opa           the opacity, above LV_OPA_MAX only the mask counts
+ * @param mask          the mask of the first pixel
+ * @param mask_stride   bytes from one row of `mask` to the next
+ */
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_mask_scalar(lv_color_t * dest_buf,
+                                                                          lv_coord_t dest_stride,
+                                                                          int32_t w, int32_t h,
+                                                                          const lv_color_t * src_buf,
+                                                                          lv_coord_t src_stride, lv_opa_t opa,
+                                                                          const lv_opa_t * mask,
+                                                                          lv_coord_t mask_stride)
+{
+    int32_t x;
+    int32_t y;
+
+    /*Only the mask matters*/
+    if(opa > LV_OPA_MAX) {
+        int32_t x_end4 = w - 4;
+
+        for(y = 0; y < h; y++) {
+            const lv_opa_t * mask_tmp_x = mask;
+            for(x = 0; x < w && ((lv_uintptr_t)mask_tmp_x & 0x3); x++) {
+                MAP_NORMAL_MASK_PX(x)
+            }
+
+            uint32_t * mask32 = (uint32_t *)mask_tmp_x;
+            for(; x < x_end4; x += 4) {
+                if(*mask32) {
+                    if((*mask32) == 0xFFFFFFFF) {
+                        dest_buf[x] = src_buf[x];
+                        dest_buf[x + 1] = src_buf[x + 1];
+                        dest_buf[x + 2] = src_buf[x + 2];
+                        dest_buf[x + 3] = src_buf[x + 3];
+                    }
+                    else {
+                        mask_tmp_x = (const lv_opa_t *)mask32;
+                        MAP_NORMAL_MASK_PX(x)
+                        MAP_NORMAL_MASK_PX(x + 1)
+                        MAP_NORMAL_MASK_PX(x + 2)
+                        MAP_NORMAL_MASK_PX(x + 3)
+                    }
+                }
+                mask32++;
+            }
+
+            mask_tmp_x = (const lv_opa_t *)mask32;
+            for(; x < w ; x++) {
+                MAP_NORMAL_MASK_PX(x)
+            }
+            dest_buf += dest_stride;
+            src_buf += src_stride;
+            mask += mask_stride;
+        }
+    }
+    /*Handle opa and mask values too*/
+    else {
+        for(y = 0; y < h; y++) {
+            for(x = 0; x < w; x++) {
+                if(mask[x]) {
+                    lv_opa_t opa_tmp = mask[x] >= LV_OPA_MAX ? opa : ((opa * mask[x]) >> 8);
+                    dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa_tmp);
+                }
+            }
+            dest_buf += dest_stride;
+            src_buf += src_stride;
+            mask += mask_stride;
+        }
+    }
+}
+
+#if LV_DRAW_SW_BLEND_RGB565
+
+/**********************
+ *   SHARED HELPERS
+ **********************/
+
+/*The mix ratio of a masked fill pixel, `opa` is LV_OPA_COVER from LV_OPA_MAX on*/
+static inline lv_opa_t LV_ATTRIBUTE_FAST_MEM _lv_blend_fill_mask_mix(lv_opa_t mask, lv_opa_t opa)
+{
+    if(mask == LV_OPA_COVER) return opa;
+    if(opa == LV_OPA_COVER) return mask;
+    return (uint32_t)((uint32_t)mask * opa) >> 8;
+}
+
+/*The mix ratio of a masked map pixel, `opa` is LV_OPA_COVER above LV_OPA_MAX*/
+static inline lv_opa_t LV_ATTRIBUTE_FAST_MEM _lv_blend_map_mask_mix(lv_opa_t mask, lv_opa_t opa)
+{
+    if(opa == LV_OPA_COVER) return mask;
+    if(mask >= LV_OPA_MAX) return opa;
+    return (uint32_t)((uint32_t)opa * mask) >> 8;
+}
+
+/*`lv_color_mix` only uses the ratio in 1/32 steps, 0: the background, 32: the foreground*/
+#define _LV_BLEND_MIX32(mix)  (((uint32_t)(mix) + 4) >> 3)
+
+/**
+ * `lv_draw_sw_blend_fill_opa_scalar` remembers the last background color and
+ * starts with black mixed by `lv_color_mix`, while it mixes all other colors
+ * with `lv_color_mix_premult`. Black pixels before the first other color of the
+ * area get that result. Fills them and returns the pixel of the row to go on
+ * from, `w` if the whole row was black.
+ */
+static inline int32_t LV_ATTRIBUTE_FAST_MEM _lv_blend_fill_opa_black(lv_color_t * dest_buf, int32_t w,
+                                                                     lv_color_t black_res, bool * black_start)
+{
+    int32_t x = 0;
+    if(*black_start) {
+        while(x < w && dest_buf[x].full == 0) {
+            dest_buf[x] = black_res;
+            x++;
+        }
+        if(x < w) *black_start = false;
+    }
+    return x;
+}
+
+/**********************
+ *    SWAR KERNELS
+ **********************/
+
+/*Two pixels in the order they are in memory, alias anything like `lv_color_t`*/
+#if defined(__GNUC__)
+typedef uint32_t __attribute__((may_alias)) _lv_blend_swar_t;
+#else
+typedef uint32_t _lv_blend_swar_t;
+#endif
+
+/*Unpack the channels of both pixels of a word to lanes at bit 0 and 16 and pack them back*/
+#if LV_COLOR_16_SWAP == 0
+#define _LV_SWAR_R(w)           (((w) >> 11) & 0x001F001FU)
+#define _LV_SWAR_G(w)           (((w) >> 5) & 0x003F003FU)
+#define _LV_SWAR_B(w)           ((w) & 0x001F001FU)
+#define _LV_SWAR_PACK(r, g, b)  (((r) << 11) | ((g) << 5) | (b))
+#else
+/*`gggb bbbb rrrr rGGG`*/
+#define _LV_SWAR_R(w)           (((w) >> 3) & 0x001F001FU)
+#define _LV_SWAR_G(w)           ((((w) << 3) & 0x00380038U) | (((w) >> 13) & 0x00070007U))
+#define _LV_SWAR_B(w)           (((w) >> 8) & 0x001F001FU)
+#define _LV_SWAR_PACK(r, g, b)  (((r) << 3) | ((b) << 8) | (((g) >> 3) & 0x00070007U) | (((g) & 0x00070007U) << 13))
+#endif
+
+static inline uint32_t LV_ATTRIBUTE_FAST_MEM _lv_blend_swar_pair(lv_color_t c0, lv_color_t c1)
+{
+    union {
+        uint32_t w;
+        uint16_t px[2];
+    } pair;
+    pair.px[0] = c0.full;
+    pair.px[1] = c1.full;
+    return pair.w;
+}
+
+/*`lv_color_mix`'s layout of one pixel: the channels spread over a word, 5 free bits above each*/
+#if LV_COLOR_16_SWAP == 0
+#define _LV_SWAR_SPREAD_MASK    0x07E0F81FU
+#define _LV_SWAR_SPREAD(c)      (((uint32_t)(c) | ((uint32_t)(c) << 16)) & _LV_SWAR_SPREAD_MASK)
+#define _LV_SWAR_FOLD(s)        ((uint16_t)(((s) >> 16) | (s)))
+#else
+#define _LV_SWAR_SPREAD_MASK    0x03E0FC1FU
+#define _LV_SWAR_SPREAD(c)      ((((uint32_t)(c) | ((uint32_t)(c) << 16)) >> 3) & _LV_SWAR_SPREAD_MASK)
+#define _LV_SWAR_FOLD(s)        ((uint16_t)((((s) << 3) >> 16) | ((s) << 3)))
+#endif
+
+/*`lv_color_mix` of spread colors, `mix32` is already `_LV_BLEND_MIX32(mix)`*/
+#define _LV_SWAR_MIX(fs, bs, mix32)  (((((fs) - (bs)) * (mix32)) >> 5) + (bs)) & _LV_SWAR_SPREAD_MASK
+
+/**
+ * Mix the spread foregrounds `fs0` and `fs1` into the two pixels of `bg`, each
+ * with its own ratio. One multiplication per pixel like `lv_color_mix`, but
+ * one load and one store for the pair.
+ */
+static inline uint32_t LV_ATTRIBUTE_FAST_MEM _lv_blend_swar_mix(uint32_t fs0, uint32_t fs1, uint32_t bg,
+                                                                uint32_t mix0, uint32_t mix1)
+{
+    uint32_t bs0 = _LV_SWAR_SPREAD(bg & 0xFFFF);
+    uint32_t bs1 = _LV_SWAR_SPREAD(bg >> 16);
+    uint32_t r0 = _LV_SWAR_MIX(fs0, bs0, mix0);
+    uint32_t r1 = _LV_SWAR_MIX(fs1, bs1, mix1);
+    return _LV_SWAR_FOLD(r0) | ((uint32_t)_LV_SWAR_FOLD(r1) << 16);
+}
+
+/*Blend a pair through its mask, `opa` is LV_OPA_COVER from LV_OPA_MAX on*/
+static inline void LV_ATTRIBUTE_FAST_MEM _lv_blend_swar_fill_pair(_lv_blend_swar_t * d32, uint32_t c32, uint32_t fs,
+                                                                  const lv_opa_t * mask, lv_opa_t opa)
+{
+    if((mask[0] | mask[1]) == 0) return;
+    uint32_t mix0 = _LV_BLEND_MIX32(_lv_blend_fill_mask_mix(mask[0], opa));
+    uint32_t mix1 = _LV_BLEND_MIX32(_lv_blend_fill_mask_mix(mask[1], opa));
+    if((mix0 & mix1) == 32) *d32 = c32;
+    else *d32 = _lv_blend_swar_mix(fs, fs, *d32, mix0, mix1);
+}
+
+/*Blend a pair through its mask, `opa` is LV_OPA_COVER above LV_OPA_MAX*/
+static inline void LV_ATTRIBUTE_FAST_MEM _lv_blend_swar_map_pair(_lv_blend_swar_t * d32, const lv_color_t * src,
+                                                                 const lv_opa_t * mask, lv_opa_t opa)
+{
+    if((mask[0] | mask[1]) == 0) return;
+    uint32_t mix0 = _LV_BLEND_MIX32(_lv_blend_map_mask_mix(mask[0], opa));
+    uint32_t mix1 = _LV_BLEND_MIX32(_lv_blend_map_mask_mix(mask[1], opa));
+    if((mix0 & mix1) == 32) *d32 = _lv_blend_swar_pair(src[0], src[1]);
+    else *d32 = _lv_blend_swar_mix(_LV_SWAR_SPREAD(src[0].full), _LV_SWAR_SPREAD(src[1].full), *d32, mix0, mix1);
+}
+
+/*`LV_UDIV255` of both lanes: (x + 1 + (x >> 8)) >> 8 is the same below 65535*/
+#define _LV_SWAR_DIV255(x, lane)  ((((x) + 0x00010001U + (((x) >> 8) & 0x00FF00FFU)) >> 8) & (lane))
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_opa_swar(lv_color_t * dest_buf,
+                                                                        lv_coord_t dest_stride,
+                                                                        int32_t w, int32_t h,
+                                                                        lv_color_t color, lv_opa_t opa)
+{
+    lv_color_t black_res = lv_color_mix(color, lv_color_black(), opa);
+    bool black_start = true;
+
+    /*The opacity `lv_draw_sw_blend_fill_opa_scalar` premultiplies with, 8 bit like there*/
+    opa = (uint32_t)((uint32_t)opa + 4) >> 3;
+    opa = opa << 3;
+    uint16_t color_premult[3];
+    lv_color_premult(color, opa, color_premult);
+    uint32_t opa_inv = 255 - opa;
+
+    uint32_t c32 = _lv_blend_swar_pair(color, color);
+    uint32_t fr = _LV_SWAR_R(c32) * opa;
+    uint32_t fg = _LV_SWAR_G(c32) * opa;
+    uint32_t fb = _LV_SWAR_B(c32) * opa;
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x = _lv_blend_fill_opa_black(dest_buf, w, black_res, &black_start);
+        if(x < w && ((lv_uintptr_t)&dest_buf[x] & 0x3)) {
+            dest_buf[x] = lv_color_mix_premult(color_premult, dest_buf[x], opa_inv);
+            x++;
+        }
+        _lv_blend_swar_t * d32 = (_lv_blend_swar_t *)&dest_buf[x];
+        for(; x < w - 1; x += 2) {
+            uint32_t bg = *d32;
+            uint32_t r = fr + _LV_SWAR_R(bg) * opa_inv;
+            uint32_t g = fg + _LV_SWAR_G(bg) * opa_inv;
+            uint32_t b = fb + _LV_SWAR_B(bg) * opa_inv;
+            r = _LV_SWAR_DIV255(r, 0x001F001FU);
+            g = _LV_SWAR_DIV255(g, 0x003F003FU);
+            b = _LV_SWAR_DIV255(b, 0x001F001FU);
+            *d32 = _LV_SWAR_PACK(r, g, b);
+            d32++;
+        }
+        if(x < w) {
+            dest_buf[x] = lv_color_mix_premult(color_premult, dest_buf[x], opa_inv);
+        }
+        dest_buf += dest_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_mask_swar(lv_color_t * dest_buf,
+                                                                         lv_coord_t dest_stride,
+                                                                         int32_t w, int32_t h,
+                                                                         lv_color_t color, lv_opa_t opa,
+                                                                         const lv_opa_t * mask,
+                                                                         lv_coord_t mask_stride)
+{
+    if(opa >= LV_OPA_MAX) opa = LV_OPA_COVER;
+
+    uint32_t c32 = _lv_blend_swar_pair(color, color);
+    uint32_t fs = _LV_SWAR_SPREAD(color.full);
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x = 0;
+        if(w > 0 && ((lv_uintptr_t)dest_buf & 0x3)) {
+            dest_buf[0] = lv_color_mix(color, dest_buf[0], _lv_blend_fill_mask_mix(mask[0], opa));
+            x++;
+        }
+        _lv_blend_swar_t * d32 = (_lv_blend_swar_t *)&dest_buf[x];
+        for(; x < w - 3; x += 4) {
+            uint32_t mask32;
+            memcpy(&mask32, &mask[x], sizeof(mask32));
+            if(mask32 == 0xFFFFFFFF && opa == LV_OPA_COVER) {
+                d32[0] = c32;
+                d32[1] = c32;
+            }
+            else if(mask32) {
+                _lv_blend_swar_fill_pair(&d32[0], c32, fs, &mask[x], opa);
+                _lv_blend_swar_fill_pair(&d32[1], c32, fs, &mask[x + 2], opa);
+            }
+            d32 += 2;
+        }
+        if(x < w - 1) {
+            _lv_blend_swar_fill_pair(d32, c32, fs, &mask[x], opa);
+            x += 2;
+        }
+        if(x < w) {
+            dest_buf[x] = lv_color_mix(color, dest_buf[x], _lv_blend_fill_mask_mix(mask[x], opa));
+        }
+        dest_buf += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_opa_swar(lv_color_t * dest_buf,
+                                                                       lv_coord_t dest_stride,
+                                                                       int32_t w, int32_t h,
+                                                                       const lv_color_t * src_buf,
+                                                                       lv_coord_t src_stride, lv_opa_t opa)
+{
+    uint32_t mix32 = _LV_BLEND_MIX32(opa);
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x = 0;
+        if(w > 0 && ((lv_uintptr_t)dest_buf & 0x3)) {
+            dest_buf[0] = lv_color_mix(src_buf[0], dest_buf[0], opa);
+            x++;
+        }
+        _lv_blend_swar_t * d32 = (_lv_blend_swar_t *)&dest_buf[x];
+        for(; x < w - 1; x += 2) {
+            *d32 = _lv_blend_swar_mix(_LV_SWAR_SPREAD(src_buf[x].full), _LV_SWAR_SPREAD(src_buf[x + 1].full), *d32,
+                                      mix32, mix32);
+            d32++;
+        }
+        if(x < w) {
+            dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa);
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_mask_swar(lv_color_t * dest_buf,
+                                                                        lv_coord_t dest_stride,
+                                                                        int32_t w, int32_t h,
+                                                                        const lv_color_t * src_buf,
+                                                                        lv_coord_t src_stride, lv_opa_t opa,
+                                                                        const lv_opa_t * mask,
+                                                                        lv_coord_t mask_stride)
+{
+    if(opa > LV_OPA_MAX) opa = LV_OPA_COVER;
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x = 0;
+        if(w > 0 && ((lv_uintptr_t)dest_buf & 0x3)) {
+            dest_buf[0] = lv_color_mix(src_buf[0], dest_buf[0], _lv_blend_map_mask_mix(mask[0], opa));
+            x++;
+        }
+        _lv_blend_swar_t * d32 = (_lv_blend_swar_t *)&dest_buf[x];
+        for(; x < w - 3; x += 4) {
+            uint32_t mask32;
+            memcpy(&mask32, &mask[x], sizeof(mask32));
+            if(mask32 == 0xFFFFFFFF && opa == LV_OPA_COVER) {
+                d32[0] = _lv_blend_swar_pair(src_buf[x], src_buf[x + 1]);
+                d32[1] = _lv_blend_swar_pair(src_buf[x + 2], src_buf[x + 3]);
+            }
+            else if(mask32) {
+                _lv_blend_swar_map_pair(&d32[0], &src_buf[x], &mask[x], opa);
+                _lv_blend_swar_map_pair(&d32[1], &src_buf[x + 2], &mask[x + 2], opa);
+            }
+            d32 += 2;
+        }
+        if(x < w - 1) {
+            _lv_blend_swar_map_pair(d32, &src_buf[x], &mask[x], opa);
+            x += 2;
+        }
+        if(x < w) {
+            dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], _lv_blend_map_mask_mix(mask[x], opa));
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+        mask += mask_stride;
+    }
+}
+
+/**********************
+ *   VECTOR KERNELS
+ **********************/
+
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+
+#define _LV_BLEND_VEC_PX    8
+
+/*One pixel or one channel of a pixel in every lane*/
+typedef uint16_t _lv_blend_vec_t __attribute__((vector_size(_LV_BLEND_VEC_PX * 2)));
+typedef uint8_t _lv_blend_vec_mask_t __attribute__((vector_size(_LV_BLEND_VEC_PX)));
+
+#if LV_COLOR_16_SWAP == 0
+#define _LV_VEC_R(v)            ((v) >> 11)
+#define _LV_VEC_G(v)            (((v) >> 5) & 0x3F)
+#define _LV_VEC_B(v)            ((v) & 0x1F)
+#define _LV_VEC_PACK(r, g, b)   (((r) << 11) | ((g) << 5) | (b))
+#else
+#define _LV_VEC_R(v)            (((v) >> 3) & 0x1F)
+#define _LV_VEC_G(v)            ((((v) << 3) & 0x38) | ((v) >> 13))
+#define _LV_VEC_B(v)            (((v) >> 8) & 0x1F)
+#define _LV_VEC_PACK(r, g, b)   (((r) << 3) | ((b) << 8) | ((g) >> 3) | (((g) & 0x07) << 13))
+#endif
+
+static inline _lv_blend_vec_t LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_load(const lv_color_t * px)
+{
+    _lv_blend_vec_t v;
+    memcpy(&v, px, sizeof(v));
+    return v;
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_store(lv_color_t * px, _lv_blend_vec_t v)
+{
+    memcpy(px, &v, sizeof(v));
+}
+
+static inline _lv_blend_vec_t LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_load_mask(const lv_opa_t * mask)
+{
+    _lv_blend_vec_mask_t m;
+    memcpy(&m, mask, sizeof(m));
+    return __builtin_convertvector(m, _lv_blend_vec_t);
+}
+
+/*`f * mix32 + b * (32 - mix32)` is at most 63 * 32, every lane has its own ratio*/
+static inline _lv_blend_vec_t LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_mix(_lv_blend_vec_t fg, _lv_blend_vec_t bg,
+                                                                      _lv_blend_vec_t mix32)
+{
+    _lv_blend_vec_t inv32 = 32 - mix32;
+    _lv_blend_vec_t r = (_LV_VEC_R(fg) * mix32 + _LV_VEC_R(bg) * inv32) >> 5;
+    _lv_blend_vec_t g = (_LV_VEC_G(fg) * mix32 + _LV_VEC_G(bg) * inv32) >> 5;
+    _lv_blend_vec_t b = (_LV_VEC_B(fg) * mix32 + _LV_VEC_B(bg) * inv32) >> 5;
+    return _LV_VEC_PACK(r, g, b);
+}
+
+/*Lanes of `a` where `sel` is all ones, of `b` elsewhere*/
+#define _LV_VEC_SELECT(sel, a, b)  (((a) & (sel)) | ((b) & ~(sel)))
+
+static inline _lv_blend_vec_t LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_fill_mask_mix(_lv_blend_vec_t mask,
+                                                                                lv_opa_t opa)
+{
+    if(opa == LV_OPA_COVER) return mask;
+    _lv_blend_vec_t cover = (_lv_blend_vec_t)(mask == LV_OPA_COVER);
+    _lv_blend_vec_t opa_v = (_lv_blend_vec_t){0} + opa;
+    return _LV_VEC_SELECT(cover, opa_v, (mask * opa) >> 8);
+}
+
+static inline _lv_blend_vec_t LV_ATTRIBUTE_FAST_MEM _lv_blend_vec_map_mask_mix(_lv_blend_vec_t mask,
+                                                                               lv_opa_t opa)
+{
+    if(opa == LV_OPA_COVER) return mask;
+    _lv_blend_vec_t max = (_lv_blend_vec_t)(mask >= LV_OPA_MAX);
+    _lv_blend_vec_t opa_v = (_lv_blend_vec_t){0} + opa;
+    return _LV_VEC_SELECT(max, opa_v, (mask * opa) >> 8);
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_opa_vector(lv_color_t * dest_buf,
+                                                                          lv_coord_t dest_stride,
+                                                                          int32_t w, int32_t h,
+                                                                          lv_color_t color, lv_opa_t opa)
+{
+    lv_color_t black_res = lv_color_mix(color, lv_color_black(), opa);
+    bool black_start = true;
+
+    opa = (uint32_t)((uint32_t)opa + 4) >> 3;
+    opa = opa << 3;
+    uint16_t color_premult[3];
+    lv_color_premult(color, opa, color_premult);
+    lv_opa_t opa_inv = 255 - opa;
+
+    _lv_blend_vec_t c = (_lv_blend_vec_t){0} + color.full;
+    _lv_blend_vec_t fr = _LV_VEC_R(c) * opa;
+    _lv_blend_vec_t fg = _LV_VEC_G(c) * opa;
+    _lv_blend_vec_t fb = _LV_VEC_B(c) * opa;
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x = _lv_blend_fill_opa_black(dest_buf, w, black_res, &black_start);
+        for(; x <= w - _LV_BLEND_VEC_PX; x += _LV_BLEND_VEC_PX) {
+            _lv_blend_vec_t bg = _lv_blend_vec_load(&dest_buf[x]);
+            /*`LV_UDIV255` is (x + 1 + (x >> 8)) >> 8 below 65535, the sums are at most 63 * 255*/
+            _lv_blend_vec_t r = fr + _LV_VEC_R(bg) * opa_inv;
+            _lv_blend_vec_t g = fg + _LV_VEC_G(bg) * opa_inv;
+            _lv_blend_vec_t b = fb + _LV_VEC_B(bg) * opa_inv;
+            r = (r + 1 + (r >> 8)) >> 8;
+            g = (g + 1 + (g >> 8)) >> 8;
+            b = (b + 1 + (b >> 8)) >> 8;
+            _lv_blend_vec_store(&dest_buf[x], _LV_VEC_PACK(r, g, b));
+        }
+        for(; x < w; x++) {
+            dest_buf[x] = lv_color_mix_premult(color_premult, dest_buf[x], opa_inv);
+        }
+        dest_buf += dest_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_fill_mask_vector(lv_color_t * dest_buf,
+                                                                           lv_coord_t dest_stride,
+                                                                           int32_t w, int32_t h,
+                                                                           lv_color_t color, lv_opa_t opa,
+                                                                           const lv_opa_t * mask,
+                                                                           lv_coord_t mask_stride)
+{
+    if(opa >= LV_OPA_MAX) opa = LV_OPA_COVER;
+
+    _lv_blend_vec_t c = (_lv_blend_vec_t){0} + color.full;
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x;
+        for(x = 0; x <= w - _LV_BLEND_VEC_PX; x += _LV_BLEND_VEC_PX) {
+            uint64_t mask64;
+            memcpy(&mask64, &mask[x], sizeof(mask64));
+            if(mask64 == 0) continue;
+            if(mask64 == UINT64_MAX && opa == LV_OPA_COVER) {
+                _lv_blend_vec_store(&dest_buf[x], c);
+                continue;
+            }
+            _lv_blend_vec_t mix32 = (_lv_blend_vec_fill_mask_mix(_lv_blend_vec_load_mask(&mask[x]), opa) + 4) >> 3;
+            _lv_blend_vec_store(&dest_buf[x], _lv_blend_vec_mix(c, _lv_blend_vec_load(&dest_buf[x]), mix32));
+        }
+        for(; x < w; x++) {
+            dest_buf[x] = lv_color_mix(color, dest_buf[x], _lv_blend_fill_mask_mix(mask[x], opa));
+        }
+        dest_buf += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_opa_vector(lv_color_t * dest_buf,
+                                                                         lv_coord_t dest_stride,
+                                                                         int32_t w, int32_t h,
+                                                                         const lv_color_t * src_buf,
+                                                                         lv_coord_t src_stride, lv_opa_t opa)
+{
+    _lv_blend_vec_t mix32 = (_lv_blend_vec_t){0} + (uint16_t)_LV_BLEND_MIX32(opa);
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x;
+        for(x = 0; x <= w - _LV_BLEND_VEC_PX; x += _LV_BLEND_VEC_PX) {
+            _lv_blend_vec_t fg = _lv_blend_vec_load(&src_buf[x]);
+            _lv_blend_vec_store(&dest_buf[x], _lv_blend_vec_mix(fg, _lv_blend_vec_load(&dest_buf[x]), mix32));
+        }
+        for(; x < w; x++) {
+            dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], opa);
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+    }
+}
+
+static inline void LV_ATTRIBUTE_FAST_MEM lv_draw_sw_blend_map_mask_vector(lv_color_t * dest_buf,
+                                                                          lv_coord_t dest_stride,
+                                                                          int32_t w, int32_t h,
+                                                                          const lv_color_t * src_buf,
+                                                                          lv_coord_t src_stride, lv_opa_t opa,
+                                                                          const lv_opa_t * mask,
+                                                                          lv_coord_t mask_stride)
+{
+    if(opa > LV_OPA_MAX) opa = LV_OPA_COVER;
+
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        int32_t x;
+        for(x = 0; x <= w - _LV_BLEND_VEC_PX; x += _LV_BLEND_VEC_PX) {
+            uint64_t mask64;
+            memcpy(&mask64, &mask[x], sizeof(mask64));
+            if(mask64 == 0) continue;
+            _lv_blend_vec_t fg = _lv_blend_vec_load(&src_buf[x]);
+            if(mask64 == UINT64_MAX && opa == LV_OPA_COVER) {
+                _lv_blend_vec_store(&dest_buf[x], fg);
+                continue;
+            }
+            _lv_blend_vec_t mix32 = (_lv_blend_vec_map_mask_mix(_lv_blend_vec_load_mask(&mask[x]), opa) + 4) >> 3;
+            _lv_blend_vec_store(&dest_buf[x], _lv_blend_vec_mix(fg, _lv_blend_vec_load(&dest_buf[x]), mix32));
+        }
+        for(; x < w; x++) {
+            dest_buf[x] = lv_color_mix(src_buf[x], dest_buf[x], _lv_blend_map_mask_mix(mask[x], opa));
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+        mask += mask_stride;
+    }
+}
+
+#endif /*LV_DRAW_SW_BLEND_HAS_VECTOR*/
+
+#endif /*LV_DRAW_SW_BLEND_RGB565*/
+
+/*The pixel macros are only for the kernels above*/
+#undef FILL_NORMAL_MASK_PX
+#undef MAP_NORMAL_MASK_PX
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*LV_DRAW_SW_BLEND_KERNEL_H*/
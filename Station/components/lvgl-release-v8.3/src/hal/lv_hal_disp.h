@@ -102,6 +102,10 @@ typedef struct _lv_disp_drv_t {
 
     uint32_t dpi : 10;              /** DPI (dot per inch) of the display. Default value is `LV_DPI_DEF`.*/
 
+    /** Cost of one more flush in pixels, e.g. the window commands an SPI panel needs before every area.
+     * Invalidated areas are joined, also across gaps, when that saves more than it costs. 0: only join overlapping areas*/
+    uint32_t flush_overhead_px;
+
     /** MANDATORY: Write the internal buffer (draw_buf) to the display. 'lv_disp_flush_ready()' has to be
      * called when finished*/
     void (*flush_cb)(struct _lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
@@ -229,6 +229,50 @@ void _lv_area_join(lv_area_t * a_res_p, const lv_area_t * a1_p, const lv_area_t
     a_res_p->y2 = LV_MAX(a1_p->y2, a2_p->y2);
 }
 
+/**
+ * Join the areas of a list where drawing the joined area is cheaper than drawing them one by one
+ * @param areas array of areas, areas other areas were joined into are enlarged in place
+ * @param joined 1 for the areas already joined into an other one, updated with the new joins
+ * @param cnt number of areas
+ * @param overhead_px cost of one more area in pixels (e.g. the commands sent before each flush).
+ *                    0: join only areas on each other, and only if the result is smaller
+ */
+void _lv_area_join_list(lv_area_t areas[], uint8_t joined[], uint32_t cnt, uint32_t overhead_px)
+{
+    lv_area_t joined_area;
+    bool changed;
+    do {
+        changed = false;
+        uint32_t join_in;
+        for(join_in = 0; join_in < cnt; join_in++) {
+            if(joined[join_in] != 0) continue;
+
+            /*Check all areas to join them in 'join_in'*/
+            uint32_t join_from;
+            for(join_from = 0; join_from < cnt; join_from++) {
+                /*Handle only unjoined areas and ignore itself*/
+                if(joined[join_from] != 0 || join_in == join_from) continue;
+
+                /*Without overhead only areas on each other can get smaller by joining*/
+                if(overhead_px == 0 && _lv_area_is_on(&areas[join_in], &areas[join_from]) == false) continue;
+
+                _lv_area_join(&joined_area, &areas[join_in], &areas[join_from]);
+
+                /*Join if one area with the extra pixels costs less than two areas*/
+                if(lv_area_get_size(&joined_area) < lv_area_get_size(&areas[join_in]) +
+                   lv_area_get_size(&areas[join_from]) + overhead_px) {
+                    lv_area_copy(&areas[join_in], &joined_area);
+
+                    /*Mark 'join_form' is joined into 'join_in'*/
+                    joined[join_from] = 1;
+                    changed = true;
+                }
+            }
+        }
+        /*A grown area can pay off with areas checked before it grew*/
+    } while(changed && overhead_px != 0);
+}
+
 /**
  * Check if a point is on an area
  * @param a_p pointer to an area
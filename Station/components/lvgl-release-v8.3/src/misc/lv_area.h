@@ -194,6 +194,16 @@ int8_t _lv_area_diff(lv_area_t * res_p, const lv_area_t * a1_p, const lv_area_t
  */
 void _lv_area_join(lv_area_t * a_res_p, const lv_area_t * a1_p, const lv_area_t * a2_p);
 
+/**
+ * Join the areas of a list where drawing the joined area is cheaper than drawing them one by one
+ * @param areas array of areas, areas other areas were joined into are enlarged in place
+ * @param joined 1 for the areas already joined into an other one, updated with the new joins
+ * @param cnt number of areas
+ * @param overhead_px cost of one more area in pixels (e.g. the commands sent before each flush).
+ *                    0: join only areas on each other, and only if the result is smaller
+ */
+void _lv_area_join_list(lv_area_t areas[], uint8_t joined[], uint32_t cnt, uint32_t overhead_px);
+
 /**
  * Check if a point is on an area
  * @param a_p pointer to an area
@@ -3,7 +3,9 @@
 import argparse
 import errno
 import glob
+import json
 import shutil
+import statistics
 import subprocess
 import sys
 import os
@@ -22,16 +24,33 @@ build_only_options = {
 test_options = {
     'OPTIONS_TEST_SYSHEAP': 'Test config, system heap, 32 bit color depth',
     'OPTIONS_TEST_DEFHEAP': 'Test config, LVGL heap, 32 bit color depth',
+    'OPTIONS_TEST_16BIT_SWAP': 'Test config, 16 bit color depth swapped, blend kernels only',
 }
 
+bench_options = {
+    'OPTIONS_BENCH': 'Bench config, 16 bit color depth swapped, release build',
+    'OPTIONS_BENCH_SWAR': 'Bench config, 16 bit color depth swapped, SWAR blend kernel, release build',
+}
+
+# How often a case that looks slower is run again before it is a regression.
+bench_reruns = 2
+
+# Runs of bench_draw whose median per case makes a baseline. Now and then a
+# whole run comes out faster, a baseline of one such run would make every
+# later run look slower.
+bench_baseline_runs = 3
+
 
 def is_valid_option_name(option_name):
-    return option_name in build_only_options or option_name in test_options
+    return (option_name in build_only_options or option_name in test_options
+            or option_name in bench_options)
 
 
 def get_option_description(option_name):
     if option_name in build_only_options:
         return build_only_options[option_name]
+    if option_name in bench_options:
+        return bench_options[option_name]
     return test_options[option_name]
 
 
@@ -81,8 +100,8 @@ def get_build_dir(options_name):
     return os.path.join(lvgl_test_dir, get_base_buid_dir(options_name))
 
 
-def build_tests(options_name, build_type, clean):
-    '''Build all tests for the specified options name.'''
+def build_tests(options_name, build_type, clean, target=None):
+    '''Build all tests (or only target) for the specified options name.'''
     global lvgl_test_dir
 
     print()
@@ -107,8 +126,10 @@ def build_tests(options_name, build_type, clean):
     if created_build_dir:
         subprocess.check_call(['cmake', '-DCMAKE_BUILD_TYPE=%s' % build_type,
                                '-D%s=1' % options_name, '..'])
-    subprocess.check_call(['cmake', '--build', build_dir,
-                           '--parallel', str(os.cpu_count())])
+    cmd = ['cmake', '--build', build_dir, '--parallel', str(os.cpu_count())]
+    if target:
+        cmd.extend(['--target', target])
+    subprocess.check_call(cmd)
 
 
 def run_tests(options_name):
@@ -126,6 +147,120 @@ def run_tests(options_name):
         ['ctest', '--timeout', '30', '--parallel', str(os.cpu_count()), '--output-on-failure'])
 
 
+def bench_relative(result):
+    '''Map the case names of a bench_draw result to their time relative to
+    the reference case.'''
+    return {r['name']: r['relative'] for r in result['results'] if r['name'] != 'reference'}
+
+
+def bench_draw(options_name, result_file, names=()):
+    '''Run bench_draw of the options name, on the named cases only if any.'''
+    build_dir = get_build_dir(options_name)
+    subprocess.check_call([os.path.join(build_dir, 'bench_draw'), result_file] + list(names))
+    with open(result_file) as f:
+        return json.load(f)
+
+
+def run_bench(options_name, baseline_dir, threshold, update_baseline):
+    '''Run the draw benchmarks and compare them with the baseline.
+
+    The cases are compared relative to the in-run reference case. A case
+    more than threshold percent slower is run again up to bench_reruns times
+    and only counts if it stays that slow. Returns the number of such cases
+    and of cases missing from the results.'''
+    global lvgl_test_dir
+
+    print()
+    print()
+    label = 'Running benchmarks for %s' % options_abbrev(options_name)
+    print('=' * len(label))
+    print(label)
+    print('=' * len(label), flush=True)
+
+    result_file = os.path.join(get_build_dir(options_name), 'bench_draw.json')
+    results = bench_draw(options_name, result_file)
+
+    os.chdir(lvgl_test_dir)
+    baseline_file = os.path.join(baseline_dir, 'bench_draw_%s.json' % options_abbrev(options_name))
+    if update_baseline:
+        runs = [results] + [bench_draw(options_name, result_file + '.%d' % run)
+                            for run in range(1, bench_baseline_runs)]
+        for i, res in enumerate(results['results']):
+            for key in ('ns_per_op', 'relative', 'mpx_per_s'):
+                res[key] = statistics.median(run['results'][i][key] for run in runs)
+        os.makedirs(baseline_dir, exist_ok=True)
+        with open(baseline_file, 'w') as f:
+            json.dump(results, f, indent=2)
+        print('Baseline updated with the median of %d runs: %s' % (len(runs), baseline_file), flush=True)
+        return 0
+    if not os.path.isfile(baseline_file):
+        print('No baseline %s, run with --update-baseline on this machine' % baseline_file)
+        return 0
+    with open(baseline_file) as f:
+        baseline = json.load(f)
+
+    for key in ('color_depth', 'color_16_swap', 'blend_kernel'):
+        if baseline.get(key) != results.get(key):
+            print('Warning: %s is %s, the baseline has %s' %
+                  (key, results.get(key), baseline.get(key)))
+
+    ref = bench_relative(baseline)
+    current = bench_relative(results)
+
+    def change(name):
+        return (current[name] / ref[name] - 1) * 100
+
+    slower = [name for name in ref if name in current and change(name) > threshold]
+    for _ in range(bench_reruns):
+        if not slower:
+            break
+        print('Running again: %s' % ' '.join(slower), flush=True)
+        again = bench_relative(bench_draw(options_name, result_file + '.rerun', slower))
+        for name in slower:
+            if name in again and again[name] < current[name]:
+                current[name] = again[name]
+        slower = [name for name in slower if change(name) > threshold]
+
+    failed = 0
+    print()
+    print('%-22s %12s %12s %8s' % ('case', 'baseline', 'now', 'change'))
+    for name in ref:
+        if name not in current:
+            print('%-22s %12.3f %12s %8s  MISSING' % (name, ref[name], '-', '-'))
+            failed += 1
+            continue
+        regressed = name in slower
+        print('%-22s %12.3f %12.3f %+7.1f%%%s' %
+              (name, ref[name], current[name], change(name),
+               '  REGRESSION' if regressed else ''))
+        if regressed:
+            failed += 1
+    print(flush=True)
+    if failed:
+        print('%d benchmark(s) more than %g%% slower than %s or missing' %
+              (failed, threshold, baseline_file), file=sys.stderr)
+    return failed
+
+
+def compare_bench_kernels(options_names):
+    '''Print the blend cases of the last results of every bench config side
+    by side, relative to their reference case.'''
+    results = {}
+    for options_name in options_names:
+        result_file = os.path.join(get_build_dir(options_name), 'bench_draw.json')
+        if os.path.isfile(result_file):
+            with open(result_file) as f:
+                results[options_name] = bench_relative(json.load(f))
+    if len(results) < 2:
+        return
+    names = list(results)
+    print('%-22s' % 'case' + ''.join(' %14s' % options_abbrev(n) for n in names))
+    for case in results[names[0]]:
+        if case.startswith('blend_'):
+            print('%-22s' % case + ''.join(' %14.3f' % results[n].get(case, float('nan')) for n in names))
+    print(flush=True)
+
+
 def generate_code_coverage_report():
     '''Produce code coverage test reports for the test execution.'''
     global lvgl_test_dir
@@ -159,7 +294,8 @@ if __name__ == "__main__":
     There are two types of LVGL tests: "build", and "test". The build-only
     tests, as their name suggests, only verify that the program successfully
     compiles and links (with various build options). There are also a set of
-    tests that execute to verify correct LVGL library behavior.
+    tests that execute to verify correct LVGL library behavior. "bench"
+    times the software renderer and compares the timings with a baseline.
     '''
     parser = argparse.ArgumentParser(
         description='Build and/or run LVGL tests.', epilog=epilog)
@@ -171,8 +307,20 @@ if __name__ == "__main__":
                         help='clean existing build artifacts before operation.')
     parser.add_argument('--report', action='store_true',
                         help='generate code coverage report for tests.')
-    parser.add_argument('actions', nargs='*', choices=['build', 'test'],
-                        help='build: compile build tests, test: compile/run executable tests.')
+    parser.add_argument('--bench-baseline-dir', default='bench_baseline',
+                        help='''where the benchmark results to compare with
+                        are kept, one file per bench config. Baselines are
+                        only comparable on the machine they were taken on.''')
+    parser.add_argument('--bench-threshold', type=float, default=25,
+                        help='''the percentage a benchmark may be slower
+                        than its baseline, relative to the reference case,
+                        before it is a regression.''')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='store the benchmark results as the baseline.')
+    parser.add_argument('actions', nargs='*', choices=['build', 'test', 'bench'],
+                        help='''build: compile build tests, test: compile/run
+                        executable tests, bench: compile/run the draw
+                        benchmarks.''')
 
     args = parser.parse_args()
 
@@ -184,6 +332,8 @@ if __name__ == "__main__":
                 options_to_build = {**build_only_options, **test_options}
             else:
                 options_to_build = build_only_options
+        elif args.actions == ['bench']:
+            options_to_build = {}
         else:
             options_to_build = test_options
 
@@ -195,6 +345,9 @@ if __name__ == "__main__":
     generate_test_runners()
 
     for options_name in options_to_build:
+        if options_name in bench_options:
+            build_tests(options_name, 'Release', args.clean, 'bench_draw')
+            continue
         is_test = options_name in test_options
         build_type = 'Debug'
         build_tests(options_name, build_type, args.clean)
@@ -204,5 +357,17 @@ if __name__ == "__main__":
             except subprocess.CalledProcessError as e:
                 sys.exit(e.returncode)
 
+    if 'bench' in args.actions:
+        to_bench = [o for o in options_to_build if o in bench_options] or list(bench_options)
+        failed = 0
+        for options_name in to_bench:
+            if options_name not in options_to_build:
+                build_tests(options_name, 'Release', args.clean, 'bench_draw')
+            failed += run_bench(options_name, os.path.join(lvgl_test_dir, args.bench_baseline_dir),
+                                args.bench_threshold, args.update_baseline)
+        compare_bench_kernels(to_bench)
+        if failed:
+            sys.exit(1)
+
     if args.report:
         generate_code_coverage_report()
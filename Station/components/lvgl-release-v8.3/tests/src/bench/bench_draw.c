@@ -0,0 +1,524 @@
+/**
+ * @file bench_draw.c
+ * Timing of the software renderer's hot paths.
+ *
+ * Every case draws into one 320 x 20 pixel stripe, the draw buffer of a
+ * 320 x 240 panel with 20 buffered lines: blending, rectangles with radius,
+ * border, shadow and gradients, a line of letters, masks and transformed
+ * images. A round of a case takes about BENCH_ROUND_NS and the median of
+ * BENCH_ROUNDS rounds counts. The "reference" case is plain C without LVGL
+ * and is always run: every round of a case follows a round of it, and the
+ * median of the ratios is the case's time relative to the host's speed at
+ * that moment, which a comparison with another run can rely on.
+ *
+ * Usage: bench_draw [result.json [case ...]]
+ * Only the named cases are run when there are any. `main.py bench` builds it
+ * with the bench_options, runs it and compares the result with a baseline
+ * taken on the same machine.
+ */
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+#include "lv_test_init.h"
+#include "../src/draw/sw/lv_draw_sw.h"
+#include "../src/draw/sw/lv_draw_sw_blend_kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define BENCH_HOR_RES   320
+#define BENCH_LINES     20
+#define BENCH_Y         40      /*The stripe's first line on the screen*/
+#define BENCH_ROUNDS    15
+#define BENCH_ROUND_NS  10000000
+
+#define IMG_SIZE        64
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    const char * name;
+    void (*setup)(void);
+    void (*run)(void);
+    void (*teardown)(void);
+    uint32_t px;                /*Pixels one run draws or computes*/
+    double ns_per_op;
+    double relative;            /*To the reference case*/
+    bool run_it;
+    uint32_t runs;              /*In one round*/
+    double ns[BENCH_ROUNDS];
+    double ratio[BENCH_ROUNDS];
+} bench_case_t;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_draw_ctx_t * draw_ctx;
+static lv_color_t stripe[BENCH_HOR_RES * BENCH_LINES];
+static lv_color_t stripe_start[BENCH_HOR_RES * BENCH_LINES];
+static lv_color_t src_buf[BENCH_HOR_RES * BENCH_LINES];
+static lv_opa_t mask_buf[BENCH_HOR_RES * BENCH_LINES];
+static const lv_area_t stripe_area = {0, BENCH_Y, BENCH_HOR_RES - 1, BENCH_Y + BENCH_LINES - 1};
+static lv_area_t clip_area;
+
+/*A widget box like the Station's message box, its top edge in the stripe*/
+static const lv_area_t box_area = {20, BENCH_Y + 5, 299, BENCH_Y + 68};
+
+static lv_draw_sw_blend_dsc_t blend_dsc;
+static lv_draw_rect_dsc_t rect_dsc;
+static lv_draw_label_dsc_t label_dsc;
+static const char * label_text = "Text received from paired device:";
+
+static lv_draw_mask_radius_param_t radius_param;
+static lv_draw_mask_line_param_t line_param;
+static int16_t mask_id;
+
+static lv_color_t img_buf[IMG_SIZE * IMG_SIZE];
+static lv_draw_img_dsc_t img_dsc;
+static const lv_area_t img_dest_area = {0, 22, IMG_SIZE - 1, 22 + BENCH_LINES - 1};
+static lv_color_t transform_cbuf[IMG_SIZE * BENCH_LINES];
+static lv_opa_t transform_abuf[IMG_SIZE * BENCH_LINES];
+
+static uint32_t rnd_state = 0x12345678;
+static uint16_t reference_buf[BENCH_HOR_RES * BENCH_LINES];
+static volatile uint32_t reference_sink;
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void nothing(void)
+{
+}
+
+/*Both stripes mixed half and half channel by channel into a third, plain C that keeps the CPU as busy as the cases*/
+static void reference_run(void)
+{
+    uint32_t i;
+    for(i = 0; i < BENCH_HOR_RES * BENCH_LINES; i++) {
+        uint32_t a = stripe[i].full;
+        uint32_t b = src_buf[i].full;
+        uint32_t rb = (((a & 0xF81F) + (b & 0xF81F)) >> 1) & 0xF81F;
+        uint32_t g = (((a & 0x07E0) + (b & 0x07E0)) >> 1) & 0x07E0;
+        reference_buf[i] = (uint16_t)(rb | g);
+    }
+    reference_sink = reference_buf[rnd_state % (BENCH_HOR_RES * BENCH_LINES)];
+}
+
+/*The stripe crossing the edges of a rounded rectangle: 0 outside, a short anti-aliased ramp, 255 inside*/
+static void mask_edge(void)
+{
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < BENCH_LINES; y++) {
+        int32_t in = 12 - y / 2;
+        for(x = 0; x < BENCH_HOR_RES; x++) {
+            int32_t d = x < BENCH_HOR_RES / 2 ? x - in : BENCH_HOR_RES - 1 - x - in;
+            mask_buf[y * BENCH_HOR_RES + x] = d < 0 ? LV_OPA_TRANSP : d >= 3 ? LV_OPA_COVER : (lv_opa_t)(d * 85 + 40);
+        }
+    }
+}
+
+static void blend_setup(lv_opa_t opa, bool masked, bool map)
+{
+    lv_memset_00(&blend_dsc, sizeof(blend_dsc));
+    blend_dsc.blend_area = &stripe_area;
+    blend_dsc.color = lv_color_make(0x21, 0x96, 0xF3);
+    blend_dsc.opa = opa;
+    blend_dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+    blend_dsc.src_buf = map ? src_buf : NULL;
+    if(masked) {
+        mask_edge();
+        blend_dsc.mask_buf = mask_buf;
+        blend_dsc.mask_area = &stripe_area;
+        blend_dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+    }
+    else {
+        blend_dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+    }
+}
+
+static void blend_fill_setup(void)
+{
+    blend_setup(LV_OPA_COVER, false, false);
+}
+
+static void blend_fill_opa_setup(void)
+{
+    blend_setup(LV_OPA_50, false, false);
+}
+
+static void blend_fill_mask_setup(void)
+{
+    blend_setup(LV_OPA_COVER, true, false);
+}
+
+static void blend_fill_mask_opa_setup(void)
+{
+    blend_setup(LV_OPA_50, true, false);
+}
+
+static void blend_map_opa_setup(void)
+{
+    blend_setup(LV_OPA_50, false, true);
+}
+
+static void blend_map_mask_setup(void)
+{
+    blend_setup(LV_OPA_COVER, true, true);
+}
+
+static void blend_run(void)
+{
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+}
+
+static void rect_setup(void)
+{
+    lv_draw_rect_dsc_init(&rect_dsc);
+    rect_dsc.bg_color = lv_color_make(0xFF, 0xFF, 0xFF);
+}
+
+static void rect_radius_border_setup(void)
+{
+    rect_setup();
+    rect_dsc.radius = 8;
+    rect_dsc.border_width = 2;
+    rect_dsc.border_color = lv_color_make(0xE0, 0xE0, 0xE0);
+}
+
+static void rect_shadow_setup(void)
+{
+    rect_radius_border_setup();
+    rect_dsc.shadow_width = 15;
+    rect_dsc.shadow_ofs_y = 4;
+    rect_dsc.shadow_opa = LV_OPA_30;
+}
+
+static void rect_grad_setup(lv_grad_dir_t dir)
+{
+    rect_setup();
+    rect_dsc.radius = 8;
+    rect_dsc.bg_grad.dir = dir;
+    rect_dsc.bg_grad.stops_count = 2;
+    rect_dsc.bg_grad.stops[0].color = lv_color_make(0x21, 0x96, 0xF3);
+    rect_dsc.bg_grad.stops[0].frac = 0;
+    rect_dsc.bg_grad.stops[1].color = lv_color_make(0xF4, 0x43, 0x36);
+    rect_dsc.bg_grad.stops[1].frac = 255;
+}
+
+static void rect_grad_ver_setup(void)
+{
+    rect_grad_setup(LV_GRAD_DIR_VER);
+}
+
+static void rect_grad_hor_setup(void)
+{
+    rect_grad_setup(LV_GRAD_DIR_HOR);
+}
+
+static void rect_run(void)
+{
+    lv_draw_sw_rect(draw_ctx, &rect_dsc, &box_area);
+}
+
+static void letter_setup(void)
+{
+    lv_draw_label_dsc_init(&label_dsc);
+    label_dsc.font = LV_FONT_DEFAULT;
+    label_dsc.color = lv_color_make(0x20, 0x20, 0x20);
+}
+
+static void letter_run(void)
+{
+    lv_point_t pos = {10, BENCH_Y + 2};
+    const char * txt = label_text;
+    while(*txt) {
+        lv_draw_sw_letter(draw_ctx, &label_dsc, &pos, (uint32_t) * txt);
+        pos.x += lv_font_get_glyph_width(label_dsc.font, (uint32_t)txt[0], (uint32_t)txt[1]);
+        txt++;
+    }
+}
+
+static void mask_radius_setup(void)
+{
+    lv_draw_mask_radius_init(&radius_param, &box_area, 8, false);
+    mask_id = lv_draw_mask_add(&radius_param, NULL);
+}
+
+static void mask_line_setup(void)
+{
+    lv_draw_mask_line_points_init(&line_param, 0, BENCH_Y - 10, BENCH_HOR_RES - 1, BENCH_Y + BENCH_LINES + 10,
+                                  LV_DRAW_MASK_LINE_SIDE_BOTTOM);
+    mask_id = lv_draw_mask_add(&line_param, NULL);
+}
+
+static void mask_teardown(void)
+{
+    lv_draw_mask_free_param(lv_draw_mask_remove_id(mask_id));
+}
+
+static void mask_run(void)
+{
+    int32_t y;
+    for(y = 0; y < BENCH_LINES; y++) {
+        lv_opa_t * line = &mask_buf[y * BENCH_HOR_RES];
+        lv_memset_ff(line, BENCH_HOR_RES);
+        lv_draw_mask_apply(line, 0, BENCH_Y + y, BENCH_HOR_RES);
+    }
+}
+
+static void transform_setup(int16_t angle, uint16_t zoom)
+{
+    lv_draw_img_dsc_init(&img_dsc);
+    img_dsc.angle = angle;
+    img_dsc.zoom = zoom;
+    img_dsc.pivot.x = IMG_SIZE / 2;
+    img_dsc.pivot.y = IMG_SIZE / 2;
+}
+
+static void transform_rotate_setup(void)
+{
+    transform_setup(300, LV_IMG_ZOOM_NONE);
+}
+
+static void transform_zoom_setup(void)
+{
+    transform_setup(0, LV_IMG_ZOOM_NONE * 3 / 2);
+}
+
+static void transform_run(void)
+{
+#if LV_DRAW_COMPLEX
+    lv_draw_sw_transform(draw_ctx, &img_dest_area, img_buf, IMG_SIZE, IMG_SIZE, IMG_SIZE, &img_dsc,
+                         LV_IMG_CF_TRUE_COLOR, transform_cbuf, transform_abuf);
+#endif
+}
+
+#define BENCH_CASE(name, setup, run, teardown, px) {name, setup, run, teardown, px, 0, 0, true, 0, {0}, {0}}
+
+/*The reference first, the others are reported relative to it*/
+static bench_case_t cases[] = {
+    BENCH_CASE("reference", nothing, reference_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_fill", blend_fill_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_fill_opa", blend_fill_opa_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_fill_mask", blend_fill_mask_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_fill_mask_opa", blend_fill_mask_opa_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_map_opa", blend_map_opa_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("blend_map_mask", blend_map_mask_setup, blend_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("rect", rect_setup, rect_run, nothing, 280 * (BENCH_LINES - 5)),
+    BENCH_CASE("rect_radius_border", rect_radius_border_setup, rect_run, nothing, 280 * (BENCH_LINES - 5)),
+    BENCH_CASE("rect_shadow", rect_shadow_setup, rect_run, nothing, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("rect_grad_ver", rect_grad_ver_setup, rect_run, nothing, 280 * (BENCH_LINES - 5)),
+    BENCH_CASE("rect_grad_hor", rect_grad_hor_setup, rect_run, nothing, 280 * (BENCH_LINES - 5)),
+    BENCH_CASE("letter_line", letter_setup, letter_run, nothing, 0),
+    BENCH_CASE("mask_radius", mask_radius_setup, mask_run, mask_teardown, BENCH_HOR_RES * BENCH_LINES),
+    BENCH_CASE("mask_line", mask_line_setup, mask_run, mask_teardown, BENCH_HOR_RES * BENCH_LINES),
+#if LV_DRAW_COMPLEX
+    BENCH_CASE("transform_rotate", transform_rotate_setup, transform_run, nothing, IMG_SIZE * BENCH_LINES),
+    BENCH_CASE("transform_zoom", transform_zoom_setup, transform_run, nothing, IMG_SIZE * BENCH_LINES),
+#endif
+};
+
+static void bench_init(void)
+{
+    lv_test_init();
+    lv_disp_t * disp = lv_disp_get_default();
+    _lv_refr_set_disp_refreshing(disp);
+
+    clip_area = stripe_area;
+    draw_ctx = disp->driver->draw_ctx;
+    draw_ctx->buf = stripe;
+    draw_ctx->buf_area = &stripe_area;
+    draw_ctx->clip_area = &clip_area;
+
+    uint32_t i;
+    for(i = 0; i < sizeof(stripe) / sizeof(stripe[0]); i++) {
+        stripe_start[i].full = rnd();
+        src_buf[i].full = rnd();
+    }
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < IMG_SIZE; y++) {
+        for(x = 0; x < IMG_SIZE; x++) {
+            img_buf[y * IMG_SIZE + x] = lv_color_make(x * 4, y * 4, (x ^ y) * 4);
+        }
+    }
+
+    /*The width of the letters and the line height they cover*/
+    lv_coord_t txt_w = lv_txt_get_width(label_text, strlen(label_text), LV_FONT_DEFAULT, 0, LV_TEXT_FLAG_NONE);
+    lv_coord_t txt_h = LV_MIN(lv_font_get_line_height(LV_FONT_DEFAULT), BENCH_LINES - 2);
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if(cases[i].px == 0) cases[i].px = txt_w * txt_h;
+    }
+}
+
+static int compare_ns(const void * a, const void * b)
+{
+    double d = *(const double *)a - *(const double *)b;
+    return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+/*ns per run of a round of runs, on the same stripe every time*/
+static double bench_round(bench_case_t * c, uint32_t runs)
+{
+    /*The blend loops remember the last pixel they mixed, so every round starts on the same stripe*/
+    lv_memcpy(stripe, stripe_start, sizeof(stripe));
+    c->setup();
+    uint64_t start = now_ns();
+    uint32_t r;
+    for(r = 0; r < runs; r++) c->run();
+    uint64_t elapsed = now_ns() - start;
+    c->teardown();
+    return (double)elapsed / runs;
+}
+
+/*Enough runs for a round of BENCH_ROUND_NS*/
+static void bench_calibrate(bench_case_t * c)
+{
+    uint32_t runs = 1;
+    while(1) {
+        double ns = bench_round(c, runs) * runs;
+        if(ns >= BENCH_ROUND_NS / 4) {
+            c->runs = (uint32_t)(runs * (BENCH_ROUND_NS / ns)) + 1;
+            return;
+        }
+        runs *= 4;
+    }
+}
+
+/*The median, a round the OS took the CPU away in moves it by one place at most*/
+static double median(double * v)
+{
+    qsort(v, BENCH_ROUNDS, sizeof(v[0]), compare_ns);
+    return v[BENCH_ROUNDS / 2];
+}
+
+/*Round after round of every case, each right after one of the reference*/
+static void bench_cases(bench_case_t * c, uint32_t n)
+{
+    uint32_t i;
+    for(i = 0; i < n; i++) {
+        if(c[i].run_it) bench_calibrate(&c[i]);
+    }
+
+    uint32_t round;
+    for(round = 0; round < BENCH_ROUNDS; round++) {
+        for(i = 1; i < n; i++) {
+            if(!c[i].run_it) continue;
+            c[0].ns[round] = bench_round(&c[0], c[0].runs);
+            c[i].ns[round] = bench_round(&c[i], c[i].runs);
+            c[i].ratio[round] = c[i].ns[round] / c[0].ns[round];
+        }
+    }
+
+    c[0].relative = 1;
+    for(i = 0; i < n; i++) {
+        if(!c[i].run_it) continue;
+        c[i].ns_per_op = median(c[i].ns);
+        if(i > 0) c[i].relative = median(c[i].ratio);
+    }
+}
+
+static int write_json(const char * path)
+{
+    FILE * f = fopen(path, "w");
+    if(f == NULL) return -1;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"bench_draw\",\n");
+    fprintf(f, "  \"color_depth\": %d,\n", LV_COLOR_DEPTH);
+    fprintf(f, "  \"color_16_swap\": %d,\n", LV_COLOR_16_SWAP);
+    fprintf(f, "  \"blend_kernel\": %d,\n", LV_DRAW_SW_BLEND_KERNEL);
+    fprintf(f, "  \"rounds\": %d,\n", BENCH_ROUNDS);
+    fprintf(f, "  \"results\": [\n");
+    uint32_t i;
+    uint32_t n = sizeof(cases) / sizeof(cases[0]);
+    const char * sep = "";
+    for(i = 0; i < n; i++) {
+        if(!cases[i].run_it) continue;
+        fprintf(f, "%s    {\"name\": \"%s\", \"px\": %u, \"ns_per_op\": %.1f, \"relative\": %.4f, \"mpx_per_s\": %.2f}",
+                sep, cases[i].name, (unsigned)cases[i].px, cases[i].ns_per_op, cases[i].relative,
+                cases[i].px / cases[i].ns_per_op * 1e3);
+        sep = ",\n";
+    }
+    fprintf(f, "\n");
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/*test_common's assert handler pulls in Unity, which wants these*/
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t n = sizeof(cases) / sizeof(cases[0]);
+    uint32_t i;
+    int a;
+    for(i = 1; i < n && argc > 2; i++) {
+        cases[i].run_it = false;
+        for(a = 2; a < argc; a++) {
+            if(strcmp(argv[a], cases[i].name) == 0) cases[i].run_it = true;
+        }
+    }
+    for(a = 2; a < argc; a++) {
+        for(i = 0; i < n && strcmp(argv[a], cases[i].name) != 0; i++);
+        if(i == n) {
+            fprintf(stderr, "unknown case %s\n", argv[a]);
+            return 2;
+        }
+    }
+
+    bench_init();
+
+    bench_cases(cases, n);
+
+    printf("%-22s %8s %12s %10s %10s\n", "case", "px", "ns/op", "relative", "Mpx/s");
+    for(i = 0; i < n; i++) {
+        if(!cases[i].run_it) continue;
+        printf("%-22s %8u %12.1f %10.3f %10.2f\n", cases[i].name, (unsigned)cases[i].px, cases[i].ns_per_op,
+               cases[i].relative, cases[i].px / cases[i].ns_per_op * 1e3);
+    }
+
+    if(argc > 1 && write_json(argv[1]) != 0) {
+        fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    lv_test_deinit();
+    return 0;
+}
+
+#endif
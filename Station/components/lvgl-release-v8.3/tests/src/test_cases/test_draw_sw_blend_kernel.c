@@ -0,0 +1,228 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+#include "../src/draw/sw/lv_draw_sw_blend_kernel.h"
+
+#include "unity/unity.h"
+
+void setUp(void)
+{
+    /* Function run before every test */
+}
+
+void tearDown(void)
+{
+    /* Function run after every test */
+}
+
+#if LV_DRAW_SW_BLEND_RGB565
+
+#define BUF_W   48
+#define BUF_H   4
+#define ROUNDS  300
+
+static lv_color_t dest_start[BUF_W * BUF_H];
+static lv_color_t dest_ref[BUF_W * BUF_H];
+static lv_color_t dest_res[BUF_W * BUF_H];
+static lv_color_t src[BUF_W * BUF_H];
+static lv_opa_t mask[BUF_W * BUF_H];
+
+static uint32_t rnd_state;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/*Random pixels with some black ones, random masks with runs of 0 and 255*/
+static void fill_buffers(void)
+{
+    uint32_t i;
+    for(i = 0; i < BUF_W * BUF_H; i++) {
+        dest_start[i].full = rnd() % 8 == 0 ? 0 : rnd();
+        src[i].full = rnd();
+        uint32_t m = rnd() % 4;
+        mask[i] = m == 0 ? LV_OPA_TRANSP : m == 1 ? LV_OPA_COVER : rnd();
+    }
+}
+
+typedef struct {
+    int32_t dest_ofs;
+    int32_t src_ofs;
+    int32_t mask_ofs;
+    int32_t w;
+    int32_t h;
+    lv_opa_t opa;
+} blend_case_t;
+
+/*A random area, with the first pixels in every alignment*/
+static blend_case_t random_case(uint32_t round)
+{
+    blend_case_t c;
+    if(round == 0) rnd_state = 0x2545F491;
+    c.dest_ofs = rnd() % 4;
+    c.src_ofs = rnd() % 4;
+    c.mask_ofs = rnd() % 4;
+    c.w = rnd() % (BUF_W - 3);
+    c.h = 1 + rnd() % BUF_H;
+    c.opa = round < 256 ? round : rnd();
+    fill_buffers();
+    lv_memcpy(dest_ref, dest_start, sizeof(dest_start));
+    lv_memcpy(dest_res, dest_start, sizeof(dest_start));
+    return c;
+}
+
+typedef void (*fill_opa_cb)(lv_color_t *, lv_coord_t, int32_t, int32_t, lv_color_t, lv_opa_t);
+typedef void (*fill_mask_cb)(lv_color_t *, lv_coord_t, int32_t, int32_t, lv_color_t, lv_opa_t,
+                             const lv_opa_t *, lv_coord_t);
+typedef void (*map_opa_cb)(lv_color_t *, lv_coord_t, int32_t, int32_t, const lv_color_t *, lv_coord_t, lv_opa_t);
+typedef void (*map_mask_cb)(lv_color_t *, lv_coord_t, int32_t, int32_t, const lv_color_t *, lv_coord_t, lv_opa_t,
+                            const lv_opa_t *, lv_coord_t);
+
+static void check_fill_opa(fill_opa_cb kernel)
+{
+    uint32_t round;
+    for(round = 0; round < ROUNDS; round++) {
+        blend_case_t c = random_case(round);
+        if(c.opa >= LV_OPA_MAX) continue;
+        lv_color_t color;
+        color.full = rnd();
+        lv_draw_sw_blend_fill_opa_scalar(&dest_ref[c.dest_ofs], BUF_W, c.w, c.h, color, c.opa);
+        kernel(&dest_res[c.dest_ofs], BUF_W, c.w, c.h, color, c.opa);
+        TEST_ASSERT_EQUAL_MEMORY(dest_ref, dest_res, sizeof(dest_ref));
+    }
+}
+
+static void check_fill_mask(fill_mask_cb kernel)
+{
+    uint32_t round;
+    for(round = 0; round < ROUNDS; round++) {
+        blend_case_t c = random_case(round);
+        lv_color_t color;
+        color.full = rnd();
+        lv_draw_sw_blend_fill_mask_scalar(&dest_ref[c.dest_ofs], BUF_W, c.w, c.h, color, c.opa,
+                                          &mask[c.mask_ofs], BUF_W);
+        kernel(&dest_res[c.dest_ofs], BUF_W, c.w, c.h, color, c.opa, &mask[c.mask_ofs], BUF_W);
+        TEST_ASSERT_EQUAL_MEMORY(dest_ref, dest_res, sizeof(dest_ref));
+    }
+}
+
+static void check_map_opa(map_opa_cb kernel)
+{
+    uint32_t round;
+    for(round = 0; round < ROUNDS; round++) {
+        blend_case_t c = random_case(round);
+        if(c.opa >= LV_OPA_MAX) continue;
+        lv_draw_sw_blend_map_opa_scalar(&dest_ref[c.dest_ofs], BUF_W, c.w, c.h, &src[c.src_ofs], BUF_W, c.opa);
+        kernel(&dest_res[c.dest_ofs], BUF_W, c.w, c.h, &src[c.src_ofs], BUF_W, c.opa);
+        TEST_ASSERT_EQUAL_MEMORY(dest_ref, dest_res, sizeof(dest_ref));
+    }
+}
+
+static void check_map_mask(map_mask_cb kernel)
+{
+    uint32_t round;
+    for(round = 0; round < ROUNDS; round++) {
+        blend_case_t c = random_case(round);
+        lv_draw_sw_blend_map_mask_scalar(&dest_ref[c.dest_ofs], BUF_W, c.w, c.h, &src[c.src_ofs], BUF_W, c.opa,
+                                         &mask[c.mask_ofs], BUF_W);
+        kernel(&dest_res[c.dest_ofs], BUF_W, c.w, c.h, &src[c.src_ofs], BUF_W, c.opa, &mask[c.mask_ofs], BUF_W);
+        TEST_ASSERT_EQUAL_MEMORY(dest_ref, dest_res, sizeof(dest_ref));
+    }
+}
+
+#endif /*LV_DRAW_SW_BLEND_RGB565*/
+
+void test_blend_kernel_swar_fill_opa_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_RGB565
+    check_fill_opa(lv_draw_sw_blend_fill_opa_swar);
+#else
+    TEST_IGNORE_MESSAGE("the SWAR kernels need RGB565, run with OPTIONS_TEST_16BIT_SWAP");
+#endif
+}
+
+void test_blend_kernel_swar_fill_mask_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_RGB565
+    check_fill_mask(lv_draw_sw_blend_fill_mask_swar);
+#else
+    TEST_IGNORE_MESSAGE("the SWAR kernels need RGB565, run with OPTIONS_TEST_16BIT_SWAP");
+#endif
+}
+
+void test_blend_kernel_swar_map_opa_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_RGB565
+    check_map_opa(lv_draw_sw_blend_map_opa_swar);
+#else
+    TEST_IGNORE_MESSAGE("the SWAR kernels need RGB565, run with OPTIONS_TEST_16BIT_SWAP");
+#endif
+}
+
+void test_blend_kernel_swar_map_mask_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_RGB565
+    check_map_mask(lv_draw_sw_blend_map_mask_swar);
+#else
+    TEST_IGNORE_MESSAGE("the SWAR kernels need RGB565, run with OPTIONS_TEST_16BIT_SWAP");
+#endif
+}
+
+void test_blend_kernel_vector_fill_opa_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+    check_fill_opa(lv_draw_sw_blend_fill_opa_vector);
+#else
+    TEST_IGNORE_MESSAGE("no vector kernels at this color depth or with this compiler");
+#endif
+}
+
+void test_blend_kernel_vector_fill_mask_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+    check_fill_mask(lv_draw_sw_blend_fill_mask_vector);
+#else
+    TEST_IGNORE_MESSAGE("no vector kernels at this color depth or with this compiler");
+#endif
+}
+
+void test_blend_kernel_vector_map_opa_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+    check_map_opa(lv_draw_sw_blend_map_opa_vector);
+#else
+    TEST_IGNORE_MESSAGE("no vector kernels at this color depth or with this compiler");
+#endif
+}
+
+void test_blend_kernel_vector_map_mask_matches_scalar(void)
+{
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+    check_map_mask(lv_draw_sw_blend_map_mask_vector);
+#else
+    TEST_IGNORE_MESSAGE("no vector kernels at this color depth or with this compiler");
+#endif
+}
+
+/*The black pixels at the start of an area take `lv_color_mix`'s result in the scalar fill*/
+void test_blend_kernel_fill_opa_keeps_the_black_start(void)
+{
+#if LV_DRAW_SW_BLEND_RGB565
+    lv_color_t color;
+    color.full = 0xF81F;
+    lv_memset_00(dest_ref, sizeof(dest_ref));
+    lv_memset_00(dest_res, sizeof(dest_res));
+    dest_ref[BUF_W + 5].full = 0x1234;
+    dest_res[BUF_W + 5].full = 0x1234;
+    lv_draw_sw_blend_fill_opa_scalar(dest_ref, BUF_W, BUF_W, BUF_H, color, 99);
+    lv_draw_sw_blend_fill_opa(dest_res, BUF_W, BUF_W, BUF_H, color, 99);
+    TEST_ASSERT_EQUAL_MEMORY(dest_ref, dest_res, sizeof(dest_ref));
+#else
+    TEST_IGNORE_MESSAGE("the kernels need RGB565, run with OPTIONS_TEST_16BIT_SWAP");
+#endif
+}
+
+#endif
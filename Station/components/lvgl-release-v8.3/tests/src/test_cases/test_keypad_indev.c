@@ -0,0 +1,209 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+#include "../lv_test_indev.h"
+
+#include "unity/unity.h"
+#include "keypad_indev.h"
+#include <string.h>
+
+/*The Station's keypad drives its text area only through LVGL keypad keys:
+ *characters, BACKSPACE and LEFT/RIGHT for every edit of the composer, NEXT
+ *to move the focus. These tests check that contract with the test keypad,
+ *and that the Station's own keypad input device (main/keypad_indev.c)
+ *hands every waiting key over within one read of the input device.*/
+
+static lv_group_t * group;
+static lv_obj_t * textarea;
+static lv_obj_t * log_box;
+
+static keypad_indev_t keys;
+static lv_indev_drv_t keys_drv;
+static lv_indev_t * keys_indev;
+static const char * poll_text;
+
+void setUp(void)
+{
+    group = lv_group_create();
+    textarea = lv_textarea_create(lv_scr_act());
+    log_box = lv_obj_create(lv_scr_act());
+    /*lv_test_key_hit also presses the mouse, keep it on the bare screen*/
+    lv_obj_align(textarea, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_obj_align(log_box, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
+    lv_test_mouse_move_to(0, 0);
+    lv_group_add_obj(group, textarea);
+    lv_group_add_obj(group, log_box);
+    lv_group_focus_obj(textarea);
+    lv_indev_set_group(lv_test_keypad_indev, group);
+}
+
+void tearDown(void)
+{
+    lv_indev_set_group(lv_test_keypad_indev, NULL);
+    lv_group_del(group);
+    lv_obj_clean(lv_scr_act());
+    lv_test_mouse_release();
+}
+
+static void check(const char * text, uint32_t cursor)
+{
+    TEST_ASSERT_EQUAL_STRING(text, lv_textarea_get_text(textarea));
+    TEST_ASSERT_EQUAL_UINT32(cursor, lv_textarea_get_cursor_pos(textarea));
+}
+
+void test_keypad_keys_edit_the_focused_textarea(void)
+{
+    lv_test_key_hit('h');
+    lv_test_key_hit('i');
+    check("hi", 2);
+    lv_test_key_hit(LV_KEY_LEFT);
+    lv_test_key_hit('x');
+    check("hxi", 2);
+    lv_test_key_hit(LV_KEY_RIGHT);
+    lv_test_key_hit(LV_KEY_BACKSPACE);
+    check("hx", 2);
+    lv_test_key_hit(LV_KEY_LEFT);
+    lv_test_key_hit(LV_KEY_LEFT);
+    lv_test_key_hit(LV_KEY_LEFT);
+    lv_test_key_hit(LV_KEY_BACKSPACE);
+    check("hx", 0);
+}
+
+/*Random edits as the composer reports them, applied to a plain string as well*/
+void test_keypad_keys_follow_random_edits(void)
+{
+    char model[128] = "";
+    uint32_t len = 0;
+    uint32_t cursor = 0;
+    uint32_t rnd = 0x12345678;
+    uint32_t i;
+
+    for(i = 0; i < 400; i++) {
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 17;
+        rnd ^= rnd << 5;
+        uint32_t what = rnd % 8;
+        if(what < 4 && len < sizeof(model) - 1) {
+            char c = 'a' + rnd % 26;
+            memmove(&model[cursor + 1], &model[cursor], len - cursor + 1);
+            model[cursor++] = c;
+            len++;
+            lv_test_key_hit(c);
+        }
+        else if(what == 4 && cursor > 0) {
+            memmove(&model[cursor - 1], &model[cursor], len - cursor + 1);
+            cursor--;
+            len--;
+            lv_test_key_hit(LV_KEY_BACKSPACE);
+        }
+        else if(what == 5 && cursor > 0) {
+            cursor--;
+            lv_test_key_hit(LV_KEY_LEFT);
+        }
+        else if(what >= 6 && cursor < len) {
+            cursor++;
+            lv_test_key_hit(LV_KEY_RIGHT);
+        }
+        check(model, cursor);
+    }
+}
+
+void test_keypad_next_moves_the_focus(void)
+{
+    lv_test_key_hit('a');
+    lv_test_key_hit(LV_KEY_NEXT);
+    TEST_ASSERT_EQUAL_PTR(log_box, lv_group_get_focused(group));
+    /*keys now go to the message box, the text stays*/
+    lv_test_key_hit('b');
+    check("a", 1);
+    lv_test_key_hit(LV_KEY_NEXT);
+    TEST_ASSERT_EQUAL_PTR(textarea, lv_group_get_focused(group));
+    lv_test_key_hit('b');
+    check("ab", 2);
+}
+
+/*Swap the test keypad for the Station's on the same group*/
+static void keys_register(keypad_indev_poll_cb poll)
+{
+    keypad_indev_init(&keys, poll, NULL);
+    keys_indev = keypad_indev_register(&keys, &keys_drv);
+    lv_indev_set_group(keys_indev, group);
+    lv_indev_set_group(lv_test_keypad_indev, NULL);
+}
+
+static void put_text(const char * text)
+{
+    const char * c;
+    for(c = text; *c; c++) TEST_ASSERT_TRUE(keypad_indev_put(&keys, (uint8_t)*c));
+}
+
+void test_keypad_buffered_keys_arrive_in_one_read(void)
+{
+    keys_register(NULL);
+
+    put_text("keypad");
+    keypad_indev_put(&keys, LV_KEY_LEFT);
+    keypad_indev_put(&keys, LV_KEY_LEFT);
+    keypad_indev_put(&keys, LV_KEY_BACKSPACE);
+    keypad_indev_put(&keys, 'Y');
+
+    /*one read, like the Station's display task after a key*/
+    lv_indev_read_timer_cb(keys_indev->driver->read_timer);
+    TEST_ASSERT_EQUAL_UINT16(0, keypad_indev_waiting(&keys));
+    check("keyYad", 4);
+
+    /*the same key twice in a row is two presses*/
+    put_text("dd");
+    lv_indev_read_timer_cb(keys_indev->driver->read_timer);
+    check("keyYddad", 6);
+
+    lv_indev_delete(keys_indev);
+}
+
+/*The Station scans the keypad from the read callback when nothing is waiting*/
+static void poll_keys(void * ctx)
+{
+    LV_UNUSED(ctx);
+    if(poll_text) put_text(poll_text);
+    poll_text = NULL;
+}
+
+void test_keypad_poll_fills_an_empty_buffer(void)
+{
+    keys_register(poll_keys);
+
+    poll_text = "abc";
+    lv_test_indev_wait(LV_INDEV_DEF_READ_PERIOD * 2);
+    TEST_ASSERT_NULL(poll_text);
+    check("abc", 3);
+
+    /*no poll while a key is still to be released*/
+    poll_text = "d";
+    keypad_indev_put(&keys, 'x');
+    lv_indev_read_timer_cb(keys_indev->driver->read_timer);
+    TEST_ASSERT_EQUAL_STRING("d", poll_text);
+    check("abcx", 4);
+    lv_test_indev_wait(LV_INDEV_DEF_READ_PERIOD * 2);
+    check("abcxd", 5);
+
+    lv_indev_delete(keys_indev);
+}
+
+void test_keypad_full_buffer_drops_keys(void)
+{
+    uint32_t i;
+    keys_register(NULL);
+
+    for(i = 0; i < KEYPAD_INDEV_BUFFER; i++) TEST_ASSERT_TRUE(keypad_indev_put(&keys, 'a'));
+    TEST_ASSERT_FALSE(keypad_indev_put(&keys, 'b'));
+    TEST_ASSERT_EQUAL_UINT16(KEYPAD_INDEV_BUFFER, keypad_indev_waiting(&keys));
+
+    /*dropped keys never reach the text area, later ones do*/
+    keypad_indev_drop(&keys);
+    keypad_indev_put(&keys, 'c');
+    lv_test_indev_wait(LV_INDEV_DEF_READ_PERIOD * 2);
+    check("c", 1);
+
+    lv_indev_delete(keys_indev);
+}
+
+#endif
@@ -1,24 +1,43 @@
 #include <string.h>
 #include <memory.h>
 #include <time.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/message_buffer.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_timer.h"
-#include "esp_lcd_panel_io.h"
-#include "esp_lcd_panel_vendor.h"
-#include "esp_lcd_panel_ops.h"
+#include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
 #include "driver/gpio.h"
-#include "driver/spi_master.h"
+#include "driver/uart.h"
 #include "esp_err.h"
 #include "lvgl.h"
-#include "esp_lcd_ili9341.h"
 #include "lwip/sockets.h"
+#include "frame_journal.h"
+#include "keypad_scan.h"
+#include "keypad_indev.h"
+#include "multitap.h"
+#include "t9.h"
+#include "macro.h"
+#include "key_trace.h"
+#include "ui_board.h"
+#include "display.h"
+#include "link_mux.h"
+#include "link_tls.h"
+#include "frame_trace.h"
+#include "link_rpc.h"
+#include "link_mirror.h"
 
 /*Definitions*/
 #define KEEPALIVE_IDLE              1
@@ -33,23 +52,8 @@
 #define PASS "super-strong-password"
 #define PORT 12345
 #define AP_IP "192.168.4.1"
-#define LVGL_TICK_PERIOD_MS 2
-#define TFT_BK_LIGHT_ON 1
-#define TFT_BK_LIGHT_OFF !TFT_BK_LIGHT_ON
-
-// Defining SPI
-#define LCD_HOST  SPI2_HOST
-
-/*Pin definition*/
-// Display
-#define SCLK_PIN 18
-#define MOSI_PIN 19
-#define MISO_PIN 21
-#define DC_PIN 5
-#define RST_PIN 22
-#define TFT_CS_PIN 4
-#define BK_LIGHT_PIN 2
 
+/*Pin definition, the display's are in display.c*/
 // Keypad
 #define R1 13
 #define R2 12
@@ -60,62 +64,104 @@
 #define C3 33
 #define C4 32
 
-// Display specs
-#define TFT_PIXEL_CLOCK_HZ (20 * 1000* 1000) // 20 MHZ
-#define HOR_RES 320           
-#define VER_RES 240         
-
-// Bit number used to represent dispaly command and parameter
-#define CMD_BITS 8
-#define PARAM_BITS 8
+// Display buffers, see display_buffer_mode_t
+#define DISPLAY_BUFFER_MODE DISPLAY_BUFFER_PINGPONG
 
 // Keyboard variables
-#define KEYPAD_DEBOUNCING 100   // < time in ms
+#define KEYPAD_SCAN_MS 5            // matrix scan period while a key is down
+#define KEYPAD_DEBOUNCE_SCANS 3     // equal samples before a key changes state
+#define KEYPAD_LONG_PRESS_MS 600
+#define MULTITAP_TIMEOUT_MS 800     // pause after which a letter is accepted without 'D'
+#define T9_TOGGLE_KEY 7             // long '+' switches between multi-tap and predictive text
+#define T9_SPACE_KEY 13             // '0' accepts the word and adds a space
+#define T9_BAR_CANDIDATES 4
+#define KEYPAD_FOCUS_KEY 3          // long '.' moves the focus to the next widget
 #define KEYPAD_STACKSIZE  5
+#define MACRO_PREFIX_KEY 14         // '#' on an empty composer, then the macro's key
+#define MACRO_NVS_NAMESPACE "macro"
+#define KEY_TRACE_REPORT_KEY 12     // long '*' logs typing latency when KEY_TRACE_ENABLED (key_trace.h)
+
+// Power saving, the backlight dims and then goes off when no key is pressed
+#define BACKLIGHT_DIM_MS 15000
+#define BACKLIGHT_OFF_MS 60000      // also stops LVGL and lets the CPU light sleep
+#define BACKLIGHT_FULL_DUTY DISPLAY_BACKLIGHT_MAX
+#define BACKLIGHT_DIM_DUTY 32
+#define POWER_STATS_INTERVAL_MS 10000
+
+// Cores, LVGL renders on its own core, Wi-Fi, lwIP and the link tasks share the other one
+#define UI_CORE (portNUM_PROCESSORS - 1)
+#define LINK_CORE 0
+#define CPU_STATS_INTERVAL_MS 10000 // per core load, needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define CPU_STATS_MAX_TASKS 24
+
+// Offline outbox
+#define OUTBOX_PARTITION "journal"
+#define OUTBOX_REPLAY_INTERVAL_MS 50 // gap between replayed frames so live frames can go in between
+#define OUTBOX_IDLE_MS 500
+
+// Frame capture, every frame sent/received is streamed out as a trace (frame_trace.h)
+#define CAPTURE_ENABLED 0
+#define CAPTURE_UART UART_NUM_1
+#define CAPTURE_TX_PIN 17
+#define CAPTURE_BAUD 921600
+#define CAPTURE_BUFFER_SIZE 4096 // frames are dropped when the UART falls this far behind
+
+// Requests to the UART device (link_rpc.h)
+#define RPC_TIMEOUT_MS 1000
+#define RPC_EXPIRE_INTERVAL_MS 50
+
+// Display mirror, flushed areas go to a viewer behind the AP while one is connected (link_mirror.h)
+#define MIRROR_ENABLED 1
+#define MIRROR_BUDGET_BYTES_S 16000 // share of the link the mirror may take
+#define MIRROR_BURST_BYTES 2048
+#define MIRROR_BACKLOG_BYTES 4096   // encoded areas waiting for the budget, an area that does not fit is redrawn later
+#define MIRROR_RETRY_MS 200         // how soon the display task looks again at areas left out
 
 // Shouldnt do that but oh well
 lv_obj_t *label3;
 lv_obj_t *label4;
+lv_obj_t *label6;
 
-static u_int8_t repeat = 0; // states which of states of letter in button is used 
-static u_int8_t spec_num = 0; // states which position was used last time button was used
-static char word[255]; // stores letter inputed by keypad
-static char frame[255];
-static char placeholder[255]; // created here due to occasional stack overflow happening if created inside the function. Stores letters from word minus last position
 static char received_data[250];
-static u_int8_t position = 0; // stores the position of last character in word 
-const char keypad[] = { 
-    '1', '2', '3', '.',
-    '4', '5', '6', '+',
-    '7', '8', '9', 'C',
-    '`', '0', '#', 'D'
-};  
-
-const char keypad1[] = { 
-    'a', 'd', 'g', ',',
-    'j', 'm', 'p', '-',
-    's', 'v', 'y', 'C',
-    '`', ' ', '#', 'D'
-};  
-
-const char keypad2[] = { 
-    'b', 'e', 'h', '!',
-    'k', 'n', 'q', '*',
-    't', 'w', 'z', 'C',
-    '`', '_', '#', 'D'
-};  
-
-const char keypad3[] = { 
-    'c', 'f', 'i', '?',
-    'l', 'o', 'r', '/',
-    'u', 'x', '$', 'C',
-    '`', '=', '#', 'D'
-};  
+
+// Key layout, character cycles follow the letters printed on the keypad
+static const multitap_key_t multitap_layout[KEYPAD_KEYS] = {
+    {MULTITAP_CHARS, "1abc"}, {MULTITAP_CHARS, "2def"}, {MULTITAP_CHARS, "3ghi"}, {MULTITAP_CHARS, ".,!?"},
+    {MULTITAP_CHARS, "4jkl"}, {MULTITAP_CHARS, "5mno"}, {MULTITAP_CHARS, "6pqr"}, {MULTITAP_CHARS, "+-*/"},
+    {MULTITAP_CHARS, "7stu"}, {MULTITAP_CHARS, "8vwx"}, {MULTITAP_CHARS, "9yz$"}, {MULTITAP_DELETE, NULL},
+    {MULTITAP_CLEAR, NULL},   {MULTITAP_CHARS, "0 _="}, {MULTITAP_SEND_KEY, NULL}, {MULTITAP_NEXT, NULL}
+};
+static multitap_t composer; // text being typed, first character is the frame type
+
+// Frames sent by a single key, built-in ones until NVS has its own (macro_initialize)
+static const char *const macro_defaults[KEYPAD_KEYS] = {
+    [0] = "1OK", [1] = "1Odebrano", [2] = "1Prosze czekac", [13] = "2"
+};
+static macro_table_t macros;
+
+// Predictive text, dictionary built from t9_words.txt and linked into flash
+extern const uint8_t t9_dict_start[] asm("_binary_t9_dict_start");
+extern const uint8_t t9_dict_end[] asm("_binary_t9_dict_end");
+static t9_dict_t t9_dict;
+static t9_cursor_t t9_word;         // keys of the word being typed
+static uint8_t t9_keys[T9_MAX_DEPTH];
+static int t9_choice = 0;           // selected candidate
+static bool predictive = false;
+lv_obj_t *candidate_bar;
+
+// Keypad as LVGL input device, keys reach the focused widget inside lv_timer_handler
+static lv_group_t *keypad_group;
+static lv_obj_t *compose_area;      // text area the composed text is mirrored to
+static keypad_indev_t keypad_keys;
+static bool compose_resync = false;  // compose_area lost track, set the whole text again
+static char preview[T9_MAX_WORD + 1];   // predicted word compose_area shows before the cursor
+static uint8_t preview_len = 0;
 
 static gpio_num_t _keypad_pins[8];
 
-// Last isr time
-time_t time_old_isr = 0;
+// Matrix scanner, only runs between a key press and the release of the last key
+static keypad_scan_t keypad_scanner;
+static esp_timer_handle_t keypad_timer;
 // Pressed keys queue
 QueueHandle_t keypad_queue;
 
@@ -127,15 +173,89 @@ static int wifi_try_no = 0;
 int socket_status = -1;
 
 // socket definition
-int soc;
+int soc = -1;                      // -1 while there is no socket
 char buffer[1024];
 char send_buffer[255];
+static SemaphoreHandle_t send_lock; // guards writes to soc and the outbox
+
+// frames composed while disconnected, replayed after reconnect
+static journal_bdev_t outbox_dev;
+static journal_t outbox;
+static bool outbox_ready = false;
+static bool outbox_in_flight = false;   // the replayed frame is on the bulk channel, still in the journal
+static uint32_t outbox_mark;            // bulk messages completed before it was pushed
+
+// logical channels multiplexed over soc
+static mux_tx_t link_tx;
+static mux_rx_t link_rx;
+static TaskHandle_t link_tx_handle;
+
+// requests waiting for an answer from the UART device
+static rpc_table_t rpc;
+static SemaphoreHandle_t rpc_lock;
+
+#if LINK_USE_TLS
+static link_tls_t link_tls;
+static SemaphoreHandle_t tls_lock; // one mbedTLS context shared by the reader and writer task
+static bool link_secure = false;   // a key is provisioned, the link runs TLS
+#endif
+
+#if CAPTURE_ENABLED
+static StreamBufferHandle_t capture_stream;
+static SemaphoreHandle_t capture_lock; // stream buffer allows one writer at a time
+static trace_writer_t capture_writer;
+static uint32_t capture_dropped = 0;
+#endif
+
+// display task power state, only the display task changes it
+typedef enum {
+    UI_ACTIVE,
+    UI_DIM,
+    UI_OFF,
+} ui_power_t;
+static volatile uint8_t ui_power = UI_ACTIVE;
+static TaskHandle_t ui_task;
+#define UI_WAKE_ACTIVITY 0x01   // key or frame, lights the screen up
+#define UI_WAKE_UPDATE 0x02     // label text waiting on ui_board
+// LVGL is only called by the display task, other tasks leave label text on the board for it
+typedef enum {
+    UI_MESSAGE,         // message_log, one line per '\n'
+    UI_INPUT_ERROR,     // label3
+    UI_OUTPUT_ERROR,    // label4
+    UI_SOCKET_STATUS,   // label6
+} ui_label_t;
+static lv_obj_t **const ui_labels[] = {NULL, &label3, &label4, &label6};
+static ui_board_t ui_board;
+static SemaphoreHandle_t ui_lock;
+static lv_timer_t *keypad_read_timer;   // paused, the display task reads the keypad itself
+#if MIRROR_ENABLED
+// the display task encodes, link_tx_task puts the messages into the mux
+static mirror_enc_t *mirror;
+static MessageBufferHandle_t mirror_out;
+static mirror_budget_t mirror_budget;
+static bool mirror_active = false;          // display task only
+static _Atomic uint8_t mirror_request = 0;  // MIRROR_MSG_REFRESH or _STOP from the AP
+#endif
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t ui_busy_lock;   // full CPU clock while LVGL works
+static esp_pm_lock_handle_t ui_lit_lock;    // no light sleep while the screen is on
+#endif
+static struct {
+    uint32_t wakeups;           // display task wakeups since since_us
+    int64_t since_us;
+    int64_t sleep_us;           // when the screen went off
+    volatile int64_t wake_us;   // row interrupt that ended the sleep, 0 when none
+} power_stats;
 
 // task tags
 static const char *TAG_WI = "WIFI";
 static const char *TAG_TCP = "TCP";
-static const char *TFT_TAG = "Display";
 static const char *KEYPAD_TAG = "Keypad";
+static const char *OUTBOX_TAG = "Outbox";
+static const char *CAPTURE_TAG = "Capture";
+static const char *POWER_TAG = "Power";
+static const char *CPU_TAG = "CPU";
+static const char *MIRROR_TAG = "Mirror";
 
 /*Frame functions*/
 unsigned char Calculate_Crc(char frameid, char framelength, const char *data, u_int8_t length){
@@ -282,6 +402,95 @@ esp_err_t connect_wifi()
     return status;
 }
 
+/*Link security*/
+// Without a key in NVS the link runs over plain TCP, the other side has to have none either
+esp_err_t link_security_initialize(void){
+#if LINK_USE_TLS
+    uint8_t psk[LINK_TLS_PSK_MAX];
+    size_t psk_len;
+    char identity[LINK_TLS_IDENTITY_MAX];
+    if(!link_tls_load_key(psk, &psk_len, identity)){
+        ESP_LOGW(TAG_TCP, "No link key provisioned in NVS, linking over plain TCP");
+        return ESP_OK;
+    }
+    tls_lock = xSemaphoreCreateMutex();
+    int ret = link_tls_init(&link_tls, false, psk, psk_len, identity);
+    memset(psk, 0, sizeof(psk));
+    if(tls_lock == NULL || ret != 0){
+        ESP_LOGE(TAG_TCP, "TLS setup failed: -0x%04x", -ret);
+        return ESP_FAIL;
+    }
+    link_secure = true;
+#endif
+    return ESP_OK;
+}
+
+// Secure freshly connected soc, resuming the previous session when AP still knows it
+static int link_open(void){
+#if LINK_USE_TLS
+    if(!link_secure){
+        return TCP_SUCCESS;
+    }
+    int ret = link_tls_handshake(&link_tls, soc);
+    if(ret != 0){
+        ESP_LOGE(TAG_TCP, "TLS handshake failed: -0x%04x", -ret);
+        return TCP_FAILURE;
+    }
+    ESP_LOGI(TAG_TCP, "TLS handshake took %lld ms", link_tls.handshake_us / 1000);
+#endif
+    return TCP_SUCCESS;
+}
+
+// Nothing to do without a socket, so a descriptor handed out since is never closed twice
+static void link_close(void){
+    if(soc < 0){
+        return;
+    }
+#if LINK_USE_TLS
+    if(link_secure){
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        link_tls_close(&link_tls);
+        xSemaphoreGive(tls_lock);
+    }
+#endif
+    close(soc);
+    soc = -1;
+}
+
+static int link_write(const void *data, size_t length){
+#if LINK_USE_TLS
+    if(link_secure){
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        int w = link_tls_write(&link_tls, data, length);
+        xSemaphoreGive(tls_lock);
+        return w;
+    }
+#endif
+    return write(soc, data, length);
+}
+
+static int link_read(void *data, size_t length){
+#if LINK_USE_TLS
+    if(link_secure){
+        // wait outside the lock so the writer is not blocked by an idle link
+        if(link_tls_pending(&link_tls) == 0){
+            fd_set readable;
+            struct timeval timeout = { .tv_sec = 0, .tv_usec = 100 * 1000 };
+            FD_ZERO(&readable);
+            FD_SET(soc, &readable);
+            if(select(soc + 1, &readable, NULL, NULL, &timeout) <= 0){
+                return -1;
+            }
+        }
+        xSemaphoreTake(tls_lock, portMAX_DELAY);
+        int r = link_tls_read(&link_tls, data, length);
+        xSemaphoreGive(tls_lock);
+        return r;
+    }
+#endif
+    return read(soc, data, length);
+}
+
 // Connect to the socket of ap
 esp_err_t socket_connection(void){
     struct sockaddr_in ap_info = {0};
@@ -301,7 +510,11 @@ esp_err_t socket_connection(void){
     // creating socket connection
     if(connect(soc, (struct sockaddr *)&ap_info, sizeof(ap_info)) != 0){
         ESP_LOGI(TAG_TCP, "Unable to to connect to %s", inet_ntoa(ap_info.sin_addr.s_addr));
-        close(soc);
+        link_close();
+        return TCP_FAILURE;
+    }
+    if(link_open() != TCP_SUCCESS){
+        link_close();
         return TCP_FAILURE;
     }
     socket_status = 0;
@@ -309,471 +522,1279 @@ esp_err_t socket_connection(void){
     return TCP_SUCCESS;
 }
 
-static void socket_read(lv_obj_t *display){    
+/*Capture*/
+esp_err_t capture_initialize(void){
+#if CAPTURE_ENABLED
+    const uart_config_t uart_config = {
+        .baud_rate = CAPTURE_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    ESP_ERROR_CHECK(uart_driver_install(CAPTURE_UART, 256, 1024, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(CAPTURE_UART, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(CAPTURE_UART, CAPTURE_TX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    capture_stream = xStreamBufferCreate(CAPTURE_BUFFER_SIZE, 1);
+    capture_lock = xSemaphoreCreateMutex();
+    if(capture_stream == NULL || capture_lock == NULL){
+        return ESP_ERR_NO_MEM;
+    }
+    trace_writer_init(&capture_writer);
+    uint8_t header[TRACE_HEADER_SIZE];
+    xStreamBufferSend(capture_stream, header, trace_header(header), 0);
+    ESP_LOGI(CAPTURE_TAG, "Streaming frames on UART%d TX pin %d", CAPTURE_UART, CAPTURE_TX_PIN);
+#endif
+    return ESP_OK;
+}
+
+// Record one frame, never blocks the caller
+static void capture_frame(uint8_t dir, uint8_t channel, const uint8_t *data, size_t length){
+#if CAPTURE_ENABLED
+    static uint8_t record[TRACE_MAX_OVERHEAD + MUX_MESSAGE_MAX];
+    if(capture_stream == NULL || length > MUX_MESSAGE_MAX){
+        return;
+    }
+    xSemaphoreTake(capture_lock, portMAX_DELAY);
+    size_t n = trace_encode(&capture_writer, record, dir, channel, esp_timer_get_time(), data, length);
+    // whole records only, a partial one would break the rest of the trace
+    if(xStreamBufferSpacesAvailable(capture_stream) >= n){
+        xStreamBufferSend(capture_stream, record, n, 0);
+    }
+    else{
+        capture_dropped++;
+    }
+    xSemaphoreGive(capture_lock);
+#endif
+}
+
+#if CAPTURE_ENABLED
+static void capture_task(void *arg){
+    static uint8_t chunk[256];
+    uint32_t reported = 0;
     while(1){
-        if(socket_status == 0){
-            bzero(buffer, sizeof(buffer));
-            bzero(received_data, sizeof(received_data));
-            int r = read(soc, buffer, sizeof(buffer));
-            if (r > 0){
-                ESP_LOGI("socket", "%i", r);
-                ESP_LOGI("socket", "%s", buffer);
-                ESP_LOG_BUFFER_HEXDUMP("dump", buffer, r, ESP_LOG_INFO);
-                switch(buffer[2]){ 
-                    case 48: // wilgotnosc, do 99
-                        strcpy(received_data, "Temperatura: ");
-                        ESP_LOGI("ds", "%s",received_data);
-                        for(int i = 13; i < r + 7; i++){
-                            received_data[i] = buffer[i - 9];
-                        }
-                        if(r > 9 || (r == 9 && (buffer[4] > '1' || (buffer[4] == '1' && (buffer[5] > '0' || buffer[6] > '0'))))){
-                            lv_label_set_text(label3, "0x03");
-                        }
-                        else{
-                            lv_label_set_text(label3, "0x00");
-                        }
-                         
-                        lv_label_set_text(display, received_data);                         
-                        ESP_LOGI("sadge", "%s",received_data);
-                        break; 
-                    case 49: // tekst
-                        strcpy(received_data, "Komunikat: ");
-                        for(int i = 11; i < r + 5; i++){
-                            received_data[i] = buffer[i - 7];
-                        }
-                        lv_label_set_text(label3, "0x00"); 
-                        lv_label_set_text(display, received_data);                                                 
-                        break;
-                    case 50: // read_only  
-                        strcpy(received_data, "Wilgotnosc: ");
-  
-                        for(int i = 12; i < r + 6; i++){
-                            received_data[i] = buffer[i - 8];
-                        }                            
-                        if(r > 9 || (r == 9 && (buffer[4] > '1' || (buffer[4] == '1' && (buffer[5] > '0' || buffer[6] > '0'))))){
-                            lv_label_set_text(label3, "0x03");
-                        }
-                        else{
-                            lv_label_set_text(label3, "0x00");
-                        } 
-                        lv_label_set_text(display, received_data);                          
-                        break;
-                    default:
-                        lv_label_set_text(label3, "0x01"); 
-                        lv_label_set_text(display, "Nie rozpoznano FrameID"); 
-                }              
-            }        
+        size_t n = xStreamBufferReceive(capture_stream, chunk, sizeof(chunk), portMAX_DELAY);
+        uart_write_bytes(CAPTURE_UART, chunk, n);
+        if(capture_dropped != reported){
+            reported = capture_dropped;
+            ESP_LOGW(CAPTURE_TAG, "%u frames dropped, UART too slow", (unsigned)reported);
+        }
+    }
+}
+#endif
+
+/*Outbox*/
+#define SEND_OK 0
+#define SEND_QUEUED 1
+#define SEND_PENDING 2  // on the link, still in RAM until its last fragment is written
+#define SEND_LOST -1
+
+esp_err_t outbox_initialize(void){
+    send_lock = xSemaphoreCreateMutex();
+    if(send_lock == NULL){
+        return ESP_ERR_NO_MEM;
+    }
+    if(journal_bdev_partition(&outbox_dev, OUTBOX_PARTITION) != JOURNAL_OK){
+        ESP_LOGE(OUTBOX_TAG, "No '%s' partition, frames sent while offline will be lost", OUTBOX_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if(journal_mount(&outbox, &outbox_dev) != JOURNAL_OK){
+        ESP_LOGE(OUTBOX_TAG, "Mount failed");
+        return ESP_FAIL;
+    }
+    outbox_ready = true;
+    ESP_LOGI(OUTBOX_TAG, "%u frames waiting from previous session", (unsigned)journal_pending(&outbox));
+    return ESP_OK;
+}
+
+/**
+ * Send frame to AP, or keep it in the outbox when the socket is down. A frame
+ * on the link is only in RAM until its last fragment is written; when the
+ * link fails before that, link_requeue moves it to the outbox.
+ */
+int send_frame(const uint8_t *data, u_int8_t length){
+    int result = SEND_LOST;
+    uint8_t channel = mux_channel_for_frame(data, length);
+    xSemaphoreTake(send_lock, portMAX_DELAY);
+    if(socket_status == 0 && mux_tx_push(&link_tx, channel, data, length)){
+        result = SEND_PENDING;
+    }
+    else if(outbox_ready && journal_append(&outbox, data, length) == JOURNAL_OK){
+        ESP_LOGI(OUTBOX_TAG, "Socket down, frame stored (%u waiting)", (unsigned)journal_pending(&outbox));
+        result = SEND_QUEUED;
+    }
+    xSemaphoreGive(send_lock);
+    if(result == SEND_PENDING){
+        capture_frame(TRACE_DIR_TX, channel, data, length);
+        xTaskNotifyGive(link_tx_handle);
+    }
+    return result;
+}
+
+/*Power saving*/
+/**
+ * Active: backlight on, LVGL runs when one of its timers is due. Dim: the
+ * backlight low and the text cursor steady, so a screen nobody touches has no
+ * LVGL timer left and the display task only wakes for the next backlight step.
+ * Off: backlight off, the display task blocks until a key or a frame arrives,
+ * so nothing keeps the CPU out of automatic light sleep. The keypad rows stay
+ * armed as GPIO wakeup. LVGL reads its tick from esp_timer_get_time
+ * (CONFIG_LV_TICK_CUSTOM), no timer interrupt keeps it going.
+ */
+esp_err_t power_initialize(void){
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if(err != ESP_OK){
+        return err;
+    }
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ui_busy", &ui_busy_lock));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "ui_lit", &ui_lit_lock));
+    esp_pm_lock_acquire(ui_lit_lock);
+#endif
+    power_stats.since_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+// Wake the display task, from a task or the esp_timer task
+static void ui_notify(void){
+    if(ui_task != NULL){
+        xTaskNotify(ui_task, UI_WAKE_ACTIVITY, eSetBits);
+    }
+}
+
+esp_err_t ui_initialize(void){
+    ui_board_init(&ui_board);
+    ui_lock = xSemaphoreCreateMutex();
+    return ui_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void ui_posted(void){
+    if(ui_task != NULL){
+        xTaskNotify(ui_task, UI_WAKE_UPDATE, eSetBits);
+    }
+}
+
+// Set a label's text from any task, the display task shows the last one on its next pass
+static void ui_set_text(ui_label_t label, const char *text){
+    xSemaphoreTake(ui_lock, portMAX_DELAY);
+    ui_board_set(&ui_board, label, text);
+    xSemaphoreGive(ui_lock);
+    ui_posted();
+}
+
+// Add a line to the message log from any task, a burst of lines is kept whole
+static void ui_add_message(const char *text){
+    char line[UI_TEXT_MAX + 1];
+    snprintf(line, sizeof(line), "%s\n", text);
+    xSemaphoreTake(ui_lock, portMAX_DELAY);
+    ui_board_append(&ui_board, UI_MESSAGE, line);
+    xSemaphoreGive(ui_lock);
+    ui_posted();
+}
+
+// Error code in an error box
+static void ui_set_status(ui_label_t label, uint8_t code){
+    xSemaphoreTake(ui_lock, portMAX_DELAY);
+    ui_board_status(&ui_board, label, code);
+    xSemaphoreGive(ui_lock);
+    ui_posted();
+}
+
+// Display task only, one set or insert per label however many updates came in
+static void ui_apply(void){
+    static ui_update_t update;
+    while(1){
+        xSemaphoreTake(ui_lock, portMAX_DELAY);
+        int slot = ui_board_take(&ui_board, &update);
+        xSemaphoreGive(ui_lock);
+        if(slot < 0){
+            return;
+        }
+        if(slot == UI_MESSAGE){
+            message_log_add(update.text);
+            continue;
+        }
+        lv_obj_t *label = *ui_labels[slot];
+        if(update.op == UI_OP_SET){
+            lv_label_set_text(label, update.text);
         }
         else{
-            vTaskDelay(10 / portTICK_PERIOD_MS);
+            lv_label_ins_text(label, LV_LABEL_POS_LAST, update.text);
         }
     }
 }
 
-/* Display */
-static bool lvgl_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
-{
-    lv_disp_drv_t *disp_driver = (lv_disp_drv_t *)user_ctx;
-    lv_disp_flush_ready(disp_driver);
-    return false;
+static void ui_set_power(ui_power_t state){
+    if(state == ui_power){
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if(ui_power == UI_OFF){
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_acquire(ui_lit_lock);
+#endif
+        display_backlight(BACKLIGHT_FULL_DUTY); // light first, the rest can wait a frame
+        ESP_LOGI(POWER_TAG, "Screen on after %lld ms", (now - power_stats.sleep_us) / 1000);
+    }
+    switch(state){
+        case UI_ACTIVE:
+            display_backlight(BACKLIGHT_FULL_DUTY);
+            // blink again at the theme's rate
+            lv_obj_remove_local_style_prop(compose_area, LV_STYLE_ANIM_TIME, LV_PART_CURSOR);
+            break;
+        case UI_DIM:
+            display_backlight(BACKLIGHT_DIM_DUTY);
+            // the blink animation would wake LVGL every refresh period
+            lv_obj_set_style_anim_time(compose_area, 0, LV_PART_CURSOR);
+            break;
+        case UI_OFF:
+            display_backlight(0);
+            lv_obj_set_style_anim_time(compose_area, 0, LV_PART_CURSOR);
+            power_stats.sleep_us = now;
+            power_stats.wake_us = 0;
+            ESP_LOGI(POWER_TAG, "Screen off, %.1f wakeups/s while on",
+                     power_stats.wakeups * 1e6 / (now - power_stats.since_us));
+            power_stats.wakeups = 0;
+            power_stats.since_us = now;
+#if CONFIG_PM_ENABLE
+            esp_pm_lock_release(ui_lit_lock);
+#endif
+            break;
+    }
+    ui_power = state;
 }
 
-static void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
-{
-    esp_lcd_panel_handle_t panel_handle = (esp_lcd_panel_handle_t) drv->user_data;
-    int offsetx1 = area->x1;
-    int offsetx2 = area->x2;
-    int offsety1 = area->y1;
-    int offsety2 = area->y2;
-    // copy a buffer's content to a specific area of the display
-    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, color_map);
+/*Display mirror*/
+esp_err_t mirror_initialize(void){
+#if MIRROR_ENABLED
+    mirror = malloc(sizeof(mirror_enc_t));
+    mirror_out = xMessageBufferCreate(MIRROR_BACKLOG_BYTES);
+    if(mirror == NULL || mirror_out == NULL){
+        free(mirror);
+        mirror = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    mirror_enc_init(mirror, DISPLAY_HOR_RES, DISPLAY_VER_RES);
+    mirror_budget_init(&mirror_budget, MIRROR_BUDGET_BYTES_S, MIRROR_BURST_BYTES, esp_timer_get_time());
+#endif
+    return ESP_OK;
 }
 
-static void increase_lvgl_tick(void *arg)
-{
-    lv_tick_inc(LVGL_TICK_PERIOD_MS);
+// Any task: the AP has a viewer that wants the whole screen, or none left
+static void mirror_ask(uint8_t request){
+#if MIRROR_ENABLED
+    atomic_store(&mirror_request, request);
+    ui_posted();
+#endif
 }
 
+#if MIRROR_ENABLED
+static bool mirror_emit(void *ctx, const uint8_t *msg, size_t len){
+    return xMessageBufferSend(mirror_out, msg, len, 0) == len;
+}
+#endif
+
+// Display task, called once the area is queued for the panel so the encoder runs while the DMA sends
+static void mirror_flush(const lv_area_t *area, const lv_color_t *pixels, size_t stride, bool last){
+#if MIRROR_ENABLED
+    if(!mirror_active){
+        return;
+    }
+    mirror_encode(mirror, area->x1, area->y1, area->x2, area->y2, (const uint16_t *)pixels, stride, last, mirror_emit, NULL);
+    xTaskNotifyGive(link_tx_handle);
+#endif
+}
+
+/**
+ * Display task, before LVGL runs. A refresh starts the mirror over with the
+ * whole screen, areas the backlog had no room for are invalidated again once
+ * it is half empty.
+ */
+static void mirror_poll(void){
+#if MIRROR_ENABLED
+    // take and clear in one step, a request the link task posts meanwhile is not lost
+    uint8_t request = atomic_exchange(&mirror_request, 0);
+    if(request == MIRROR_MSG_STOP && mirror_active){
+        mirror_active = false;
+        display_set_watched(false);
+        ESP_LOGI(MIRROR_TAG, "Viewer gone, %u messages, %u bytes, %u areas left out",
+                 (unsigned)mirror->messages, (unsigned)mirror->bytes, (unsigned)mirror->dropped);
+    }
+    else if(request == MIRROR_MSG_REFRESH && mirror != NULL){
+        uint8_t msg[8];
+        mirror_enc_reset(mirror);
+        mirror_active = xMessageBufferSend(mirror_out, msg, mirror_screen_msg(mirror, msg), 0) > 0;
+        display_set_watched(mirror_active);
+        if(mirror_active){
+            ESP_LOGI(MIRROR_TAG, "Viewer connected, sending the screen");
+            lv_obj_invalidate(lv_scr_act());
+        }
+        else{
+            // retry later, unless the AP asked for something newer meanwhile
+            uint8_t none = 0;
+            atomic_compare_exchange_strong(&mirror_request, &none, MIRROR_MSG_REFRESH);
+        }
+    }
+    mirror_rect_t dirty;
+    if(mirror_active && xMessageBufferSpacesAvailable(mirror_out) >= MIRROR_BACKLOG_BYTES / 2
+       && mirror_take_dirty(mirror, &dirty)){
+        lv_area_t area = {dirty.x1, dirty.y1, dirty.x2, dirty.y2};
+        lv_obj_invalidate_area(lv_scr_act(), &area);
+    }
+#endif
+}
+
+// Display task, after LVGL ran: what could not be sent is looked at again soon
+static uint32_t mirror_wait_ms(void){
+#if MIRROR_ENABLED
+    if(atomic_load(&mirror_request) != 0 || (mirror_active && mirror->has_dirty)){
+        return MIRROR_RETRY_MS;
+    }
+#endif
+    return UINT32_MAX;
+}
+
+// link_tx_task: encoded messages go into the mux as far as the budget and the channel's queue allow
+static void mirror_feed(int64_t now_us){
+#if MIRROR_ENABLED
+    static uint8_t msg[MIRROR_MSG_MAX];
+    static size_t len = 0;  // taken out of mirror_out, not yet in the mux
+    while(mirror_out != NULL){
+        if(len == 0){
+            size_t next = xMessageBufferNextLengthBytes(mirror_out);
+            if(next == 0 || !mirror_budget_take(&mirror_budget, next, now_us)){
+                return;
+            }
+            len = xMessageBufferReceive(mirror_out, msg, sizeof(msg), 0);
+        }
+        xSemaphoreTake(send_lock, portMAX_DELAY);
+        bool pushed = socket_status == 0 && mux_tx_push(&link_tx, MUX_CH_MIRROR, msg, len);
+        xSemaphoreGive(send_lock);
+        if(!pushed){
+            return;
+        }
+        len = 0;
+    }
+#endif
+}
+
+/*Requests*/
+esp_err_t rpc_initialize(void){
+    rpc_init(&rpc);
+    rpc_lock = xSemaphoreCreateMutex();
+    return rpc_lock != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// Ask the UART device for a value of frame type target, done runs when it answers or times out
+int rpc_request(uint8_t target, rpc_done_cb done){
+    uint8_t request[RPC_FRAME_OVERHEAD];
+    uint16_t id;
+    xSemaphoreTake(rpc_lock, portMAX_DELAY);
+    int begun = rpc_begin(&rpc, esp_timer_get_time(), RPC_TIMEOUT_MS, done, NULL, &id);
+    xSemaphoreGive(rpc_lock);
+    if(begun != RPC_OK){
+        return SEND_LOST;
+    }
+    size_t length = rpc_encode_request(request, id, target, NULL, 0);
+    // an answer is only useful now, requests never go to the outbox
+    xSemaphoreTake(send_lock, portMAX_DELAY);
+    bool pushed = socket_status == 0 && mux_tx_push(&link_tx, MUX_CH_CONTROL, request, length);
+    xSemaphoreGive(send_lock);
+    if(!pushed){
+        rpc_finished_t cancelled;
+        xSemaphoreTake(rpc_lock, portMAX_DELAY);
+        bool taken = rpc_take(&rpc, id, &cancelled);
+        xSemaphoreGive(rpc_lock);
+        if(taken){
+            rpc_finish(&cancelled, RPC_STATUS_CANCELLED, NULL, 0);
+        }
+        return SEND_LOST;
+    }
+    capture_frame(TRACE_DIR_TX, MUX_CH_CONTROL, request, length);
+    xTaskNotifyGive(link_tx_handle);
+    return SEND_OK;
+}
+
+static void rpc_response(const uint8_t *msg, size_t len){
+    rpc_msg_t response;
+    if(rpc_parse(msg, len, &response) != RPC_OK || response.type != RPC_FRAME_RESPONSE){
+        ui_set_status(UI_INPUT_ERROR, 0x01);
+        return;
+    }
+    // callbacks run outside rpc_lock, they may start the next request
+    rpc_finished_t answered;
+    xSemaphoreTake(rpc_lock, portMAX_DELAY);
+    bool taken = rpc_take(&rpc, response.id, &answered);
+    xSemaphoreGive(rpc_lock);
+    if(taken){
+        rpc_finish(&answered, response.code, response.data, response.len);
+    }
+    else{
+        ESP_LOGI(TAG_TCP, "Late answer to request %u", response.id);
+    }
+}
+
+static void humidity_done(void *ctx, uint16_t id, int status, const uint8_t *value, size_t len){
+    static char text[RPC_VALUE_MAX + 16];
+    switch(status){
+        case RPC_STATUS_CANCELLED: // never sent, keypad already shows the error
+            break;
+        case RPC_STATUS_TIMEOUT:
+            ui_set_status(UI_INPUT_ERROR, 0x06);
+            ui_add_message("Brak odpowiedzi");
+            break;
+        case 0x00:
+            snprintf(text, sizeof(text), "Wilgotnosc: %.*s", (int)len, (const char *)value);
+            ui_set_status(UI_INPUT_ERROR, 0x00);
+            ui_add_message(text);
+            break;
+        default: // error code reported by the device
+            ui_set_status(UI_INPUT_ERROR, status);
+    }
+}
+
+// Frames from send_frame, as opposed to RPC requests, mirror updates and outbox replays
+static bool link_frame_is_user(int channel, const uint8_t *frame, size_t len){
+    return channel == MUX_CH_TEXT
+           || (channel == MUX_CH_CONTROL && len >= 3
+               && frame[2] != RPC_FRAME_REQUEST && frame[2] != RPC_FRAME_RESPONSE);
+}
+
+/**
+ * The link failed: empty the mux, frames from send_frame go to the outbox.
+ * RPC requests time out, the mirror is asked for again after a reconnect and
+ * a replayed outbox frame is still in the journal. Called with send_lock held.
+ */
+static void link_requeue(void){
+    static uint8_t msg[MUX_MESSAGE_MAX];
+    unsigned kept = 0, lost = 0;
+    if(outbox_in_flight){
+        // pushed when the bulk channel was empty, so it is the oldest there
+        mux_tx_drop(&link_tx, MUX_CH_BULK);
+        outbox_in_flight = false;
+    }
+    for(int c = 0; c < MUX_CHANNELS; c++){
+        size_t len;
+        while((len = mux_tx_front(&link_tx, c, msg, sizeof(msg))) > 0){
+            bool user = c == MUX_CH_BULK || link_frame_is_user(c, msg, len);
+            mux_tx_drop(&link_tx, c);
+            if(!user){
+                continue;
+            }
+            if(outbox_ready && len <= JOURNAL_MAX_RECORD && journal_append(&outbox, msg, len) == JOURNAL_OK){
+                kept++;
+            }
+            else{
+                lost++;
+            }
+        }
+    }
+    mux_tx_rewind(&link_tx);
+    if(kept > 0 || lost > 0){
+        ESP_LOGW(OUTBOX_TAG, "Link down, %u frames moved to the outbox, %u lost", kept, lost);
+        ui_set_status(UI_OUTPUT_ERROR, lost > 0 ? 0x06 : 0x05);
+    }
+}
+
+// Puts queued fragments on the wire, channel order decided by the mux scheduler
+static void link_tx_task(void *arg){
+    static uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
+    static rpc_finished_t expired[RPC_MAX_OUTSTANDING];
+    int64_t last_expire = 0;
+    while(1){
+        int64_t now = esp_timer_get_time();
+        if(now - last_expire >= RPC_EXPIRE_INTERVAL_MS * 1000){
+            xSemaphoreTake(rpc_lock, portMAX_DELAY);
+            int count = rpc_take_expired(&rpc, now, expired);
+            xSemaphoreGive(rpc_lock);
+            for(int i = 0; i < count; i++){
+                rpc_finish(&expired[i], RPC_STATUS_TIMEOUT, NULL, 0);
+            }
+            last_expire = now;
+        }
+        mirror_feed(now);
+        xSemaphoreTake(send_lock, portMAX_DELAY);
+        size_t n = socket_status == 0 ? mux_tx_prepare(&link_tx, fragment) : 0;
+        xSemaphoreGive(send_lock);
+        if(n == 0){
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+        // the fragment stays queued until it is written
+        bool written = link_write(fragment, n) == n;
+        bool text_sent = false;
+        xSemaphoreTake(send_lock, portMAX_DELAY);
+        if(written){
+            text_sent = mux_tx_commit(&link_tx) == MUX_CH_TEXT;
+        }
+        else if(socket_status == 0){
+            // the rest of the message can not follow a lost fragment, keep() opens a new link
+            socket_status = -1;
+            link_requeue();
+        }
+        xSemaphoreGive(send_lock);
+        if(!written){
+            ESP_LOGW(TAG_TCP, "Fragment write failed, closing the link");
+        }
+        else if(text_sent){
+            ui_set_status(UI_OUTPUT_ERROR, 0x00);
+        }
+    }
+}
+
+/**
+ * Replays stored frames oldest first on the bulk channel, one per
+ * OUTBOX_REPLAY_INTERVAL_MS. A frame leaves the journal only once its last
+ * fragment is written, a reset before that replays it again.
+ */
+static void outbox_task(void *arg){
+    static uint8_t stored[JOURNAL_MAX_RECORD];
+    u_int8_t length;
+    while(1){
+        bool sent = false;
+        if(socket_status == 0 && journal_pending(&outbox) > 0){
+            xSemaphoreTake(send_lock, portMAX_DELAY);
+            if(outbox_in_flight && mux_tx_completed(&link_tx, MUX_CH_BULK) != outbox_mark){
+                journal_pop(&outbox);
+                outbox_in_flight = false;
+            }
+            // only one replayed frame in flight, the rest stays safe in flash
+            if(!outbox_in_flight && mux_tx_queued(&link_tx, MUX_CH_BULK) == 0
+               && journal_peek(&outbox, stored, sizeof(stored), &length) == JOURNAL_OK
+               && mux_tx_push(&link_tx, MUX_CH_BULK, stored, length)){
+                outbox_mark = mux_tx_completed(&link_tx, MUX_CH_BULK);
+                outbox_in_flight = true;
+                sent = true;
+            }
+            xSemaphoreGive(send_lock);
+        }
+        if(sent){
+            capture_frame(TRACE_DIR_TX, MUX_CH_BULK, stored, length);
+            xTaskNotifyGive(link_tx_handle);
+            vTaskDelay(OUTBOX_REPLAY_INTERVAL_MS / portTICK_PERIOD_MS);
+        }
+        else{
+            vTaskDelay(OUTBOX_IDLE_MS / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+// Called by the demultiplexer for every complete frame from AP
+static void handle_frame(void *ctx, uint8_t channel, const uint8_t *msg, size_t len){
+    capture_frame(TRACE_DIR_RX, channel, msg, len);
+    if(channel == MUX_CH_MIRROR){
+        // about the AP's viewer, nothing to show
+        if(len > 0){
+            mirror_ask(msg[0]);
+        }
+        return;
+    }
+    ui_notify(); // a new message lights the screen up
+    bzero(buffer, sizeof(buffer));
+    bzero(received_data, sizeof(received_data));
+    // longest prefix is 13 characters, keep the copy inside received_data
+    int r = len < sizeof(received_data) - 14 ? len : sizeof(received_data) - 14;
+    memcpy(buffer, msg, r);
+    ESP_LOGI("socket", "%i (channel %u)", r, channel);
+    ESP_LOGI("socket", "%s", buffer);
+    ESP_LOG_BUFFER_HEXDUMP("dump", buffer, r, ESP_LOG_INFO);
+    switch(buffer[2]){ 
+        case 48: // wilgotnosc, do 99
+            strcpy(received_data, "Temperatura: ");
+            ESP_LOGI("ds", "%s",received_data);
+            for(int i = 13; i < r + 7; i++){
+                received_data[i] = buffer[i - 9];
+            }
+            if(r > 9 || (r == 9 && (buffer[4] > '1' || (buffer[4] == '1' && (buffer[5] > '0' || buffer[6] > '0'))))){
+                ui_set_status(UI_INPUT_ERROR, 0x03);
+            }
+            else{
+                ui_set_status(UI_INPUT_ERROR, 0x00);
+            }
+             
+            ui_add_message(received_data);                         
+            ESP_LOGI("sadge", "%s",received_data);
+            break; 
+        case 49: // tekst
+            strcpy(received_data, "Komunikat: ");
+            for(int i = 11; i < r + 5; i++){
+                received_data[i] = buffer[i - 7];
+            }
+            ui_set_status(UI_INPUT_ERROR, 0x00); 
+            ui_add_message(received_data);                                                 
+            break;
+        case 50: // read_only  
+            strcpy(received_data, "Wilgotnosc: ");
+
+            for(int i = 12; i < r + 6; i++){
+                received_data[i] = buffer[i - 8];
+            }                            
+            if(r > 9 || (r == 9 && (buffer[4] > '1' || (buffer[4] == '1' && (buffer[5] > '0' || buffer[6] > '0'))))){
+                ui_set_status(UI_INPUT_ERROR, 0x03);
+            }
+            else{
+                ui_set_status(UI_INPUT_ERROR, 0x00);
+            } 
+            ui_add_message(received_data);                          
+            break;
+        case 52: // odpowiedz na zapytanie
+            rpc_response(msg, len);
+            break;
+        default:
+            ui_set_status(UI_INPUT_ERROR, 0x01); 
+            ui_add_message("Nie rozpoznano FrameID"); 
+    }
+}
+
+static void socket_read(void *arg){
+    static uint8_t chunk[256];
+    mux_rx_init(&link_rx, handle_frame, NULL);
+    while(1){
+        if(socket_status == 0){
+            int r = link_read(chunk, sizeof(chunk));
+            if (r > 0){
+                mux_rx_feed(&link_rx, chunk, r);
+            }
+            else{
+                // idle or dead link, let keep() notice the latter instead of spinning
+                vTaskDelay(10 / portTICK_PERIOD_MS);
+            }
+        }
+        else{
+            // partial messages from the old connection are useless
+            mux_rx_reset(&link_rx);
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+static uint32_t min_ms(uint32_t a, uint32_t b){
+    return a < b ? a : b;
+}
+
+/**
+ * Sleeps until an LVGL timer, the multi-tap timeout or the next backlight
+ * step is due, keys and frames wake it early through ui_notify.
+ */
 static void disRefresh(void *arg){
+    uint32_t wait_ms = 0;
+    uint32_t last_activity_ms = esp_timer_get_time() / 1000;
+    ui_task = xTaskGetCurrentTaskHandle();
     while (1) {
-        // raise the task priority of LVGL and/or reduce the handler period can improve the performance
-        vTaskDelay(pdMS_TO_TICKS(10));
-        // The task running lv_timer_handler should have lower priority than that running `lv_tick_inc`
-        lv_timer_handler();
+        TickType_t ticks = ui_power == UI_OFF ? portMAX_DELAY
+                           : (wait_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        uint32_t wake = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &wake, ticks);
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_acquire(ui_busy_lock);
+#endif
+        power_stats.wakeups++;
+        uint32_t now_ms = esp_timer_get_time() / 1000;
+        if(wake & UI_WAKE_ACTIVITY){
+            last_activity_ms = now_ms;
+            ui_set_power(UI_ACTIVE);
+        }
+        ui_apply();
+        mirror_poll();
+        lv_indev_read_timer_cb(keypad_read_timer);
+        wait_ms = lv_timer_handler();
+        wait_ms = min_ms(wait_ms, mirror_wait_ms());
+
+        if(power_stats.wake_us != 0){
+            ESP_LOGI(POWER_TAG, "First key %lld us after wakeup", esp_timer_get_time() - power_stats.wake_us);
+            power_stats.wake_us = 0;
+        }
+        int64_t since_us = esp_timer_get_time() - power_stats.since_us;
+        if(ui_power != UI_OFF && since_us >= POWER_STATS_INTERVAL_MS * 1000LL){
+            ESP_LOGI(POWER_TAG, "%.1f wakeups/s", power_stats.wakeups * 1e6 / since_us);
+            power_stats.wakeups = 0;
+            power_stats.since_us += since_us;
+        }
+
+        uint32_t idle_ms = now_ms - last_activity_ms;
+        if(idle_ms >= BACKLIGHT_OFF_MS){
+            ui_set_power(UI_OFF);
+        }
+        else if(idle_ms >= BACKLIGHT_DIM_MS){
+            ui_set_power(UI_DIM);
+            wait_ms = min_ms(wait_ms, BACKLIGHT_OFF_MS - idle_ms);
+        }
+        else{
+            wait_ms = min_ms(wait_ms, BACKLIGHT_DIM_MS - idle_ms);
+        }
+        wait_ms = min_ms(wait_ms, multitap_next_deadline(&composer, now_ms));
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_release(ui_busy_lock);
+#endif
     }   
 }
 
-/*Keypad*/
-void intr_click_handler(void *args);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// Logs how busy each core was over the last interval and the display task's part of that
+static void cpu_stats_task(void *arg){
+    static TaskStatus_t tasks[CPU_STATS_MAX_TASKS];
+    uint32_t last_idle[portNUM_PROCESSORS] = {0};
+    uint32_t last_ui = 0;
+    uint32_t last_total = 0;
+    while(1){
+        vTaskDelay(CPU_STATS_INTERVAL_MS / portTICK_PERIOD_MS);
+        uint32_t total;
+        UBaseType_t count = uxTaskGetSystemState(tasks, CPU_STATS_MAX_TASKS, &total);
+        if(count == 0){
+            ESP_LOGW(CPU_TAG, "More than %d tasks", CPU_STATS_MAX_TASKS);
+            continue;
+        }
+        uint32_t idle[portNUM_PROCESSORS] = {0};
+        uint32_t ui = 0;
+        for(UBaseType_t i = 0; i < count; i++){
+            for(int core = 0; core < portNUM_PROCESSORS; core++){
+                if(tasks[i].xHandle == xTaskGetIdleTaskHandleForCPU(core)){
+                    idle[core] = tasks[i].ulRunTimeCounter;
+                }
+            }
+            if(tasks[i].xHandle == ui_task){
+                ui = tasks[i].ulRunTimeCounter;
+            }
+        }
+        // the run time counter is time since boot, each core's idle task counts the time its core had nothing to do
+        uint32_t elapsed = total - last_total;
+        if(last_total != 0 && elapsed != 0){
+            char line[64];
+            int n = 0;
+            for(int core = 0; core < portNUM_PROCESSORS; core++){
+                uint32_t busy = 100 - (uint64_t)(idle[core] - last_idle[core]) * 100 / elapsed;
+                n += snprintf(&line[n], sizeof(line) - n, "core %d %u%%, ", core, (unsigned)busy);
+            }
+            ESP_LOGI(CPU_TAG, "%sdisplay task %u%%", line, (unsigned)((uint64_t)(ui - last_ui) * 100 / elapsed));
+        }
+        memcpy(last_idle, idle, sizeof(idle));
+        last_ui = ui;
+        last_total = total;
+    }
+}
+#endif
 
+/*Keypad*/
 /**
- * Enable rows'pin pullup resistor, and isr. Prepares
- * keypad to read pressed row number.
+ * Idle: all columns driven low, a key press pulls its row low and the row
+ * interrupt starts the scan timer. Scanning: one column low at a time, rows
+ * read back through their pullups. The timer stops once every key has been
+ * released and settled, so nothing runs while the keypad is untouched.
  */
-void turnon_rows()
+static void keypad_columns_idle(void)
 {
     for(int i = 4; i < 8; i++) /// Columns
     {
-        gpio_set_pull_mode(_keypad_pins[i], GPIO_PULLDOWN_ONLY);
-    }
-    for(int i = 0; i < 4; i++) /// Rows
-    {
-        gpio_set_pull_mode(_keypad_pins[i], GPIO_PULLUP_ONLY);
-        gpio_intr_enable(_keypad_pins[i]);
+        gpio_set_level(_keypad_pins[i], 0);
     }
 }
 
-/**
- *  Enable columns'pin pullup resistor, and disable rows isr and pullup resistor.
- * Prepares keypad to read pressed column number. 
- */
-void turnon_cols()
+static void IRAM_ATTR keypad_wake_isr(void *args)
 {
-    for(int i = 0; i < 4; i++) /// Rows
+    if(ui_power == UI_OFF && power_stats.wake_us == 0)
     {
-        gpio_intr_disable(_keypad_pins[i]);
-        gpio_set_pull_mode(_keypad_pins[i], GPIO_PULLDOWN_ONLY);
+        power_stats.wake_us = esp_timer_get_time();
     }
-    for(int i = 4; i < 8; i++) /// Columns
+    KEY_TRACE(key_trace_isr(esp_timer_get_time()));
+    for(int i = 0; i < 4; i++) /// Rows
     {
-        gpio_set_pull_mode(_keypad_pins[i], GPIO_PULLUP_ONLY);
+        gpio_intr_disable(_keypad_pins[i]);
     }
+    esp_timer_start_periodic(keypad_timer, KEYPAD_SCAN_MS * 1000);
 }
 
-esp_err_t keypad_initalize(gpio_num_t keypad_pins[8])
+// Bit row * 4 + col set for every closed key
+static uint16_t keypad_sample(void)
 {
-    memcpy(_keypad_pins, keypad_pins, 8*sizeof(gpio_num_t));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_install_isr_service(ESP_INTR_FLAG_EDGE));
-    for(int i = 0; i < 4; i++) /// Rows
+    uint16_t raw = 0;
+    for(int c = 0; c < 4; c++)
     {
-        gpio_intr_disable(keypad_pins[i]);
-        gpio_set_direction(keypad_pins[i], GPIO_MODE_INPUT);
-        gpio_set_intr_type(keypad_pins[i], GPIO_INTR_NEGEDGE);
-        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_isr_handler_add(_keypad_pins[i], (void*)intr_click_handler, (void*)i));
-        
+        for(int i = 4; i < 8; i++)
+        {
+            gpio_set_level(_keypad_pins[i], i - 4 != c);
+        }
+        esp_rom_delay_us(2); // let the row lines settle through the pullups
+        for(int r = 0; r < 4; r++)
+        {
+            if(!gpio_get_level(_keypad_pins[r]))
+            {
+                raw |= 1 << (r * 4 + c);
+            }
+        }
     }
-    for(int i = 4; i < 8; i++)
+    return raw;
+}
+
+static void keypad_scan_timer(void *arg)
+{
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    uint16_t raw = keypad_sample();
+    keypad_columns_idle();
+    if(!keypad_scan_feed(&keypad_scanner, raw, now_ms))
     {
-        gpio_set_direction(keypad_pins[i], GPIO_MODE_INPUT);
+        esp_timer_stop(keypad_timer);
+        for(int i = 0; i < 4; i++) /// Rows
+        {
+            gpio_intr_enable(_keypad_pins[i]);
+        }
     }
-
-    keypad_queue = xQueueCreate(5, sizeof(char));
-    if(keypad_queue == NULL)
-        return ESP_ERR_NO_MEM;
-
-    turnon_rows();
-
-    return ESP_OK;
 }
 
-void intr_click_handler(void* args)
+// Runs in the esp_timer task, text entry happens in the LVGL input device read
+static void keypad_event(void *ctx, const key_event_t *event)
 {
-    int index = (int)(args);
-    
-    time_t time_now_isr = time(NULL);
-    time_t time_isr = (time_now_isr - time_old_isr)*1000L;
-    
-    if(time_isr >= KEYPAD_DEBOUNCING)
+    if(event->type != KEY_EVENT_UP)
     {
-        turnon_cols();
-        for(int j = 4; j < 8; j++)
+        if(xQueueSend(keypad_queue, event, 0) == pdTRUE)
         {
-            if(!gpio_get_level(_keypad_pins[j]))
-            {
-            if(spec_num == index*4 + j - 4 && repeat == 0)
-            {
-                xQueueSendFromISR(keypad_queue, &keypad[index*4 + j - 4], NULL);
-                spec_num = index*4 + j - 4;
-                repeat = 1;
-                break;                
-            }            
-            else if(spec_num == index*4 + j - 4 && repeat == 1)
-            {
-                xQueueSendFromISR(keypad_queue, &keypad1[index*4 + j - 4], NULL);
-                spec_num = index*4 + j - 4;
-                repeat = 2;
-                break;                
-            }
-            else if(spec_num == index*4 + j - 4 && repeat == 2)
-            {
-                xQueueSendFromISR(keypad_queue, &keypad2[index*4 + j - 4], NULL);
-                spec_num = index*4 + j - 4;
-                repeat = 3;
-                break;                
-            }
-            else if(spec_num == index*4 + j - 4 && repeat == 3)
-            {
-                xQueueSendFromISR(keypad_queue, &keypad3[index*4 + j - 4], NULL);
-                spec_num = index*4 + j - 4;
-                repeat = 0;
-                break;                
-            }
-            else
-            {
-                xQueueSendFromISR(keypad_queue, &keypad[index*4 + j - 4], NULL);
-                spec_num = index*4 + j - 4;
-                repeat = 1;                                
-                break;               
-            }            
-            }
+            KEY_TRACE(key_trace_scanned(event->key, esp_timer_get_time()));
         }
-        turnon_rows();
+        ui_notify();
     }
-    time_old_isr = time_now_isr;
-    
 }
 
-char keypad_getkey()
+esp_err_t keypad_initalize(gpio_num_t keypad_pins[8])
 {
-    char key;
-    if(!uxQueueMessagesWaiting(keypad_queue)) /// if is empty, return teminator character
-        return '\0';
-    xQueueReceive(keypad_queue, &key, portMAX_DELAY);
-    return key;
+    memcpy(_keypad_pins, keypad_pins, 8*sizeof(gpio_num_t));
+    keypad_queue = xQueueCreate(KEYPAD_STACKSIZE, sizeof(key_event_t));
+    if(keypad_queue == NULL)
+        return ESP_ERR_NO_MEM;
+    keypad_scan_init(&keypad_scanner, KEYPAD_DEBOUNCE_SCANS, KEYPAD_LONG_PRESS_MS, keypad_event, NULL);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = keypad_scan_timer,
+        .name = "keypad_scan"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &keypad_timer));
+
+    for(int i = 4; i < 8; i++) /// Columns
+    {
+        gpio_set_direction(keypad_pins[i], GPIO_MODE_OUTPUT_OD);
+    }
+    keypad_columns_idle();
+
+    // level interrupts, light sleep can only be woken up by a GPIO level
+    ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_install_isr_service(0));
+    for(int i = 0; i < 4; i++) /// Rows
+    {
+        gpio_intr_disable(keypad_pins[i]);
+        gpio_set_direction(keypad_pins[i], GPIO_MODE_INPUT);
+        gpio_set_pull_mode(keypad_pins[i], GPIO_PULLUP_ONLY);
+        gpio_set_intr_type(keypad_pins[i], GPIO_INTR_LOW_LEVEL);
+        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_isr_handler_add(keypad_pins[i], keypad_wake_isr, NULL));
+        ESP_ERROR_CHECK_WITHOUT_ABORT(gpio_wakeup_enable(keypad_pins[i], GPIO_INTR_LOW_LEVEL));
+        gpio_intr_enable(keypad_pins[i]);
+    }
+    return esp_sleep_enable_gpio_wakeup();
 }
 
 void keypad_delete()
 {
+    esp_timer_stop(keypad_timer);
+    esp_timer_delete(keypad_timer);
     for(int i = 0; i < 8; i++)
     {   
         gpio_isr_handler_remove(_keypad_pins[i]);
+        gpio_wakeup_disable(_keypad_pins[i]);
         gpio_set_direction(_keypad_pins[i], GPIO_MODE_DISABLE);
     }
     vQueueDelete(keypad_queue);
 }
 
 
-static void keypadtask(lv_obj_t *txt){
-    // spliting 16 bit number into 2 8bit numbers for prefix
-    short frameid = 0xAA55;
-    char frameid_bytes[2];
-    frameid_bytes[0] = (frameid >> 8) & 0xFF;
-    frameid_bytes[1] = frameid & 0xFF;
-    static char safty_skip_flag = 'f';
-    while(true)
-    {
-        char keypressed = keypad_getkey();  /// gets from key queue    
-        
-        if(keypressed != '\0' && keypressed != '`' && keypressed != 'D' && keypressed != 'C' && keypressed != '#'){ // Display character
-            /* Pehaps add safty measure for array opverflow*/
-            word[position] = keypressed;
-            word[position + 1] = '\0';
-            if(position == 0){
-                frame[2] = keypressed;
+// [0xAA][0x55][type][len][text after the type][crc][xor], text[0] is the frame type
+static u_int8_t compose_frame(uint8_t *out, const char *text, u_int8_t length){
+    out[0] = 0xAA;
+    out[1] = 0x55;
+    out[2] = text[0];
+    out[3] = length + 5;
+    memcpy(&out[4], &text[1], length - 1);
+    out[length + 3] = Calculate_Crc(out[2], out[3], text, length);
+    out[length + 4] = Calculate_Xor(out[2], out[3], text, length);
+    return length + 5;
+}
+
+// Error code for text that cannot go out as a frame, 0x00 when it can
+static uint8_t text_check(const char *text, u_int8_t length){
+    switch(text[0]){
+        case '0': // temperatura do 100
+            return length - 1 > 3 || (length - 1 == 3 && strncmp(&text[1], "100", 3) > 0) ? 0x03 : 0x00;
+        case '1': // tekst
+            return length - 1 > 249 ? 0x03 : 0x00;
+        case '2': // read_only (wilgotnosc), value is requested from the UART device
+            return 0x00;
+        default:
+            return 0x02;
+    }
+}
+
+static void show_send_error(uint8_t code){
+    static char text[5];
+    snprintf(text, sizeof(text), "0x%02X", code);
+    ESP_LOGI("Frame_Error", "ERROR %s", text);
+    lv_label_set_text(label4, text);
+}
+
+// Send a ready frame, or ask the UART device for humidity, returns false when it was lost
+static bool frame_send(const uint8_t *frame, u_int8_t size){
+    if(frame[2] == '2'){
+        // no link or too many requests waiting
+        int sent = rpc_request('2', humidity_done);
+        show_send_error(sent == SEND_OK ? 0x00 : 0x06);
+        return sent == SEND_OK;
+    }
+    ESP_LOG_BUFFER_HEXDUMP("dump", frame, size, ESP_LOG_INFO);
+    int sent = send_frame(frame, size);
+    if(sent == SEND_QUEUED){ // kept in outbox until reconnect
+        show_send_error(0x05);
+    }
+    else if(sent == SEND_LOST){ // no link and no room in the outbox, as in link_requeue
+        show_send_error(0x06);
+    }
+    // SEND_PENDING: link_tx_task shows 0x00 once the last fragment is written
+    return sent != SEND_LOST;
+}
+
+// Validate and send the composed text, returns true when it left the composer
+static bool keypad_send(const char *text, u_int8_t length){
+    static uint8_t frame[MULTITAP_MAX_TEXT + 5];
+    uint8_t error = text_check(text, length);
+    if(error != 0x00){
+        show_send_error(error);
+        return false;
+    }
+    return frame_send(frame, compose_frame(frame, text, length));
+}
+
+/*Macros*/
+// Load the macro table, NVS entries "k0".."k15" override the built-in ones
+esp_err_t macro_initialize(void){
+    nvs_handle_t nvs;
+    bool stored = nvs_open(MACRO_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK;
+    int count = 0;
+
+    macro_init(&macros, MACRO_PREFIX_KEY);
+    for(uint8_t key = 0; key < MACRO_SLOTS; key++){
+        char text[MACRO_MAX_TEXT + 1];
+        char name[4];
+        size_t size = sizeof(text);
+        snprintf(name, sizeof(name), "k%u", key);
+        if(!stored || nvs_get_str(nvs, name, text, &size) != ESP_OK){
+            if(macro_defaults[key] == NULL){
+                continue;
             }
-            else{
-                frame[position + 3] = keypressed;
+            snprintf(text, sizeof(text), "%s", macro_defaults[key]);
+        }
+        uint8_t length = strlen(text);
+        uint8_t frame[MACRO_MAX_FRAME];
+        if(length == 0 || text_check(text, length) != 0x00){
+            ESP_LOGW(KEYPAD_TAG, "Macro %s \"%s\" is not a valid frame", name, text);
+            continue;
+        }
+        count += macro_set(&macros, key, frame, compose_frame(frame, text, length)) == MACRO_OK;
+    }
+    if(stored){
+        nvs_close(nvs);
+    }
+    ESP_LOGI(KEYPAD_TAG, "%d macros", count);
+    return ESP_OK;
+}
+
+/*Predictive text*/
+// Keys carrying letters, the ones predictive mode spells with
+static bool t9_letter_key(uint8_t key){
+    const multitap_key_t *k = &multitap_layout[key];
+    return k->role == MULTITAP_CHARS && k->chars[1] >= 'a' && k->chars[1] <= 'z';
+}
+
+// Selected candidate, or the first letter of every key when the dictionary has no match
+static void t9_current(char *out, size_t size){
+    if(t9_candidate(&t9_word, t9_choice, out, size) > 0){
+        return;
+    }
+    size_t n = 0;
+    for(; n < t9_word.depth && n < size - 1; n++){
+        out[n] = multitap_layout[t9_keys[n]].chars[1];
+    }
+    out[n] = '\0';
+}
+
+static void t9_accept(bool space){
+    char word[T9_MAX_WORD + 1];
+    if(t9_word.depth == 0){
+        return;
+    }
+    t9_current(word, sizeof(word));
+    multitap_insert(&composer, word);
+    if(space){
+        multitap_insert(&composer, " ");
+    }
+    t9_reset(&t9_word, &t9_dict);
+    t9_choice = 0;
+}
+
+/**
+ * Handle a key in predictive mode. Returns MULTITAP_* flags, or -1 when the
+ * key should go to the multi-tap engine as usual.
+ */
+static int t9_event(const key_event_t *event){
+    const multitap_key_t *key = &multitap_layout[event->key];
+    bool typing = t9_word.depth > 0;
+
+    if(event->key == T9_TOGGLE_KEY && event->type == KEY_EVENT_LONG){
+        multitap_cancel(&composer); // the '+' of the short press
+        t9_accept(false);
+        predictive = t9_dict.data != NULL && !predictive;
+        return MULTITAP_CHANGED;
+    }
+    if(!predictive){
+        return -1;
+    }
+    if(t9_letter_key(event->key)){
+        if(event->type == KEY_EVENT_DOWN){
+            multitap_commit(&composer);
+            if(t9_word.depth < T9_MAX_DEPTH){
+                t9_keys[t9_word.depth] = event->key;
+                t9_push(&t9_word, event->key);
             }
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %c\n", keypressed);
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %s\n", word);
-            lv_textarea_set_text(txt, word);
-            safty_skip_flag = 't';
-        }
-
-        // clear the display
-        else if (keypressed == '`'){
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %c\n", keypressed);
-            word[0] = ' ';
-            word[1] = '\0';
-            lv_textarea_set_text(txt, word);
-            position = 0;
-            safty_skip_flag = 'f';
-            strcpy(frame, frameid_bytes);
-        }
-        else if (keypressed == 'D' && safty_skip_flag == 't'){ // going onto next character
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %c\n", keypressed);
-            position ++;
-            safty_skip_flag = 'f';
-            
+            t9_choice = 0;
+        }
+        else if(typing){ // long press, the digit instead of a letter
+            t9_pop(&t9_word);
+            t9_accept(false);
+            char digit[2] = {key->chars[0], '\0'};
+            multitap_insert(&composer, digit);
         }
-        else if (keypressed == 'C' && position > 0){ // delete last accepted character
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %c\n", keypressed);
-            for(int i=0; i < position; i++){
-                placeholder[i] = word[i];
+        return MULTITAP_CHANGED;
+    }
+    if(!typing){
+        return -1;
+    }
+    switch(key->role){
+        case MULTITAP_NEXT: // next candidate
+            if(event->type == KEY_EVENT_DOWN){
+                int count = t9_count(&t9_word);
+                t9_choice = count > 0 ? (t9_choice + 1) % count : 0;
             }
-            position --;
-            for(int i=0; i < position; i++){
-                word[i] = placeholder[i];
-                if(i == 0){
-                    frame[2] = placeholder[i];
-                }
-                else{
-                    frame[3+i] = placeholder[i];
-                }
+            return MULTITAP_CHANGED;
+        case MULTITAP_DELETE:
+            if(event->type == KEY_EVENT_LONG){
+                t9_reset(&t9_word, &t9_dict);
+                return -1;
             }
-            word[position] = '\0';
-            safty_skip_flag = 'f';
-            lv_textarea_set_text(txt, word);
-        }
-        else if(keypressed == '#'){
-            ESP_LOGI(KEYPAD_TAG, "Pressed key: %c\n", keypressed);
-            if(position > 0){
-                uint8_t* frame = (uint8_t*) malloc(position+6);
-                frame[0] = frameid_bytes[0];
-                frame[1] = frameid_bytes[1];
-                frame[2] = word[0]; // at least for now, FrameId is the same as the first input of keypad
-                for(u_int8_t i = 1; i < position+1; i++){
-                    frame[3+i] = word[i];
-                }
-                if (frame[position+3] == 0x00){
-                    frame[3] = position+5; // length of frame, 5 for fields besides data, position for data, as first number in data is for frameid for now (otherwise would be position +1), and we don't take into account the field with null value created by pressing D
-                    frame[position + 3] = Calculate_Crc(frame[2], frame[3], word, position);
-                    frame[position + 4] = Calculate_Xor(frame[2], frame[3], word, position);
-                ESP_LOGI("frame", "%s", frame);
-                ESP_LOG_BUFFER_HEXDUMP("dump", frame, position+5, ESP_LOG_INFO);
-                }
-                else{
-                    frame[3] = position+6; // length of frame, 6 for fields besides data, position for data, as first number in data is for frameid for now (otherwise would be position +1)
-                    frame[position + 4] = Calculate_Crc(frame[2], frame[3], word, position+1);
-                    frame[position + 5] = Calculate_Xor(frame[2], frame[3], word, position+1);
-                ESP_LOGI("frame", "%s", frame);
-                ESP_LOG_BUFFER_HEXDUMP("dump", frame, position+6, ESP_LOG_INFO);
-                }
-
-                switch(frame[2]){ 
-                    case '0': // temperatura do 100  if(r > 9 || (r == 9 && (buffer[4] > '1' || (buffer[4] == '1' && (buffer[5] > '0' || buffer[6] > '0')))))
-                        if((position > 3 && word[position] != '\0') || ((position == 3 || position == 4) && (word[1] > '1' || (word[1] == '1' && (word[2] > '0' || word[3] > '0'))))){ // position > 2 && word[position] != '\0' jak byla wilgotnosc do 99
-                            ESP_LOGI("Frame_Error", "ERROR 0x03");
-                            lv_label_set_text(label4, "0x03");
-                        }
-
-                        else{ 
-                            if(socket_status == 0){                  
-                                ESP_LOGI("socket", "%s", frame);
-                                write(soc, frame, position+6);          
-                                ESP_LOGI("Frame_Error", "ERROR 0x00");
-                                lv_label_set_text(label4, "0x00");            
-                            }                            
-                        }
-                        break; 
-                    case '1': // tekst
-                       if(position > 249){
-                            ESP_LOGI("Frame_Error", "ERROR 0x03");
-                            lv_label_set_text(label4, "0x03");
-                        }
-                        else{ 
-                            if(socket_status == 0){                  
-                                ESP_LOGI("socket", "%s", frame);
-                                write(soc, frame, position+6);          
-                                ESP_LOGI("Frame_Error", "ERROR 0x00");
-                                lv_label_set_text(label4, "0x00");            
-                            }                            
-                        }
-                        break;
-                    case '2': // read_only (wilgotnosc)
-                        ESP_LOGI("Frame_Error", "ERROR 0x04");
-                        lv_label_set_text(label4, "0x04");   
-                        break;
-                    default:
-                        ESP_LOGI("Frame_Error", "ERROR 0x02");
-                        lv_label_set_text(label4, "0x02");   
-                }
-                free(frame);
+            t9_pop(&t9_word);
+            t9_choice = 0;
+            return MULTITAP_CHANGED;
+        default:
+            if(event->key == T9_SPACE_KEY && event->type == KEY_EVENT_DOWN){
+                t9_accept(true);
+                return MULTITAP_CHANGED;
             }
-     
-            position = 0;
-            safty_skip_flag = 'f';
-        }        
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+            // punctuation, clear or send act on the finished word
+            t9_accept(false);
+            return -1;
     }
 }
 
-void display_initialize(){
-    static lv_disp_draw_buf_t disp_buf; // contains internal graphic buffer
-    static lv_disp_drv_t disp_drv;      // contains callback functions
+/*Keypad input device*/
+static bool indev_put(uint32_t key){
+    return keypad_indev_put(&keypad_keys, key);
+}
 
-    ESP_LOGI(TFT_TAG, "Turn off LCD backlight");
-    gpio_config_t bk_gpio_config = {
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = 1ULL << BK_LIGHT_PIN
-    };
-    ESP_ERROR_CHECK(gpio_config(&bk_gpio_config));    
-
-    // Creating SPI bus
-    ESP_LOGI(TFT_TAG, "Initialize SPI bus");
-    spi_bus_config_t buscfg = {
-        .sclk_io_num = SCLK_PIN,
-        .mosi_io_num = MOSI_PIN,
-        .miso_io_num = MISO_PIN,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .max_transfer_sz = HOR_RES * 80 * sizeof(uint16_t),
-    };
-    ESP_ERROR_CHECK(spi_bus_initialize(LCD_HOST, &buscfg, SPI_DMA_CH_AUTO));
- 
-    // Allocating LCD IO device handle
-    ESP_LOGI(TFT_TAG, "Installing IO");
-    esp_lcd_panel_io_handle_t io_handle = NULL;
-    esp_lcd_panel_io_spi_config_t io_config = {
-        .dc_gpio_num = DC_PIN,
-        .cs_gpio_num = TFT_CS_PIN,
-        .pclk_hz = TFT_PIXEL_CLOCK_HZ,
-        .lcd_cmd_bits = CMD_BITS,
-        .lcd_param_bits = PARAM_BITS,
-        .spi_mode = 0,
-        .trans_queue_depth = 10,
-        .on_color_trans_done = lvgl_flush_ready,
-        .user_ctx = &disp_drv,
-    };
-    
-    // TFT attachment to SPI bus
-    ESP_ERROR_CHECK(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)LCD_HOST, &io_config, &io_handle));
-
-    // Installing LCD controller drive
-    esp_lcd_panel_handle_t panel_handle = NULL;
-    esp_lcd_panel_dev_config_t panel_config = {
-        .reset_gpio_num = RST_PIN,
-        .rgb_endian = LCD_RGB_ENDIAN_BGR,
-        .bits_per_pixel = 16,
-    };
+// Key for compose_area, falls back to a full resync once the buffer is full
+static void compose_put(uint32_t key){
+    if(!compose_resync && !indev_put(key)){
+        compose_resync = true;
+    }
+}
+
+// Turn the preview before the cursor into word, only the changed tail is retyped
+static void preview_show(const char *word){
+    uint8_t same = 0;
+    while(same < preview_len && word[same] == preview[same]){
+        same++;
+    }
+    for(uint8_t i = same; i < preview_len; i++){
+        compose_put(LV_KEY_BACKSPACE);
+    }
+    for(const char *c = &word[same]; *c; c++){
+        compose_put((uint8_t)*c);
+    }
+    preview_len = snprintf(preview, sizeof(preview), "%s", word);
+}
+
+// Every composer edit becomes the same key on compose_area
+static void composer_edit(void *ctx, uint8_t edit, char c){
+    preview_show("");
+    switch(edit){
+        case MULTITAP_EDIT_INSERT: compose_put((uint8_t)c); break;
+        case MULTITAP_EDIT_BACKSPACE: compose_put(LV_KEY_BACKSPACE); break;
+        case MULTITAP_EDIT_LEFT: compose_put(LV_KEY_LEFT); break;
+        case MULTITAP_EDIT_RIGHT: compose_put(LV_KEY_RIGHT); break;
+        default: compose_resync = true; break;
+    }
+}
+
+// Replace the whole compose_area text, drops the keys it has not taken yet
+static void compose_area_set(void){
+    static char text[MULTITAP_MAX_TEXT + T9_MAX_WORD + 1];
+    uint16_t len = multitap_text(&composer, text, MULTITAP_MAX_TEXT + 1);
+    uint16_t cursor = gap_cursor(&composer.text);
+    memmove(&text[cursor + preview_len], &text[cursor], len - cursor + 1);
+    memcpy(&text[cursor], preview, preview_len);
+    keypad_indev_drop(&keypad_keys);
+    lv_textarea_set_text(compose_area, text);
+    lv_textarea_set_cursor_pos(compose_area, cursor + preview_len);
+    compose_resync = false;
+}
 
-    ESP_ERROR_CHECK(esp_lcd_new_panel_ili9341(io_handle, &panel_config, &panel_handle));
-    ESP_ERROR_CHECK(esp_lcd_panel_reset(panel_handle));
-    ESP_ERROR_CHECK(esp_lcd_panel_init(panel_handle));
-    ESP_ERROR_CHECK(esp_lcd_panel_mirror(panel_handle, true, false));
-
-    ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_handle, true));
-    // turing backlight on after initialization
-    ESP_LOGI(TFT_TAG, "Turn on LCD backlight");
-    gpio_set_level(BK_LIGHT_PIN, TFT_BK_LIGHT_ON);
-
-    // Initialization of LVGL
-    ESP_LOGI(TFT_TAG, "Initialize LVGL library");
-    lv_init();
-
-    // buffer allocation
-    lv_color_t *buf1 = heap_caps_malloc(HOR_RES * 20 * sizeof(lv_color_t), MALLOC_CAP_DMA);
-    assert(buf1);
-    lv_color_t *buf2 = heap_caps_malloc(HOR_RES * 20 * sizeof(lv_color_t), MALLOC_CAP_DMA);
-    assert(buf2);
-    // initialize LVGL draw buffers and ddriver
-    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, HOR_RES * 20);
-
-    // display characteristics
-    lv_disp_drv_init(&disp_drv);
-    disp_drv.hor_res = HOR_RES;
-    disp_drv.ver_res = VER_RES;
-    disp_drv.flush_cb = lvgl_flush_cb;
-    disp_drv.draw_buf = &disp_buf;
-    disp_drv.user_data = panel_handle;
-    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
-  
-    // Tick interface for LVGL (using esp_timer to generate 2ms periodic event)
-    const esp_timer_create_args_t lvgl_tick_timer_args = {
-        .callback = &increase_lvgl_tick,
-        .name = "lvgl_tick"
+// Word being predicted shown at the cursor, candidates in the bar
+static void keypad_redraw(void){
+    static char bar[T9_BAR_CANDIDATES * (T9_MAX_WORD + 10)];
+    char word[T9_MAX_WORD + 1];
+
+    if(!predictive || t9_word.depth == 0){
+        preview_show("");
+        lv_label_set_text(candidate_bar, macros.armed ? "#ff8000 Macro?#" : predictive ? "T9" : "");
+    }
+    else{
+        t9_current(word, sizeof(word));
+        preview_show(word);
+
+        // candidates after the selected one, selected one highlighted
+        size_t used = snprintf(bar, sizeof(bar), "T9 #ff8000 %s#", word);
+        int count = t9_count(&t9_word);
+        for(int i = 1; i < T9_BAR_CANDIDATES && i < count && used < sizeof(bar); i++){
+            t9_candidate(&t9_word, (t9_choice + i) % count, word, sizeof(word));
+            used += snprintf(&bar[used], sizeof(bar) - used, " %s", word);
+        }
+        lv_label_set_text(candidate_bar, bar);
+    }
+    if(compose_resync){
+        compose_area_set();
+    }
+}
+
+// Keys for a focused widget other than the text area: 2 up, 8 down, '#' enter
+static void keypad_navigate(const key_event_t *event){
+    if(event->type != KEY_EVENT_DOWN){
+        return;
+    }
+    switch(event->key){
+        case 1: indev_put(LV_KEY_UP); break;
+        case 9: indev_put(LV_KEY_DOWN); break;
+        case 14: indev_put(LV_KEY_ENTER); break;
+        default: break;
+    }
+}
+
+#if KEY_TRACE_ENABLED
+static void key_trace_report(void){
+    static const char *const stage_names[KEY_STAGES] = {
+        "interrupt to scan", NULL, "scan to dequeue", "scan to buffer", "scan to screen"
     };
+    key_trace_stat_t stats[KEY_STAGES];
+    int keys = key_trace_stats(stats);
+    ESP_LOGI(KEYPAD_TAG, "Typing latency over %d keys, us p50/p90/p99/max", keys);
+    for(int stage = 0; stage < KEY_STAGES; stage++){
+        if(stage_names[stage] != NULL){
+            ESP_LOGI(KEYPAD_TAG, "%-18s %6u %6u %6u %6u (%u keys)", stage_names[stage],
+                     (unsigned)stats[stage].p50, (unsigned)stats[stage].p90,
+                     (unsigned)stats[stage].p99, (unsigned)stats[stage].max, stats[stage].count);
+        }
+    }
+}
+#endif
+
+// Runs the text entry engines on new key events, called from the input device read
+static void keypad_poll(void){
+    key_event_t event;
+    bool composing = lv_group_get_focused(keypad_group) == compose_area;
+    int result = 0;
+    while(xQueueReceive(keypad_queue, &event, 0) == pdTRUE){
+        KEY_TRACE(key_trace_dequeued(event.key, esp_timer_get_time()));
+        ESP_LOGI(KEYPAD_TAG, "Key %u event %u", event.key, event.type);
+#if KEY_TRACE_ENABLED
+        if(event.key == KEY_TRACE_REPORT_KEY && event.type == KEY_EVENT_LONG){
+            key_trace_report();
+            continue;
+        }
+#endif
+        if(event.key == KEYPAD_FOCUS_KEY && event.type == KEY_EVENT_LONG){
+            if(composing){
+                multitap_cancel(&composer); // the '.' of the short press
+                result |= MULTITAP_CHANGED;
+            }
+            indev_put(LV_KEY_NEXT);
+            continue;
+        }
+        if(!composing){
+            keypad_navigate(&event);
+            continue;
+        }
+        // nothing composed yet, apart from what this key's own press put in
+        uint16_t length = multitap_length(&composer);
+        bool idle = t9_word.depth == 0 && (length == 0 || (length == 1 && composer.pending_key == event.key));
+        const macro_t *macro;
+        macro_result_t taken = macro_event(&macros, &event, idle, &macro);
+        if(taken == MACRO_FIRE){
+            multitap_cancel(&composer); // the character of the short press
+            frame_send(macro->frame, macro->len);
+        }
+        if(taken != MACRO_PASS){
+            result |= MULTITAP_CHANGED;
+            continue;
+        }
+        int handled = t9_event(&event);
+        result |= handled >= 0 ? handled : multitap_event(&composer, &event);
+        KEY_TRACE(key_trace_buffered(esp_timer_get_time()));
+    }
+    result |= multitap_tick(&composer, esp_timer_get_time() / 1000);
+
+    if((result & MULTITAP_SEND) && multitap_length(&composer) > 0){
+        char text[MULTITAP_MAX_TEXT + 1];
+        uint16_t len = multitap_text(&composer, text, sizeof(text));
+        if(keypad_send(text, len)){
+            multitap_clear(&composer);
+        }
+    }
+    if(result & MULTITAP_CHANGED){
+        keypad_redraw();
+    }
+}
+
+// Scans the keypad when LVGL finds no key waiting
+static void keypad_indev_poll(void *ctx){
+    keypad_poll();
+}
 
-    // time handler so that dispy knows passed time for operations or something
-    esp_timer_handle_t lvgl_tick_timer = NULL;
-    ESP_ERROR_CHECK(esp_timer_create(&lvgl_tick_timer_args, &lvgl_tick_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(lvgl_tick_timer, LVGL_TICK_PERIOD_MS * 1000));
+// Register the keypad with LVGL, text_area gets the composed text, the rest of group is navigable
+void keypad_indev_initialize(lv_obj_t *text_area, lv_group_t *group){
+    static lv_indev_drv_t indev_drv;
+    multitap_init(&composer, multitap_layout, MULTITAP_TIMEOUT_MS, composer_edit, NULL);
+    if(t9_open(&t9_dict, t9_dict_start, t9_dict_end - t9_dict_start) != T9_OK){
+        ESP_LOGE(KEYPAD_TAG, "Predictive text dictionary unusable");
+        t9_dict.data = NULL;
+    }
+    t9_reset(&t9_word, &t9_dict);
+
+    compose_area = text_area;
+    keypad_group = group;
+    keypad_indev_init(&keypad_keys, keypad_indev_poll, NULL);
+    lv_indev_t *indev = keypad_indev_register(&keypad_keys, &indev_drv);
+    lv_indev_set_group(indev, group);
+    keypad_read_timer = indev->driver->read_timer;
+    lv_timer_pause(keypad_read_timer);
+    lv_group_focus_obj(text_area);
 }
 
 void keep(){
-    lv_obj_t *label6 = lv_label_create(lv_scr_act());
-    lv_label_set_text(label6, "soc_status: 0");
-    lv_obj_align(label6, LV_ALIGN_BOTTOM_RIGHT, -5, 0);
     struct sockaddr_in ap_info = {0};
     ap_info.sin_family = AF_INET;
     ap_info.sin_port = htons(PORT);
@@ -790,21 +1811,34 @@ void keep(){
         setsockopt(soc, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));   
         ESP_LOGI("socket state", "%i", w);     
         vTaskDelay(1000 / portTICK_PERIOD_MS);
-        if(w != 0){
-            close(soc);
-            lv_label_set_text(label6, "soc_status: -1");
+        // closed by a failed write in link_tx_task, or the socket is gone
+        if(w != 0 || socket_status != 0){
+            xSemaphoreTake(send_lock, portMAX_DELAY);
             socket_status = -1;
+            link_requeue();
+            xSemaphoreGive(send_lock);
+            link_close();
+            ui_set_text(UI_SOCKET_STATUS, "soc_status: -1");
             soc = socket(AF_INET, SOCK_STREAM, 0);
             if(soc < 0){
                 ESP_LOGI(TAG_TCP, "Socket creation Failed");
             }
-            if(connect(soc, (struct sockaddr *)&ap_info, sizeof(ap_info)) != 0){
+            else if(connect(soc, (struct sockaddr *)&ap_info, sizeof(ap_info)) != 0){
                 ESP_LOGI(TAG_TCP, "Unable to to connect to %s", inet_ntoa(ap_info.sin_addr.s_addr));
-                close(soc);
+                link_close();
+            }
+            else if(link_open() != TCP_SUCCESS){
+                link_close();
             }
             else{
+                // messages cut by the disconnect go out again from the start
+                xSemaphoreTake(send_lock, portMAX_DELAY);
+                mux_tx_rewind(&link_tx);
+                xSemaphoreGive(send_lock);
+                // the AP asks for the screen again if it still has a viewer
+                mirror_ask(MIRROR_MSG_STOP);
                 socket_status = 0;
-                lv_label_set_text(label6, "soc_status: 0");
+                ui_set_text(UI_SOCKET_STATUS, "soc_status: 0");
             }
             
         }
@@ -823,53 +1857,36 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(storage);
     gpio_num_t keypad[8] = {R1, R2, R3, R4, C1, C2, C3, C4};
+    // Initialize outbox and link channels before anything can be sent
+    mux_tx_init(&link_tx);
+    if(outbox_initialize() != ESP_OK){
+        ESP_LOGE(OUTBOX_TAG, "Outbox unavailable");
+    }
+    ESP_ERROR_CHECK(link_security_initialize());
+    ESP_ERROR_CHECK(capture_initialize());
+    ESP_ERROR_CHECK(rpc_initialize());
+    ESP_ERROR_CHECK(power_initialize());
+    ESP_ERROR_CHECK(macro_initialize());
+    ESP_ERROR_CHECK(ui_initialize());
+    if(mirror_initialize() != ESP_OK){
+        ESP_LOGE(MIRROR_TAG, "Display mirror unavailable");
+    }
     // Initialize keyboard
     keypad_initalize(keypad);
-    display_initialize();
-    // Create display interface 
-    lv_obj_t *label1 = lv_label_create(lv_scr_act());
-    lv_label_set_long_mode(label1, LV_LABEL_LONG_WRAP); 
-    lv_label_set_text_static(label1, "Text received from paired device:");
-    lv_obj_align(label1, LV_ALIGN_TOP_MID, 0, 10);
- 
-    lv_obj_t *obj1 = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(obj1, 280, 60);
-    lv_obj_align(obj1, LV_ALIGN_TOP_MID, 0, 30);
-
-    lv_obj_t *label2 = lv_label_create(obj1);
-    lv_label_set_long_mode(label2, LV_LABEL_LONG_WRAP); 
-    lv_label_set_text(label2, "Waiting for message");
-    lv_obj_set_width(label2, 240);
-    lv_obj_align(label2, LV_ALIGN_CENTER, 0, 0);
-    
-    lv_obj_t *obj2 = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(obj2, 70, 45);
-    lv_obj_align(obj2, LV_ALIGN_LEFT_MID, 0, 5);
-
-    label3 = lv_label_create(obj2);
-    lv_label_set_long_mode(label3, LV_LABEL_LONG_WRAP); 
-    lv_label_set_text(label3, "INerr");
-    lv_obj_set_width(label3, 40);
-    lv_obj_align(label3, LV_ALIGN_CENTER, 0, 0);
-
-    lv_obj_t *obj3 = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(obj3, 70, 45);
-    lv_obj_align(obj3, LV_ALIGN_RIGHT_MID, 0, 5);
-
-    label4 = lv_label_create(obj3);
-    lv_label_set_long_mode(label4, LV_LABEL_LONG_WRAP); 
-    lv_label_set_text(label4, "Oerr");
-    lv_obj_set_width(label4, 40);
-    lv_obj_align(label4, LV_ALIGN_CENTER, 0, 0);
-    
-    lv_obj_t *label5 = lv_label_create(lv_scr_act());
-    lv_label_set_long_mode(label5, LV_LABEL_LONG_WRAP); 
-    lv_label_set_text_static(label5, "Text input that will be \nsent to paired device:");
-    lv_obj_align(label5, LV_ALIGN_CENTER, 0, 10);
-
-    lv_obj_t *txt_area = lv_textarea_create(lv_scr_act());
-    lv_obj_set_size(txt_area, 280, 60);
-    lv_obj_align(txt_area, LV_ALIGN_CENTER, 0, 65);
+    display_initialize(DISPLAY_BUFFER_MODE, mirror_flush);
+    // Create display interface
+    display_screen_t screen;
+    display_screen_create(&screen);
+    label3 = screen.input_error;
+    label4 = screen.output_error;
+    label6 = screen.socket_status;
+    candidate_bar = screen.candidate_bar;
+
+    // Keypad input, received message box can be focused to page through the log
+    lv_group_t *group = lv_group_create();
+    lv_group_add_obj(group, screen.text_area);
+    lv_group_add_obj(group, screen.log_box);
+    keypad_indev_initialize(screen.text_area, group);
    
     // Connect to AP
     wifistatus = connect_wifi();
@@ -877,15 +1894,26 @@ void app_main(void)
         ESP_LOGE(TAG_WI, "Failed to connect to AP");
     }
 
-    // Connect to socket
+    // Connect to socket, frames wait in the outbox until it is up
     wifistatus = socket_connection();
     if(wifistatus != TCP_SUCCESS){
         ESP_LOGE(TAG_TCP, "Failed socket connection");
-    }     
-    xTaskCreate(socket_read, "Socket receive task", 1024*2, label2, configMAX_PRIORITIES, NULL);
-    xTaskCreate(keypadtask, "keypad task", 1024*4, txt_area, configMAX_PRIORITIES - 1, NULL);
-    xTaskCreate(disRefresh, "disp refresh task", 1024*8, NULL,configMAX_PRIORITIES,NULL);
-    xTaskCreate(keep, "alive_task", 1024*2, NULL, configMAX_PRIORITIES-2, NULL);
+    }
+    // mbedTLS record and handshake code needs the larger stacks
+    // from here on only the display task calls LVGL
+    xTaskCreatePinnedToCore(socket_read, "Socket receive task", 1024*4, NULL, configMAX_PRIORITIES - 1, NULL, LINK_CORE);
+    xTaskCreatePinnedToCore(link_tx_task, "link_tx_task", 1024*4, NULL, configMAX_PRIORITIES - 2, &link_tx_handle, LINK_CORE);
+    xTaskCreatePinnedToCore(disRefresh, "disp refresh task", 1024*8, NULL, configMAX_PRIORITIES - 1, NULL, UI_CORE);
+    xTaskCreatePinnedToCore(keep, "alive_task", 1024*6, NULL, configMAX_PRIORITIES - 3, NULL, LINK_CORE);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    xTaskCreate(cpu_stats_task, "cpu_stats", 1024*3, NULL, 1, NULL);
+#endif
+#if CAPTURE_ENABLED
+    xTaskCreatePinnedToCore(capture_task, "capture_task", 1024*2, NULL, 1, NULL, LINK_CORE);
+#endif
+    if(outbox_ready){
+        xTaskCreatePinnedToCore(outbox_task, "outbox_task", 1024*3, NULL, configMAX_PRIORITIES - 4, NULL, LINK_CORE);
+    }
     }
 
 
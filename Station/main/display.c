@@ -0,0 +1,552 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_vendor.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_ili9341.h"
+#include "driver/spi_master.h"
+#include "driver/ledc.h"
+#include "lvgl.h"
+#include "key_trace.h"
+#include "scroll_log.h"
+#include "display.h"
+
+// SPI bus and pins
+#define LCD_HOST  SPI2_HOST
+#define SCLK_PIN 18
+#define MOSI_PIN 19
+#define MISO_PIN 21
+#define DC_PIN 5
+#define RST_PIN 22
+#define TFT_CS_PIN 4
+#define BK_LIGHT_PIN 2
+#define TFT_BK_LIGHT_ON 1
+
+// Display settings
+#define TFT_PIXEL_CLOCK_HZ (20 * 1000* 1000) // 20 MHZ, known good, the probe starts here
+#define TFT_READ_CLOCK_HZ (5 * 1000 * 1000)    // ILI9341 memory reads are specified up to ~6.6 MHz
+#define TFT_PROBE_ROUNDS 3                      // patterns that have to read back right at a clock
+#define TFT_PROBE_WIDTH 16
+#define TFT_PROBE_HEIGHT 4
+#define TFT_NVS_NAMESPACE "display"
+#define TFT_FLUSH_OVERHEAD_US 120   // CASET/RASET/RAMWR sent by polling plus LVGL's work per area
+#define TFT_RENDER_NS_PER_PX 60     // drawing one more pixel, on top of sending it
+#define TFT_LOG_SCROLL 1            // message log scrolled by the controller, 0 redraws it through LVGL
+#define TFT_MEMORY_ROWS 320         // rows the ILI9341 scrolls through, VSCRDEF has to add up to them
+#define DISPLAY_BUFFER_LINES 20     // stripe height of the stripe modes
+#define BACKLIGHT_PWM_HZ 5000
+
+// Bit number used to represent dispaly command and parameter
+#define CMD_BITS 8
+#define PARAM_BITS 8
+
+static SemaphoreHandle_t flush_done;    // given by the SPI interrupt, which runs on the other core
+static volatile uint8_t flush_parts;    // transfers left of the area being flushed
+static display_flushed_cb flushed;
+static bool watched = false;            // the flushes are looked at, in screen rows
+// Received messages, the display task owns the log
+static lv_obj_t *message_log;
+static scroll_log_t message_lines;
+static uint16_t message_log_back = 0;   // lines scrolled back with the keys
+static esp_lcd_panel_io_handle_t tft_io;
+static bool tft_scrolls = false;        // message_lines rows are mapped to the controller's scrolling area
+static uint16_t tft_scroll_start;       // VSCRSADD the controller has
+
+static const char *TFT_TAG = "Display";
+
+static void message_log_draw(lv_event_t *e){
+    lv_obj_t *obj = lv_event_get_target(e);
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    lv_obj_init_draw_label_dsc(obj, LV_PART_MAIN, &dsc);
+    uint16_t rows = scroll_log_rows(&message_lines);
+    lv_area_t line = obj->coords, clip;
+    for(uint16_t row = 0; row < rows; row++){
+        line.y1 = obj->coords.y1 + row * message_lines.line_h;
+        line.y2 = line.y1 + message_lines.line_h - 1;
+        const char *text = scroll_log_line(&message_lines, rows - 1 - row + message_log_back);
+        if(text != NULL && _lv_area_intersect(&clip, &line, draw_ctx->clip_area)){
+            lv_draw_label(draw_ctx, &dsc, &line, text, NULL);
+        }
+    }
+}
+
+// Up and down page through the kept lines while the message box is focused
+static void message_log_key(lv_event_t *e){
+    uint32_t key = lv_event_get_key(e);
+    uint16_t rows = scroll_log_rows(&message_lines);
+    uint16_t most = message_lines.count > rows ? message_lines.count - rows : 0;
+    uint16_t back = message_log_back;
+    if(key == LV_KEY_UP && back < most){
+        back++;
+    }
+    else if(key == LV_KEY_DOWN && back > 0){
+        back--;
+    }
+    if(back != message_log_back){
+        message_log_back = back;
+        lv_obj_invalidate(message_log);
+    }
+}
+
+/**
+ * Display task only. Text is wrapped to the log's width, every line moves the
+ * log up by one. When the controller scrolls the band only the new lines at
+ * the bottom are invalidated, the old ones are already on the panel one line
+ * higher. Whoever watches the flushes has no scrolling area, so while there
+ * is one the whole log is drawn again.
+ */
+void message_log_add(const char *text){
+    const lv_font_t *font = lv_obj_get_style_text_font(message_log, LV_PART_MAIN);
+    lv_coord_t space = lv_obj_get_style_text_letter_space(message_log, LV_PART_MAIN);
+    lv_coord_t width = lv_obj_get_content_width(message_log);
+    uint16_t added = 0;
+    while(*text){
+        uint32_t len = _lv_txt_get_next_line(text, font, space, width, NULL, LV_TEXT_FLAG_NONE);
+        if(len == 0){
+            break;
+        }
+        uint32_t shown = len;
+        while(shown > 0 && (text[shown - 1] == '\n' || text[shown - 1] == '\r')){
+            shown--;
+        }
+        scroll_log_add(&message_lines, text, shown);
+        added++;
+        text += len;
+    }
+    if(added == 0){
+        return;
+    }
+    if(tft_scrolls && !watched && message_log_back == 0 && added < scroll_log_rows(&message_lines)){
+        lv_area_t fresh = message_log->coords;
+        fresh.y1 = fresh.y2 + 1 - added * message_lines.line_h;
+        lv_obj_invalidate_area(message_log, &fresh);
+    }
+    else{
+        message_log_back = 0;
+        lv_obj_invalidate(message_log);
+    }
+}
+
+/**
+ * Message log inside box. The controller can only scroll whole panel rows,
+ * so the band also takes the rest of the rows it covers along: that only
+ * works while everything beside the log looks the same in each of them,
+ * the box's straight side borders and the plain screen background.
+ */
+static void message_log_initialize(lv_obj_t *box){
+    lv_obj_update_layout(box);
+    const lv_area_t *band = &message_log->coords;
+    lv_coord_t radius = lv_obj_get_style_radius(box, LV_PART_MAIN);
+    bool straight = band->y1 >= box->coords.y1 + radius && band->y2 <= box->coords.y2 - radius;
+    const lv_font_t *font = lv_obj_get_style_text_font(message_log, LV_PART_MAIN);
+    int err = scroll_log_init(&message_lines, band->y1, lv_area_get_height(band), lv_font_get_line_height(font), TFT_MEMORY_ROWS);
+    ESP_ERROR_CHECK(err == SCROLL_LOG_OK ? ESP_OK : ESP_ERR_INVALID_SIZE);
+    tft_scrolls = tft_scrolls && straight;
+    if(tft_scrolls){
+        uint16_t tfa = message_lines.top, vsa = message_lines.height, bfa = scroll_log_bottom(&message_lines);
+        esp_lcd_panel_io_tx_param(tft_io, 0x33, (uint8_t[]){tfa >> 8, tfa, vsa >> 8, vsa, bfa >> 8, bfa}, 6); // VSCRDEF
+        tft_scroll_start = scroll_log_start(&message_lines);
+        esp_lcd_panel_io_tx_param(tft_io, 0x37, (uint8_t[]){tft_scroll_start >> 8, tft_scroll_start}, 2); // VSCRSADD
+    }
+    ESP_LOGI(TFT_TAG, "Message log rows %u-%u %s", (unsigned)band->y1, (unsigned)band->y2,
+             tft_scrolls ? "scrolled by the panel" : "redrawn");
+}
+
+void display_set_watched(bool on){
+    watched = on;
+}
+
+void display_backlight(uint32_t duty){
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, duty);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+}
+
+// Hand the area on to whoever watches the flushes, once it is queued for the panel
+static void area_flushed(const lv_area_t *area, const lv_color_t *pixels, size_t stride, bool last){
+    if(flushed != NULL){
+        flushed(area, pixels, stride, last);
+    }
+}
+
+static bool lvgl_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    lv_disp_drv_t *disp_driver = (lv_disp_drv_t *)user_ctx;
+    BaseType_t woken = pdFALSE;
+    // an area split around the scrolling area is done with its last piece
+    if(--flush_parts > 0){
+        return false;
+    }
+    KEY_TRACE(key_trace_flushed(esp_timer_get_time()));
+    lv_disp_flush_ready(disp_driver);
+    xSemaphoreGiveFromISR(flush_done, &woken);
+    return woken == pdTRUE;
+}
+
+// LVGL waits here for a buffer to come back from the bus, block instead of spinning
+static void lvgl_flush_wait(lv_disp_drv_t *drv)
+{
+    // a give left over from a flush nobody waited for only costs one more check of the flag
+    xSemaphoreTake(flush_done, 1);
+}
+
+static void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    esp_lcd_panel_handle_t panel_handle = (esp_lcd_panel_handle_t) drv->user_data;
+    KEY_TRACE(key_trace_frame(lv_disp_flush_is_last(drv)));
+    if(drv->direct_mode){
+        // every area is already in the frame buffer, send the rows they cover at the end
+        if(!lv_disp_flush_is_last(drv)){
+            lv_disp_flush_ready(drv);
+            return;
+        }
+        lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+        lv_coord_t y1 = DISPLAY_VER_RES, y2 = -1;
+        for(uint16_t i = 0; i < disp->inv_p; i++){
+            if(!disp->inv_area_joined[i]){
+                y1 = LV_MIN(y1, disp->inv_areas[i].y1);
+                y2 = LV_MAX(y2, disp->inv_areas[i].y2);
+            }
+        }
+        if(y2 < y1){
+            lv_disp_flush_ready(drv);
+            return;
+        }
+        flush_parts = 1;
+        esp_lcd_panel_draw_bitmap(panel_handle, 0, y1, DISPLAY_HOR_RES, y2 + 1, &color_map[y1 * DISPLAY_HOR_RES]);
+        area_flushed(&(lv_area_t){0, y1, DISPLAY_HOR_RES - 1, y2}, &color_map[y1 * DISPLAY_HOR_RES], DISPLAY_HOR_RES, true);
+        return;
+    }
+    if(tft_scrolls){
+        // the first area drawn with a new start moves the panel's picture along
+        uint16_t start = scroll_log_start(&message_lines);
+        if(start != tft_scroll_start){
+            esp_lcd_panel_io_tx_param(tft_io, 0x37, (uint8_t[]){start >> 8, start}, 2); // VSCRSADD
+            tft_scroll_start = start;
+        }
+        scroll_piece_t piece[SCROLL_LOG_PIECES];
+        int pieces = scroll_log_map(&message_lines, area->y1, area->y2, piece);
+        lv_coord_t width = lv_area_get_width(area);
+        flush_parts = pieces;
+        for(int i = 0; i < pieces; i++){
+            esp_lcd_panel_draw_bitmap(panel_handle, area->x1, piece[i].mem_y, area->x2 + 1, piece[i].mem_y + piece[i].rows,
+                                      &color_map[(piece[i].y - area->y1) * width]);
+        }
+        // whoever watches the flushes gets the screen's rows, not the memory's
+        area_flushed(area, color_map, width, lv_disp_flush_is_last(drv));
+        return;
+    }
+    flush_parts = 1;
+    int offsetx1 = area->x1;
+    int offsetx2 = area->x2;
+    int offsety1 = area->y1;
+    int offsety2 = area->y2;
+    // copy a buffer's content to a specific area of the display
+    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, color_map);
+    area_flushed(area, color_map, lv_area_get_width(area), lv_disp_flush_is_last(drv));
+}
+
+// Pixel clocks the SPI master can make from 80 MHz, tried from the lowest up
+static const uint32_t tft_clock_steps[] = {TFT_PIXEL_CLOCK_HZ, 80000000 / 3, 80000000 / 2};
+
+static esp_lcd_panel_io_handle_t display_io(uint32_t pclk_hz, lv_disp_drv_t *drv){
+    esp_lcd_panel_io_handle_t io_handle = NULL;
+    esp_lcd_panel_io_spi_config_t io_config = {
+        .dc_gpio_num = DC_PIN,
+        .cs_gpio_num = TFT_CS_PIN,
+        .pclk_hz = pclk_hz,
+        .lcd_cmd_bits = CMD_BITS,
+        .lcd_param_bits = PARAM_BITS,
+        .spi_mode = 0,
+        .trans_queue_depth = 10,
+        .on_color_trans_done = drv != NULL ? lvgl_flush_ready : NULL,
+        .user_ctx = drv,
+    };
+    ESP_ERROR_CHECK(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)LCD_HOST, &io_config, &io_handle));
+    return io_handle;
+}
+
+static void display_window(esp_lcd_panel_io_handle_t io, int x1, int y1, int x2, int y2){
+    esp_lcd_panel_io_tx_param(io, 0x2A, (uint8_t[]){x1 >> 8, x1, x2 >> 8, x2}, 4); // CASET
+    esp_lcd_panel_io_tx_param(io, 0x2B, (uint8_t[]){y1 >> 8, y1, y2 >> 8, y2}, 4); // RASET
+}
+
+/**
+ * Write a pattern at pclk_hz and read it back over MISO at the read clock.
+ * Red equals blue in every pixel, so the check does not depend on the
+ * panel's RGB/BGR order, the 16 bit pixels still cover every data bit.
+ */
+static bool display_probe(uint32_t pclk_hz, uint32_t seed){
+    enum { PIXELS = TFT_PROBE_WIDTH * TFT_PROBE_HEIGHT };
+    uint8_t *pattern = heap_caps_malloc(PIXELS * 2, MALLOC_CAP_DMA);
+    uint8_t *readback = heap_caps_malloc(PIXELS * 3 + 1, MALLOC_CAP_DMA); // dummy byte, then 18 bit RGB
+    bool ok = pattern != NULL && readback != NULL;
+    for(int i = 0; ok && i < PIXELS; i++){
+        seed = seed * 1103515245 + 12345;
+        uint16_t rb = (seed >> 16) & 0x1F, g = (seed >> 24) & 0x3F;
+        uint16_t pixel = rb << 11 | g << 5 | rb;
+        pattern[2 * i] = pixel >> 8;
+        pattern[2 * i + 1] = pixel;
+    }
+    if(ok){
+        esp_lcd_panel_io_handle_t io = display_io(pclk_hz, NULL);
+        display_window(io, 0, 0, TFT_PROBE_WIDTH - 1, TFT_PROBE_HEIGHT - 1);
+        esp_lcd_panel_io_tx_color(io, 0x2C, pattern, PIXELS * 2); // RAMWR
+        esp_lcd_panel_io_del(io); // waits for the queued pixels
+        io = display_io(TFT_READ_CLOCK_HZ, NULL);
+        display_window(io, 0, 0, TFT_PROBE_WIDTH - 1, TFT_PROBE_HEIGHT - 1);
+        ok = esp_lcd_panel_io_rx_param(io, 0x2E, readback, PIXELS * 3 + 1) == ESP_OK; // RAMRD
+        esp_lcd_panel_io_del(io);
+    }
+    for(int i = 0; ok && i < PIXELS; i++){
+        uint16_t pixel = pattern[2 * i] << 8 | pattern[2 * i + 1];
+        const uint8_t *rgb = &readback[1 + 3 * i];
+        ok = rgb[0] >> 3 == pixel >> 11 && rgb[1] >> 2 == ((pixel >> 5) & 0x3F) && rgb[2] >> 3 == (pixel & 0x1F);
+    }
+    free(pattern);
+    free(readback);
+    return ok;
+}
+
+// ILI9341 answers RDID4 with 00 93 41 after a dummy byte, panels that do not keep the LVGL redraw
+static bool display_scrolls(void){
+    uint8_t id[4] = {0};
+    esp_lcd_panel_io_handle_t io = display_io(TFT_READ_CLOCK_HZ, NULL);
+    bool ok = esp_lcd_panel_io_rx_param(io, 0xD3, id, sizeof(id)) == ESP_OK; // RDID4
+    esp_lcd_panel_io_del(io);
+    return ok && id[1] == 0x00 && id[2] == 0x93 && id[3] == 0x41;
+}
+
+static bool display_probe_rounds(uint32_t pclk_hz){
+    for(int round = 0; round < TFT_PROBE_ROUNDS; round++){
+        if(!display_probe(pclk_hz, pclk_hz + round)){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Highest pixel clock the wiring carries. The clock found last time is
+ * checked again and kept, otherwise the clock steps up from the known good
+ * one until a pattern reads back wrong. Without a working readback the
+ * known good clock is used and nothing is stored.
+ */
+static uint32_t display_pixel_clock(void){
+    nvs_handle_t nvs;
+    uint32_t stored = 0;
+    if(nvs_open(TFT_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK){
+        return TFT_PIXEL_CLOCK_HZ;
+    }
+    if(nvs_get_u32(nvs, "pclk", &stored) == ESP_OK && display_probe_rounds(stored)){
+        nvs_close(nvs);
+        return stored;
+    }
+    if(!display_probe_rounds(TFT_PIXEL_CLOCK_HZ)){
+        ESP_LOGW(TFT_TAG, "Display readback failed, staying at %d Hz", TFT_PIXEL_CLOCK_HZ);
+        nvs_close(nvs);
+        return TFT_PIXEL_CLOCK_HZ;
+    }
+    uint32_t best = TFT_PIXEL_CLOCK_HZ;
+    for(int i = 1; i < sizeof(tft_clock_steps) / sizeof(tft_clock_steps[0]); i++){
+        bool ok = display_probe_rounds(tft_clock_steps[i]);
+        ESP_LOGI(TFT_TAG, "Pixel clock %u Hz %s", (unsigned)tft_clock_steps[i], ok ? "ok" : "failed");
+        if(!ok){
+            break;
+        }
+        best = tft_clock_steps[i];
+    }
+    nvs_set_u32(nvs, "pclk", best);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    return best;
+}
+
+void display_initialize(display_buffer_mode_t mode, display_flushed_cb flushed_cb){
+    static lv_disp_draw_buf_t disp_buf; // contains internal graphic buffer
+    static lv_disp_drv_t disp_drv;      // contains callback functions
+    flushed = flushed_cb;
+    flush_done = xSemaphoreCreateBinary();
+    assert(flush_done);
+
+    // buffer allocation, before the SPI bus so its transfer size can follow the buffer
+    size_t lines = mode == DISPLAY_BUFFER_FULL ? DISPLAY_VER_RES : DISPLAY_BUFFER_LINES;
+    lv_color_t *buf1 = heap_caps_malloc(DISPLAY_HOR_RES * lines * sizeof(lv_color_t), MALLOC_CAP_DMA);
+    if(buf1 == NULL && mode == DISPLAY_BUFFER_FULL){
+        ESP_LOGW(TFT_TAG, "No room for a frame buffer, using %d line stripes", DISPLAY_BUFFER_LINES);
+        mode = DISPLAY_BUFFER_PINGPONG;
+        lines = DISPLAY_BUFFER_LINES;
+        buf1 = heap_caps_malloc(DISPLAY_HOR_RES * lines * sizeof(lv_color_t), MALLOC_CAP_DMA);
+    }
+    assert(buf1);
+    lv_color_t *buf2 = NULL;
+    if(mode == DISPLAY_BUFFER_PINGPONG){
+        buf2 = heap_caps_malloc(DISPLAY_HOR_RES * lines * sizeof(lv_color_t), MALLOC_CAP_DMA);
+        assert(buf2);
+    }
+
+    ESP_LOGI(TFT_TAG, "Turn off LCD backlight");
+    ledc_timer_config_t bk_timer_config = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = LEDC_TIMER_8_BIT,
+        .timer_num = LEDC_TIMER_0,
+        .freq_hz = BACKLIGHT_PWM_HZ,
+        .clk_cfg = LEDC_AUTO_CLK
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&bk_timer_config));
+    ledc_channel_config_t bk_channel_config = {
+        .gpio_num = BK_LIGHT_PIN,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = LEDC_CHANNEL_0,
+        .timer_sel = LEDC_TIMER_0,
+        .duty = 0,
+        .flags.output_invert = !TFT_BK_LIGHT_ON
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&bk_channel_config));
+
+    // Creating SPI bus
+    ESP_LOGI(TFT_TAG, "Initialize SPI bus");
+    spi_bus_config_t buscfg = {
+        .sclk_io_num = SCLK_PIN,
+        .mosi_io_num = MOSI_PIN,
+        .miso_io_num = MISO_PIN,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = DISPLAY_HOR_RES * lines * sizeof(uint16_t),
+    };
+    ESP_ERROR_CHECK(spi_bus_initialize(LCD_HOST, &buscfg, SPI_DMA_CH_AUTO));
+
+    // Installing LCD controller drive, at the known good clock first
+    ESP_LOGI(TFT_TAG, "Installing IO");
+    esp_lcd_panel_io_handle_t io_handle = display_io(TFT_PIXEL_CLOCK_HZ, NULL);
+    esp_lcd_panel_handle_t panel_handle = NULL;
+    esp_lcd_panel_dev_config_t panel_config = {
+        .reset_gpio_num = RST_PIN,
+        .rgb_endian = LCD_RGB_ENDIAN_BGR,
+        .bits_per_pixel = 16,
+    };
+
+    ESP_ERROR_CHECK(esp_lcd_new_panel_ili9341(io_handle, &panel_config, &panel_handle));
+    ESP_ERROR_CHECK(esp_lcd_panel_reset(panel_handle));
+    ESP_ERROR_CHECK(esp_lcd_panel_init(panel_handle));
+
+    // one SPI device per CS line, so the probe and the final IO replace this one
+    ESP_ERROR_CHECK(esp_lcd_panel_del(panel_handle));
+    ESP_ERROR_CHECK(esp_lcd_panel_io_del(io_handle));
+    uint32_t pclk_hz = display_pixel_clock();
+    ESP_LOGI(TFT_TAG, "Pixel clock %u Hz", (unsigned)pclk_hz);
+    // a frame buffer sends whole rows of it, the band's rows in it would go out unscrolled
+    tft_scrolls = TFT_LOG_SCROLL && mode != DISPLAY_BUFFER_FULL && display_scrolls();
+
+    // TFT attachment to SPI bus, controller keeps its state, no second reset
+    io_handle = display_io(pclk_hz, &disp_drv);
+    tft_io = io_handle;
+    panel_config.reset_gpio_num = -1;
+    ESP_ERROR_CHECK(esp_lcd_new_panel_ili9341(io_handle, &panel_config, &panel_handle));
+    ESP_ERROR_CHECK(esp_lcd_panel_init(panel_handle));
+    ESP_ERROR_CHECK(esp_lcd_panel_mirror(panel_handle, true, false));
+
+    ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_handle, true));
+    // turing backlight on after initialization
+    ESP_LOGI(TFT_TAG, "Turn on LCD backlight");
+    display_backlight(DISPLAY_BACKLIGHT_MAX);
+
+    // Initialization of LVGL
+    ESP_LOGI(TFT_TAG, "Initialize LVGL library");
+    lv_init();
+
+    // initialize LVGL draw buffers and ddriver
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, DISPLAY_HOR_RES * lines);
+    ESP_LOGI(TFT_TAG, "%s buffer%s of %u lines", mode == DISPLAY_BUFFER_FULL ? "Frame" : "Stripe",
+             buf2 != NULL ? "s" : "", (unsigned)lines);
+
+    // display characteristics
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = DISPLAY_HOR_RES;
+    disp_drv.ver_res = DISPLAY_VER_RES;
+    disp_drv.flush_cb = lvgl_flush_cb;
+    disp_drv.wait_cb = lvgl_flush_wait;
+    disp_drv.draw_buf = &disp_buf;
+    disp_drv.user_data = panel_handle;
+    disp_drv.direct_mode = mode == DISPLAY_BUFFER_FULL;
+    // one more area costs as much as this many more pixels drawn and sent
+    disp_drv.flush_overhead_px = TFT_FLUSH_OVERHEAD_US * 1000 / (16000000000ULL / pclk_hz + TFT_RENDER_NS_PER_PX);
+    lv_disp_drv_register(&disp_drv);
+}
+
+void display_screen_create(display_screen_t *screen){
+    lv_obj_t *label1 = lv_label_create(lv_scr_act());
+    lv_label_set_long_mode(label1, LV_LABEL_LONG_WRAP);
+    lv_label_set_text_static(label1, "Text received from paired device:");
+    lv_obj_align(label1, LV_ALIGN_TOP_MID, 0, 10);
+
+    // three lines of log between the box's rounded corners
+    lv_obj_t *obj1 = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(obj1, 280, 64);
+    lv_obj_set_style_pad_ver(obj1, 6, 0);
+    lv_obj_clear_flag(obj1, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_align(obj1, LV_ALIGN_TOP_MID, 0, 30);
+
+    message_log = lv_obj_create(obj1);
+    lv_obj_remove_style_all(message_log);
+    lv_obj_set_size(message_log, lv_pct(100), lv_pct(100));
+    lv_obj_clear_flag(message_log, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(message_log, message_log_draw, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(obj1, message_log_key, LV_EVENT_KEY, NULL);
+    message_log_initialize(obj1);
+    message_log_add("Waiting for message");
+    screen->log_box = obj1;
+
+    lv_obj_t *obj2 = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(obj2, 70, 45);
+    lv_obj_align(obj2, LV_ALIGN_LEFT_MID, 0, 5);
+
+    lv_obj_t *label3 = lv_label_create(obj2);
+    lv_label_set_long_mode(label3, LV_LABEL_LONG_WRAP);
+    lv_label_set_text(label3, "INerr");
+    lv_obj_set_width(label3, 40);
+    lv_obj_align(label3, LV_ALIGN_CENTER, 0, 0);
+    screen->input_error = label3;
+
+    lv_obj_t *obj3 = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(obj3, 70, 45);
+    lv_obj_align(obj3, LV_ALIGN_RIGHT_MID, 0, 5);
+
+    lv_obj_t *label4 = lv_label_create(obj3);
+    lv_label_set_long_mode(label4, LV_LABEL_LONG_WRAP);
+    lv_label_set_text(label4, "Oerr");
+    lv_obj_set_width(label4, 40);
+    lv_obj_align(label4, LV_ALIGN_CENTER, 0, 0);
+    screen->output_error = label4;
+
+    lv_obj_t *label5 = lv_label_create(lv_scr_act());
+    lv_label_set_long_mode(label5, LV_LABEL_LONG_WRAP);
+    lv_label_set_text_static(label5, "Text input that will be \nsent to paired device:");
+    lv_obj_align(label5, LV_ALIGN_CENTER, 0, 10);
+
+    lv_obj_t *txt_area = lv_textarea_create(lv_scr_act());
+    lv_obj_set_size(txt_area, 280, 60);
+    lv_obj_align(txt_area, LV_ALIGN_CENTER, 0, 65);
+    screen->text_area = txt_area;
+
+    lv_obj_t *candidate_bar = lv_label_create(lv_scr_act());
+    lv_label_set_recolor(candidate_bar, true);
+    lv_label_set_long_mode(candidate_bar, LV_LABEL_LONG_CLIP);
+    lv_obj_set_width(candidate_bar, 190);
+    lv_label_set_text(candidate_bar, "");
+    lv_obj_align(candidate_bar, LV_ALIGN_BOTTOM_LEFT, 5, 0);
+    screen->candidate_bar = candidate_bar;
+
+    lv_obj_t *label6 = lv_label_create(lv_scr_act());
+    lv_label_set_text(label6, "soc_status: 0");
+    lv_obj_align(label6, LV_ALIGN_BOTTOM_RIGHT, -5, 0);
+    screen->socket_status = label6;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+/*
+ * The Station's ILI9341 under LVGL: SPI bus and panel bring-up, the pixel
+ * clock probe, the draw buffers and the flush, the backlight, the main
+ * screen and the message log band the controller scrolls by itself.
+ *
+ * tools/panel_emu builds this file unchanged against an emulated panel, so
+ * it needs nothing of ESP-IDF beyond the panel IO, the SPI bus, LEDC, NVS,
+ * esp_timer and a binary semaphore. Only the display task calls it after
+ * display_initialize, like the rest of LVGL.
+ */
+
+#define DISPLAY_HOR_RES 320
+#define DISPLAY_VER_RES 240
+#define DISPLAY_BACKLIGHT_MAX 255   // 8 bit PWM duty
+
+/**
+ * STRIPE: one buffer of DISPLAY_BUFFER_LINES, LVGL waits for every stripe's
+ * DMA before drawing the next one.
+ * PINGPONG: two stripe buffers, the next stripe is drawn while the previous
+ * one is still on the bus.
+ * FULL: one frame buffer in direct mode, every refresh goes out as a single
+ * transfer of the changed rows, so CASET/RASET is paid once per refresh.
+ * Needs a 150 kB DMA capable block, falls back to PINGPONG without it.
+ */
+typedef enum {
+    DISPLAY_BUFFER_STRIPE,
+    DISPLAY_BUFFER_PINGPONG,
+    DISPLAY_BUFFER_FULL,
+} display_buffer_mode_t;
+
+/**
+ * Called once an area is queued for the panel, with its screen rows however
+ * the panel gets them, so the caller can work while the DMA sends.
+ */
+typedef void (*display_flushed_cb)(const lv_area_t *area, const lv_color_t *pixels, size_t stride, bool last);
+
+// Widgets of the main screen the Station writes to
+typedef struct {
+    lv_obj_t *log_box;          // received messages, focused to page through them
+    lv_obj_t *input_error;
+    lv_obj_t *output_error;
+    lv_obj_t *text_area;
+    lv_obj_t *candidate_bar;
+    lv_obj_t *socket_status;
+} display_screen_t;
+
+// Panel, LVGL and its display driver, the backlight on at full; flushed may be NULL
+void display_initialize(display_buffer_mode_t mode, display_flushed_cb flushed);
+
+/**
+ * Display task only. On while the flushed areas are used, e.g. by the mirror:
+ * they carry screen rows, so the log is then redrawn whole instead of
+ * scrolled by the panel.
+ */
+void display_set_watched(bool on);
+
+void display_backlight(uint32_t duty);
+
+// The main screen, with "Waiting for message" in the log
+void display_screen_create(display_screen_t *screen);
+
+/**
+ * Display task only. Text is wrapped to the log's width, every line moves the
+ * log up by one.
+ */
+void message_log_add(const char *text);
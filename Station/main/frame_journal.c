@@ -0,0 +1,434 @@
+#include <string.h>
+#include "frame_journal.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#define SECTOR_MAGIC   0x4C4E524A // "JRNL"
+#define SECTOR_HDR     16
+#define RECORD_HDR     4
+
+#define STATE_FREE     0xFF
+#define STATE_PENDING  0xFE
+#define STATE_DONE     0x00
+
+enum record_kind {
+    REC_END,        // erased space, nothing written after this point
+    REC_PENDING,
+    REC_DONE,
+    REC_BAD         // torn or corrupted, rest of the sector is unusable
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t reserved;
+} sector_hdr_t;
+
+static uint16_t crc16(uint8_t len, const uint8_t *data)
+{
+    uint16_t crc = 0xFFFF;
+    for(int i = -1; i < len; i++){
+        crc ^= (uint16_t)(i < 0 ? len : data[i]) << 8;
+        for(int b = 0; b < 8; b++){
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static inline uint32_t record_size(uint8_t len)
+{
+    return (RECORD_HDR + len + 3) & ~3u;
+}
+
+static inline uint32_t sector_base(const journal_t *j, uint32_t sector)
+{
+    return sector * j->dev->sector_size;
+}
+
+static bool read_sector_hdr(const journal_t *j, uint32_t sector, sector_hdr_t *hdr)
+{
+    if(j->dev->read(j->dev, sector_base(j, sector), hdr, sizeof(*hdr)) != 0){
+        return false;
+    }
+    return hdr->magic == SECTOR_MAGIC;
+}
+
+// Erase a sector and stamp it with a new sequence number, carrying the erase counter over
+static int open_sector(journal_t *j, uint32_t sector, uint32_t seq)
+{
+    sector_hdr_t hdr;
+    uint32_t erase_count = read_sector_hdr(j, sector, &hdr) ? hdr.erase_count : 0;
+
+    if(j->dev->erase(j->dev, sector_base(j, sector), j->dev->sector_size) != 0){
+        return JOURNAL_ERR_IO;
+    }
+    hdr.magic = SECTOR_MAGIC;
+    hdr.seq = seq;
+    hdr.erase_count = erase_count + 1;
+    hdr.reserved = 0xFFFFFFFF;
+    if(j->dev->write(j->dev, sector_base(j, sector), &hdr, sizeof(hdr)) != 0){
+        return JOURNAL_ERR_IO;
+    }
+    return JOURNAL_OK;
+}
+
+/**
+ * Decode the record at given offset. Payload is only copied (and checked) for
+ * records that are still pending or consumed; *size is the space it takes.
+ */
+static enum record_kind read_record(const journal_t *j, uint32_t sector, uint32_t offset,
+                                    uint8_t *payload, uint8_t *len, uint32_t *size)
+{
+    uint8_t hdr[RECORD_HDR];
+    uint8_t tmp[JOURNAL_MAX_RECORD];
+    uint32_t sector_size = j->dev->sector_size;
+
+    if(offset + RECORD_HDR > sector_size){
+        return REC_END;
+    }
+    if(j->dev->read(j->dev, sector_base(j, sector) + offset, hdr, RECORD_HDR) != 0){
+        return REC_BAD;
+    }
+    if(hdr[0] == STATE_FREE){
+        // a header that is not fully blank means the write was cut in the middle
+        return (hdr[1] == 0xFF && hdr[2] == 0xFF && hdr[3] == 0xFF) ? REC_END : REC_BAD;
+    }
+    if(hdr[0] != STATE_PENDING && hdr[0] != STATE_DONE){
+        return REC_BAD;
+    }
+    *len = hdr[1];
+    *size = record_size(hdr[1]);
+    if(offset + *size > sector_size){
+        return REC_BAD;
+    }
+    if(payload == NULL){
+        payload = tmp;
+    }
+    if(j->dev->read(j->dev, sector_base(j, sector) + offset + RECORD_HDR, payload, hdr[1]) != 0){
+        return REC_BAD;
+    }
+    if(crc16(hdr[1], payload) != (uint16_t)(hdr[2] | (hdr[3] << 8))){
+        return REC_BAD;
+    }
+    return hdr[0] == STATE_PENDING ? REC_PENDING : REC_DONE;
+}
+
+/**
+ * Walk the ring from the oldest sector and position the tail on the first
+ * pending record. Also recounts pending records when count is not NULL.
+ */
+static void find_tail(journal_t *j, uint32_t *count)
+{
+    uint32_t n = j->dev->sector_count;
+    bool found = false;
+    sector_hdr_t hdr;
+
+    if(count){
+        *count = 0;
+    }
+    j->tail_sector = j->head_sector;
+    j->tail_offset = j->head_offset;
+    for(uint32_t i = 1; i <= n; i++){
+        uint32_t sector = (j->head_sector + i) % n;
+        if(!read_sector_hdr(j, sector, &hdr)){
+            continue;
+        }
+        uint32_t offset = SECTOR_HDR;
+        uint32_t size;
+        uint8_t len;
+        enum record_kind kind;
+        while((kind = read_record(j, sector, offset, NULL, &len, &size)) == REC_PENDING || kind == REC_DONE){
+            if(kind == REC_PENDING){
+                if(!found){
+                    j->tail_sector = sector;
+                    j->tail_offset = offset;
+                    found = true;
+                }
+                if(count == NULL){
+                    return;
+                }
+                (*count)++;
+            }
+            offset += size;
+        }
+    }
+}
+
+int journal_format(journal_t *j, const journal_bdev_t *dev)
+{
+    memset(j, 0, sizeof(*j));
+    j->dev = dev;
+    if(dev->sector_count < 2 || dev->sector_size <= SECTOR_HDR + RECORD_HDR + JOURNAL_MAX_RECORD){
+        return JOURNAL_ERR_ARG;
+    }
+    for(uint32_t s = 0; s < dev->sector_count; s++){
+        if(dev->erase(dev, s * dev->sector_size, dev->sector_size) != 0){
+            return JOURNAL_ERR_IO;
+        }
+    }
+    j->head_seq = 1;
+    j->head_offset = SECTOR_HDR;
+    j->tail_offset = SECTOR_HDR;
+    return open_sector(j, 0, j->head_seq);
+}
+
+int journal_mount(journal_t *j, const journal_bdev_t *dev)
+{
+    sector_hdr_t hdr;
+    bool any = false;
+
+    memset(j, 0, sizeof(*j));
+    j->dev = dev;
+    if(dev->sector_count < 2 || dev->sector_size <= SECTOR_HDR + RECORD_HDR + JOURNAL_MAX_RECORD){
+        return JOURNAL_ERR_ARG;
+    }
+
+    // the newest sector is the one being written to
+    for(uint32_t s = 0; s < dev->sector_count; s++){
+        if(read_sector_hdr(j, s, &hdr) && (!any || hdr.seq > j->head_seq)){
+            j->head_sector = s;
+            j->head_seq = hdr.seq;
+            any = true;
+        }
+    }
+    if(!any){
+        return journal_format(j, dev);
+    }
+
+    // find end of written data in head sector
+    uint32_t offset = SECTOR_HDR;
+    uint32_t size;
+    uint8_t len;
+    enum record_kind kind;
+    while((kind = read_record(j, j->head_sector, offset, NULL, &len, &size)) == REC_PENDING || kind == REC_DONE){
+        offset += size;
+    }
+    // a torn record seals the sector, next append starts a fresh one
+    j->head_offset = kind == REC_BAD ? dev->sector_size : offset;
+
+    find_tail(j, &j->pending);
+    return JOURNAL_OK;
+}
+
+int journal_append(journal_t *j, const void *data, uint8_t len)
+{
+    uint8_t rec[RECORD_HDR + JOURNAL_MAX_RECORD + 3];
+    uint32_t size = record_size(len);
+    uint32_t n = j->dev->sector_count;
+
+    if(data == NULL || len == 0){
+        return JOURNAL_ERR_ARG;
+    }
+
+    if(j->head_offset + size > j->dev->sector_size){
+        uint32_t next = (j->head_sector + 1) % n;
+        bool overwrite = j->pending > 0 && j->tail_sector == next;
+        int err = open_sector(j, next, j->head_seq + 1);
+        if(err != JOURNAL_OK){
+            return err;
+        }
+        j->head_sector = next;
+        j->head_offset = SECTOR_HDR;
+        j->head_seq++;
+        if(overwrite){
+            // ring is full, the oldest sector has just been sacrificed
+            uint32_t left;
+            find_tail(j, &left);
+            j->dropped += j->pending - left;
+            j->pending = left;
+        }
+    }
+
+    uint16_t crc = crc16(len, data);
+    rec[0] = STATE_PENDING;
+    rec[1] = len;
+    rec[2] = crc & 0xFF;
+    rec[3] = crc >> 8;
+    memcpy(&rec[RECORD_HDR], data, len);
+    memset(&rec[RECORD_HDR + len], 0xFF, size - RECORD_HDR - len);
+
+    if(j->dev->write(j->dev, sector_base(j, j->head_sector) + j->head_offset, rec, size) != 0){
+        // whatever got written is torn, do not write after it
+        j->head_offset = j->dev->sector_size;
+        return JOURNAL_ERR_IO;
+    }
+    if(j->pending == 0){
+        j->tail_sector = j->head_sector;
+        j->tail_offset = j->head_offset;
+    }
+    j->head_offset += size;
+    j->pending++;
+    return JOURNAL_OK;
+}
+
+int journal_peek(journal_t *j, void *dst, size_t cap, uint8_t *len)
+{
+    uint8_t payload[JOURNAL_MAX_RECORD];
+    uint32_t n = j->dev->sector_count;
+    uint32_t hops = 0;
+    uint32_t size;
+
+    while(j->pending > 0){
+        enum record_kind kind = read_record(j, j->tail_sector, j->tail_offset, payload, len, &size);
+        if(kind == REC_PENDING){
+            if(*len > cap){
+                return JOURNAL_ERR_SIZE;
+            }
+            memcpy(dst, payload, *len);
+            return JOURNAL_OK;
+        }
+        if(kind == REC_DONE){
+            j->tail_offset += size;
+            continue;
+        }
+        // end of sector (or garbage), continue with the next one
+        if(j->tail_sector == j->head_sector || ++hops > n){
+            j->pending = 0;
+            break;
+        }
+        j->tail_sector = (j->tail_sector + 1) % n;
+        j->tail_offset = SECTOR_HDR;
+    }
+    return JOURNAL_ERR_EMPTY;
+}
+
+int journal_pop(journal_t *j)
+{
+    uint8_t len;
+    uint32_t size;
+    const uint8_t done = STATE_DONE;
+
+    if(j->pending == 0 || read_record(j, j->tail_sector, j->tail_offset, NULL, &len, &size) != REC_PENDING){
+        return JOURNAL_ERR_EMPTY;
+    }
+    if(j->dev->write(j->dev, sector_base(j, j->tail_sector) + j->tail_offset, &done, 1) != 0){
+        return JOURNAL_ERR_IO;
+    }
+    j->tail_offset += size;
+    j->pending--;
+    return JOURNAL_OK;
+}
+
+#ifdef ESP_PLATFORM
+static int partition_read(const journal_bdev_t *dev, uint32_t offset, void *dst, uint32_t len)
+{
+    return esp_partition_read(dev->ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int partition_write(const journal_bdev_t *dev, uint32_t offset, const void *src, uint32_t len)
+{
+    return esp_partition_write(dev->ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int partition_erase(const journal_bdev_t *dev, uint32_t offset, uint32_t len)
+{
+    return esp_partition_erase_range(dev->ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+int journal_bdev_partition(journal_bdev_t *dev, const char *label)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if(part == NULL){
+        return JOURNAL_ERR_ARG;
+    }
+    dev->sector_size = part->erase_size;
+    dev->sector_count = part->size / part->erase_size;
+    dev->read = partition_read;
+    dev->write = partition_write;
+    dev->erase = partition_erase;
+    dev->ctx = (void *)part;
+    return JOURNAL_OK;
+}
+#else
+static int file_read(const journal_bdev_t *dev, uint32_t offset, void *dst, uint32_t len)
+{
+    FILE *f = dev->ctx;
+    if(fseek(f, offset, SEEK_SET) != 0 || fread(dst, 1, len, f) != len){
+        return -1;
+    }
+    return 0;
+}
+
+// NOR semantics: programming can only clear bits
+static int file_write(const journal_bdev_t *dev, uint32_t offset, const void *src, uint32_t len)
+{
+    uint8_t cur[256];
+    const uint8_t *in = src;
+    FILE *f = dev->ctx;
+
+    while(len > 0){
+        uint32_t chunk = len > sizeof(cur) ? sizeof(cur) : len;
+        if(file_read(dev, offset, cur, chunk) != 0){
+            return -1;
+        }
+        for(uint32_t i = 0; i < chunk; i++){
+            cur[i] &= in[i];
+        }
+        if(fseek(f, offset, SEEK_SET) != 0 || fwrite(cur, 1, chunk, f) != chunk){
+            return -1;
+        }
+        offset += chunk;
+        in += chunk;
+        len -= chunk;
+    }
+    return fflush(f) == 0 ? 0 : -1;
+}
+
+static int file_erase(const journal_bdev_t *dev, uint32_t offset, uint32_t len)
+{
+    uint8_t blank[256];
+    FILE *f = dev->ctx;
+
+    memset(blank, 0xFF, sizeof(blank));
+    if(fseek(f, offset, SEEK_SET) != 0){
+        return -1;
+    }
+    while(len > 0){
+        uint32_t chunk = len > sizeof(blank) ? sizeof(blank) : len;
+        if(fwrite(blank, 1, chunk, f) != chunk){
+            return -1;
+        }
+        len -= chunk;
+    }
+    return fflush(f) == 0 ? 0 : -1;
+}
+
+int journal_bdev_file(journal_bdev_t *dev, const char *path, uint32_t sector_size, uint32_t sector_count)
+{
+    FILE *f = fopen(path, "r+b");
+    bool fresh = f == NULL;
+
+    if(fresh){
+        f = fopen(path, "w+b");
+        if(f == NULL){
+            return JOURNAL_ERR_IO;
+        }
+    }
+    dev->sector_size = sector_size;
+    dev->sector_count = sector_count;
+    dev->read = file_read;
+    dev->write = file_write;
+    dev->erase = file_erase;
+    dev->ctx = f;
+    if(fresh && file_erase(dev, 0, sector_size * sector_count) != 0){
+        journal_bdev_file_close(dev);
+        return JOURNAL_ERR_IO;
+    }
+    return JOURNAL_OK;
+}
+
+void journal_bdev_file_close(journal_bdev_t *dev)
+{
+    if(dev->ctx){
+        fclose(dev->ctx);
+        dev->ctx = NULL;
+    }
+}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Append-only journal of outbound frames.
+ *
+ * The journal is a ring of flash sectors. Every sector starts with a small
+ * header (magic, sequence number, erase counter) followed by records:
+ *
+ *   [state][len][crc16 lo][crc16 hi][payload ... padded to 4 bytes]
+ *
+ * state 0xFF - erased, end of written data
+ * state 0xFE - pending, waiting to be replayed
+ * state 0x00 - consumed (only 1 -> 0 bit transitions, so no erase needed)
+ *
+ * Sectors are erased lazily, only when the writer wraps around onto them, so
+ * every sector is erased the same number of times. When the ring is full the
+ * oldest sector is dropped.
+ */
+
+#define JOURNAL_OK          0
+#define JOURNAL_ERR_IO     -1
+#define JOURNAL_ERR_ARG    -2
+#define JOURNAL_ERR_EMPTY  -3
+#define JOURNAL_ERR_SIZE   -4
+
+#define JOURNAL_MAX_RECORD 255
+
+// Block device the journal lives on. Writes must behave like NOR flash (bits can only be cleared).
+typedef struct journal_bdev {
+    uint32_t sector_size;
+    uint32_t sector_count;
+    int (*read)(const struct journal_bdev *dev, uint32_t offset, void *dst, uint32_t len);
+    int (*write)(const struct journal_bdev *dev, uint32_t offset, const void *src, uint32_t len);
+    int (*erase)(const struct journal_bdev *dev, uint32_t offset, uint32_t len);
+    void *ctx;
+} journal_bdev_t;
+
+typedef struct {
+    const journal_bdev_t *dev;
+    uint32_t head_sector;   // sector currently written to
+    uint32_t head_offset;   // next free byte in head sector
+    uint32_t head_seq;
+    uint32_t tail_sector;   // sector holding the oldest pending record
+    uint32_t tail_offset;
+    uint32_t pending;       // records not yet replayed
+    uint32_t dropped;       // records lost because the ring was full
+} journal_t;
+
+/**
+ * Scan the device and rebuild the read/write positions. Torn records left by a
+ * power loss are skipped, a blank device is formatted.
+ */
+int journal_mount(journal_t *j, const journal_bdev_t *dev);
+
+// Erase the whole device and start with an empty journal.
+int journal_format(journal_t *j, const journal_bdev_t *dev);
+
+int journal_append(journal_t *j, const void *data, uint8_t len);
+
+/**
+ * Copy the oldest pending record into dst without consuming it.
+ * Returns JOURNAL_ERR_EMPTY when nothing is waiting.
+ */
+int journal_peek(journal_t *j, void *dst, size_t cap, uint8_t *len);
+
+// Mark the record returned by the last journal_peek as replayed.
+int journal_pop(journal_t *j);
+
+static inline uint32_t journal_pending(const journal_t *j)
+{
+    return j->pending;
+}
+
+#ifdef ESP_PLATFORM
+// Journal stored in a data partition (see partitions.csv).
+int journal_bdev_partition(journal_bdev_t *dev, const char *label);
+#else
+// Host backend: file emulating NOR flash, created (erased) if missing.
+int journal_bdev_file(journal_bdev_t *dev, const char *path, uint32_t sector_size, uint32_t sector_count);
+void journal_bdev_file_close(journal_bdev_t *dev);
+#endif
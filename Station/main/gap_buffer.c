@@ -0,0 +1,105 @@
+#include <string.h>
+#include "gap_buffer.h"
+
+void gap_init(gap_buffer_t *gb, char *storage, uint16_t capacity)
+{
+    gb->buf = storage;
+    gb->capacity = capacity;
+    gap_clear(gb);
+}
+
+void gap_clear(gap_buffer_t *gb)
+{
+    gb->gap_start = 0;
+    gb->gap_end = gb->capacity;
+}
+
+bool gap_insert(gap_buffer_t *gb, char c)
+{
+    if(gb->gap_start == gb->gap_end){
+        return false;
+    }
+    gb->buf[gb->gap_start++] = c;
+    return true;
+}
+
+bool gap_replace_before(gap_buffer_t *gb, char c)
+{
+    if(gb->gap_start == 0){
+        return false;
+    }
+    gb->buf[gb->gap_start - 1] = c;
+    return true;
+}
+
+bool gap_delete_before(gap_buffer_t *gb)
+{
+    if(gb->gap_start == 0){
+        return false;
+    }
+    gb->gap_start--;
+    return true;
+}
+
+bool gap_delete_after(gap_buffer_t *gb)
+{
+    if(gb->gap_end == gb->capacity){
+        return false;
+    }
+    gb->gap_end++;
+    return true;
+}
+
+bool gap_left(gap_buffer_t *gb)
+{
+    if(gb->gap_start == 0){
+        return false;
+    }
+    gb->buf[--gb->gap_end] = gb->buf[--gb->gap_start];
+    return true;
+}
+
+bool gap_right(gap_buffer_t *gb)
+{
+    if(gb->gap_end == gb->capacity){
+        return false;
+    }
+    gb->buf[gb->gap_start++] = gb->buf[gb->gap_end++];
+    return true;
+}
+
+void gap_move_to(gap_buffer_t *gb, uint16_t pos)
+{
+    uint16_t len = gap_length(gb);
+    if(pos > len){
+        pos = len;
+    }
+    if(pos < gb->gap_start){
+        uint16_t n = gb->gap_start - pos;
+        memmove(&gb->buf[gb->gap_end - n], &gb->buf[pos], n);
+        gb->gap_start -= n;
+        gb->gap_end -= n;
+    }
+    else if(pos > gb->gap_start){
+        uint16_t n = pos - gb->gap_start;
+        memmove(&gb->buf[gb->gap_start], &gb->buf[gb->gap_end], n);
+        gb->gap_start += n;
+        gb->gap_end += n;
+    }
+}
+
+uint16_t gap_copy(const gap_buffer_t *gb, char *out, uint16_t size)
+{
+    if(size == 0){
+        return 0;
+    }
+    uint16_t before = gb->gap_start < size - 1 ? gb->gap_start : size - 1;
+    memcpy(out, gb->buf, before);
+    uint16_t after = gb->capacity - gb->gap_end;
+    if(after > size - 1 - before){
+        after = size - 1 - before;
+    }
+    memcpy(&out[before], &gb->buf[gb->gap_end], after);
+    out[before + after] = '\0';
+    return before + after;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Text with a gap at the cursor.
+ *
+ *   [text before cursor][ ... gap ... ][text after cursor]
+ *
+ * Typing and deleting next to the cursor only move the gap edges, moving the
+ * cursor by one copies one character, so editing costs the same for a five
+ * letter word and a full message.
+ */
+
+typedef struct {
+    char *buf;
+    uint16_t capacity;
+    uint16_t gap_start;     // == cursor
+    uint16_t gap_end;       // first character after the cursor
+} gap_buffer_t;
+
+void gap_init(gap_buffer_t *gb, char *storage, uint16_t capacity);
+
+void gap_clear(gap_buffer_t *gb);
+
+static inline uint16_t gap_length(const gap_buffer_t *gb)
+{
+    return gb->capacity - (gb->gap_end - gb->gap_start);
+}
+
+static inline uint16_t gap_cursor(const gap_buffer_t *gb)
+{
+    return gb->gap_start;
+}
+
+// Character before the cursor, 0 at the start
+static inline char gap_before(const gap_buffer_t *gb)
+{
+    return gb->gap_start > 0 ? gb->buf[gb->gap_start - 1] : 0;
+}
+
+// All return false when there is no room or nothing to do
+bool gap_insert(gap_buffer_t *gb, char c);
+bool gap_replace_before(gap_buffer_t *gb, char c);
+bool gap_delete_before(gap_buffer_t *gb);
+bool gap_delete_after(gap_buffer_t *gb);
+bool gap_left(gap_buffer_t *gb);
+bool gap_right(gap_buffer_t *gb);
+
+// Move the cursor to pos, costs one copy per character moved over
+void gap_move_to(gap_buffer_t *gb, uint16_t pos);
+
+// Copy the text out as a C string, returns its length
+uint16_t gap_copy(const gap_buffer_t *gb, char *out, uint16_t size);
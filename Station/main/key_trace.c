@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "key_trace.h"
+
+#if KEY_TRACE_ENABLED
+
+static key_trace_mark_t ring[KEY_TRACE_SIZE];
+static uint32_t ring_head;          // marks ever written, only grows
+static uint16_t scanned_keys;       // written by the scanner only
+static uint16_t dequeued_keys;      // written by the display task only
+static uint16_t frame_seq;
+static bool frame_pending;
+
+static void mark(uint8_t stage, uint16_t seq, uint8_t key, uint32_t now_us)
+{
+    uint32_t slot = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED) & (KEY_TRACE_SIZE - 1);
+    ring[slot] = (key_trace_mark_t){now_us, seq, stage, key};
+}
+
+void key_trace_isr(uint32_t now_us)
+{
+    mark(KEY_STAGE_ISR, scanned_keys, 0, now_us);
+}
+
+void key_trace_scanned(uint8_t key, uint32_t now_us)
+{
+    mark(KEY_STAGE_SCAN, scanned_keys++, key, now_us);
+}
+
+void key_trace_dequeued(uint8_t key, uint32_t now_us)
+{
+    mark(KEY_STAGE_DEQUEUE, dequeued_keys++, key, now_us);
+}
+
+void key_trace_buffered(uint32_t now_us)
+{
+    mark(KEY_STAGE_BUFFER, dequeued_keys - 1, 0, now_us);
+}
+
+void key_trace_frame(bool last)
+{
+    // every key taken so far is drawn by this refresh
+    frame_seq = dequeued_keys - 1;
+    frame_pending = last && dequeued_keys > 0;
+}
+
+void key_trace_flushed(uint32_t now_us)
+{
+    if(frame_pending){
+        frame_pending = false;
+        mark(KEY_STAGE_FLUSH, frame_seq, 0, now_us);
+    }
+}
+
+void key_trace_reset(void)
+{
+    __atomic_store_n(&ring_head, 0, __ATOMIC_RELAXED);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int key_trace_stats(key_trace_stat_t stats[KEY_STAGES])
+{
+    static uint32_t times[KEY_TRACE_KEYS][KEY_STAGES];
+    static uint16_t seqs[KEY_TRACE_KEYS];
+    static uint8_t seen[KEY_TRACE_KEYS];    // bit per stage
+    static uint32_t latency[KEY_TRACE_KEYS];
+
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    uint32_t first = head > KEY_TRACE_SIZE ? head - KEY_TRACE_SIZE : 0;
+    uint16_t flushed = 0;
+    bool any_flush = false;
+
+    memset(seen, 0, sizeof(seen));
+    for(uint32_t i = first; i < head; i++){
+        key_trace_mark_t m = ring[i & (KEY_TRACE_SIZE - 1)];
+        if(m.stage >= KEY_STAGES){
+            continue;
+        }
+        if(m.stage == KEY_STAGE_FLUSH){
+            // a refresh shows every key up to m.seq not shown before
+            uint16_t from = any_flush ? flushed + 1 : m.seq - (KEY_TRACE_KEYS - 1);
+            for(uint16_t s = from; (int16_t)(m.seq - s) >= 0; s++){
+                uint16_t slot = s & (KEY_TRACE_KEYS - 1);
+                if(seqs[slot] == s && (seen[slot] & (1 << KEY_STAGE_SCAN)) && !(seen[slot] & (1 << KEY_STAGE_FLUSH))){
+                    times[slot][KEY_STAGE_FLUSH] = m.time_us;
+                    seen[slot] |= 1 << KEY_STAGE_FLUSH;
+                }
+            }
+            flushed = m.seq;
+            any_flush = true;
+            continue;
+        }
+        // a newer key in the same slot pushes the old one out
+        uint16_t slot = m.seq & (KEY_TRACE_KEYS - 1);
+        if(seqs[slot] != m.seq){
+            seqs[slot] = m.seq;
+            seen[slot] = 0;
+        }
+        times[slot][m.stage] = m.time_us;
+        seen[slot] |= 1 << m.stage;
+    }
+
+    int keys = 0;
+    for(int stage = 0; stage < KEY_STAGES; stage++){
+        uint16_t n = 0;
+        for(int slot = 0; slot < KEY_TRACE_KEYS; slot++){
+            uint8_t need = (1 << KEY_STAGE_SCAN) | (1 << stage);
+            if((seen[slot] & need) != need){
+                continue;
+            }
+            if(stage == KEY_STAGE_ISR){
+                latency[n++] = times[slot][KEY_STAGE_SCAN] - times[slot][KEY_STAGE_ISR];
+            }
+            else{
+                latency[n++] = times[slot][stage] - times[slot][KEY_STAGE_SCAN];
+            }
+        }
+        qsort(latency, n, sizeof(latency[0]), compare_u32);
+        stats[stage].count = n;
+        stats[stage].p50 = n ? latency[n * 50 / 100] : 0;
+        stats[stage].p90 = n ? latency[n * 90 / 100] : 0;
+        stats[stage].p99 = n ? latency[n * 99 / 100] : 0;
+        stats[stage].max = n ? latency[n - 1] : 0;
+        if(stage == KEY_STAGE_SCAN){
+            keys = n;
+        }
+    }
+    return keys;
+}
+
+#endif
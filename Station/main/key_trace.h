@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Typing latency profiler.
+ *
+ * Every key is timestamped on its way to the screen: the row interrupt that
+ * started scanning, the debounced scanner event, the display task taking it
+ * from the queue, the text buffer update and the end of the LVGL flush that
+ * shows it. Marks go into a lock-free ring that any task or interrupt can
+ * write to, key_trace_stats turns the ring into per-stage percentiles.
+ *
+ * Keys are numbered in queue order, the scanner and the display task count
+ * them independently, so no sequence number has to travel with the event.
+ *
+ * With KEY_TRACE_ENABLED 0 every KEY_TRACE(...) call site disappears,
+ * arguments included, and the module is empty.
+ */
+
+#ifndef KEY_TRACE_ENABLED
+#define KEY_TRACE_ENABLED 0
+#endif
+
+#if KEY_TRACE_ENABLED
+#define KEY_TRACE(call) call
+#else
+#define KEY_TRACE(call)
+#endif
+
+#define KEY_TRACE_SIZE  1024    // marks kept, power of two
+#define KEY_TRACE_KEYS  256     // keys key_trace_stats looks at, power of two
+
+typedef enum {
+    KEY_STAGE_ISR,      // row interrupt, only for the first key after the keypad went idle
+    KEY_STAGE_SCAN,     // debounced and queued
+    KEY_STAGE_DEQUEUE,
+    KEY_STAGE_BUFFER,   // text entry engines done with it
+    KEY_STAGE_FLUSH,    // last flush of the next refresh done
+    KEY_STAGES
+} key_stage_t;
+
+typedef struct {
+    uint32_t time_us;
+    uint16_t seq;       // key number
+    uint8_t stage;
+    uint8_t key;
+} key_trace_mark_t;
+
+// Microseconds from KEY_STAGE_SCAN to the stage, for KEY_STAGE_ISR from the interrupt to the scan
+typedef struct {
+    uint16_t count;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} key_trace_stat_t;
+
+#if KEY_TRACE_ENABLED
+void key_trace_isr(uint32_t now_us);
+void key_trace_scanned(uint8_t key, uint32_t now_us);
+void key_trace_dequeued(uint8_t key, uint32_t now_us);
+void key_trace_buffered(uint32_t now_us);
+
+// Call from every flush, last tells the refresh's final area, then from its completion
+void key_trace_frame(bool last);
+void key_trace_flushed(uint32_t now_us);
+
+// Percentiles over the keys still in the ring, returns the number of keys
+int key_trace_stats(key_trace_stat_t stats[KEY_STAGES]);
+
+void key_trace_reset(void);
+#endif
@@ -0,0 +1,61 @@
+#include "keypad_indev.h"
+
+void keypad_indev_init(keypad_indev_t *kb, keypad_indev_poll_cb poll, void *ctx)
+{
+    kb->head = 0;
+    kb->count = 0;
+    kb->last_key = 0;
+    kb->pressed = false;
+    kb->poll = poll;
+    kb->ctx = ctx;
+}
+
+bool keypad_indev_put(keypad_indev_t *kb, uint32_t key)
+{
+    if(kb->count == KEYPAD_INDEV_BUFFER){
+        return false;
+    }
+    kb->keys[(kb->head + kb->count) % KEYPAD_INDEV_BUFFER] = key;
+    kb->count++;
+    return true;
+}
+
+void keypad_indev_drop(keypad_indev_t *kb)
+{
+    kb->count = 0;
+}
+
+// Every key is reported pressed once and released on the next read
+void keypad_indev_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    keypad_indev_t *kb = drv->user_data;
+    if(!kb->pressed && kb->count == 0 && kb->poll){
+        kb->poll(kb->ctx);
+    }
+    data->key = kb->last_key;
+    if(kb->pressed){
+        data->state = LV_INDEV_STATE_RELEASED;
+        kb->pressed = false;
+    }
+    else if(kb->count > 0){
+        kb->last_key = kb->keys[kb->head];
+        kb->head = (kb->head + 1) % KEYPAD_INDEV_BUFFER;
+        kb->count--;
+        data->key = kb->last_key;
+        data->state = LV_INDEV_STATE_PRESSED;
+        kb->pressed = true;
+    }
+    else{
+        data->state = LV_INDEV_STATE_RELEASED;
+    }
+    data->continue_reading = kb->pressed || kb->count > 0;
+}
+
+lv_indev_t *keypad_indev_register(keypad_indev_t *kb, lv_indev_drv_t *drv)
+{
+    lv_indev_drv_init(drv);
+    drv->type = LV_INDEV_TYPE_KEYPAD;
+    drv->read_cb = keypad_indev_read;
+    drv->user_data = kb;
+    return lv_indev_drv_register(drv);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+/*
+ * LVGL keypad input device fed from a key buffer.
+ *
+ * The keypad puts the LVGL keys of an edit (characters, BACKSPACE, LEFT,
+ * RIGHT, NEXT, ...) into the buffer, the read callback reports each one
+ * pressed once and released on the next read and asks LVGL to keep reading
+ * while keys are waiting, so one read of the input device hands over all of
+ * them. When the buffer is empty the poll callback is called first so it
+ * can scan the keypad and fill it.
+ *
+ * Only LVGL, no ESP-IDF: the LVGL tests drive this file unchanged.
+ */
+
+#define KEYPAD_INDEV_BUFFER 64      // LVGL keys waiting to be read by the input device
+
+typedef void (*keypad_indev_poll_cb)(void *ctx);
+
+typedef struct {
+    uint32_t keys[KEYPAD_INDEV_BUFFER];
+    uint16_t head;
+    uint16_t count;
+    uint32_t last_key;
+    bool pressed;               // last_key reported pressed, release it on the next read
+    keypad_indev_poll_cb poll;  // may be NULL
+    void *ctx;
+} keypad_indev_t;
+
+void keypad_indev_init(keypad_indev_t *kb, keypad_indev_poll_cb poll, void *ctx);
+
+// Returns false when the buffer is full, the key is dropped
+bool keypad_indev_put(keypad_indev_t *kb, uint32_t key);
+
+// Drop the keys not read yet
+void keypad_indev_drop(keypad_indev_t *kb);
+
+static inline uint16_t keypad_indev_waiting(const keypad_indev_t *kb)
+{
+    return kb->count;
+}
+
+// LVGL read_cb, drv->user_data is the keypad_indev_t
+void keypad_indev_read(lv_indev_drv_t *drv, lv_indev_data_t *data);
+
+// Register a keypad input device reading kb, drv must stay alive with it
+lv_indev_t *keypad_indev_register(keypad_indev_t *kb, lv_indev_drv_t *drv);
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "keypad_scan.h"
+
+#define ROW_MASK ((1 << KEYPAD_COLS) - 1)
+
+static void emit(keypad_scan_t *scan, uint8_t key, key_event_type_t type, uint32_t now_ms)
+{
+    if(scan->cb){
+        key_event_t event = { .key = key, .type = type, .time_ms = now_ms };
+        scan->cb(scan->ctx, &event);
+    }
+}
+
+// Two rows sharing two or more closed columns, one of the four keys may be a ghost
+static bool ambiguous(uint16_t raw)
+{
+    for(int a = 0; a < KEYPAD_ROWS; a++){
+        uint16_t row_a = (raw >> (a * KEYPAD_COLS)) & ROW_MASK;
+        if(row_a == 0 || (row_a & (row_a - 1)) == 0){
+            continue; // fewer than two columns
+        }
+        for(int b = a + 1; b < KEYPAD_ROWS; b++){
+            uint16_t common = row_a & (raw >> (b * KEYPAD_COLS)) & ROW_MASK;
+            if(common & (common - 1)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void keypad_scan_init(keypad_scan_t *scan, uint8_t integrate, uint32_t long_press_ms,
+                      keypad_event_cb cb, void *ctx)
+{
+    memset(scan, 0, sizeof(*scan));
+    scan->integrate = integrate > 0 ? integrate : 1;
+    scan->long_press_ms = long_press_ms;
+    scan->cb = cb;
+    scan->ctx = ctx;
+}
+
+bool keypad_scan_feed(keypad_scan_t *scan, uint16_t raw, uint32_t now_ms)
+{
+    bool busy = false;
+
+    if(ambiguous(raw)){
+        // keep the counters where they are until the sample makes sense again
+        scan->ghosted++;
+        return true;
+    }
+    for(uint8_t key = 0; key < KEYPAD_KEYS; key++){
+        uint16_t bit = 1 << key;
+        bool closed = raw & bit;
+
+        if(closed && scan->count[key] < scan->integrate){
+            scan->count[key]++;
+        }
+        else if(!closed && scan->count[key] > 0){
+            scan->count[key]--;
+        }
+
+        if(!(scan->state & bit) && scan->count[key] == scan->integrate){
+            scan->state |= bit;
+            scan->long_sent &= ~bit;
+            scan->down_ms[key] = now_ms;
+            emit(scan, key, KEY_EVENT_DOWN, now_ms);
+        }
+        else if((scan->state & bit) && scan->count[key] == 0){
+            scan->state &= ~bit;
+            emit(scan, key, KEY_EVENT_UP, now_ms);
+        }
+        else if((scan->state & bit) && !(scan->long_sent & bit) && scan->long_press_ms > 0
+                && now_ms - scan->down_ms[key] >= scan->long_press_ms){
+            scan->long_sent |= bit;
+            emit(scan, key, KEY_EVENT_LONG, now_ms);
+        }
+
+        busy |= scan->count[key] > 0;
+    }
+    return busy;
+}
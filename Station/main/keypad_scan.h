@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Debounce and event logic for the 4x4 key matrix.
+ *
+ * The driver samples the whole matrix every scan period and feeds it here as a
+ * bitmask, bit row * 4 + col set while that key is closed. Every key has an
+ * integrating counter: it counts up on closed samples and down on open ones,
+ * and the key only changes state when the counter reaches either end. So a
+ * bouncing contact never produces an event, and a clean press is reported
+ * after `integrate` scans.
+ *
+ * Keys are tracked independently (n-key rollover). The matrix has no diodes,
+ * so three keys on the corners of a rectangle make the fourth corner look
+ * pressed. Samples with such a rectangle are ambiguous and are skipped.
+ */
+
+#define KEYPAD_ROWS 4
+#define KEYPAD_COLS 4
+#define KEYPAD_KEYS (KEYPAD_ROWS * KEYPAD_COLS)
+
+typedef enum {
+    KEY_EVENT_DOWN,
+    KEY_EVENT_UP,
+    KEY_EVENT_LONG,     // still held long_press_ms after DOWN, sent once per press
+} key_event_type_t;
+
+typedef struct {
+    uint8_t key;        // row * KEYPAD_COLS + col, same order as the keypad tables
+    uint8_t type;       // key_event_type_t
+    uint32_t time_ms;
+} key_event_t;
+
+typedef void (*keypad_event_cb)(void *ctx, const key_event_t *event);
+
+typedef struct {
+    uint8_t count[KEYPAD_KEYS];
+    uint16_t state;         // debounced, bit set = pressed
+    uint16_t long_sent;
+    uint32_t down_ms[KEYPAD_KEYS];
+    uint8_t integrate;
+    uint32_t long_press_ms;
+    keypad_event_cb cb;
+    void *ctx;
+    uint32_t ghosted;       // samples skipped as ambiguous
+} keypad_scan_t;
+
+void keypad_scan_init(keypad_scan_t *scan, uint8_t integrate, uint32_t long_press_ms,
+                      keypad_event_cb cb, void *ctx);
+
+/**
+ * Feed one sample of the matrix taken at now_ms.
+ * Returns true while any key is pressed or still settling, the driver keeps
+ * scanning until it returns false and can then go back to waiting for an
+ * interrupt.
+ */
+bool keypad_scan_feed(keypad_scan_t *scan, uint16_t raw, uint32_t now_ms);
@@ -0,0 +1,58 @@
+#include <string.h>
+#include "macro.h"
+
+void macro_init(macro_table_t *table, uint8_t prefix_key)
+{
+    memset(table, 0, sizeof(*table));
+    table->prefix_key = prefix_key;
+    table->held_key = MACRO_NO_KEY;
+}
+
+int macro_set(macro_table_t *table, uint8_t key, const uint8_t *frame, size_t len)
+{
+    if(key >= MACRO_SLOTS || key == table->prefix_key){
+        return MACRO_ERR_SLOT;
+    }
+    if(len == 0 || len > MACRO_MAX_FRAME){
+        return MACRO_ERR_SIZE;
+    }
+    memcpy(table->slot[key].frame, frame, len);
+    table->slot[key].len = len;
+    return MACRO_OK;
+}
+
+void macro_remove(macro_table_t *table, uint8_t key)
+{
+    if(key < MACRO_SLOTS){
+        table->slot[key].len = 0;
+    }
+}
+
+macro_result_t macro_event(macro_table_t *table, const key_event_t *event, bool idle, const macro_t **fire)
+{
+    *fire = NULL;
+    if(event->type != KEY_EVENT_DOWN){
+        // long press of a key the engine has already taken
+        if(event->key == table->held_key){
+            return MACRO_TAKEN;
+        }
+        if(event->type == KEY_EVENT_LONG && idle && !table->armed){
+            *fire = macro_get(table, event->key);
+        }
+        return *fire != NULL ? MACRO_FIRE : MACRO_PASS;
+    }
+    table->held_key = MACRO_NO_KEY;
+    if(table->armed){
+        // second key of the combination, the prefix again cancels
+        table->armed = false;
+        table->held_key = event->key;
+        *fire = macro_get(table, event->key);
+        return *fire != NULL ? MACRO_FIRE : MACRO_TAKEN;
+    }
+    if(idle && event->key == table->prefix_key){
+        table->armed = true;
+        table->held_key = event->key;
+        return MACRO_TAKEN;
+    }
+    return MACRO_PASS;
+}
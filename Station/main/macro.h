@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "keypad_scan.h"
+
+/*
+ * Macro keys, one ready-to-send frame per key.
+ *
+ * Frames are encoded once when the table is loaded, so firing a macro only
+ * hands the stored bytes to the link. A macro fires by pressing the prefix
+ * key and then its key, or by a long press of its key, both only while
+ * nothing is being composed. Keys without a macro keep their normal meaning.
+ */
+
+#define MACRO_OK          0
+#define MACRO_ERR_SLOT    -1
+#define MACRO_ERR_SIZE    -2
+
+#define MACRO_SLOTS       KEYPAD_KEYS
+#define MACRO_MAX_TEXT    64
+#define MACRO_MAX_FRAME   (MACRO_MAX_TEXT + 5)   // type and text with header and checksums
+#define MACRO_NO_KEY      0xFF
+
+typedef enum {
+    MACRO_PASS,     // not a macro key, handle the event as usual
+    MACRO_TAKEN,    // used by the macro engine, nothing to do
+    MACRO_FIRE,     // send *fire
+} macro_result_t;
+
+typedef struct {
+    uint8_t len;    // 0 when the key has no macro
+    uint8_t frame[MACRO_MAX_FRAME];
+} macro_t;
+
+typedef struct {
+    macro_t slot[MACRO_SLOTS];  // indexed by key
+    uint8_t prefix_key;
+    bool armed;                 // prefix pressed, waiting for the macro key
+    uint8_t held_key;           // key whose long press is swallowed
+} macro_table_t;
+
+void macro_init(macro_table_t *table, uint8_t prefix_key);
+
+int macro_set(macro_table_t *table, uint8_t key, const uint8_t *frame, size_t len);
+
+void macro_remove(macro_table_t *table, uint8_t key);
+
+static inline const macro_t *macro_get(const macro_table_t *table, uint8_t key)
+{
+    return key < MACRO_SLOTS && table->slot[key].len > 0 ? &table->slot[key] : NULL;
+}
+
+/**
+ * Feed a key event. idle tells whether the composer is empty, not counting
+ * the pending character the same key's press has just put there.
+ */
+macro_result_t macro_event(macro_table_t *table, const key_event_t *event, bool idle, const macro_t **fire);
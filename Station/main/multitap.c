@@ -0,0 +1,173 @@
+#include <string.h>
+#include "multitap.h"
+
+static void edit(multitap_t *mt, multitap_edit_t what, char c)
+{
+    if(mt->on_edit){
+        mt->on_edit(mt->ctx, what, c);
+    }
+}
+
+static bool insert(multitap_t *mt, char c)
+{
+    if(!gap_insert(&mt->text, c)){
+        return false;
+    }
+    edit(mt, MULTITAP_EDIT_INSERT, c);
+    return true;
+}
+
+// Swap the pending character for c
+static void replace(multitap_t *mt, char c)
+{
+    if(gap_before(&mt->text) != c){
+        gap_replace_before(&mt->text, c);
+        edit(mt, MULTITAP_EDIT_BACKSPACE, 0);
+        edit(mt, MULTITAP_EDIT_INSERT, c);
+    }
+}
+
+static void backspace(multitap_t *mt)
+{
+    if(gap_delete_before(&mt->text)){
+        edit(mt, MULTITAP_EDIT_BACKSPACE, 0);
+    }
+}
+
+bool multitap_commit(multitap_t *mt)
+{
+    if(mt->pending_key < 0){
+        return false;
+    }
+    mt->pending_key = -1;
+    return true;
+}
+
+void multitap_init(multitap_t *mt, const multitap_key_t *layout, uint32_t timeout_ms,
+                   multitap_edit_cb on_edit, void *ctx)
+{
+    memset(mt, 0, sizeof(*mt));
+    gap_init(&mt->text, mt->storage, sizeof(mt->storage));
+    mt->layout = layout;
+    mt->timeout_ms = timeout_ms;
+    mt->pending_key = -1;
+    mt->on_edit = on_edit;
+    mt->ctx = ctx;
+}
+
+void multitap_cancel(multitap_t *mt)
+{
+    if(mt->pending_key >= 0){
+        backspace(mt);
+        mt->pending_key = -1;
+    }
+}
+
+void multitap_insert(multitap_t *mt, const char *str)
+{
+    multitap_commit(mt);
+    while(*str && insert(mt, *str)){
+        str++;
+    }
+}
+
+void multitap_clear(multitap_t *mt)
+{
+    gap_clear(&mt->text);
+    mt->pending_key = -1;
+    edit(mt, MULTITAP_EDIT_CLEAR, 0);
+}
+
+static int char_key(multitap_t *mt, const key_event_t *event, const char *chars)
+{
+    if(event->type == KEY_EVENT_LONG){
+        // the short press already put the first character in, keep it and commit
+        if(mt->pending_key == event->key){
+            replace(mt, chars[0]);
+            multitap_commit(mt);
+        }
+        return MULTITAP_CHANGED;
+    }
+    if(mt->pending_key == event->key && event->time_ms - mt->last_ms < mt->timeout_ms){
+        mt->pending_index = (mt->pending_index + 1) % strlen(chars);
+        replace(mt, chars[mt->pending_index]);
+    }
+    else{
+        multitap_commit(mt);
+        if(!insert(mt, chars[0])){
+            return 0;
+        }
+        mt->pending_key = event->key;
+        mt->pending_index = 0;
+    }
+    mt->last_ms = event->time_ms;
+    return MULTITAP_CHANGED;
+}
+
+int multitap_event(multitap_t *mt, const key_event_t *event)
+{
+    if(event->key >= KEYPAD_KEYS || event->type == KEY_EVENT_UP){
+        return 0;
+    }
+    const multitap_key_t *key = &mt->layout[event->key];
+
+    switch(key->role){
+        case MULTITAP_CHARS:
+            return key->chars && key->chars[0] ? char_key(mt, event, key->chars) : 0;
+        case MULTITAP_NEXT:
+            if(event->type == KEY_EVENT_LONG){
+                // the short press of this key moved right already, take that back too
+                int steps = mt->next_moved ? 2 : 1;
+                multitap_commit(mt);
+                while(steps-- > 0 && gap_left(&mt->text)){
+                    edit(mt, MULTITAP_EDIT_LEFT, 0);
+                }
+                mt->next_moved = false;
+            }
+            else{
+                mt->next_moved = !multitap_commit(mt) && gap_right(&mt->text);
+                if(mt->next_moved){
+                    edit(mt, MULTITAP_EDIT_RIGHT, 0);
+                }
+            }
+            return MULTITAP_CHANGED;
+        case MULTITAP_DELETE:
+            if(event->type == KEY_EVENT_LONG){
+                multitap_clear(mt);
+            }
+            else{
+                // the pending character sits before the cursor as well
+                backspace(mt);
+                mt->pending_key = -1;
+            }
+            return MULTITAP_CHANGED;
+        case MULTITAP_CLEAR:
+            multitap_clear(mt);
+            return MULTITAP_CHANGED;
+        case MULTITAP_SEND_KEY:
+            if(event->type == KEY_EVENT_LONG){
+                return 0;
+            }
+            multitap_commit(mt);
+            return MULTITAP_CHANGED | MULTITAP_SEND;
+    }
+    return 0;
+}
+
+int multitap_tick(multitap_t *mt, uint32_t now_ms)
+{
+    if(mt->pending_key >= 0 && now_ms - mt->last_ms >= mt->timeout_ms){
+        multitap_commit(mt);
+        return MULTITAP_CHANGED;
+    }
+    return 0;
+}
+
+uint32_t multitap_next_deadline(const multitap_t *mt, uint32_t now_ms)
+{
+    if(mt->pending_key < 0){
+        return UINT32_MAX;
+    }
+    uint32_t elapsed = now_ms - mt->last_ms;
+    return elapsed >= mt->timeout_ms ? 0 : mt->timeout_ms - elapsed;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "keypad_scan.h"
+#include "gap_buffer.h"
+
+/*
+ * Multi-tap text entry.
+ *
+ * Every character key has a cycle of characters. The first press inserts the
+ * first character of the cycle before the cursor as a pending character,
+ * pressing the same key again within timeout_ms replaces it with the next one.
+ * The pending character is committed by the timeout, by another key or by
+ * NEXT, so 'D' is no longer needed between letters.
+ *
+ * Keys:
+ *   CHARS   short: cycle, long: insert the first character of the cycle
+ *   NEXT    short: commit / cursor right, long: cursor left
+ *   DELETE  short: drop the pending character or the one before the cursor,
+ *           long: clear everything
+ *   CLEAR   clear everything
+ *   SEND    commit and report MULTITAP_SEND
+ *
+ * The text lives in a gap buffer, so every edit is O(1). Each edit is also
+ * reported to the edit callback, which lets a text widget follow along one
+ * character at a time instead of taking the whole text again.
+ */
+
+#define MULTITAP_MAX_TEXT 250
+
+#define MULTITAP_CHANGED 0x01   // text or cursor changed, redraw
+#define MULTITAP_SEND    0x02   // text is ready to be sent
+
+typedef enum {
+    MULTITAP_CHARS,
+    MULTITAP_NEXT,
+    MULTITAP_DELETE,
+    MULTITAP_CLEAR,
+    MULTITAP_SEND_KEY,
+} multitap_role_t;
+
+typedef enum {
+    MULTITAP_EDIT_INSERT,       // c typed before the cursor
+    MULTITAP_EDIT_BACKSPACE,    // character before the cursor removed
+    MULTITAP_EDIT_LEFT,
+    MULTITAP_EDIT_RIGHT,
+    MULTITAP_EDIT_CLEAR,
+} multitap_edit_t;
+
+typedef struct {
+    uint8_t role;       // multitap_role_t
+    const char *chars;  // cycle of a MULTITAP_CHARS key
+} multitap_key_t;
+
+typedef void (*multitap_edit_cb)(void *ctx, uint8_t edit, char c);
+
+typedef struct {
+    char storage[MULTITAP_MAX_TEXT];
+    gap_buffer_t text;      // cursor is after the pending character
+    int8_t pending_key;     // -1 when nothing is pending
+    uint8_t pending_index;  // position in the key's cycle
+    uint32_t last_ms;
+    bool next_moved;        // the last NEXT press moved the cursor right
+    uint32_t timeout_ms;
+    const multitap_key_t *layout;   // KEYPAD_KEYS entries
+    multitap_edit_cb on_edit;
+    void *ctx;
+} multitap_t;
+
+void multitap_init(multitap_t *mt, const multitap_key_t *layout, uint32_t timeout_ms,
+                   multitap_edit_cb on_edit, void *ctx);
+
+// Feed a key event from the scanner, returns MULTITAP_CHANGED / MULTITAP_SEND flags
+int multitap_event(multitap_t *mt, const key_event_t *event);
+
+// Commit the pending character once its timeout ran out, returns MULTITAP_CHANGED when it did
+int multitap_tick(multitap_t *mt, uint32_t now_ms);
+
+// Milliseconds until multitap_tick has something to do, UINT32_MAX when nothing is pending
+uint32_t multitap_next_deadline(const multitap_t *mt, uint32_t now_ms);
+
+static inline bool multitap_pending(const multitap_t *mt)
+{
+    return mt->pending_key >= 0;
+}
+
+static inline uint16_t multitap_length(const multitap_t *mt)
+{
+    return gap_length(&mt->text);
+}
+
+// Copy the text out as a C string, returns its length
+static inline uint16_t multitap_text(const multitap_t *mt, char *out, uint16_t size)
+{
+    return gap_copy(&mt->text, out, size);
+}
+
+// Accept the pending character now, false when there was none
+bool multitap_commit(multitap_t *mt);
+
+// Drop the pending character
+void multitap_cancel(multitap_t *mt);
+
+// Commit the pending character and insert str at the cursor
+void multitap_insert(multitap_t *mt, const char *str);
+
+void multitap_clear(multitap_t *mt);
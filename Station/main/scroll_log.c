@@ -0,0 +1,72 @@
+#include <string.h>
+#include "scroll_log.h"
+
+int scroll_log_init(scroll_log_t *log, uint16_t top, uint16_t height, uint16_t line_h, uint16_t memory_rows)
+{
+    memset(log, 0, sizeof(*log));
+    if(line_h == 0 || height < line_h || top + height > memory_rows){
+        return SCROLL_LOG_ERR_SIZE;
+    }
+    log->top = top;
+    log->height = height - height % line_h;
+    log->line_h = line_h;
+    log->memory_rows = memory_rows;
+    return SCROLL_LOG_OK;
+}
+
+void scroll_log_add(scroll_log_t *log, const char *text, size_t len)
+{
+    if(len > SCROLL_LOG_LINE_MAX){
+        len = SCROLL_LOG_LINE_MAX;
+    }
+    memcpy(log->line[log->head], text, len);
+    log->line[log->head][len] = '\0';
+    log->head = (log->head + 1) % SCROLL_LOG_LINES;
+    if(log->count < SCROLL_LOG_LINES){
+        log->count++;
+    }
+    log->offset = (log->offset + log->line_h) % log->height;
+}
+
+const char *scroll_log_line(const scroll_log_t *log, uint16_t back)
+{
+    if(back >= log->count){
+        return NULL;
+    }
+    return log->line[(log->head + SCROLL_LOG_LINES - 1 - back) % SCROLL_LOG_LINES];
+}
+
+static int piece(scroll_piece_t *p, int16_t y, int16_t mem_y, int16_t rows)
+{
+    p->y = y;
+    p->mem_y = mem_y;
+    p->rows = rows;
+    return 1;
+}
+
+int scroll_log_map(const scroll_log_t *log, int16_t y1, int16_t y2, scroll_piece_t out[SCROLL_LOG_PIECES])
+{
+    int16_t top = log->top, bottom = log->top + log->height; // band is top .. bottom - 1
+    int n = 0;
+    if(y1 < top){
+        int16_t end = y2 < top ? y2 : top - 1;
+        n += piece(&out[n], y1, y1, end - y1 + 1);
+        y1 = end + 1;
+    }
+    if(y1 <= y2 && y1 < bottom){
+        int16_t end = y2 < bottom ? y2 : bottom - 1;
+        // screen row y shows memory row top + (y - top + offset) % height
+        int16_t mem_y = top + (y1 - top + log->offset) % log->height;
+        int16_t rows = end - y1 + 1;
+        int16_t first = bottom - mem_y < rows ? bottom - mem_y : rows;
+        n += piece(&out[n], y1, mem_y, first);
+        if(first < rows){
+            n += piece(&out[n], y1 + first, top, rows - first);
+        }
+        y1 = end + 1;
+    }
+    if(y1 <= y2){
+        n += piece(&out[n], y1, y1, y2 - y1 + 1);
+    }
+    return n;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Message log in a band of the panel that the ILI9341 scrolls by itself.
+ *
+ * The controller shows the rows of its vertical scrolling area (VSCRDEF)
+ * starting at the memory row set with VSCRSADD and wraps around inside the
+ * area. Adding a line moves that start down by one line height: the panel
+ * then shows every old line one line higher without a pixel being sent, and
+ * only the rows that came around at the bottom need the new line drawn.
+ *
+ * LVGL keeps drawing in screen rows. scroll_log_map turns the rows of a
+ * flushed area into the memory rows they sit in for the current start, in
+ * up to four pieces: above the band, two inside it around the wrap, below
+ * it. The log does no drawing and no locking, one task owns it.
+ */
+
+#define SCROLL_LOG_OK        0
+#define SCROLL_LOG_ERR_SIZE -1  // band leaves the memory or holds no whole line
+
+#define SCROLL_LOG_LINES    16  // lines kept, the band shows the newest ones
+#define SCROLL_LOG_LINE_MAX 63
+#define SCROLL_LOG_PIECES    4
+
+typedef struct {
+    int16_t y;          // first screen row of the piece
+    int16_t mem_y;      // memory row it is written to
+    int16_t rows;
+} scroll_piece_t;
+
+typedef struct {
+    uint16_t top;           // first screen row of the band, VSCRDEF TFA
+    uint16_t height;        // whole lines, VSCRDEF VSA
+    uint16_t line_h;
+    uint16_t memory_rows;   // rows the controller scrolls through, TFA + VSA + BFA
+    uint16_t offset;        // rows the content moved up, below height
+    uint16_t head;          // slot the next line goes to
+    uint16_t count;         // lines kept
+    char line[SCROLL_LOG_LINES][SCROLL_LOG_LINE_MAX + 1];
+} scroll_log_t;
+
+/**
+ * Band of screen rows top .. top + height - 1, height is cut down to whole
+ * lines. The band must fit into the controller's memory_rows.
+ */
+int scroll_log_init(scroll_log_t *log, uint16_t top, uint16_t height, uint16_t line_h, uint16_t memory_rows);
+
+// New line at the bottom, the oldest one leaves once SCROLL_LOG_LINES are kept, text cut to SCROLL_LOG_LINE_MAX
+void scroll_log_add(scroll_log_t *log, const char *text, size_t len);
+
+// Text of the line back lines before the newest one, NULL when it is not kept
+const char *scroll_log_line(const scroll_log_t *log, uint16_t back);
+
+// Split screen rows y1 .. y2 by the memory rows they go to, returns the number of pieces
+int scroll_log_map(const scroll_log_t *log, int16_t y1, int16_t y2, scroll_piece_t piece[SCROLL_LOG_PIECES]);
+
+// Lines the band shows
+static inline uint16_t scroll_log_rows(const scroll_log_t *log)
+{
+    return log->height / log->line_h;
+}
+
+// Memory row shown at the top of the band, VSCRSADD
+static inline uint16_t scroll_log_start(const scroll_log_t *log)
+{
+    return log->top + log->offset;
+}
+
+// Rows below the band, VSCRDEF BFA
+static inline uint16_t scroll_log_bottom(const scroll_log_t *log)
+{
+    return log->memory_rows - log->top - log->height;
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+#include "t9.h"
+
+#define COMPLETION (1UL << 23)
+
+static uint32_t u24(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | (uint32_t)p[2] << 16;
+}
+
+int t9_open(t9_dict_t *dict, const uint8_t *data, size_t size)
+{
+    if(size < 10 || memcmp(data, "T9D1", 4) != 0){
+        return T9_ERR_FORMAT;
+    }
+    dict->data = data;
+    dict->size = size;
+    dict->root = data[4] | data[5] << 8 | (uint32_t)data[6] << 16 | (uint32_t)data[7] << 24;
+    if(dict->root + 2 > size){
+        return T9_ERR_FORMAT;
+    }
+    return T9_OK;
+}
+
+void t9_reset(t9_cursor_t *cur, const t9_dict_t *dict)
+{
+    cur->dict = dict;
+    cur->path[0] = dict->root;
+    cur->depth = 0;
+    cur->matched = 0;
+}
+
+bool t9_push(t9_cursor_t *cur, uint8_t key)
+{
+    if(cur->depth >= T9_MAX_DEPTH){
+        return false;
+    }
+    cur->depth++;
+    if(cur->matched != cur->depth - 1){
+        return false; // already off the dictionary
+    }
+    const uint8_t *node = &cur->dict->data[cur->path[cur->matched]];
+    const uint8_t *child = node + 2;
+    // children are sorted by key and there are at most a dozen
+    for(int i = 0; i < node[0] && child[0] <= key; i++, child += 4){
+        if(child[0] == key){
+            cur->path[++cur->matched] = u24(child + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void t9_pop(t9_cursor_t *cur)
+{
+    if(cur->depth == 0){
+        return;
+    }
+    cur->depth--;
+    if(cur->matched > cur->depth){
+        cur->matched = cur->depth;
+    }
+}
+
+int t9_count(const t9_cursor_t *cur)
+{
+    if(cur->depth == 0 || cur->matched != cur->depth){
+        return 0;
+    }
+    return cur->dict->data[cur->path[cur->matched] + 1];
+}
+
+size_t t9_candidate(const t9_cursor_t *cur, int index, char *out, size_t size)
+{
+    if(index < 0 || index >= t9_count(cur) || size == 0){
+        return 0;
+    }
+    const uint8_t *node = &cur->dict->data[cur->path[cur->matched]];
+    uint32_t entry = u24(node + 2 + node[0] * 4 + index * 3);
+    const uint8_t *word = &cur->dict->data[entry & ~COMPLETION];
+    size_t len = word[0];
+    if(entry & COMPLETION){
+        len = cur->depth; // only the letters typed so far
+    }
+    if(len >= size){
+        len = size - 1;
+    }
+    memcpy(out, word + 1, len);
+    out[len] = '\0';
+    return len;
+}
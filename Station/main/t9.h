@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Predictive text lookup.
+ *
+ * The dictionary is a trie keyed by keypad key, built by
+ * tools/t9dict/build_dict.py and linked into flash. It is read in place, so
+ * nothing is copied to RAM. Every node lists the words spelled by its key
+ * sequence, most frequent first. A node without words points at the most
+ * frequent longer word instead, and its first letters are offered while the
+ * user is still typing.
+ */
+
+#define T9_OK           0
+#define T9_ERR_FORMAT   -1
+
+#define T9_MAX_DEPTH    32
+#define T9_MAX_WORD     32
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    uint32_t root;
+} t9_dict_t;
+
+typedef struct {
+    const t9_dict_t *dict;
+    uint32_t path[T9_MAX_DEPTH + 1];    // node offsets, path[0] is the root
+    uint8_t depth;      // keys pressed
+    uint8_t matched;    // keys the dictionary could follow, <= depth
+} t9_cursor_t;
+
+int t9_open(t9_dict_t *dict, const uint8_t *data, size_t size);
+
+void t9_reset(t9_cursor_t *cur, const t9_dict_t *dict);
+
+// Add a key, returns false when no dictionary word starts with the keys so far
+bool t9_push(t9_cursor_t *cur, uint8_t key);
+
+// Remove the last key
+void t9_pop(t9_cursor_t *cur);
+
+// Number of candidates for the keys so far, 0 when nothing matches
+int t9_count(const t9_cursor_t *cur);
+
+/**
+ * Copy candidate index (0 = most frequent) into out as a C string.
+ * Returns its length, 0 when index is out of range.
+ */
+size_t t9_candidate(const t9_cursor_t *cur, int index, char *out, size_t size);
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include "ui_board.h"
+
+void ui_board_init(ui_board_t *board)
+{
+    memset(board, 0, sizeof(*board));
+}
+
+// Put text at offset from, cutting it at UI_TEXT_MAX
+static int put(ui_update_t *update, uint16_t from, const char *text)
+{
+    size_t len = strlen(text);
+    int result = UI_OK;
+    if(len > (size_t)(UI_TEXT_MAX - from)){
+        len = UI_TEXT_MAX - from;
+        result = UI_ERR_SIZE;
+    }
+    memcpy(&update->text[from], text, len);
+    update->len = from + len;
+    update->text[update->len] = '\0';
+    return result;
+}
+
+int ui_board_set(ui_board_t *board, uint8_t slot, const char *text)
+{
+    if(slot >= UI_SLOTS){
+        return UI_ERR_SLOT;
+    }
+    ui_update_t *update = &board->slot[slot];
+    update->op = UI_OP_SET;
+    board->dirty |= 1u << slot;
+    board->posted++;
+    return put(update, 0, text);
+}
+
+int ui_board_append(ui_board_t *board, uint8_t slot, const char *text)
+{
+    if(slot >= UI_SLOTS){
+        return UI_ERR_SLOT;
+    }
+    ui_update_t *update = &board->slot[slot];
+    // appending to a waiting text keeps its op, a waiting SET stays a SET
+    if(update->op == UI_OP_NONE){
+        update->op = UI_OP_APPEND;
+        update->len = 0;
+    }
+    board->dirty |= 1u << slot;
+    board->posted++;
+    return put(update, update->len, text);
+}
+
+int ui_board_status(ui_board_t *board, uint8_t slot, uint8_t code)
+{
+    char text[8];
+    snprintf(text, sizeof(text), "0x%02X", code);
+    return ui_board_set(board, slot, text);
+}
+
+int ui_board_take(ui_board_t *board, ui_update_t *out)
+{
+    if(board->dirty == 0){
+        return -1;
+    }
+    int slot = __builtin_ctz(board->dirty);
+    ui_update_t *update = &board->slot[slot];
+    out->op = update->op;
+    out->len = update->len;
+    memcpy(out->text, update->text, update->len + 1);
+    update->op = UI_OP_NONE;
+    update->len = 0;
+    board->dirty &= ~(1u << slot);
+    board->taken++;
+    return slot;
+}
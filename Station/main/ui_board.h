@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Label updates posted by other tasks, applied by the display task.
+ *
+ * One slot per label. A slot keeps only what the label has to show in the
+ * end: a new text replaces whatever was waiting, an appended text is added
+ * to it, so a burst of updates to one label costs a single lv_label_set_text
+ * and relayout when the display task gets to it. The board does no locking,
+ * callers hold one lock around every call.
+ */
+
+#define UI_OK            0
+#define UI_ERR_SLOT     -1
+#define UI_ERR_SIZE     -2  // text cut to UI_TEXT_MAX
+
+#define UI_SLOTS         8
+#define UI_TEXT_MAX      250
+
+typedef enum {
+    UI_OP_NONE,     // nothing waiting
+    UI_OP_SET,      // replace the label's text
+    UI_OP_APPEND,   // add to the label's text
+} ui_op_t;
+
+typedef struct {
+    uint8_t op;             // ui_op_t
+    uint16_t len;
+    char text[UI_TEXT_MAX + 1];
+} ui_update_t;
+
+typedef struct {
+    ui_update_t slot[UI_SLOTS];
+    uint32_t dirty;         // bit per slot with an update waiting
+    uint32_t posted;        // updates posted, for the coalescing ratio
+    uint32_t taken;         // updates handed to the display task
+} ui_board_t;
+
+void ui_board_init(ui_board_t *board);
+
+int ui_board_set(ui_board_t *board, uint8_t slot, const char *text);
+
+int ui_board_append(ui_board_t *board, uint8_t slot, const char *text);
+
+// Shows code as 0xNN, the way the error boxes report it
+int ui_board_status(ui_board_t *board, uint8_t slot, uint8_t code);
+
+/**
+ * Move the next waiting update out of the board, lowest slot first.
+ * Returns the slot, or -1 when nothing is waiting.
+ */
+int ui_board_take(ui_board_t *board, ui_update_t *out);
@@ -0,0 +1,108 @@
+#include <string.h>
+#include "frame_trace.h"
+
+static size_t put_varint(uint8_t *out, uint32_t v)
+{
+    size_t n = 0;
+    while(v >= 0x80){
+        out[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+// Returns the bytes used, 0 when in ends early, -1 when longer than max_bytes
+static int get_varint(const uint8_t *in, size_t len, size_t max_bytes, uint32_t *v)
+{
+    *v = 0;
+    for(size_t i = 0; i < max_bytes; i++){
+        if(i >= len){
+            return 0;
+        }
+        *v |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if(!(in[i] & 0x80)){
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+size_t trace_header(uint8_t *out)
+{
+    memcpy(out, TRACE_MAGIC, 4);
+    out[4] = TRACE_VERSION;
+    out[5] = out[6] = out[7] = 0;
+    return TRACE_HEADER_SIZE;
+}
+
+int trace_check_header(const uint8_t *in, size_t len)
+{
+    if(len < TRACE_HEADER_SIZE || memcmp(in, TRACE_MAGIC, 4) != 0 || in[4] != TRACE_VERSION){
+        return TRACE_ERR_FORMAT;
+    }
+    return TRACE_OK;
+}
+
+void trace_writer_init(trace_writer_t *w)
+{
+    w->last_us = 0;
+    w->started = false;
+}
+
+size_t trace_encode(trace_writer_t *w, uint8_t *out, uint8_t dir, uint8_t channel,
+                    uint64_t now_us, const uint8_t *data, uint16_t len)
+{
+    uint64_t delta = w->started && now_us > w->last_us ? now_us - w->last_us : 0;
+    if(delta > UINT32_MAX){
+        delta = UINT32_MAX; // over an hour of silence, exact gap does not matter
+    }
+    w->last_us = now_us;
+    w->started = true;
+
+    size_t n = 0;
+    out[n++] = TRACE_TAG | (dir & 1) << 2 | (channel & 3);
+    n += put_varint(&out[n], delta);
+    n += put_varint(&out[n], len);
+    memcpy(&out[n], data, len);
+    return n + len;
+}
+
+int trace_decode(const uint8_t *in, size_t len, trace_record_t *rec)
+{
+    uint32_t v;
+    int used;
+    size_t n = 1;
+
+    if(len == 0){
+        return TRACE_INCOMPLETE;
+    }
+    if((in[0] & 0xF8) != TRACE_TAG){
+        return TRACE_ERR_FORMAT;
+    }
+    rec->dir = (in[0] >> 2) & 1;
+    rec->channel = in[0] & 3;
+
+    used = get_varint(&in[n], len - n, 5, &v);
+    if(used <= 0){
+        return used;
+    }
+    rec->delta_us = v;
+    n += used;
+
+    used = get_varint(&in[n], len - n, 3, &v);
+    if(used <= 0){
+        return used;
+    }
+    if(v > UINT16_MAX){
+        return TRACE_ERR_FORMAT;
+    }
+    rec->len = v;
+    n += used;
+
+    if(len - n < rec->len){
+        return TRACE_INCOMPLETE;
+    }
+    rec->data = &in[n];
+    return n + rec->len;
+}
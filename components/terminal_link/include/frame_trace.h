@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Binary trace of the frames crossing the Station <-> AP link.
+ *
+ * A trace starts with an 8 byte header ("FTRC", version, 3 reserved bytes)
+ * followed by one record per complete message:
+ *
+ *   [0x80 | dir << 2 | channel][delta_us varint][len varint][payload]
+ *
+ * delta_us is the time since the previous record, varints are little endian
+ * base 128, so a typical sensor frame costs 3-4 bytes on top of its payload.
+ * Recorded on the Station and replayed by tools/trace_replay.
+ */
+
+#define TRACE_MAGIC         "FTRC"
+#define TRACE_VERSION       1
+#define TRACE_HEADER_SIZE   8
+#define TRACE_TAG           0x80
+#define TRACE_MAX_OVERHEAD  (1 + 5 + 3)  // tag, 32 bit delta, 16 bit length
+
+#define TRACE_DIR_TX        0   // Station -> AP
+#define TRACE_DIR_RX        1   // AP -> Station
+
+#define TRACE_OK            0
+#define TRACE_INCOMPLETE    0   // decode: need more bytes
+#define TRACE_ERR_FORMAT    -1
+
+typedef struct {
+    uint64_t last_us;
+    bool started;
+} trace_writer_t;
+
+typedef struct {
+    uint8_t dir;
+    uint8_t channel;
+    uint32_t delta_us;
+    uint16_t len;
+    const uint8_t *data;    // points into the decoded buffer
+} trace_record_t;
+
+// Writes the trace header into out (TRACE_HEADER_SIZE bytes)
+size_t trace_header(uint8_t *out);
+
+// Returns TRACE_OK when in starts with a header this code understands
+int trace_check_header(const uint8_t *in, size_t len);
+
+void trace_writer_init(trace_writer_t *w);
+
+/**
+ * Encode one record stamped at now_us into out, which must hold
+ * TRACE_MAX_OVERHEAD + len bytes. Returns the encoded size.
+ */
+size_t trace_encode(trace_writer_t *w, uint8_t *out, uint8_t dir, uint8_t channel,
+                    uint64_t now_us, const uint8_t *data, uint16_t len);
+
+/**
+ * Decode the record at the start of in.
+ * Returns the bytes it took, TRACE_INCOMPLETE or TRACE_ERR_FORMAT.
+ */
+int trace_decode(const uint8_t *in, size_t len, trace_record_t *rec);
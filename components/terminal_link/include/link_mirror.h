@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Remote mirror of the Station's display on MUX_CH_MIRROR.
+ *
+ * The Station encodes every area LVGL flushes, the AP hands the messages to a
+ * viewer connected on MIRROR_VIEWER_PORT, each behind a two byte length
+ * (low byte first), and the viewer applies them to its copy of the screen:
+ *
+ *   screen   [MIRROR_MSG_SCREEN][w lo][w hi][h lo][h hi]    clears the copy
+ *   area     [MIRROR_MSG_AREA][flags][x lo][x hi][y lo][y hi][w lo][w hi][rows][ops]
+ *   refresh  [MIRROR_MSG_REFRESH]     AP -> Station, a viewer wants the screen
+ *   stop     [MIRROR_MSG_STOP]        AP -> Station, no viewer left
+ *
+ * The ops of an area cover the rectangle x, y, w, rows in raster order, each
+ * [kind << 6 | n - 1] for 1 to 63 pixels or [kind << 6 | 63][n - 64] up to
+ * MIRROR_RUN_MAX:
+ *
+ *   SKIP  n pixels the viewer already has
+ *   FILL  n pixels of one colour, followed by the colour
+ *   UP    n pixels equal to the ones in the row above
+ *   RAW   n pixels, followed by them
+ *
+ * Pixels are RGB565 in the byte order LVGL hands them to the panel, high
+ * byte first with LV_COLOR_16_SWAP. MIRROR_FLAG_END marks the last message
+ * of a refresh, the viewer shows the picture then.
+ *
+ * Nothing of the previous frame is kept on the Station: the encoder keeps a
+ * hash of every MIRROR_SPAN pixel piece of every row as it was last sent and
+ * skips the pieces that hash the same. A message the caller could not take
+ * ends the area, the rows from it on forget their hashes and are collected
+ * in a dirty rectangle for the caller to redraw once there is room again.
+ */
+
+#define MIRROR_VIEWER_PORT  12346
+
+#define MIRROR_MSG_SCREEN   'S'
+#define MIRROR_MSG_AREA     'A'
+#define MIRROR_MSG_REFRESH  'R'
+#define MIRROR_MSG_STOP     'X'
+
+#define MIRROR_FLAG_END     0x01
+
+#define MIRROR_OP_SKIP      0
+#define MIRROR_OP_FILL      1
+#define MIRROR_OP_UP        2
+#define MIRROR_OP_RAW       3
+#define MIRROR_RUN_MAX      (64 + 255)
+
+#define MIRROR_MAX_WIDTH    320
+#define MIRROR_MAX_HEIGHT   240
+#define MIRROR_SPAN         32      // pixels of a row under one hash
+#define MIRROR_SPANS        ((MIRROR_MAX_WIDTH + MIRROR_SPAN - 1) / MIRROR_SPAN)
+#define MIRROR_AREA_HEADER  10
+#define MIRROR_MSG_MAX      480     // two of them fit a mux channel's queue
+
+#define MIRROR_OK           0
+#define MIRROR_ERR_SIZE     -1
+#define MIRROR_ERR_FULL     -2      // the caller did not take a message, see mirror_take_dirty
+#define MIRROR_ERR_FORMAT   -3
+
+typedef struct {
+    int16_t x1, y1, x2, y2;         // inclusive, like lv_area_t
+} mirror_rect_t;
+
+// Takes one message, false when there is no room for it
+typedef bool (*mirror_emit_cb)(void *ctx, const uint8_t *msg, size_t len);
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint32_t hash[MIRROR_MAX_HEIGHT][MIRROR_SPANS];   // 0: the viewer's copy is unknown
+    uint8_t msg[MIRROR_MSG_MAX];
+    mirror_rect_t dirty;
+    bool has_dirty;
+    uint32_t messages;
+    uint32_t bytes;                 // of the messages taken
+    uint32_t dropped;               // areas cut short
+} mirror_enc_t;
+
+// Viewer side copy of the screen
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t pixels[MIRROR_MAX_HEIGHT * MIRROR_MAX_WIDTH];   // wire byte order, row after row
+    uint32_t frames;                // MIRROR_FLAG_END seen
+} mirror_view_t;
+
+// Byte budget refilled at rate bytes per second up to burst
+typedef struct {
+    uint32_t rate;
+    uint32_t burst;
+    uint32_t tokens;
+    int64_t last_us;
+} mirror_budget_t;
+
+int mirror_enc_init(mirror_enc_t *enc, uint16_t width, uint16_t height);
+
+// Forget what the viewer has, the next areas go out whole
+void mirror_enc_reset(mirror_enc_t *enc);
+
+// MIRROR_MSG_SCREEN for the encoder's size, returns its length
+size_t mirror_screen_msg(const mirror_enc_t *enc, uint8_t *out);
+
+/**
+ * Encode the area x1, y1 .. x2, y2 (inclusive) flushed from pixels, stride
+ * pixels from one row to the next, and hand the messages to emit. last marks
+ * the area that ends a refresh. MIRROR_ERR_FULL when emit refused a message.
+ */
+int mirror_encode(mirror_enc_t *enc, int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                  const uint16_t *pixels, size_t stride, bool last, mirror_emit_cb emit, void *ctx);
+
+// Rectangle left out since the last call, false when there is none
+bool mirror_take_dirty(mirror_enc_t *enc, mirror_rect_t *rect);
+
+void mirror_view_init(mirror_view_t *view);
+
+// Apply one message, MIRROR_ERR_FORMAT for a truncated or out of bounds one
+int mirror_view_apply(mirror_view_t *view, const uint8_t *msg, size_t len);
+
+void mirror_budget_init(mirror_budget_t *budget, uint32_t rate, uint32_t burst, int64_t now_us);
+
+// Take bytes from the budget, false and nothing taken when it has fewer
+bool mirror_budget_take(mirror_budget_t *budget, size_t bytes, int64_t now_us);
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Logical channels over the single Station <-> AP TCP stream.
+ *
+ * Every message is cut into fragments of at most MUX_FRAGMENT_MAX bytes:
+ *
+ *   [0xA5][channel << 4 | flags][seq][len][payload]
+ *
+ * flags: MUX_FLAG_FIRST / MUX_FLAG_LAST mark the message boundaries, seq counts
+ * fragments per channel so a lost fragment drops the partial message instead
+ * of gluing two messages together.
+ *
+ * The sender picks fragments by weighted round-robin, lower channel number
+ * first within a round, so a long text frame can only hold a sensor frame back
+ * by a few fragments instead of the whole message.
+ */
+
+#define MUX_SYNC            0xA5
+#define MUX_HEADER_SIZE     4
+#define MUX_FRAGMENT_MAX    48
+#define MUX_MESSAGE_MAX     1024
+#define MUX_QUEUE_SIZE      1024    // bytes of queued messages per channel
+#define MUX_CHANNELS        4
+
+#define MUX_FLAG_FIRST      0x01
+#define MUX_FLAG_LAST       0x02
+
+// Channels, lower number = served first in a round
+#define MUX_CH_CONTROL      0   // sensor values, short and latency sensitive
+#define MUX_CH_TEXT         1   // text messages
+#define MUX_CH_BULK         2   // outbox replay and other background traffic
+#define MUX_CH_MIRROR       3   // remote display mirror, see link_mirror.h
+
+typedef struct {
+    uint8_t queue[MUX_QUEUE_SIZE];  // ring of [len lo][len hi][bytes]
+    uint16_t head;
+    uint16_t tail;
+    uint16_t used;
+    uint16_t offset;    // bytes of the front message already sent
+    uint16_t messages;
+    uint8_t weight;
+    uint8_t credit;
+    uint8_t seq;
+    uint32_t completed; // messages whose last fragment was committed
+} mux_channel_t;
+
+typedef struct {
+    mux_channel_t ch[MUX_CHANNELS];
+    int8_t prepared;    // channel of the fragment from mux_tx_prepare, -1 when none
+    uint8_t prepared_len;
+} mux_tx_t;
+
+typedef void (*mux_deliver_cb)(void *ctx, uint8_t channel, const uint8_t *msg, size_t len);
+
+typedef struct {
+    uint8_t header[MUX_HEADER_SIZE];
+    uint8_t header_got;
+    uint8_t payload_got;
+    bool discard;       // current fragment does not continue a message
+    struct {
+        uint8_t msg[MUX_MESSAGE_MAX];
+        uint16_t len;
+        uint8_t seq;
+        bool active;
+    } ch[MUX_CHANNELS];
+    mux_deliver_cb deliver;
+    void *ctx;
+    uint32_t errors;    // dropped partial messages and resyncs
+} mux_rx_t;
+
+// Default weights: control 4, text 2, bulk 1, mirror 1
+void mux_tx_init(mux_tx_t *tx);
+
+void mux_tx_set_weight(mux_tx_t *tx, uint8_t channel, uint8_t weight);
+
+// Queue a message, false when it does not fit
+bool mux_tx_push(mux_tx_t *tx, uint8_t channel, const void *msg, size_t len);
+
+/**
+ * Produce the next fragment to put on the wire.
+ * Returns its size (at most MUX_HEADER_SIZE + MUX_FRAGMENT_MAX) or 0 when idle.
+ */
+size_t mux_tx_next(mux_tx_t *tx, uint8_t *out);
+
+/**
+ * Like mux_tx_next, but the fragment stays queued until mux_tx_commit, so a
+ * message is only consumed once its last fragment is on the wire. After a
+ * failed write, mux_tx_rewind sends the message again from its first fragment.
+ */
+size_t mux_tx_prepare(mux_tx_t *tx, uint8_t *out);
+
+/**
+ * The prepared fragment was written. Returns its channel when it was the last
+ * fragment of a message, -1 otherwise (or when nothing was prepared).
+ */
+int mux_tx_commit(mux_tx_t *tx);
+
+// Messages whose last fragment was committed on a channel, wraps around
+static inline uint32_t mux_tx_completed(const mux_tx_t *tx, uint8_t channel)
+{
+    return tx->ch[channel].completed;
+}
+
+/**
+ * Copy up to cap bytes of the oldest message waiting on a channel.
+ * Returns its full length, 0 when the channel is empty.
+ */
+size_t mux_tx_front(const mux_tx_t *tx, uint8_t channel, uint8_t *out, size_t cap);
+
+// Remove the oldest message of a channel, sent in part or not at all
+bool mux_tx_drop(mux_tx_t *tx, uint8_t channel);
+
+// Messages (including a partially sent one) waiting on a channel
+static inline uint16_t mux_tx_queued(const mux_tx_t *tx, uint8_t channel)
+{
+    return tx->ch[channel].messages;
+}
+
+// Restart partially sent messages from their first fragment, used after a reconnect or a failed write
+void mux_tx_rewind(mux_tx_t *tx);
+
+void mux_rx_init(mux_rx_t *rx, mux_deliver_cb deliver, void *ctx);
+
+// Feed bytes as they come from the socket, complete messages go to deliver()
+void mux_rx_feed(mux_rx_t *rx, const uint8_t *data, size_t len);
+
+// Forget partial messages, used when a new connection starts
+void mux_rx_reset(mux_rx_t *rx);
+
+// Channel a terminal frame ([0xAA][0x55][type][len]...) travels on
+uint8_t mux_channel_for_frame(const uint8_t *frame, size_t len);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Request/response frames between the Station and the UART device behind the AP.
+ *
+ * Both use the usual frame layout [0xAA][0x55][type][len][payload][crc][xor],
+ * len counting the whole frame:
+ *
+ *   request  '3': [id hi][id lo][target frame type][arguments]
+ *   response '4': [id hi][id lo][status][value]
+ *
+ * The responder copies the correlation id, so any number of requests can be
+ * in flight and answers may come back in any order. Outstanding requests live
+ * in a small open addressing table keyed by id; a request that gets no answer
+ * before its deadline completes with RPC_STATUS_TIMEOUT.
+ */
+
+#define RPC_FRAME_REQUEST   '3'
+#define RPC_FRAME_RESPONSE  '4'
+
+#define RPC_SLOTS           64      // power of two, kept at most half full
+#define RPC_MAX_OUTSTANDING (RPC_SLOTS / 2)
+#define RPC_HEADER_SIZE     4
+#define RPC_FRAME_OVERHEAD  (RPC_HEADER_SIZE + 3 + 2)  // frame header, id + code, crc + xor
+#define RPC_VALUE_MAX       (255 - RPC_FRAME_OVERHEAD)
+
+#define RPC_OK              0
+#define RPC_ERR_FULL        -1
+#define RPC_ERR_FORMAT      -2
+
+// Status passed to rpc_done_cb besides the status byte of a response
+#define RPC_STATUS_TIMEOUT  -1
+#define RPC_STATUS_CANCELLED -2
+
+typedef void (*rpc_done_cb)(void *ctx, uint16_t id, int status, const uint8_t *value, size_t len);
+
+typedef struct {
+    int64_t deadline_us;
+    rpc_done_cb done;
+    void *ctx;
+    uint16_t id;
+    bool used;
+} rpc_slot_t;
+
+typedef struct {
+    rpc_slot_t slot[RPC_SLOTS];
+    uint16_t next_id;
+    uint16_t outstanding;
+    uint32_t timeouts;
+    uint32_t late;          // responses for ids that already timed out
+} rpc_table_t;
+
+// A request taken out of the table whose callback has not run yet
+typedef struct {
+    rpc_done_cb done;
+    void *ctx;
+    uint16_t id;
+} rpc_finished_t;
+
+typedef struct {
+    uint8_t type;           // RPC_FRAME_REQUEST or RPC_FRAME_RESPONSE
+    uint16_t id;
+    uint8_t code;           // target of a request, status of a response
+    const uint8_t *data;    // arguments or value, points into the frame
+    size_t len;
+} rpc_msg_t;
+
+void rpc_init(rpc_table_t *rpc);
+
+/**
+ * Track a new request and hand out its correlation id.
+ * Returns RPC_OK or RPC_ERR_FULL when RPC_MAX_OUTSTANDING are in flight.
+ */
+int rpc_begin(rpc_table_t *rpc, int64_t now_us, uint32_t timeout_ms,
+              rpc_done_cb done, void *ctx, uint16_t *id);
+
+/**
+ * Finish the request with this id and call its done callback.
+ * Returns false for unknown ids (already timed out or never sent).
+ */
+bool rpc_complete(rpc_table_t *rpc, uint16_t id, int status, const uint8_t *value, size_t len);
+
+// Drop a request that could not be sent, done gets RPC_STATUS_CANCELLED
+void rpc_cancel(rpc_table_t *rpc, uint16_t id);
+
+// Time out every request past its deadline, returns how many
+int rpc_expire(rpc_table_t *rpc, int64_t now_us);
+
+/**
+ * rpc_complete, rpc_cancel and rpc_expire call done while the caller still
+ * holds whatever guards the table, so done must not start a request. With a
+ * lock around the table, take the requests out under it instead and call
+ * rpc_finish after releasing it.
+ */
+bool rpc_take(rpc_table_t *rpc, uint16_t id, rpc_finished_t *out);
+
+// Take every request past its deadline, counted as timeouts, returns how many
+int rpc_take_expired(rpc_table_t *rpc, int64_t now_us, rpc_finished_t out[RPC_MAX_OUTSTANDING]);
+
+static inline void rpc_finish(const rpc_finished_t *f, int status, const uint8_t *value, size_t len)
+{
+    if(f->done){
+        f->done(f->ctx, f->id, status, value, len);
+    }
+}
+
+// Build frames into out (at least RPC_FRAME_OVERHEAD + len bytes), return the frame size
+size_t rpc_encode_request(uint8_t *out, uint16_t id, uint8_t target, const uint8_t *args, size_t len);
+size_t rpc_encode_response(uint8_t *out, uint16_t id, uint8_t status, const uint8_t *value, size_t len);
+
+// Check a received request or response frame, RPC_OK or RPC_ERR_FORMAT
+int rpc_parse(const uint8_t *frame, size_t len, rpc_msg_t *msg);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ssl_ticket.h"
+
+/*
+ * Optional TLS 1.2 layer for the Station <-> AP socket.
+ *
+ * Both sides authenticate with a pre-shared key. ECDHE-PSK is preferred so a
+ * leaked key does not expose recorded traffic, plain PSK is the fallback. The
+ * AP hands out session tickets and the Station keeps the last session, so a
+ * reconnect after a Wi-Fi drop is an abbreviated handshake without any ECDHE.
+ */
+
+// Set to 0 in both projects to build without TLS, plain TCP whatever is in NVS
+#ifndef LINK_USE_TLS
+#define LINK_USE_TLS 1
+#endif
+
+#define LINK_TLS_PSK_MAX        32
+#define LINK_TLS_IDENTITY_MAX   32
+#define LINK_TLS_TICKET_LIFETIME (24 * 60 * 60)
+
+/*
+ * There is no factory key: each Station/AP pair gets its own key in NVS. A
+ * unit without one links over plain TCP, so a freshly flashed pair works
+ * unsecured and a pair where only one side has a key does not link. Flash
+ * the same key to both with nvs_partition_gen.py from a CSV like
+ *
+ *   key,type,encoding,value
+ *   link,namespace,,
+ *   psk,data,hex2bin,<32 random bytes as hex>
+ *   psk_id,data,string,terminal
+ */
+#define LINK_TLS_NVS_NAMESPACE  "link"
+#define LINK_TLS_DEFAULT_IDENTITY "terminal"    // host tools, unless given one
+
+typedef struct {
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_ticket_context ticket;  // server only
+    mbedtls_ssl_session session;        // client only, last negotiated session
+    bool has_session;
+    bool server;
+    int fd;
+    int64_t handshake_us;               // duration of the last handshake
+} link_tls_t;
+
+/**
+ * Prepare a client (Station) or server (AP) context. The key is copied by
+ * mbedTLS, identity is a printable name both sides agree on.
+ * Returns 0 or an mbedTLS error code.
+ */
+int link_tls_init(link_tls_t *tls, bool server, const uint8_t *psk, size_t psk_len, const char *identity);
+
+/**
+ * Run the handshake on a connected socket. The client offers the session saved
+ * by the previous successful handshake.
+ */
+int link_tls_handshake(link_tls_t *tls, int fd);
+
+// Same semantics as read()/write(): bytes transferred, 0 on close, <0 on error
+int link_tls_read(link_tls_t *tls, void *buf, size_t len);
+int link_tls_write(link_tls_t *tls, const void *buf, size_t len);
+
+// Bytes already decrypted and waiting, read() will not block when > 0
+size_t link_tls_pending(link_tls_t *tls);
+
+// Send close_notify and get ready for the next connection, the session is kept
+void link_tls_close(link_tls_t *tls);
+
+void link_tls_free(link_tls_t *tls);
+
+// Key written as hex, as in the provisioning CSV. Returns its length, -1 when malformed
+int link_tls_parse_key(const char *hex, uint8_t psk[LINK_TLS_PSK_MAX]);
+
+#ifdef ESP_PLATFORM
+/**
+ * Read the key and identity provisioned in NVS.
+ * Returns false when there is none, the link must then stay down.
+ */
+bool link_tls_load_key(uint8_t psk[LINK_TLS_PSK_MAX], size_t *psk_len, char identity[LINK_TLS_IDENTITY_MAX]);
+#endif
@@ -0,0 +1,395 @@
+#include <string.h>
+#include "link_mirror.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef struct {
+    uint8_t *out;
+    size_t used;
+    size_t room;
+} writer_t;
+
+// Message being filled, a rectangle of whole rows or a piece of one row
+typedef struct {
+    int16_t x, y, w;
+    uint8_t rows;
+    bool open;
+} part_t;
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+int mirror_enc_init(mirror_enc_t *enc, uint16_t width, uint16_t height)
+{
+    memset(enc, 0, sizeof(*enc));
+    if(width == 0 || height == 0 || width > MIRROR_MAX_WIDTH || height > MIRROR_MAX_HEIGHT){
+        return MIRROR_ERR_SIZE;
+    }
+    enc->width = width;
+    enc->height = height;
+    return MIRROR_OK;
+}
+
+void mirror_enc_reset(mirror_enc_t *enc)
+{
+    memset(enc->hash, 0, sizeof(enc->hash));
+    enc->has_dirty = false;
+}
+
+size_t mirror_screen_msg(const mirror_enc_t *enc, uint8_t *out)
+{
+    out[0] = MIRROR_MSG_SCREEN;
+    put16(&out[1], enc->width);
+    put16(&out[3], enc->height);
+    return 5;
+}
+
+// FNV-1a over the pixels, seeded with the piece's place so a shorter piece never matches a longer one
+static uint32_t piece_hash(const uint16_t *px, int n, int x)
+{
+    uint32_t h = 2166136261u ^ (uint32_t)(x << 16 | n);
+    for(int i = 0; i < n; i++){
+        h = (h ^ px[i]) * 16777619u;
+    }
+    return h != 0 ? h : 1;
+}
+
+// Marks the pieces of row y the viewer already has, false when that is all of them
+static bool hash_row(mirror_enc_t *enc, int16_t y, int16_t x1, int16_t x2, const uint16_t *row, uint8_t *skip)
+{
+    bool changed = false;
+    for(int s = x1 / MIRROR_SPAN; s <= x2 / MIRROR_SPAN; s++){
+        int a = MAX(x1, s * MIRROR_SPAN);
+        int b = MIN(x2 + 1, (s + 1) * MIRROR_SPAN);
+        uint32_t h = piece_hash(&row[a - x1], b - a, a);
+        skip[s] = h == enc->hash[y][s];
+        if(!skip[s]){
+            enc->hash[y][s] = h;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Op header for n pixels, false when it does not fit with extra bytes behind it
+static bool op(writer_t *w, int kind, int n, size_t extra)
+{
+    if(w->used + (n > 63 ? 2 : 1) + extra > w->room){
+        return false;
+    }
+    if(n > 63){
+        w->out[w->used++] = kind << 6 | 63;
+        w->out[w->used++] = n - 64;
+    }
+    else{
+        w->out[w->used++] = kind << 6 | (n - 1);
+    }
+    return true;
+}
+
+// First x from x on that lies in a skipped piece, end when there is none before it
+static int changed_until(const uint8_t *skip, int x, int end)
+{
+    while(x < end && !skip[x / MIRROR_SPAN]){
+        x = (x / MIRROR_SPAN + 1) * MIRROR_SPAN;
+    }
+    return MIN(x, end);
+}
+
+/**
+ * Ops for the pixels from .. to - 1 of a row starting at x1, above is the
+ * row before it in the same area or NULL. Stops at an op that does not fit,
+ * returns how far it got.
+ */
+static int encode_row(writer_t *w, const uint16_t *row, const uint16_t *above, int x1, const uint8_t *skip, int from, int to)
+{
+    int x = from;
+    while(x < to){
+        const uint16_t *p = &row[x - x1];
+        int left = MIN(to - x, MIRROR_RUN_MAX);
+        int n = 1;
+        if(skip[x / MIRROR_SPAN]){
+            while(n < left && skip[(x + n) / MIRROR_SPAN]){
+                n++;
+            }
+            if(!op(w, MIRROR_OP_SKIP, n, 0)){
+                break;
+            }
+            x += n;
+            continue;
+        }
+        left = MIN(left, changed_until(skip, x, to) - x);
+        const uint16_t *a = above != NULL ? &above[x - x1] : NULL;
+        int r = 1, u = 0;
+        while(r < left && p[r] == p[0]){
+            r++;
+        }
+        while(a != NULL && u < left && p[u] == a[u]){
+            u++;
+        }
+        if(u >= 2 && u >= r){
+            if(!op(w, MIRROR_OP_UP, u, 0)){
+                break;
+            }
+            x += u;
+            continue;
+        }
+        if(r >= 2){
+            if(!op(w, MIRROR_OP_FILL, r, 2)){
+                break;
+            }
+            memcpy(&w->out[w->used], p, 2);
+            w->used += 2;
+            x += r;
+            continue;
+        }
+        // literal pixels until a run worth its own op starts
+        while(n < left
+              && !(n + 2 < left && p[n] == p[n + 1] && p[n] == p[n + 2])
+              && !(a != NULL && n + 1 < left && p[n] == a[n] && p[n + 1] == a[n + 1])){
+            n++;
+        }
+        size_t room = w->room - w->used;
+        if(room < (n > 63 ? 2 : 1) + 2 * (size_t)n){
+            n = room > 2 ? (int)(room - 1) / 2 : 0;
+            n = n > 63 ? (int)(room - 2) / 2 : n;
+            if(n < 1){
+                break;
+            }
+        }
+        op(w, MIRROR_OP_RAW, n, 2 * n);
+        memcpy(&w->out[w->used], p, 2 * n);
+        w->used += 2 * n;
+        x += n;
+    }
+    return x;
+}
+
+static void start(part_t *part, writer_t *w, int16_t x, int16_t y, int16_t width)
+{
+    part->x = x;
+    part->y = y;
+    part->w = width;
+    part->rows = 0;
+    part->open = true;
+    w->used = MIRROR_AREA_HEADER;
+}
+
+static bool finish(mirror_enc_t *enc, part_t *part, writer_t *w, uint8_t flags, mirror_emit_cb emit, void *ctx)
+{
+    w->out[0] = MIRROR_MSG_AREA;
+    w->out[1] = flags;
+    put16(&w->out[2], part->x);
+    put16(&w->out[4], part->y);
+    put16(&w->out[6], part->w);
+    w->out[8] = part->rows;
+    w->out[9] = 0;
+    part->open = false;
+    if(!emit(ctx, w->out, w->used)){
+        return false;
+    }
+    enc->messages++;
+    enc->bytes += w->used;
+    return true;
+}
+
+// Rows y1 .. y2 did not go out, the viewer's copy of them is unknown
+static int drop(mirror_enc_t *enc, int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+{
+    for(int y = y1; y <= y2; y++){
+        for(int s = x1 / MIRROR_SPAN; s <= x2 / MIRROR_SPAN; s++){
+            enc->hash[y][s] = 0;
+        }
+    }
+    mirror_rect_t *d = &enc->dirty;
+    if(enc->has_dirty){
+        d->x1 = MIN(d->x1, x1);
+        d->y1 = MIN(d->y1, y1);
+        d->x2 = MAX(d->x2, x2);
+        d->y2 = MAX(d->y2, y2);
+    }
+    else{
+        *d = (mirror_rect_t){x1, y1, x2, y2};
+        enc->has_dirty = true;
+    }
+    enc->dropped++;
+    return MIRROR_ERR_FULL;
+}
+
+int mirror_encode(mirror_enc_t *enc, int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                  const uint16_t *pixels, size_t stride, bool last, mirror_emit_cb emit, void *ctx)
+{
+    if(x1 < 0 || y1 < 0 || x2 >= enc->width || y2 >= enc->height || x1 > x2 || y1 > y2){
+        return MIRROR_ERR_SIZE;
+    }
+    writer_t w = { .out = enc->msg, .room = MIRROR_MSG_MAX };
+    part_t part = { .open = false };
+    uint8_t skip[MIRROR_SPANS];
+    for(int16_t y = y1; y <= y2; y++){
+        const uint16_t *row = pixels + (size_t)(y - y1) * stride;
+        const uint16_t *above = y > y1 ? row - stride : NULL;
+        if(!hash_row(enc, y, x1, x2, row, skip)){
+            // unchanged rows are left out, a message holds rows that follow each other
+            if(part.open && !finish(enc, &part, &w, 0, emit, ctx)){
+                return drop(enc, x1, part.y, x2, y2);
+            }
+            continue;
+        }
+        int16_t x = x1;
+        while(x <= x2){
+            if(!part.open){
+                start(&part, &w, x, y, x2 + 1 - x);
+            }
+            size_t before = w.used;
+            int16_t done = encode_row(&w, row, above, x1, skip, x, x2 + 1);
+            if(done == x2 + 1){
+                part.rows++;
+                x = done;
+                if((part.x != x1 || part.rows == UINT8_MAX) && !finish(enc, &part, &w, 0, emit, ctx)){
+                    return drop(enc, x1, part.y, x2, y2);
+                }
+                continue;
+            }
+            if(part.rows > 0){
+                // row goes into a message of its own
+                w.used = before;
+            }
+            else{
+                // does not fit one message at all, send the part that did
+                part.w = done - x;
+                part.rows = 1;
+                x = done;
+            }
+            if(!finish(enc, &part, &w, 0, emit, ctx)){
+                return drop(enc, x1, part.y, x2, y2);
+            }
+        }
+    }
+    if(last && !part.open){
+        start(&part, &w, 0, 0, 0);
+    }
+    if(part.open && !finish(enc, &part, &w, last ? MIRROR_FLAG_END : 0, emit, ctx)){
+        return part.rows > 0 ? drop(enc, x1, part.y, x2, y2) : MIRROR_ERR_FULL;
+    }
+    return MIRROR_OK;
+}
+
+bool mirror_take_dirty(mirror_enc_t *enc, mirror_rect_t *rect)
+{
+    if(!enc->has_dirty){
+        return false;
+    }
+    *rect = enc->dirty;
+    enc->has_dirty = false;
+    return true;
+}
+
+void mirror_view_init(mirror_view_t *view)
+{
+    memset(view, 0, sizeof(*view));
+}
+
+static int apply_area(mirror_view_t *view, const uint8_t *msg, size_t len)
+{
+    if(len < MIRROR_AREA_HEADER){
+        return MIRROR_ERR_FORMAT;
+    }
+    int x = get16(&msg[2]), y = get16(&msg[4]), w = get16(&msg[6]), rows = msg[8];
+    if(x + w > view->width || y + rows > view->height){
+        return MIRROR_ERR_FORMAT;
+    }
+    int total = w * rows, i = 0;
+    size_t at = MIRROR_AREA_HEADER;
+    while(at < len){
+        int kind = msg[at] >> 6, n = (msg[at] & 63) + 1;
+        at++;
+        if(n == 64){
+            if(at >= len){
+                return MIRROR_ERR_FORMAT;
+            }
+            n = 64 + msg[at++];
+        }
+        size_t data = kind == MIRROR_OP_FILL ? 2 : kind == MIRROR_OP_RAW ? 2 * (size_t)n : 0;
+        if(i + n > total || at + data > len){
+            return MIRROR_ERR_FORMAT;
+        }
+        for(int k = 0; k < n; k++, i++){
+            uint16_t *px = &view->pixels[(y + i / w) * MIRROR_MAX_WIDTH + x + i % w];
+            switch(kind){
+                case MIRROR_OP_FILL:
+                    memcpy(px, &msg[at], 2);
+                    break;
+                case MIRROR_OP_UP:
+                    if(y + i / w == 0){
+                        return MIRROR_ERR_FORMAT;
+                    }
+                    *px = px[-MIRROR_MAX_WIDTH];
+                    break;
+                case MIRROR_OP_RAW:
+                    memcpy(px, &msg[at + 2 * k], 2);
+                    break;
+            }
+        }
+        at += data;
+    }
+    if(msg[1] & MIRROR_FLAG_END){
+        view->frames++;
+    }
+    return MIRROR_OK;
+}
+
+int mirror_view_apply(mirror_view_t *view, const uint8_t *msg, size_t len)
+{
+    if(len == 0){
+        return MIRROR_ERR_FORMAT;
+    }
+    switch(msg[0]){
+        case MIRROR_MSG_SCREEN:
+            if(len < 5 || get16(&msg[1]) > MIRROR_MAX_WIDTH || get16(&msg[3]) > MIRROR_MAX_HEIGHT){
+                return MIRROR_ERR_FORMAT;
+            }
+            view->width = get16(&msg[1]);
+            view->height = get16(&msg[3]);
+            memset(view->pixels, 0, sizeof(view->pixels));
+            return MIRROR_OK;
+        case MIRROR_MSG_AREA:
+            return apply_area(view, msg, len);
+        case MIRROR_MSG_REFRESH:
+        case MIRROR_MSG_STOP:
+            return MIRROR_OK;
+        default:
+            return MIRROR_ERR_FORMAT;
+    }
+}
+
+void mirror_budget_init(mirror_budget_t *budget, uint32_t rate, uint32_t burst, int64_t now_us)
+{
+    budget->rate = rate;
+    // a message larger than the burst could never be taken
+    budget->burst = MAX(burst, MIRROR_MSG_MAX);
+    budget->tokens = budget->burst;
+    budget->last_us = now_us;
+}
+
+bool mirror_budget_take(mirror_budget_t *budget, size_t bytes, int64_t now_us)
+{
+    uint64_t earned = (uint64_t)(now_us - budget->last_us) * budget->rate / 1000000;
+    if(earned > 0){
+        budget->tokens = MIN(budget->burst, budget->tokens + earned);
+        budget->last_us = now_us;
+    }
+    if(bytes > budget->tokens){
+        return false;
+    }
+    budget->tokens -= bytes;
+    return true;
+}
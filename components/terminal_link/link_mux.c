@@ -0,0 +1,299 @@
+#include <string.h>
+#include "link_mux.h"
+
+static const uint8_t default_weight[MUX_CHANNELS] = {4, 2, 1, 1};
+
+static void ring_write(mux_channel_t *ch, const uint8_t *src, size_t len)
+{
+    for(size_t i = 0; i < len; i++){
+        ch->queue[ch->tail] = src[i];
+        ch->tail = (ch->tail + 1) % MUX_QUEUE_SIZE;
+    }
+    ch->used += len;
+}
+
+static void ring_read(const mux_channel_t *ch, uint16_t at, uint8_t *dst, size_t len)
+{
+    uint16_t pos = (ch->head + at) % MUX_QUEUE_SIZE;
+    for(size_t i = 0; i < len; i++){
+        dst[i] = ch->queue[pos];
+        pos = (pos + 1) % MUX_QUEUE_SIZE;
+    }
+}
+
+void mux_tx_init(mux_tx_t *tx)
+{
+    memset(tx, 0, sizeof(*tx));
+    for(int c = 0; c < MUX_CHANNELS; c++){
+        tx->ch[c].weight = default_weight[c];
+        tx->ch[c].credit = default_weight[c];
+    }
+    tx->prepared = -1;
+}
+
+void mux_tx_set_weight(mux_tx_t *tx, uint8_t channel, uint8_t weight)
+{
+    if(channel < MUX_CHANNELS){
+        tx->ch[channel].weight = weight > 0 ? weight : 1;
+    }
+}
+
+void mux_tx_rewind(mux_tx_t *tx)
+{
+    for(int c = 0; c < MUX_CHANNELS; c++){
+        tx->ch[c].offset = 0;
+        tx->ch[c].credit = tx->ch[c].weight;
+    }
+    tx->prepared = -1;
+}
+
+bool mux_tx_push(mux_tx_t *tx, uint8_t channel, const void *msg, size_t len)
+{
+    if(channel >= MUX_CHANNELS || len == 0 || len > MUX_MESSAGE_MAX){
+        return false;
+    }
+    mux_channel_t *ch = &tx->ch[channel];
+    if(ch->used + 2 + len > MUX_QUEUE_SIZE){
+        return false;
+    }
+    uint8_t prefix[2] = {len & 0xFF, len >> 8};
+    ring_write(ch, prefix, 2);
+    ring_write(ch, msg, len);
+    ch->messages++;
+    return true;
+}
+
+static uint16_t front_len(const mux_channel_t *ch)
+{
+    uint8_t prefix[2];
+    ring_read(ch, 0, prefix, 2);
+    return prefix[0] | (prefix[1] << 8);
+}
+
+// Build the next fragment of the channel's front message, nothing is consumed yet
+static size_t build(const mux_channel_t *ch, uint8_t channel, uint8_t *out)
+{
+    uint16_t len = front_len(ch);
+    uint16_t n = len - ch->offset;
+    if(n > MUX_FRAGMENT_MAX){
+        n = MUX_FRAGMENT_MAX;
+    }
+
+    uint8_t flags = 0;
+    if(ch->offset == 0){
+        flags |= MUX_FLAG_FIRST;
+    }
+    if(ch->offset + n == len){
+        flags |= MUX_FLAG_LAST;
+    }
+    out[0] = MUX_SYNC;
+    out[1] = (channel << 4) | flags;
+    out[2] = ch->seq;
+    out[3] = n;
+    ring_read(ch, 2 + ch->offset, &out[MUX_HEADER_SIZE], n);
+    return MUX_HEADER_SIZE + n;
+}
+
+static void remove_front(mux_channel_t *ch)
+{
+    uint16_t len = front_len(ch);
+    ch->head = (ch->head + 2 + len) % MUX_QUEUE_SIZE;
+    ch->used -= 2 + len;
+    ch->offset = 0;
+    ch->messages--;
+}
+
+size_t mux_tx_prepare(mux_tx_t *tx, uint8_t *out)
+{
+    for(int round = 0; round < 2; round++){
+        for(int c = 0; c < MUX_CHANNELS; c++){
+            if(tx->ch[c].messages > 0 && tx->ch[c].credit > 0){
+                size_t n = build(&tx->ch[c], c, out);
+                tx->prepared = c;
+                tx->prepared_len = n - MUX_HEADER_SIZE;
+                return n;
+            }
+        }
+        // everyone with data used up their share, start a new round
+        bool waiting = false;
+        for(int c = 0; c < MUX_CHANNELS; c++){
+            tx->ch[c].credit = tx->ch[c].weight;
+            waiting |= tx->ch[c].messages > 0;
+        }
+        if(!waiting){
+            break;
+        }
+    }
+    tx->prepared = -1;
+    return 0;
+}
+
+int mux_tx_commit(mux_tx_t *tx)
+{
+    if(tx->prepared < 0){
+        return -1;
+    }
+    int channel = tx->prepared;
+    mux_channel_t *ch = &tx->ch[channel];
+    tx->prepared = -1;
+    ch->seq++;
+    ch->credit--;
+    ch->offset += tx->prepared_len;
+    if(ch->offset < front_len(ch)){
+        return -1;
+    }
+    remove_front(ch);
+    ch->completed++;
+    return channel;
+}
+
+size_t mux_tx_next(mux_tx_t *tx, uint8_t *out)
+{
+    size_t n = mux_tx_prepare(tx, out);
+    if(n > 0){
+        mux_tx_commit(tx);
+    }
+    return n;
+}
+
+size_t mux_tx_front(const mux_tx_t *tx, uint8_t channel, uint8_t *out, size_t cap)
+{
+    if(channel >= MUX_CHANNELS || tx->ch[channel].messages == 0){
+        return 0;
+    }
+    uint16_t len = front_len(&tx->ch[channel]);
+    ring_read(&tx->ch[channel], 2, out, len < cap ? len : cap);
+    return len;
+}
+
+bool mux_tx_drop(mux_tx_t *tx, uint8_t channel)
+{
+    if(channel >= MUX_CHANNELS || tx->ch[channel].messages == 0){
+        return false;
+    }
+    remove_front(&tx->ch[channel]);
+    tx->prepared = -1;
+    return true;
+}
+
+void mux_rx_init(mux_rx_t *rx, mux_deliver_cb deliver, void *ctx)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->deliver = deliver;
+    rx->ctx = ctx;
+}
+
+void mux_rx_reset(mux_rx_t *rx)
+{
+    rx->header_got = 0;
+    rx->payload_got = 0;
+    for(int c = 0; c < MUX_CHANNELS; c++){
+        rx->ch[c].active = false;
+        rx->ch[c].len = 0;
+    }
+}
+
+// Header is complete, decide where the payload goes
+static bool start_fragment(mux_rx_t *rx)
+{
+    uint8_t channel = rx->header[1] >> 4;
+    uint8_t flags = rx->header[1] & 0x0F;
+    uint8_t seq = rx->header[2];
+    uint8_t len = rx->header[3];
+
+    if(channel >= MUX_CHANNELS || len == 0 || len > MUX_FRAGMENT_MAX){
+        return false;
+    }
+    rx->discard = false;
+    if(flags & MUX_FLAG_FIRST){
+        if(rx->ch[channel].active){
+            rx->errors++; // previous message never finished
+        }
+        rx->ch[channel].active = true;
+        rx->ch[channel].len = 0;
+    }
+    else if(!rx->ch[channel].active || rx->ch[channel].seq != seq){
+        rx->errors++;
+        rx->ch[channel].active = false;
+        rx->discard = true;
+    }
+    if(!rx->discard && rx->ch[channel].len + len > MUX_MESSAGE_MAX){
+        rx->errors++;
+        rx->ch[channel].active = false;
+        rx->discard = true;
+    }
+    return true;
+}
+
+static void end_fragment(mux_rx_t *rx)
+{
+    uint8_t channel = rx->header[1] >> 4;
+    uint8_t flags = rx->header[1] & 0x0F;
+
+    if(rx->discard){
+        return;
+    }
+    rx->ch[channel].len += rx->header[3];
+    rx->ch[channel].seq = rx->header[2] + 1;
+    if(flags & MUX_FLAG_LAST){
+        rx->ch[channel].active = false;
+        if(rx->deliver){
+            rx->deliver(rx->ctx, channel, rx->ch[channel].msg, rx->ch[channel].len);
+        }
+        rx->ch[channel].len = 0;
+    }
+}
+
+void mux_rx_feed(mux_rx_t *rx, const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+    while(i < len){
+        if(rx->header_got < MUX_HEADER_SIZE){
+            if(rx->header_got == 0 && data[i] != MUX_SYNC){
+                rx->errors++;
+                i++;
+                continue;
+            }
+            rx->header[rx->header_got++] = data[i++];
+            if(rx->header_got == MUX_HEADER_SIZE){
+                rx->payload_got = 0;
+                if(!start_fragment(rx)){
+                    rx->errors++;
+                    rx->header_got = 0;
+                }
+            }
+            continue;
+        }
+
+        uint8_t channel = rx->header[1] >> 4;
+        size_t n = rx->header[3] - rx->payload_got;
+        if(n > len - i){
+            n = len - i;
+        }
+        if(!rx->discard){
+            memcpy(&rx->ch[channel].msg[rx->ch[channel].len + rx->payload_got], &data[i], n);
+        }
+        rx->payload_got += n;
+        i += n;
+        if(rx->payload_got == rx->header[3]){
+            end_fragment(rx);
+            rx->header_got = 0;
+        }
+    }
+}
+
+uint8_t mux_channel_for_frame(const uint8_t *frame, size_t len)
+{
+    if(len < 3 || frame[0] != 0xAA || frame[1] != 0x55){
+        return MUX_CH_BULK;
+    }
+    switch(frame[2]){
+        case '0': // temperature
+        case '2': // humidity
+        case '3': // request
+        case '4': // response
+            return MUX_CH_CONTROL;
+        default:
+            return MUX_CH_TEXT;
+    }
+}
@@ -0,0 +1,207 @@
+#include <string.h>
+#include "link_rpc.h"
+
+#define SLOT_MASK (RPC_SLOTS - 1)
+
+static rpc_slot_t *find(rpc_table_t *rpc, uint16_t id)
+{
+    for(unsigned i = id & SLOT_MASK, n = 0; n < RPC_SLOTS; i = (i + 1) & SLOT_MASK, n++){
+        if(!rpc->slot[i].used){
+            return NULL;
+        }
+        if(rpc->slot[i].id == id){
+            return &rpc->slot[i];
+        }
+    }
+    return NULL;
+}
+
+// Backward shift deletion keeps probe chains intact without tombstones
+static void release(rpc_table_t *rpc, rpc_slot_t *slot)
+{
+    unsigned hole = slot - rpc->slot;
+    unsigned i = hole;
+    while(1){
+        i = (i + 1) & SLOT_MASK;
+        if(!rpc->slot[i].used){
+            break;
+        }
+        unsigned home = rpc->slot[i].id & SLOT_MASK;
+        // entry may move into the hole unless its home lies between hole and i
+        bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+        if(!stays){
+            rpc->slot[hole] = rpc->slot[i];
+            hole = i;
+        }
+    }
+    rpc->slot[hole].used = false;
+    rpc->outstanding--;
+}
+
+// The slot is free before done runs, so done may start the next request
+static void take(rpc_table_t *rpc, rpc_slot_t *slot, rpc_finished_t *out)
+{
+    out->done = slot->done;
+    out->ctx = slot->ctx;
+    out->id = slot->id;
+    release(rpc, slot);
+}
+
+void rpc_init(rpc_table_t *rpc)
+{
+    memset(rpc, 0, sizeof(*rpc));
+    rpc->next_id = 1;
+}
+
+int rpc_begin(rpc_table_t *rpc, int64_t now_us, uint32_t timeout_ms,
+              rpc_done_cb done, void *ctx, uint16_t *id)
+{
+    if(rpc->outstanding >= RPC_MAX_OUTSTANDING){
+        return RPC_ERR_FULL;
+    }
+    // skip 0 and ids of requests that are still waiting after a wrap
+    while(rpc->next_id == 0 || find(rpc, rpc->next_id) != NULL){
+        rpc->next_id++;
+    }
+    *id = rpc->next_id++;
+
+    unsigned i = *id & SLOT_MASK;
+    while(rpc->slot[i].used){
+        i = (i + 1) & SLOT_MASK;
+    }
+    rpc->slot[i].id = *id;
+    rpc->slot[i].deadline_us = now_us + (int64_t)timeout_ms * 1000;
+    rpc->slot[i].done = done;
+    rpc->slot[i].ctx = ctx;
+    rpc->slot[i].used = true;
+    rpc->outstanding++;
+    return RPC_OK;
+}
+
+bool rpc_take(rpc_table_t *rpc, uint16_t id, rpc_finished_t *out)
+{
+    rpc_slot_t *slot = find(rpc, id);
+    if(slot == NULL){
+        rpc->late++;
+        return false;
+    }
+    take(rpc, slot, out);
+    return true;
+}
+
+bool rpc_complete(rpc_table_t *rpc, uint16_t id, int status, const uint8_t *value, size_t len)
+{
+    rpc_finished_t finished;
+    if(!rpc_take(rpc, id, &finished)){
+        return false;
+    }
+    rpc_finish(&finished, status, value, len);
+    return true;
+}
+
+void rpc_cancel(rpc_table_t *rpc, uint16_t id)
+{
+    rpc_slot_t *slot = find(rpc, id);
+    if(slot != NULL){
+        rpc_finished_t finished;
+        take(rpc, slot, &finished);
+        rpc_finish(&finished, RPC_STATUS_CANCELLED, NULL, 0);
+    }
+}
+
+int rpc_take_expired(rpc_table_t *rpc, int64_t now_us, rpc_finished_t out[RPC_MAX_OUTSTANDING])
+{
+    // collect first, releasing moves entries around
+    uint16_t expired[RPC_MAX_OUTSTANDING];
+    int count = 0;
+    for(int i = 0; i < RPC_SLOTS && count < RPC_MAX_OUTSTANDING; i++){
+        if(rpc->slot[i].used && rpc->slot[i].deadline_us <= now_us){
+            expired[count++] = rpc->slot[i].id;
+        }
+    }
+    int taken = 0;
+    for(int i = 0; i < count; i++){
+        rpc_slot_t *slot = find(rpc, expired[i]);
+        if(slot != NULL){
+            rpc->timeouts++;
+            take(rpc, slot, &out[taken++]);
+        }
+    }
+    return taken;
+}
+
+int rpc_expire(rpc_table_t *rpc, int64_t now_us)
+{
+    rpc_finished_t expired[RPC_MAX_OUTSTANDING];
+    int count = rpc_take_expired(rpc, now_us, expired);
+    for(int i = 0; i < count; i++){
+        rpc_finish(&expired[i], RPC_STATUS_TIMEOUT, NULL, 0);
+    }
+    return count;
+}
+
+// Same checksums as the keypad frames: seeded with 0x5a, frame type and length included
+static void seal(uint8_t *out, size_t payload)
+{
+    uint8_t crc = 0x5a + out[2] + out[3];
+    uint8_t crc_xor = 0x5a ^ out[2] ^ out[3];
+    for(size_t i = 0; i < payload; i++){
+        crc += out[RPC_HEADER_SIZE + i];
+        crc_xor ^= out[RPC_HEADER_SIZE + i];
+    }
+    out[RPC_HEADER_SIZE + payload] = crc;
+    out[RPC_HEADER_SIZE + payload + 1] = crc_xor;
+}
+
+static size_t encode(uint8_t *out, uint8_t type, uint16_t id, uint8_t code, const uint8_t *data, size_t len)
+{
+    if(len > RPC_VALUE_MAX){
+        len = RPC_VALUE_MAX;
+    }
+    size_t payload = 3 + len;
+    out[0] = 0xAA;
+    out[1] = 0x55;
+    out[2] = type;
+    out[3] = RPC_HEADER_SIZE + payload + 2;
+    out[4] = id >> 8;
+    out[5] = id & 0xFF;
+    out[6] = code;
+    if(len > 0){
+        memcpy(&out[7], data, len);
+    }
+    seal(out, payload);
+    return out[3];
+}
+
+size_t rpc_encode_request(uint8_t *out, uint16_t id, uint8_t target, const uint8_t *args, size_t len)
+{
+    return encode(out, RPC_FRAME_REQUEST, id, target, args, len);
+}
+
+size_t rpc_encode_response(uint8_t *out, uint16_t id, uint8_t status, const uint8_t *value, size_t len)
+{
+    return encode(out, RPC_FRAME_RESPONSE, id, status, value, len);
+}
+
+int rpc_parse(const uint8_t *frame, size_t len, rpc_msg_t *msg)
+{
+    if(len < RPC_FRAME_OVERHEAD || frame[0] != 0xAA || frame[1] != 0x55 || frame[3] != len
+       || (frame[2] != RPC_FRAME_REQUEST && frame[2] != RPC_FRAME_RESPONSE)){
+        return RPC_ERR_FORMAT;
+    }
+    uint8_t crc = 0x5a + frame[2] + frame[3];
+    uint8_t crc_xor = 0x5a ^ frame[2] ^ frame[3];
+    for(size_t i = RPC_HEADER_SIZE; i < len - 2; i++){
+        crc += frame[i];
+        crc_xor ^= frame[i];
+    }
+    if(frame[len - 2] != crc || frame[len - 1] != crc_xor){
+        return RPC_ERR_FORMAT;
+    }
+    msg->type = frame[2];
+    msg->id = frame[4] << 8 | frame[5];
+    msg->code = frame[6];
+    msg->data = &frame[7];
+    msg->len = len - RPC_FRAME_OVERHEAD;
+    return RPC_OK;
+}
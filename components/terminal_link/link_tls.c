@@ -0,0 +1,237 @@
+#include <string.h>
+#include <errno.h>
+#include "link_tls.h"
+#include "mbedtls/net_sockets.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+static const int ciphersuites[] = {
+    MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+    0
+};
+
+static int64_t now_us(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static int bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    int r = write(*(int *)ctx, buf, len);
+    if(r < 0){
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return r;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    int r = read(*(int *)ctx, buf, len);
+    if(r < 0){
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return r;
+}
+
+int link_tls_init(link_tls_t *tls, bool server, const uint8_t *psk, size_t psk_len, const char *identity)
+{
+    static const char pers[] = "terminal_link";
+    int ret;
+
+    memset(tls, 0, sizeof(*tls));
+    tls->server = server;
+    tls->fd = -1;
+    mbedtls_ssl_init(&tls->ssl);
+    mbedtls_ssl_config_init(&tls->conf);
+    mbedtls_entropy_init(&tls->entropy);
+    mbedtls_ctr_drbg_init(&tls->drbg);
+    mbedtls_ssl_ticket_init(&tls->ticket);
+    mbedtls_ssl_session_init(&tls->session);
+
+    ret = mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy,
+                                (const unsigned char *)pers, sizeof(pers) - 1);
+    if(ret != 0){
+        return ret;
+    }
+    ret = mbedtls_ssl_config_defaults(&tls->conf,
+                                      server ? MBEDTLS_SSL_IS_SERVER : MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if(ret != 0){
+        return ret;
+    }
+    mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+    mbedtls_ssl_conf_min_tls_version(&tls->conf, MBEDTLS_SSL_VERSION_TLS1_2);
+    mbedtls_ssl_conf_max_tls_version(&tls->conf, MBEDTLS_SSL_VERSION_TLS1_2);
+    mbedtls_ssl_conf_ciphersuites(&tls->conf, ciphersuites);
+
+    ret = mbedtls_ssl_conf_psk(&tls->conf, psk, psk_len,
+                               (const unsigned char *)identity, strlen(identity));
+    if(ret != 0){
+        return ret;
+    }
+
+    if(server){
+        ret = mbedtls_ssl_ticket_setup(&tls->ticket, mbedtls_ctr_drbg_random, &tls->drbg,
+                                       MBEDTLS_CIPHER_AES_128_GCM, LINK_TLS_TICKET_LIFETIME);
+        if(ret != 0){
+            return ret;
+        }
+        mbedtls_ssl_conf_session_tickets_cb(&tls->conf, mbedtls_ssl_ticket_write,
+                                            mbedtls_ssl_ticket_parse, &tls->ticket);
+    }
+    else{
+        mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    }
+
+    ret = mbedtls_ssl_setup(&tls->ssl, &tls->conf);
+    if(ret != 0){
+        return ret;
+    }
+    mbedtls_ssl_set_bio(&tls->ssl, &tls->fd, bio_send, bio_recv, NULL);
+    return 0;
+}
+
+int link_tls_handshake(link_tls_t *tls, int fd)
+{
+    int ret;
+    int64_t start = now_us();
+
+    mbedtls_ssl_session_reset(&tls->ssl);
+    tls->fd = fd;
+    if(!tls->server && tls->has_session){
+        // a rejected ticket just means a full handshake, not an error
+        mbedtls_ssl_set_session(&tls->ssl, &tls->session);
+    }
+    do{
+        ret = mbedtls_ssl_handshake(&tls->ssl);
+    } while(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+    if(ret != 0){
+        return ret;
+    }
+    tls->handshake_us = now_us() - start;
+
+    if(!tls->server){
+        mbedtls_ssl_session_free(&tls->session);
+        mbedtls_ssl_session_init(&tls->session);
+        tls->has_session = mbedtls_ssl_get_session(&tls->ssl, &tls->session) == 0;
+    }
+    return 0;
+}
+
+int link_tls_read(link_tls_t *tls, void *buf, size_t len)
+{
+    int ret;
+    do{
+        ret = mbedtls_ssl_read(&tls->ssl, buf, len);
+    } while(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+    if(ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY){
+        return 0;
+    }
+    return ret;
+}
+
+int link_tls_write(link_tls_t *tls, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    size_t done = 0;
+    while(done < len){
+        int ret = mbedtls_ssl_write(&tls->ssl, p + done, len - done);
+        if(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE){
+            continue;
+        }
+        if(ret < 0){
+            return ret;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+size_t link_tls_pending(link_tls_t *tls)
+{
+    return mbedtls_ssl_get_bytes_avail(&tls->ssl);
+}
+
+void link_tls_close(link_tls_t *tls)
+{
+    if(tls->fd >= 0){
+        mbedtls_ssl_close_notify(&tls->ssl);
+    }
+    tls->fd = -1;
+}
+
+void link_tls_free(link_tls_t *tls)
+{
+    mbedtls_ssl_session_free(&tls->session);
+    mbedtls_ssl_free(&tls->ssl);
+    mbedtls_ssl_config_free(&tls->conf);
+    mbedtls_ssl_ticket_free(&tls->ticket);
+    mbedtls_ctr_drbg_free(&tls->drbg);
+    mbedtls_entropy_free(&tls->entropy);
+}
+
+static int hex_digit(char c)
+{
+    if(c >= '0' && c <= '9'){
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f'){
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F'){
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+int link_tls_parse_key(const char *hex, uint8_t psk[LINK_TLS_PSK_MAX])
+{
+    size_t n = strlen(hex);
+    if(n == 0 || n % 2 != 0 || n / 2 > LINK_TLS_PSK_MAX){
+        return -1;
+    }
+    for(size_t i = 0; i < n / 2; i++){
+        int hi = hex_digit(hex[2 * i]);
+        int lo = hex_digit(hex[2 * i + 1]);
+        if(hi < 0 || lo < 0){
+            return -1;
+        }
+        psk[i] = hi << 4 | lo;
+    }
+    return n / 2;
+}
+
+#ifdef ESP_PLATFORM
+bool link_tls_load_key(uint8_t psk[LINK_TLS_PSK_MAX], size_t *psk_len, char identity[LINK_TLS_IDENTITY_MAX])
+{
+    nvs_handle_t nvs;
+    size_t id_len = LINK_TLS_IDENTITY_MAX;
+
+    bool found = false;
+
+    *psk_len = LINK_TLS_PSK_MAX;
+    if(nvs_open(LINK_TLS_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK){
+        found = nvs_get_blob(nvs, "psk", psk, psk_len) == ESP_OK && *psk_len > 0
+                && nvs_get_str(nvs, "psk_id", identity, &id_len) == ESP_OK;
+        nvs_close(nvs);
+    }
+    if(!found){
+        *psk_len = 0;
+    }
+    return found;
+}
+#endif
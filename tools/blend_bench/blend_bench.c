@@ -0,0 +1,114 @@
+/*
+ * Host check and benchmark of lv_color_mix with LV_COLOR_16_SWAP, the byte
+ * order the ILI9341 takes straight from the draw buffer.
+ *
+ * Compares the vendored lv_color_mix, which mixes in the swapped order, with
+ * the old path that swapped both colors, mixed and swapped the result back,
+ * over every foreground color and mix ratio, then times both over a draw
+ * buffer stripe the way the blend kernels use it, next to the channel by
+ * channel mix LVGL uses when LV_COLOR_MIX_ROUND_OFS is not 0.
+ *
+ *   LV=../../Station/components/lvgl-release-v8.3
+ *   cc -O2 -DLV_CONF_SKIP -DLV_COLOR_DEPTH=16 -DLV_COLOR_16_SWAP=1 -I$LV blend_bench.c -o blend_bench
+ *   ./blend_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "src/misc/lv_color.h"
+
+#define STRIPE_PX (320 * 20)    // DISPLAY_BUFFER_LINES stripe
+#define ROUNDS 2000
+
+// lv_color_mix before the change: swap in, mix in RGB565, swap out
+static inline lv_color_t mix_swapping(lv_color_t c1, lv_color_t c2, uint8_t mix)
+{
+    lv_color_t ret;
+    c1.full = c1.full << 8 | c1.full >> 8;
+    c2.full = c2.full << 8 | c2.full >> 8;
+    mix = (uint32_t)((uint32_t)mix + 4) >> 3;
+    uint32_t bg = (uint32_t)((uint32_t)c2.full | ((uint32_t)c2.full << 16)) & 0x7E0F81F;
+    uint32_t fg = (uint32_t)((uint32_t)c1.full | ((uint32_t)c1.full << 16)) & 0x7E0F81F;
+    uint32_t result = ((((fg - bg) * mix) >> 5) + bg) & 0x7E0F81F;
+    ret.full = (uint16_t)((result >> 16) | result);
+    ret.full = ret.full << 8 | ret.full >> 8;
+    return ret;
+}
+
+// lv_color_mix with LV_COLOR_MIX_ROUND_OFS 128, through the split green bit fields
+static inline lv_color_t mix_rounded(lv_color_t c1, lv_color_t c2, uint8_t mix)
+{
+    lv_color_t ret;
+    LV_COLOR_SET_R(ret, LV_UDIV255((uint16_t)LV_COLOR_GET_R(c1) * mix + LV_COLOR_GET_R(c2) * (255 - mix) + 128));
+    LV_COLOR_SET_G(ret, LV_UDIV255((uint16_t)LV_COLOR_GET_G(c1) * mix + LV_COLOR_GET_G(c2) * (255 - mix) + 128));
+    LV_COLOR_SET_B(ret, LV_UDIV255((uint16_t)LV_COLOR_GET_B(c1) * mix + LV_COLOR_GET_B(c2) * (255 - mix) + 128));
+    return ret;
+}
+
+static uint32_t rng = 0x12345678;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static lv_color_t src[STRIPE_PX], dest[STRIPE_PX];
+static lv_opa_t mask[STRIPE_PX];
+
+int main(void)
+{
+    // every fg and mix against random bg, plus the channel extremes
+    static const uint16_t edges[] = {0x0000, 0xFFFF, 0x00F8, 0xE007, 0x1F00, 0x07E0, 0xF81F};
+    unsigned long checked = 0, wrong = 0;
+    for(uint32_t fg = 0; fg <= 0xFFFF; fg++){
+        for(uint32_t n = 0; n < 16 + sizeof(edges) / sizeof(edges[0]); n++){
+            lv_color_t c1 = {.full = fg};
+            lv_color_t c2 = {.full = n < 16 ? (uint16_t)next_random() : edges[n - 16]};
+            for(uint32_t mix = 0; mix <= 255; mix++){
+                if(lv_color_mix(c1, c2, mix).full != mix_swapping(c1, c2, mix).full){
+                    if(wrong++ < 5){
+                        printf("mismatch fg %04x bg %04x mix %u\n", c1.full, c2.full, mix);
+                    }
+                }
+                checked++;
+            }
+        }
+    }
+    printf("%lu mixes checked, %lu differ\n", checked, wrong);
+
+    for(int i = 0; i < STRIPE_PX; i++){
+        src[i].full = next_random();
+        dest[i].full = next_random();
+        mask[i] = next_random();
+    }
+    static const char *const names[] = {"rounded, by channel", "swap, mix, swap", "mix in panel order"};
+    for(int variant = 0; variant < 3; variant++){
+        uint32_t sum = 0;
+        double start = now_ns();
+        for(int r = 0; r < ROUNDS; r++){
+            for(int i = 0; i < STRIPE_PX; i++){
+                lv_color_t c = variant == 0 ? mix_rounded(src[i], dest[i], mask[i])
+                               : variant == 1 ? mix_swapping(src[i], dest[i], mask[i])
+                               : lv_color_mix(src[i], dest[i], mask[i]);
+                dest[i] = c;
+                sum += c.full;
+            }
+            // keep the data moving so the loop is not folded away
+            mask[r % STRIPE_PX] += sum;
+        }
+        double ns = (now_ns() - start) / ((double)ROUNDS * STRIPE_PX);
+        printf("%-22s %5.2f ns/px  %6.1f Mpx/s  (%u)\n", names[variant], ns,
+               1e3 / ns, (unsigned)sum);
+    }
+    return wrong != 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Host check and benchmark of the RGB565 blend kernels of the vendored LVGL
+ * (src/draw/sw/lv_draw_sw_blend_kernel.h) with LV_COLOR_16_SWAP.
+ *
+ * Runs the scalar, SWAR and vector variant of every normal blend loop, fill
+ * and map, with opacity, with a mask and with both, over a draw buffer stripe
+ * starting one pixel in, like an area that is not word aligned. Two masks:
+ * the edge of a rounded rectangle, mostly 0 and 255 with a few anti-aliased
+ * pixels, and random values, where no run can be skipped or copied.
+ * Every variant has to give the scalar one's pixels, then it reports
+ * Mpixels/s per variant and the speedup over scalar.
+ *
+ *   LV=../../Station/components/lvgl-release-v8.3
+ *   cc -O2 -DLV_CONF_SKIP -DLV_COLOR_DEPTH=16 -DLV_COLOR_16_SWAP=1 -I$LV blend_kernels.c -o blend_kernels
+ *   ./blend_kernels
+ *
+ * For the numbers of an Xtensa-like target without SIMD, compare SWAR with
+ * scalar; -fno-tree-vectorize keeps the compiler from vectorizing scalar.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "src/draw/sw/lv_draw_sw_blend_kernel.h"
+
+#define HOR_RES 320
+#define LINES 20                // DISPLAY_BUFFER_LINES stripe
+#define AREA_X 1
+#define AREA_W (HOR_RES - 3)
+#define ROUNDS 200
+#define REPEATS 5
+
+enum { SCALAR, SWAR, VECTOR, VARIANTS };
+static const char *const variant_names[VARIANTS] = {"scalar", "swar", "vector"};
+
+enum { FILL_OPA, FILL_MASK, FILL_MASK_OPA, MAP_OPA, MAP_MASK, MAP_MASK_OPA, CASES };
+static const char *const case_names[CASES] = {
+    "fill opa", "fill mask", "fill mask+opa", "map opa", "map mask", "map mask+opa"
+};
+
+static lv_color_t dest[HOR_RES * LINES], src[HOR_RES * LINES], start[HOR_RES * LINES];
+static lv_opa_t mask[HOR_RES * LINES];
+static const lv_color_t color = {.full = 0x1F84};
+
+static uint32_t rng = 0x12345678;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Rounded rectangle edge: 0 outside, a short anti-aliased ramp, 255 inside
+static void mask_edge(void)
+{
+    for(int y = 0; y < LINES; y++){
+        int in = 12 - y / 2;
+        for(int x = 0; x < HOR_RES; x++){
+            int d = x < HOR_RES / 2 ? x - in : HOR_RES - 1 - x - in;
+            mask[y * HOR_RES + x] = d < 0 ? 0 : d >= 3 ? 255 : (lv_opa_t)(d * 85 + 40);
+        }
+    }
+}
+
+static void mask_random(void)
+{
+    for(int i = 0; i < HOR_RES * LINES; i++){
+        mask[i] = next_random();
+    }
+}
+
+static void run(int variant, int blend, lv_opa_t opa)
+{
+    lv_color_t *d = &dest[AREA_X];
+    const lv_color_t *s = &src[AREA_X];
+    const lv_opa_t *m = &mask[AREA_X];
+#if LV_DRAW_SW_BLEND_HAS_VECTOR
+#define PICK(name) variant == SCALAR ? name##_scalar : variant == SWAR ? name##_swar : name##_vector
+#else
+#define PICK(name) variant == SCALAR ? name##_scalar : name##_swar
+#endif
+    switch(blend){
+    case FILL_OPA:
+        (PICK(lv_draw_sw_blend_fill_opa))(d, HOR_RES, AREA_W, LINES, color, opa);
+        break;
+    case FILL_MASK:
+    case FILL_MASK_OPA:
+        (PICK(lv_draw_sw_blend_fill_mask))(d, HOR_RES, AREA_W, LINES, color, opa, m, HOR_RES);
+        break;
+    case MAP_OPA:
+        (PICK(lv_draw_sw_blend_map_opa))(d, HOR_RES, AREA_W, LINES, s, HOR_RES, opa);
+        break;
+    default:
+        (PICK(lv_draw_sw_blend_map_mask))(d, HOR_RES, AREA_W, LINES, s, HOR_RES, opa, m, HOR_RES);
+        break;
+    }
+#undef PICK
+}
+
+int main(void)
+{
+    for(int i = 0; i < HOR_RES * LINES; i++){
+        src[i].full = next_random();
+        start[i].full = next_random();
+    }
+    int variants = LV_DRAW_SW_BLEND_HAS_VECTOR ? VARIANTS : VECTOR;
+    int wrong = 0;
+    printf("%-14s %-6s  %9s %9s %9s   swar   vector\n", "", "mask", "scalar", "swar", "vector");
+    for(int blend = 0; blend < CASES; blend++){
+        lv_opa_t opa = blend == FILL_MASK || blend == MAP_MASK ? LV_OPA_COVER : 150;
+        bool masked = blend != FILL_OPA && blend != MAP_OPA;
+        for(int pattern = 0; pattern < (masked ? 2 : 1); pattern++){
+            if(pattern == 0){
+                mask_edge();
+            }
+            else {
+                mask_random();
+            }
+            static lv_color_t expected[HOR_RES * LINES];
+            double mpx[VARIANTS] = {0};
+            for(int variant = 0; variant < variants; variant++){
+                memcpy(dest, start, sizeof(dest));
+                run(variant, blend, opa);
+                if(variant == SCALAR){
+                    memcpy(expected, dest, sizeof(dest));
+                }
+                else if(memcmp(expected, dest, sizeof(dest)) != 0){
+                    printf("%s %s differs from scalar\n", case_names[blend], variant_names[variant]);
+                    wrong = 1;
+                }
+                // blending onto its own result keeps the background changing, best of REPEATS
+                for(int repeat = 0; repeat < REPEATS; repeat++){
+                    double begin = now_ns();
+                    for(int r = 0; r < ROUNDS; r++){
+                        run(variant, blend, opa);
+                    }
+                    double rate = (double)ROUNDS * AREA_W * LINES / ((now_ns() - begin) / 1e3);
+                    if(rate > mpx[variant]){
+                        mpx[variant] = rate;
+                    }
+                }
+            }
+            printf("%-14s %-6s  %9.1f %9.1f %9.1f  %5.2fx  %5.2fx  Mpx/s\n", case_names[blend],
+                   masked ? (pattern == 0 ? "edge" : "random") : "-", mpx[SCALAR], mpx[SWAR], mpx[VECTOR],
+                   mpx[SWAR] / mpx[SCALAR], variants > VECTOR ? mpx[VECTOR] / mpx[SCALAR] : 0.0);
+        }
+    }
+    return wrong;
+}
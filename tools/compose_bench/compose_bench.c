@@ -0,0 +1,124 @@
+/*
+ * Host benchmark of editing the composed text (Station/main/gap_buffer.c).
+ *
+ * Fills a 1000 character buffer, then types, deletes and moves the cursor at
+ * random positions, once with the gap buffer and once with the plain array
+ * and memmove the multi-tap engine used before, and reports the time per edit.
+ *
+ *   cc -O2 -I../../Station/main compose_bench.c ../../Station/main/gap_buffer.c -o compose_bench
+ *   ./compose_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gap_buffer.h"
+
+#define TEXT_LEN 1000
+#define CAPACITY 1100
+#define EDITS 2000000
+
+// Plain array with the cursor as an index, every edit shifts the tail
+typedef struct {
+    char text[CAPACITY];
+    uint16_t len;
+    uint16_t cursor;
+} flat_buffer_t;
+
+static void flat_insert(flat_buffer_t *fb, char c)
+{
+    if(fb->len < CAPACITY){
+        memmove(&fb->text[fb->cursor + 1], &fb->text[fb->cursor], fb->len - fb->cursor);
+        fb->text[fb->cursor++] = c;
+        fb->len++;
+    }
+}
+
+static void flat_delete_before(flat_buffer_t *fb)
+{
+    if(fb->cursor > 0){
+        memmove(&fb->text[fb->cursor - 1], &fb->text[fb->cursor], fb->len - fb->cursor);
+        fb->cursor--;
+        fb->len--;
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Edit script: 0 type or backspace to keep the length at TEXT_LEN, 1 left, 2 right, 3 jump
+static uint8_t ops[EDITS];
+static uint16_t jumps[EDITS];
+
+int main(void)
+{
+    srand(1);
+    for(int i = 0; i < EDITS; i++){
+        int r = rand() % 100;
+        // mostly typing and deleting next to the cursor, sometimes a jump
+        ops[i] = r < 90 ? 0 : r < 94 ? 1 : r < 98 ? 2 : 3;
+        jumps[i] = rand() % TEXT_LEN;
+    }
+
+    static char storage[CAPACITY];
+    gap_buffer_t gb;
+    gap_init(&gb, storage, CAPACITY);
+    static flat_buffer_t fb;
+    for(int i = 0; i < TEXT_LEN; i++){
+        gap_insert(&gb, 'a' + i % 26);
+        flat_insert(&fb, 'a' + i % 26);
+    }
+    gap_move_to(&gb, TEXT_LEN / 2);
+    fb.cursor = TEXT_LEN / 2;
+
+    double start = now_s();
+    for(int i = 0; i < EDITS; i++){
+        switch(ops[i]){
+            case 0:
+                if(gap_length(&gb) < TEXT_LEN || gap_cursor(&gb) == 0){
+                    gap_insert(&gb, 'x');
+                }
+                else{
+                    gap_delete_before(&gb);
+                }
+                break;
+            case 1: gap_left(&gb); break;
+            case 2: gap_right(&gb); break;
+            case 3: gap_move_to(&gb, jumps[i]); break;
+        }
+    }
+    double gap_s = now_s() - start;
+
+    start = now_s();
+    for(int i = 0; i < EDITS; i++){
+        switch(ops[i]){
+            case 0:
+                if(fb.len < TEXT_LEN || fb.cursor == 0){
+                    flat_insert(&fb, 'x');
+                }
+                else{
+                    flat_delete_before(&fb);
+                }
+                break;
+            case 1: fb.cursor -= fb.cursor > 0; break;
+            case 2: fb.cursor += fb.cursor < fb.len; break;
+            case 3: fb.cursor = jumps[i] < fb.len ? jumps[i] : fb.len; break;
+        }
+    }
+    double flat_s = now_s() - start;
+
+    static char a[CAPACITY + 1];
+    uint16_t n = gap_copy(&gb, a, sizeof(a));
+    if(n != fb.len || memcmp(a, fb.text, n) != 0 || gap_cursor(&gb) != fb.cursor){
+        fprintf(stderr, "buffers differ\n");
+        return 1;
+    }
+    printf("text: %u characters, %d edits\n", n, EDITS);
+    printf("gap buffer: %.1f ns per edit\n", gap_s * 1e9 / EDITS);
+    printf("memmove:    %.1f ns per edit\n", flat_s * 1e9 / EDITS);
+    return 0;
+}
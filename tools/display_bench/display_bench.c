@@ -0,0 +1,145 @@
+/*
+ * Host model of the Station display pipeline (display_initialize buffer modes).
+ *
+ * Stands in for the SPI bus and the ILI9341: every flush costs the
+ * CASET/RASET/RAMWR commands, sent by polling with the CPU busy, and then
+ * the pixel DMA at the bus clock with the CPU free. Rendering costs a fixed
+ * amount per pixel plus a fixed amount per rendered part. The model replays
+ * how LVGL waits for the bus in each mode and reports frames per second and
+ * the share of the frame time the CPU is busy, for a full screen redraw and
+ * for the text area redraw that typing causes.
+ *
+ *   cc -O2 display_bench.c -o display_bench
+ *   ./display_bench [spi_mhz] [render_ns_per_px] [lines]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HOR_RES 320
+#define VER_RES 240
+
+typedef enum {
+    MODE_STRIPE,
+    MODE_PINGPONG,
+    MODE_FULL,
+} bench_mode_t;
+
+typedef struct {
+    const char *name;
+    int x1, y1, x2, y2;     // redrawn area, inclusive
+} workload_t;
+
+typedef struct {
+    double spi_hz;
+    double render_ns_px;
+    double render_part_us;  // object tree walk and clipping per rendered part
+    double command_us;      // one polled command transaction
+    int lines;
+} model_t;
+
+typedef struct {
+    double frame_us;
+    double cpu_us;
+    int flushes;
+} result_t;
+
+static double max_d(double a, double b)
+{
+    return a > b ? a : b;
+}
+
+static double render_us(const model_t *m, int pixels)
+{
+    return m->render_part_us + pixels * m->render_ns_px / 1000.0;
+}
+
+static double dma_us(const model_t *m, int pixels)
+{
+    return pixels * 16 / m->spi_hz * 1e6;
+}
+
+static result_t run(const model_t *m, bench_mode_t mode, const workload_t *w)
+{
+    result_t r = {0};
+    int width = w->x2 - w->x1 + 1;
+    int height = w->y2 - w->y1 + 1;
+    double cpu = 0;         // time the CPU is free again
+    double bus = 0;         // time the bus is free again
+    double busy = 0;        // CPU time spent
+
+    if(mode == MODE_FULL){
+        // area drawn in place, one transfer of the full width rows it covers
+        double t = render_us(m, width * height);
+        busy += t;
+        cpu += t;
+        double cmd = 3 * m->command_us;
+        busy += cmd;
+        cpu += cmd;
+        bus = cpu + dma_us(m, HOR_RES * height);
+        r.flushes = 1;
+        // the single buffer can only be drawn into again after the transfer
+        r.frame_us = bus;
+        r.cpu_us = busy;
+        return r;
+    }
+
+    double previous_dma_done = 0;
+    for(int y = 0; y < height; y += m->lines){
+        int rows = height - y < m->lines ? height - y : m->lines;
+        int pixels = width * rows;
+        if(mode == MODE_STRIPE){
+            cpu = max_d(cpu, previous_dma_done);    // one buffer, wait for its DMA
+        }
+        double t = render_us(m, pixels);
+        busy += t;
+        cpu += t;
+        // flush waits for the other buffer's transfer to finish
+        cpu = max_d(cpu, previous_dma_done);
+        double cmd = 3 * m->command_us;
+        busy += cmd;
+        cpu += cmd;
+        bus = cpu + dma_us(m, pixels);
+        previous_dma_done = bus;
+        r.flushes++;
+    }
+    r.frame_us = max_d(cpu, bus);
+    r.cpu_us = busy;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    model_t m = {
+        .spi_hz = 20e6,
+        .render_ns_px = 60,
+        .render_part_us = 150,
+        .command_us = 15,
+        .lines = 20,
+    };
+    if(argc > 1){
+        m.spi_hz = atof(argv[1]) * 1e6;
+    }
+    if(argc > 2){
+        m.render_ns_px = atof(argv[2]);
+    }
+    if(argc > 3){
+        m.lines = atoi(argv[3]);
+    }
+
+    static const workload_t workloads[] = {
+        {"full screen", 0, 0, HOR_RES - 1, VER_RES - 1},
+        {"text area", 20, 155, 299, 214},
+    };
+    static const char *const mode_names[] = {"stripe", "pingpong", "full"};
+
+    printf("SPI %.0f MHz, %.0f ns/px render, %d line stripes\n", m.spi_hz / 1e6, m.render_ns_px, m.lines);
+    for(size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++){
+        printf("%s:\n", workloads[w].name);
+        for(int mode = MODE_STRIPE; mode <= MODE_FULL; mode++){
+            result_t r = run(&m, mode, &workloads[w]);
+            printf("  %-9s %7.2f ms  %6.1f fps  cpu %5.1f%%  %2d flushes\n", mode_names[mode],
+                   r.frame_us / 1000, 1e6 / r.frame_us, 100 * r.cpu_us / r.frame_us, r.flushes);
+        }
+    }
+    return 0;
+}
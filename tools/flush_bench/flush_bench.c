@@ -0,0 +1,104 @@
+/*
+ * Host benchmark of joining invalidated areas before the Station flushes them
+ * (_lv_area_join_list in the vendored LVGL, lv_disp_drv_t.flush_overhead_px).
+ *
+ * Replays the areas the Station UI invalidates in typical frames, joins them
+ * the way LVGL does without and with the flush cost model, splits them into
+ * buffer stripes like lv_refr does, and reports flushes, SPI transactions and
+ * SPI bytes per frame together with the bus and CPU time they take.
+ *
+ *   LV=../../Station/components/lvgl-release-v8.3
+ *   cc -O2 -DLV_CONF_SKIP -I$LV flush_bench.c $LV/src/misc/lv_area.c $LV/src/misc/lv_math.c -o flush_bench
+ *   ./flush_bench
+ */
+#include <stdio.h>
+#include <string.h>
+#include "src/misc/lv_area.h"
+
+#define HOR_RES 320
+#define BUFFER_PX (HOR_RES * 20)        // DISPLAY_BUFFER_LINES stripes
+#define FLUSH_OVERHEAD_US 120           // TFT_FLUSH_OVERHEAD_US
+#define RENDER_NS_PER_PX 60             // TFT_RENDER_NS_PER_PX
+#define COMMAND_BYTES (5 + 5 + 1)       // CASET and RASET with 4 parameters each, RAMWR
+#define TRANSACTIONS_PER_FLUSH 4        // three polled commands and the pixel DMA
+
+typedef struct {
+    const char *name;
+    int count;
+    lv_area_t areas[8];
+} frame_t;
+
+// Areas from the app_main layout: message box, error boxes, text area, candidate bar, socket status
+static const frame_t frames[] = {
+    {"key typed", 4, {
+        {36, 171, 283, 187},    // text area label
+        {60, 170, 62, 188},     // cursor, old place
+        {68, 170, 70, 188},     // cursor, new place
+        {5, 224, 194, 239},     // candidate bar
+    }},
+    {"cursor blink", 1, {
+        {68, 170, 70, 188},
+    }},
+    {"frame received", 3, {
+        {40, 52, 279, 68},      // message label
+        {15, 117, 54, 133},     // input error label
+        {265, 117, 304, 133},   // output error label
+    }},
+    {"status line", 3, {
+        {5, 224, 194, 239},     // candidate bar
+        {215, 224, 314, 239},   // socket status
+        {265, 117, 304, 133},   // output error label
+    }},
+};
+
+typedef struct {
+    int flushes;
+    long bytes;
+    long pixels;
+} cost_t;
+
+static cost_t frame_cost(const frame_t *frame, uint32_t overhead_px)
+{
+    lv_area_t areas[8];
+    uint8_t joined[8] = {0};
+    cost_t cost = {0};
+
+    memcpy(areas, frame->areas, sizeof(areas));
+    _lv_area_join_list(areas, joined, frame->count, overhead_px);
+    for(int i = 0; i < frame->count; i++){
+        if(joined[i]){
+            continue;
+        }
+        int w = lv_area_get_width(&areas[i]);
+        int h = lv_area_get_height(&areas[i]);
+        int rows = BUFFER_PX / w;
+        int stripes = (h + rows - 1) / rows;
+        cost.flushes += stripes;
+        cost.pixels += (long)w * h;
+        cost.bytes += stripes * COMMAND_BYTES + (long)w * h * 2;
+    }
+    return cost;
+}
+
+int main(void)
+{
+    static const double clocks[] = {20e6, 80e6 / 3, 40e6};
+
+    for(size_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++){
+        double px_ns = 16e9 / clocks[c];
+        uint32_t overhead_px = FLUSH_OVERHEAD_US * 1000 / (px_ns + RENDER_NS_PER_PX);
+        printf("%.1f MHz, flush overhead %u px\n", clocks[c] / 1e6, (unsigned)overhead_px);
+        printf("  %-15s %23s   %23s\n", "", "LVGL join", "cost model join");
+        for(size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++){
+            printf("  %-15s", frames[f].name);
+            for(int model = 0; model < 2; model++){
+                cost_t cost = frame_cost(&frames[f], model ? overhead_px : 0);
+                double us = cost.flushes * FLUSH_OVERHEAD_US + cost.pixels * (px_ns + RENDER_NS_PER_PX) / 1000;
+                printf(" %d fl %2d tr %6ld B %5.0f us", cost.flushes, cost.flushes * TRANSACTIONS_PER_FLUSH,
+                       cost.bytes, us);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
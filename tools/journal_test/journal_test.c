@@ -0,0 +1,383 @@
+/*
+ * Host test of the outbox journal (Station/main/frame_journal.c).
+ *
+ * Recovery: random appends and replays run against a RAM flash that loses
+ * power after a random number of programmed bytes. The cut write keeps only
+ * the bytes before the cut; erases are all or nothing. The journal is then
+ * mounted from what is left and replayed. Every frame whose append returned
+ * and that was not popped has to come back, in order, exactly once. The
+ * frame in flight at the cut may come back or not, but only whole.
+ * Also checks that a full ring drops the oldest frames, and that sectors are
+ * erased evenly.
+ *
+ * Throughput: appends and replays on a 16 x 4K journal, the size of the
+ * 'journal' partition, in RAM and on the host's file backend, with the
+ * flash bytes programmed per frame.
+ *
+ *   cc -O2 -I../../Station/main journal_test.c ../../Station/main/frame_journal.c -o journal_test
+ *   ./journal_test [trials]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame_journal.h"
+
+#define SECTOR_SIZE 4096
+#define SECTORS 16
+#define MAX_FRAME 64
+#define MODEL_MAX 32            // frames waiting in a recovery trial, well below a sector
+
+// RAM NOR flash, also counts programmed bytes and can lose power
+typedef struct {
+    uint8_t mem[SECTOR_SIZE * SECTORS];
+    const journal_bdev_t *inner;    // wraps another device when set
+    long budget;                    // bytes left before the power cut, < 0 = no cut
+    unsigned long written;
+    unsigned long erased;
+    int dead;
+} flash_t;
+
+static uint32_t rng = 0x9E3779B9;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int flash_read(const journal_bdev_t *dev, uint32_t offset, void *dst, uint32_t len)
+{
+    flash_t *f = dev->ctx;
+    if(f->inner){
+        return f->inner->read(f->inner, offset, dst, len);
+    }
+    memcpy(dst, &f->mem[offset], len);
+    return 0;
+}
+
+static int flash_write(const journal_bdev_t *dev, uint32_t offset, const void *src, uint32_t len)
+{
+    flash_t *f = dev->ctx;
+    const uint8_t *in = src;
+    uint32_t done = len;
+    if(f->dead){
+        return -1;
+    }
+    if(f->budget >= 0 && (long)len > f->budget){
+        done = f->budget;
+        f->dead = 1;
+    }
+    if(f->budget >= 0){
+        f->budget -= done;
+    }
+    f->written += done;
+    if(f->inner){
+        if(done > 0 && f->inner->write(f->inner, offset, src, done) != 0){
+            return -1;
+        }
+    }
+    else{
+        for(uint32_t i = 0; i < done; i++){
+            f->mem[offset + i] &= in[i];
+        }
+    }
+    return done == len ? 0 : -1;
+}
+
+static int flash_erase(const journal_bdev_t *dev, uint32_t offset, uint32_t len)
+{
+    flash_t *f = dev->ctx;
+    if(f->dead || f->budget == 0){
+        f->dead = 1;
+        return -1;
+    }
+    f->erased += len;
+    if(f->inner){
+        return f->inner->erase(f->inner, offset, len);
+    }
+    memset(&f->mem[offset], 0xFF, len);
+    return 0;
+}
+
+static void flash_init(flash_t *f, journal_bdev_t *dev, const journal_bdev_t *inner)
+{
+    memset(f, 0, sizeof(*f));
+    memset(f->mem, 0xFF, sizeof(f->mem));
+    f->inner = inner;
+    f->budget = -1;
+    dev->sector_size = SECTOR_SIZE;
+    dev->sector_count = SECTORS;
+    dev->read = flash_read;
+    dev->write = flash_write;
+    dev->erase = flash_erase;
+    dev->ctx = f;
+}
+
+// Frame n: its number, then bytes derived from it, 4..MAX_FRAME long
+static uint8_t make_frame(uint32_t n, uint8_t *frame)
+{
+    uint8_t len = 4 + n * 7 % (MAX_FRAME - 3);
+    memcpy(frame, &n, 4);
+    for(int i = 4; i < len; i++){
+        frame[i] = (uint8_t)(n * 31 + i);
+    }
+    return len;
+}
+
+// Number of the frame, -1 when it is not one make_frame built
+static long frame_number(const uint8_t *frame, uint8_t len)
+{
+    uint8_t expected[MAX_FRAME];
+    uint32_t n;
+    if(len < 4){
+        return -1;
+    }
+    memcpy(&n, frame, 4);
+    if(make_frame(n, expected) != len || memcmp(frame, expected, len) != 0){
+        return -1;
+    }
+    return n;
+}
+
+// Replay everything that is waiting into out, -1 on a broken frame
+static int drain(journal_t *j, long *out, int cap)
+{
+    uint8_t frame[JOURNAL_MAX_RECORD];
+    uint8_t len;
+    int n = 0;
+    while(journal_peek(j, frame, sizeof(frame), &len) == JOURNAL_OK){
+        long number = frame_number(frame, len);
+        if(number < 0 || n == cap || journal_pop(j) != JOURNAL_OK){
+            return -1;
+        }
+        out[n++] = number;
+    }
+    return n;
+}
+
+static int same(const long *a, int na, const long *b, int nb)
+{
+    return na == nb && memcmp(a, b, na * sizeof(long)) == 0;
+}
+
+/**
+ * One power cut. Returns 0 when the mounted journal holds exactly the frames
+ * the model says are waiting, give or take the one in flight.
+ */
+static int recovery_trial(int trial)
+{
+    static flash_t flash;
+    journal_bdev_t dev;
+    journal_t j;
+    uint8_t frame[JOURNAL_MAX_RECORD];
+    long model[MODEL_MAX];
+    int waiting = 0;
+    uint32_t next = 0;
+    long in_flight = -1;
+    int in_flight_pop = 0;
+
+    flash_init(&flash, &dev, NULL);
+    if(journal_format(&j, &dev) != JOURNAL_OK){
+        return -1;
+    }
+    // a few rounds through the ring first, so the cut can hit a wrap
+    long warmup = next_random() % (4L * SECTOR_SIZE * SECTORS);
+    flash.budget = warmup + next_random() % (2 * SECTOR_SIZE);
+    while(!flash.dead){
+        if(waiting < MODEL_MAX && (waiting == 0 || next_random() % 8 < 5)){
+            uint8_t len = make_frame(next, frame);
+            in_flight = next;
+            in_flight_pop = 0;
+            if(journal_append(&j, frame, len) == JOURNAL_OK){
+                model[waiting++] = next;
+                in_flight = -1;
+            }
+            next++;
+        }
+        else{
+            uint8_t len;
+            if(journal_peek(&j, frame, sizeof(frame), &len) != JOURNAL_OK || frame_number(frame, len) != model[0]){
+                printf("trial %d: replay before the cut returned the wrong frame\n", trial);
+                return -1;
+            }
+            in_flight = model[0];
+            in_flight_pop = 1;
+            if(journal_pop(&j) == JOURNAL_OK){
+                memmove(model, &model[1], --waiting * sizeof(long));
+                in_flight = -1;
+            }
+        }
+    }
+
+    // power back: mount what is on the flash
+    flash.dead = 0;
+    flash.budget = -1;
+    long got[MODEL_MAX + 8];
+    if(journal_mount(&j, &dev) != JOURNAL_OK){
+        printf("trial %d: mount failed\n", trial);
+        return -1;
+    }
+    uint32_t pending = journal_pending(&j);
+    int n = drain(&j, got, MODEL_MAX + 8);
+    int ok = n >= 0 && (uint32_t)n == pending && same(got, n, model, waiting);
+    if(!ok && n >= 0 && in_flight >= 0 && !in_flight_pop){
+        // the append in flight made it
+        model[waiting] = in_flight;
+        ok = same(got, n, model, waiting + 1) && (uint32_t)n == pending;
+    }
+    if(!ok && n >= 0 && in_flight >= 0 && in_flight_pop){
+        // the pop in flight made it
+        ok = same(got, n, &model[1], waiting - 1) && (uint32_t)n == pending;
+    }
+    if(!ok){
+        printf("trial %d: %d frames waiting, %d replayed after the cut (%u pending)\n", trial, waiting, n,
+               (unsigned)pending);
+        return -1;
+    }
+
+    // and the journal keeps working after the recovery
+    for(uint32_t i = 0; i < 5; i++){
+        uint8_t len = make_frame(next + i, frame);
+        if(journal_append(&j, frame, len) != JOURNAL_OK){
+            printf("trial %d: append after recovery failed\n", trial);
+            return -1;
+        }
+    }
+    n = drain(&j, got, MODEL_MAX + 8);
+    if(n != 5 || got[0] != (long)next || got[4] != (long)next + 4){
+        printf("trial %d: frames appended after recovery came back wrong\n", trial);
+        return -1;
+    }
+    return 0;
+}
+
+// A full ring drops whole sectors of the oldest frames, the newest survive in order
+static int ring_full(void)
+{
+    static flash_t flash;
+    journal_bdev_t dev;
+    journal_t j;
+    uint8_t frame[JOURNAL_MAX_RECORD];
+    static long got[SECTOR_SIZE * SECTORS / 8];
+    uint32_t total = 3 * SECTOR_SIZE * SECTORS / 40;
+
+    flash_init(&flash, &dev, NULL);
+    journal_format(&j, &dev);
+    for(uint32_t i = 0; i < total; i++){
+        if(journal_append(&j, frame, make_frame(i, frame)) != JOURNAL_OK){
+            return -1;
+        }
+    }
+    uint32_t dropped = j.dropped;
+    journal_mount(&j, &dev);
+    int n = drain(&j, got, sizeof(got) / sizeof(got[0]));
+    int ok = n > 0 && dropped > 0 && (uint32_t)n + dropped == total && got[n - 1] == (long)total - 1;
+    for(int i = 1; ok && i < n; i++){
+        ok = got[i] == got[i - 1] + 1;
+    }
+    printf("ring full: %u frames appended, %u dropped, %d replayed: %s\n", (unsigned)total, (unsigned)dropped, n,
+           ok ? "ok" : "WRONG");
+    return ok ? 0 : -1;
+}
+
+// Erase counters of all sectors after many wraps differ by at most one
+static int wear(void)
+{
+    static flash_t flash;
+    journal_bdev_t dev;
+    journal_t j;
+    uint8_t frame[JOURNAL_MAX_RECORD];
+    uint32_t lo = UINT32_MAX, hi = 0;
+    uint8_t len;
+
+    flash_init(&flash, &dev, NULL);
+    journal_format(&j, &dev);
+    for(uint32_t i = 0; i < 50000; i++){
+        journal_append(&j, frame, make_frame(i, frame));
+        if(i % 3 == 0){
+            journal_peek(&j, frame, sizeof(frame), &len);
+            journal_pop(&j);
+        }
+    }
+    for(uint32_t s = 0; s < SECTORS; s++){
+        uint32_t count;
+        memcpy(&count, &flash.mem[s * SECTOR_SIZE + 8], 4);   // sector header: magic, seq, erase count
+        lo = count < lo ? count : lo;
+        hi = count > hi ? count : hi;
+    }
+    printf("wear: sectors erased %u..%u times: %s\n", (unsigned)lo, (unsigned)hi, hi - lo <= 1 ? "ok" : "UNEVEN");
+    return hi - lo <= 1 ? 0 : -1;
+}
+
+// Append and replay in batches of a socket outage, frames/s and bytes programmed per frame
+static void throughput(const char *name, journal_bdev_t *dev, flash_t *counter)
+{
+    journal_t j;
+    uint8_t frame[JOURNAL_MAX_RECORD];
+    uint8_t len;
+    const int batches = 200, batch = 100;
+    double t_append = 0, t_replay = 0;
+
+    journal_format(&j, dev);
+    counter->written = 0;
+    counter->erased = 0;
+    for(int b = 0; b < batches; b++){
+        double start = now_s();
+        for(int i = 0; i < batch; i++){
+            journal_append(&j, frame, make_frame(b * batch + i, frame));
+        }
+        double mid = now_s();
+        while(journal_peek(&j, frame, sizeof(frame), &len) == JOURNAL_OK){
+            journal_pop(&j);
+        }
+        t_append += mid - start;
+        t_replay += now_s() - mid;
+    }
+    int frames = batches * batch;
+    printf("%-5s append %8.0f frames/s, replay %8.0f frames/s, %.1f bytes programmed and %.0f erased per frame\n",
+           name, frames / t_append, frames / t_replay, (double)counter->written / frames,
+           (double)counter->erased / frames);
+}
+
+int main(int argc, char **argv)
+{
+    int trials = argc > 1 ? atoi(argv[1]) : 2000;
+    int failed = 0;
+
+    for(int t = 0; t < trials; t++){
+        failed += recovery_trial(t) != 0;
+    }
+    printf("power cut: %d trials, %d failed\n", trials, failed);
+    failed += ring_full() != 0;
+    failed += wear() != 0;
+
+    static flash_t ram, file_counter;
+    journal_bdev_t ram_dev, file_dev, counted_file_dev;
+    flash_init(&ram, &ram_dev, NULL);
+    throughput("ram", &ram_dev, &ram);
+
+    char path[] = "/tmp/journal_test_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd >= 0){
+        close(fd);
+        unlink(path);
+        if(journal_bdev_file(&file_dev, path, SECTOR_SIZE, SECTORS) == JOURNAL_OK){
+            flash_init(&file_counter, &counted_file_dev, &file_dev);
+            throughput("file", &counted_file_dev, &file_counter);
+            journal_bdev_file_close(&file_dev);
+        }
+        unlink(path);
+    }
+    return failed != 0;
+}
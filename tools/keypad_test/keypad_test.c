@@ -0,0 +1,428 @@
+/*
+ * Host test of the key matrix debouncer (Station/main/keypad_scan.c).
+ *
+ * A simulated 4x4 matrix without diodes stands in for keypad_sample(): keys
+ * are switches, and a key reads closed when its row and column are connected
+ * through any closed switches, so three corners of a rectangle show the
+ * fourth. Contacts bounce for up to BOUNCE_MS after every change, reading
+ * open or closed at random. The scanner is fed every KEYPAD_SCAN_MS with the
+ * Station's settings.
+ *
+ *   clean      one press, DOWN after the debounce scans, UP after release
+ *   bounce     bouncing presses give exactly one DOWN and one UP each
+ *   long       LONG once for a held key, never for a tap
+ *   rollover   overlapping presses on shared rows and columns
+ *   ghost      three corners held, the fourth never goes DOWN
+ *   random     random timelines of up to three keys without a rectangle,
+ *              the events have to match the script key by key
+ *
+ *   cc -O2 -I../../Station/main keypad_test.c ../../Station/main/keypad_scan.c -o keypad_test
+ *   ./keypad_test [timelines]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keypad_scan.h"
+
+// Station.c settings
+#define KEYPAD_SCAN_MS 5
+#define KEYPAD_DEBOUNCE_SCANS 3
+#define KEYPAD_LONG_PRESS_MS 600
+
+// bounce shorter than the debounce window, (KEYPAD_DEBOUNCE_SCANS - 1) scans
+#define BOUNCE_MS 9
+#define EVENTS_MAX 256
+// DOWN and UP both lag the contact by up to this, so LONG is certain after
+// KEYPAD_LONG_PRESS_MS + LONG_SLACK_MS held and impossible for a release before - LONG_SLACK_MS
+#define LONG_SLACK_MS (BOUNCE_MS + (KEYPAD_DEBOUNCE_SCANS + 1) * KEYPAD_SCAN_MS)
+
+static uint32_t rng = 0x2545F491;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/* Simulated matrix */
+
+typedef struct {
+    uint16_t held;                      // switches as the script sets them
+    uint32_t changed_ms[KEYPAD_KEYS];   // last change, the contact bounces after it
+} matrix_t;
+
+static void matrix_set(matrix_t *m, uint8_t key, int closed, uint32_t now_ms)
+{
+    uint16_t bit = 1 << key;
+    if(((m->held & bit) != 0) != closed){
+        m->held ^= bit;
+        m->changed_ms[key] = now_ms;
+    }
+}
+
+// Contacts as they are at now_ms, bouncing ones at random
+static uint16_t matrix_contacts(const matrix_t *m, uint32_t now_ms)
+{
+    uint16_t closed = m->held;
+    for(uint8_t key = 0; key < KEYPAD_KEYS; key++){
+        if(m->changed_ms[key] != 0 && now_ms - m->changed_ms[key] < BOUNCE_MS && (next_random() & 1)){
+            closed ^= 1 << key;
+        }
+    }
+    return closed;
+}
+
+// What the column scan reads: row and column joined through closed switches
+static uint16_t matrix_read(uint16_t contacts)
+{
+    // union of rows (0..3) and columns (4..7)
+    int parent[KEYPAD_ROWS + KEYPAD_COLS];
+    for(int i = 0; i < KEYPAD_ROWS + KEYPAD_COLS; i++){
+        parent[i] = i;
+    }
+    for(int key = 0; key < KEYPAD_KEYS; key++){
+        if(contacts & (1 << key)){
+            int a = key / KEYPAD_COLS, b = KEYPAD_ROWS + key % KEYPAD_COLS;
+            while(parent[a] != a){
+                a = parent[a];
+            }
+            while(parent[b] != b){
+                b = parent[b];
+            }
+            parent[a] = b;
+        }
+    }
+    uint16_t raw = 0;
+    for(int key = 0; key < KEYPAD_KEYS; key++){
+        int a = key / KEYPAD_COLS, b = KEYPAD_ROWS + key % KEYPAD_COLS;
+        while(parent[a] != a){
+            a = parent[a];
+        }
+        while(parent[b] != b){
+            b = parent[b];
+        }
+        if(a == b){
+            raw |= 1 << key;
+        }
+    }
+    return raw;
+}
+
+/* Scanner under test */
+
+typedef struct {
+    key_event_t event[EVENTS_MAX];
+    int count;
+} events_t;
+
+static void record(void *ctx, const key_event_t *event)
+{
+    events_t *events = ctx;
+    if(events->count < EVENTS_MAX){
+        events->event[events->count++] = *event;
+    }
+}
+
+typedef struct {
+    matrix_t matrix;
+    keypad_scan_t scan;
+    events_t events;
+    uint32_t now_ms;
+    int busy;
+} rig_t;
+
+static void rig_init(rig_t *rig)
+{
+    memset(rig, 0, sizeof(*rig));
+    rig->now_ms = 1000;
+    keypad_scan_init(&rig->scan, KEYPAD_DEBOUNCE_SCANS, KEYPAD_LONG_PRESS_MS, record, &rig->events);
+}
+
+static void rig_run(rig_t *rig, uint32_t ms)
+{
+    for(uint32_t end = rig->now_ms + ms; rig->now_ms < end; rig->now_ms += KEYPAD_SCAN_MS){
+        uint16_t raw = matrix_read(matrix_contacts(&rig->matrix, rig->now_ms));
+        rig->busy = keypad_scan_feed(&rig->scan, raw, rig->now_ms);
+    }
+}
+
+static const char *const type_names[] = {"DOWN", "UP", "LONG"};
+
+static int expect(const char *test, const rig_t *rig, int index, uint8_t key, key_event_type_t type)
+{
+    if(index >= rig->events.count){
+        printf("%s: event %d missing, expected %s %u\n", test, index, type_names[type], key);
+        return 1;
+    }
+    const key_event_t *e = &rig->events.event[index];
+    if(e->key != key || e->type != type){
+        printf("%s: event %d is %s %u, expected %s %u\n", test, index, type_names[e->type], e->key,
+               type_names[type], key);
+        return 1;
+    }
+    return 0;
+}
+
+static int expect_count(const char *test, const rig_t *rig, int count)
+{
+    if(rig->events.count != count){
+        printf("%s: %d events, expected %d\n", test, rig->events.count, count);
+        return 1;
+    }
+    return 0;
+}
+
+static int clean(void)
+{
+    rig_t rig;
+    int errors = 0;
+    rig_init(&rig);
+    matrix_set(&rig.matrix, 5, 1, rig.now_ms);
+    rig.matrix.changed_ms[5] = 0;   // no bounce
+    uint32_t pressed_ms = rig.now_ms;
+    rig_run(&rig, 100);
+    errors += expect("clean", &rig, 0, 5, KEY_EVENT_DOWN);
+    if(rig.events.count > 0 && rig.events.event[0].time_ms != pressed_ms + (KEYPAD_DEBOUNCE_SCANS - 1) * KEYPAD_SCAN_MS){
+        printf("clean: DOWN at +%u ms\n", (unsigned)(rig.events.event[0].time_ms - pressed_ms));
+        errors++;
+    }
+    matrix_set(&rig.matrix, 5, 0, rig.now_ms);
+    rig.matrix.changed_ms[5] = 0;
+    rig_run(&rig, 100);
+    errors += expect("clean", &rig, 1, 5, KEY_EVENT_UP);
+    errors += expect_count("clean", &rig, 2);
+    if(rig.busy){
+        printf("clean: scanner still busy after release\n");
+        errors++;
+    }
+    return errors;
+}
+
+static int bounce(void)
+{
+    int errors = 0;
+    for(int trial = 0; trial < 200; trial++){
+        rig_t rig;
+        rig_init(&rig);
+        uint8_t key = next_random() % KEYPAD_KEYS;
+        for(int press = 0; press < 10; press++){
+            matrix_set(&rig.matrix, key, 1, rig.now_ms);
+            rig_run(&rig, 30 + next_random() % 200);
+            matrix_set(&rig.matrix, key, 0, rig.now_ms);
+            rig_run(&rig, 30 + next_random() % 200);
+        }
+        int trial_errors = expect_count("bounce", &rig, 20);
+        for(int i = 0; i < 20 && !trial_errors; i++){
+            trial_errors += expect("bounce", &rig, i, key, i % 2 ? KEY_EVENT_UP : KEY_EVENT_DOWN);
+        }
+        errors += trial_errors;
+    }
+    return errors;
+}
+
+static int long_press(void)
+{
+    rig_t rig;
+    int errors = 0;
+    rig_init(&rig);
+    // a tap just under the long press time
+    matrix_set(&rig.matrix, 0, 1, rig.now_ms);
+    rig_run(&rig, KEYPAD_LONG_PRESS_MS - 50);
+    matrix_set(&rig.matrix, 0, 0, rig.now_ms);
+    rig_run(&rig, 100);
+    // held for three times as long
+    matrix_set(&rig.matrix, 0, 1, rig.now_ms);
+    rig_run(&rig, 3 * KEYPAD_LONG_PRESS_MS);
+    matrix_set(&rig.matrix, 0, 0, rig.now_ms);
+    rig_run(&rig, 100);
+    errors += expect("long", &rig, 0, 0, KEY_EVENT_DOWN);
+    errors += expect("long", &rig, 1, 0, KEY_EVENT_UP);
+    errors += expect("long", &rig, 2, 0, KEY_EVENT_DOWN);
+    errors += expect("long", &rig, 3, 0, KEY_EVENT_LONG);
+    errors += expect("long", &rig, 4, 0, KEY_EVENT_UP);
+    errors += expect_count("long", &rig, 5);
+    if(rig.events.count == 5 && rig.events.event[3].time_ms - rig.events.event[2].time_ms != KEYPAD_LONG_PRESS_MS){
+        printf("long: LONG %u ms after DOWN\n", (unsigned)(rig.events.event[3].time_ms - rig.events.event[2].time_ms));
+        errors++;
+    }
+    return errors;
+}
+
+static int rollover(void)
+{
+    // same row, same column, neither
+    static const uint8_t pairs[][2] = {{0, 3}, {1, 13}, {6, 9}};
+    int errors = 0;
+    for(int p = 0; p < 3; p++){
+        rig_t rig;
+        uint8_t a = pairs[p][0], b = pairs[p][1];
+        rig_init(&rig);
+        matrix_set(&rig.matrix, a, 1, rig.now_ms);
+        rig_run(&rig, 50);
+        matrix_set(&rig.matrix, b, 1, rig.now_ms);
+        rig_run(&rig, 50);
+        matrix_set(&rig.matrix, a, 0, rig.now_ms);
+        rig_run(&rig, 50);
+        matrix_set(&rig.matrix, b, 0, rig.now_ms);
+        rig_run(&rig, 50);
+        errors += expect("rollover", &rig, 0, a, KEY_EVENT_DOWN);
+        errors += expect("rollover", &rig, 1, b, KEY_EVENT_DOWN);
+        errors += expect("rollover", &rig, 2, a, KEY_EVENT_UP);
+        errors += expect("rollover", &rig, 3, b, KEY_EVENT_UP);
+        errors += expect_count("rollover", &rig, 4);
+    }
+    return errors;
+}
+
+static int ghost(void)
+{
+    // rows 1 and 2, columns 0 and 2: keys 4, 6 and 8 make 10 read closed
+    rig_t rig;
+    int errors = 0;
+    rig_init(&rig);
+    matrix_set(&rig.matrix, 4, 1, rig.now_ms);
+    rig_run(&rig, 50);
+    matrix_set(&rig.matrix, 6, 1, rig.now_ms);
+    rig_run(&rig, 50);
+    matrix_set(&rig.matrix, 8, 1, rig.now_ms);
+    rig_run(&rig, 200);
+    for(int i = 0; i < rig.events.count; i++){
+        if(rig.events.event[i].key == 10){
+            printf("ghost: phantom %s on key 10\n", type_names[rig.events.event[i].type]);
+            errors++;
+        }
+    }
+    if(rig.scan.ghosted == 0){
+        printf("ghost: no sample counted as ambiguous\n");
+        errors++;
+    }
+    // the third key is reported once the rectangle is gone
+    matrix_set(&rig.matrix, 4, 0, rig.now_ms);
+    rig_run(&rig, 100);
+    matrix_set(&rig.matrix, 6, 0, rig.now_ms);
+    matrix_set(&rig.matrix, 8, 0, rig.now_ms);
+    rig_run(&rig, 100);
+    int downs = 0, ups = 0;
+    for(int i = 0; i < rig.events.count; i++){
+        errors += rig.events.event[i].key == 10;
+        downs += rig.events.event[i].type == KEY_EVENT_DOWN;
+        ups += rig.events.event[i].type == KEY_EVENT_UP;
+    }
+    if(downs != 3 || ups != 3){
+        printf("ghost: %d DOWN and %d UP, expected 3 each\n", downs, ups);
+        errors++;
+    }
+    return errors;
+}
+
+/* Random timelines */
+
+// True when the held keys put three corners of a rectangle down
+static int rectangle(uint16_t held)
+{
+    return matrix_read(held) != held;
+}
+
+static int random_timeline(int n)
+{
+    rig_t rig;
+    uint16_t expected_long = 0;
+    uint32_t down_ms[KEYPAD_KEYS] = {0};
+    // per key, the events the script should produce
+    key_event_type_t script[KEYPAD_KEYS][EVENTS_MAX / 4];
+    int script_len[KEYPAD_KEYS] = {0};
+    int errors = 0;
+
+    rig_init(&rig);
+    for(int step = 0; step < 40; step++){
+        uint8_t key = next_random() % KEYPAD_KEYS;
+        uint16_t bit = 1 << key;
+        uint16_t next = rig.matrix.held ^ bit;
+        int count = __builtin_popcount(next);
+        if(count <= 3 && !rectangle(next) && script_len[key] < EVENTS_MAX / 4 - 3){
+            if(next & bit){
+                down_ms[key] = rig.now_ms;
+                script[key][script_len[key]++] = KEY_EVENT_DOWN;
+                expected_long &= ~bit;
+            }
+            else{
+                script[key][script_len[key]++] = KEY_EVENT_UP;
+            }
+            matrix_set(&rig.matrix, key, (next & bit) != 0, rig.now_ms);
+        }
+        // settle well past the bounce, sometimes long enough for LONG
+        uint32_t wait = next_random() % 4 == 0 ? KEYPAD_LONG_PRESS_MS + 100 : 30 + next_random() % 300;
+        rig_run(&rig, wait);
+        // a key released now may or may not send LONG, hold it until it certainly has
+        for(uint8_t k = 0; k < KEYPAD_KEYS; k++){
+            uint32_t held_ms = rig.now_ms - down_ms[k];
+            if((rig.matrix.held & (1 << k)) && held_ms + LONG_SLACK_MS >= KEYPAD_LONG_PRESS_MS
+               && held_ms < KEYPAD_LONG_PRESS_MS + LONG_SLACK_MS){
+                rig_run(&rig, KEYPAD_LONG_PRESS_MS + LONG_SLACK_MS - held_ms);
+            }
+        }
+        for(uint8_t k = 0; k < KEYPAD_KEYS; k++){
+            uint16_t b = 1 << k;
+            if((rig.matrix.held & b) && !(expected_long & b)
+               && rig.now_ms - down_ms[k] >= KEYPAD_LONG_PRESS_MS + LONG_SLACK_MS){
+                script[k][script_len[k]++] = KEY_EVENT_LONG;
+                expected_long |= b;
+            }
+        }
+    }
+    for(uint8_t k = 0; k < KEYPAD_KEYS; k++){
+        matrix_set(&rig.matrix, k, 0, rig.now_ms);
+        if(script_len[k] > 0 && script[k][script_len[k] - 1] != KEY_EVENT_UP){
+            script[k][script_len[k]++] = KEY_EVENT_UP;
+        }
+    }
+    rig_run(&rig, 200);
+
+    for(uint8_t k = 0; k < KEYPAD_KEYS; k++){
+        int got = 0;
+        for(int i = 0; i < rig.events.count; i++){
+            const key_event_t *e = &rig.events.event[i];
+            if(e->key != k){
+                continue;
+            }
+            if(got >= script_len[k] || e->type != script[k][got]){
+                errors++;
+                break;
+            }
+            got++;
+        }
+        if(got != script_len[k]){
+            errors++;
+        }
+    }
+    if(errors > 0){
+        printf("random: timeline %d, events do not match the script\n", n);
+    }
+    if(rig.busy){
+        printf("random: timeline %d, scanner still busy with every key up\n", n);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int timelines = argc > 1 ? atoi(argv[1]) : 2000;
+    int failed = 0;
+
+    failed += clean() != 0;
+    failed += bounce() != 0;
+    failed += long_press() != 0;
+    failed += rollover() != 0;
+    failed += ghost() != 0;
+    int random_failed = 0;
+    for(int n = 0; n < timelines; n++){
+        random_failed += random_timeline(n) != 0;
+    }
+    printf("random: %d timelines, %d failed\n", timelines, random_failed);
+    failed += random_failed;
+    printf("%s\n", failed ? "FAILED" : "all passed");
+    return failed != 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Host test of the macro key engine (Station/main/macro.c).
+ *
+ * Key timelines use the keypad labels of multitap_test with the Station's
+ * prefix key, '#' on the SEND key, and check what macro_event makes of every
+ * event: '.' passed on, '-' taken, or the label of the macro fired.
+ *
+ *   #2      prefix, then "2def"        the macro of 2 fires on its press
+ *   2!      a long press of 2          the macro of 2 fires on the LONG
+ *
+ * Labels: 0-9 . + as printed, D delete, C clear, # prefix, N next; '!' after
+ * a label holds it past the long press time. Upper case "I" before a label
+ * marks it as pressed while something is being composed. Random timelines
+ * then check the engine against a plain model of the two rules.
+ *
+ *   cc -O2 -I../../Station/main macro_test.c ../../Station/main/macro.c -o macro_test
+ *   ./macro_test [random timelines]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+
+// Station.c settings
+#define MACRO_PREFIX_KEY 14
+
+static const char labels[KEYPAD_KEYS + 1] = "123.456+789DC0#N";
+
+static uint32_t rng = 0x2545F491;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Frame of a key's macro: its label and number, so a fire says which slot it came from
+static size_t macro_frame(uint8_t key, uint8_t *frame)
+{
+    return snprintf((char *)frame, MACRO_MAX_FRAME, "1%c macro %u", labels[key], key);
+}
+
+// Macros on 1, 2, 3, 0 and N, like the built-in ones and one on a key with its own long press
+static void table_init(macro_table_t *table)
+{
+    static const uint8_t keys[] = {0, 1, 2, 13, 15};
+    uint8_t frame[MACRO_MAX_FRAME];
+    macro_init(table, MACRO_PREFIX_KEY);
+    for(size_t i = 0; i < sizeof(keys); i++){
+        macro_set(table, keys[i], frame, macro_frame(keys[i], frame));
+    }
+}
+
+static char event_result(macro_table_t *table, uint8_t key, key_event_type_t type, bool idle, int *bad)
+{
+    key_event_t event = { .key = key, .type = type };
+    const macro_t *fire;
+    uint8_t frame[MACRO_MAX_FRAME];
+
+    switch(macro_event(table, &event, idle, &fire)){
+        case MACRO_PASS:
+            *bad += fire != NULL;
+            return '.';
+        case MACRO_TAKEN:
+            *bad += fire != NULL;
+            return '-';
+        case MACRO_FIRE:
+            // the slot of the key that fired, with its frame intact
+            if(fire == NULL || fire != macro_get(table, key) || fire->len != macro_frame(key, frame)
+               || memcmp(fire->frame, frame, fire->len) != 0){
+                (*bad)++;
+                return '?';
+            }
+            return labels[key];
+    }
+    (*bad)++;
+    return '?';
+}
+
+// Results of DOWN, LONG if held, and UP per key; -1 when the timeline does not parse, else the wrong macros
+static int play(const char *timeline, char *out)
+{
+    macro_table_t table;
+    int bad = 0;
+    table_init(&table);
+    for(const char *p = timeline; *p;){
+        if(*p == ' '){
+            *out++ = *p++;
+            continue;
+        }
+        bool idle = *p != 'I';
+        p += !idle;
+        const char *label = strchr(labels, *p);
+        if(*p == 0 || label == NULL){
+            *out = 0;
+            return -1;
+        }
+        uint8_t key = label - labels;
+        bool held = p[1] == '!';
+        p += 1 + held;
+
+        *out++ = event_result(&table, key, KEY_EVENT_DOWN, idle, &bad);
+        if(held){
+            *out++ = event_result(&table, key, KEY_EVENT_LONG, idle, &bad);
+        }
+        *out++ = event_result(&table, key, KEY_EVENT_UP, idle, &bad);
+    }
+    *out = 0;
+    return bad;
+}
+
+typedef struct {
+    const char *timeline;
+    const char *expected;
+} case_t;
+
+static const case_t cases[] = {
+    // prefix
+    {"#2", "--2-"},
+    {"#1 #3", "--1- --3-"},
+    {"#4", "----"},                 // no macro, the key is swallowed
+    {"##", "----"},                 // the prefix again cancels
+    {"## 2", "---- .."},
+    {"#2!", "--2--"},               // the long press of the combination's key is the engine's
+    {"#! 2", "--- 2-"},             // holding the prefix arms it all the same
+    {"I#2", "...."},                // only on an empty composer
+    {"#I2", "--2-"},                // armed, the composer does not matter any more
+    {"#N", "--N-"},
+    // long press
+    {"2!", ".2."},
+    {"4!", "..."},
+    {"I2!", "..."},
+    {"N!", ".N."},
+    {"D!", "..."},
+    {"#D!", "-----"},
+    {"2 2!", ".. .2."},
+    // ordinary keys
+    {"4 5 6", ".. .. .."},
+    {"2 3", ".. .."},
+};
+
+static int timelines(void)
+{
+    int failed = 0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        char got[128];
+        int bad = play(cases[i].timeline, got);
+        if(bad < 0){
+            printf("\"%s\": does not parse\n", cases[i].timeline);
+            failed++;
+        }
+        else if(bad > 0 || strcmp(got, cases[i].expected) != 0){
+            printf("\"%s\": \"%s\", expected \"%s\"%s\n", cases[i].timeline, got, cases[i].expected,
+                   bad ? ", wrong macro" : "");
+            failed++;
+        }
+    }
+    printf("timelines: %d cases, %d failed\n", (int)(sizeof(cases) / sizeof(cases[0])), failed);
+    return failed;
+}
+
+static int table(void)
+{
+    macro_table_t table;
+    uint8_t frame[MACRO_MAX_FRAME + 1] = {0};
+    int failed = 0;
+
+    macro_init(&table, MACRO_PREFIX_KEY);
+    failed += macro_set(&table, MACRO_PREFIX_KEY, frame, 4) != MACRO_ERR_SLOT;
+    failed += macro_set(&table, MACRO_SLOTS, frame, 4) != MACRO_ERR_SLOT;
+    failed += macro_set(&table, 3, frame, 0) != MACRO_ERR_SIZE;
+    failed += macro_set(&table, 3, frame, MACRO_MAX_FRAME + 1) != MACRO_ERR_SIZE;
+    failed += macro_get(&table, 3) != NULL;
+    failed += macro_set(&table, 3, frame, MACRO_MAX_FRAME) != MACRO_OK;
+    failed += macro_get(&table, 3) == NULL || macro_get(&table, 3)->len != MACRO_MAX_FRAME;
+    failed += macro_get(&table, MACRO_NO_KEY) != NULL;
+    macro_remove(&table, 3);
+    failed += macro_get(&table, 3) != NULL;
+    macro_remove(&table, MACRO_NO_KEY);
+    if(failed){
+        printf("table: %d checks failed\n", failed);
+    }
+    return failed;
+}
+
+/*
+ * The rules on their own: a DOWN of the prefix on an empty composer arms,
+ * the next DOWN fires its key's macro or is swallowed, and the rest of both
+ * presses is swallowed with it. A LONG fires the key's macro on an empty
+ * composer when nothing is armed.
+ */
+typedef struct {
+    bool armed;
+    int held;       // key whose LONG and UP are swallowed, -1 for none
+} model_t;
+
+static macro_result_t model_event(model_t *m, const macro_table_t *table, uint8_t key, key_event_type_t type,
+                                  bool idle)
+{
+    bool has_macro = key != MACRO_PREFIX_KEY && table->slot[key].len > 0;
+    if(type != KEY_EVENT_DOWN){
+        if(key == m->held){
+            return MACRO_TAKEN;
+        }
+        return type == KEY_EVENT_LONG && idle && !m->armed && has_macro ? MACRO_FIRE : MACRO_PASS;
+    }
+    m->held = -1;
+    if(m->armed){
+        m->armed = false;
+        m->held = key;
+        return has_macro ? MACRO_FIRE : MACRO_TAKEN;
+    }
+    if(idle && key == MACRO_PREFIX_KEY){
+        m->armed = true;
+        m->held = key;
+        return MACRO_TAKEN;
+    }
+    return MACRO_PASS;
+}
+
+static int random_timeline(int n)
+{
+    macro_table_t table;
+    model_t model = { false, -1 };
+    int fires = 0;
+
+    table_init(&table);
+    for(int step = 0; step < 500; step++){
+        // the prefix often, so combinations happen
+        uint8_t key = next_random() % 3 == 0 ? MACRO_PREFIX_KEY : next_random() % KEYPAD_KEYS;
+        bool held = next_random() % 4 == 0;
+        bool idle = next_random() % 3 != 0;
+        key_event_type_t types[3] = {KEY_EVENT_DOWN, KEY_EVENT_LONG, KEY_EVENT_UP};
+        for(int i = 0; i < 3; i++){
+            if(types[i] == KEY_EVENT_LONG && !held){
+                continue;
+            }
+            key_event_t event = { .key = key, .type = types[i] };
+            const macro_t *fire;
+            macro_result_t got = macro_event(&table, &event, idle, &fire);
+            macro_result_t expected = model_event(&model, &table, key, types[i], idle);
+            if(got != expected || (got == MACRO_FIRE) != (fire != NULL)
+               || (fire != NULL && fire != macro_get(&table, key))){
+                printf("random: timeline %d step %d, key %c %s: %d, expected %d\n", n, step, labels[key],
+                       i == 0 ? "down" : i == 1 ? "long" : "up", got, expected);
+                return 1;
+            }
+            fires += got == MACRO_FIRE;
+        }
+        if(table.armed != model.armed){
+            printf("random: timeline %d step %d, armed %d, expected %d\n", n, step, table.armed, model.armed);
+            return 1;
+        }
+    }
+    return fires == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int randoms = argc > 1 ? atoi(argv[1]) : 2000;
+    int failed = table();
+    failed += timelines();
+    int random_failed = 0;
+    for(int n = 0; n < randoms; n++){
+        random_failed += random_timeline(n);
+    }
+    printf("random: %d timelines, %d failed\n", randoms, random_failed);
+    failed += random_failed;
+    printf("%s\n", failed ? "FAILED" : "all passed");
+    return failed != 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Host benchmark of the display mirror encoder (components/terminal_link/link_mirror.c).
+ *
+ * Runs the Station's display code (Station/main/display.c) on the emulated
+ * panel of tools/panel_emu, feeds every flushed area to mirror_encode the way
+ * the Station's mirror_flush does and applies the messages to a viewer's
+ * copy of the screen with mirror_view_apply. After every frame the copy has
+ * to match what the glass shows, message log band scrolled by the controller
+ * included. Reports per frame the areas and pixels flushed, the bytes they
+ * would take raw and encoded and the encoder's time per area and per pixel,
+ * and how long the messages take at the Station's MIRROR_BUDGET_BYTES_S.
+ *
+ * The last frames go through a backlog of MIRROR_BACKLOG_BYTES that is only
+ * drained between frames, like a slow link would, and redraw what was
+ * dropped until the copy has caught up.
+ *
+ *   LV=../../Station/components/lvgl-release-v8.3
+ *   LINK=../../components/terminal_link
+ *   ILI=../../Station/managed_components/espressif__esp_lcd_ili9341
+ *   EMU=../panel_emu
+ *   cc -O2 -DLV_CONF_SKIP -DLV_COLOR_16_SWAP=1 -DESP_LCD_ILI9341_VER_MAJOR=1 -DESP_LCD_ILI9341_VER_MINOR=2 -DESP_LCD_ILI9341_VER_PATCH=0 \
+ *      -I$EMU/idf -I$EMU -I../../Station/main -I$ILI/include -I$LV -I$LINK/include \
+ *      mirror_bench.c $EMU/panel_emu.c ../../Station/main/display.c ../../Station/main/scroll_log.c \
+ *      $ILI/esp_lcd_ili9341.c $LINK/link_mirror.c $(find $LV/src -name '*.c') -o mirror_bench
+ *   ./mirror_bench
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "lvgl.h"
+#include "display.h"
+#include "panel_emu.h"
+#include "link_mirror.h"
+
+// Station.c settings
+#define MIRROR_BUDGET_BYTES_S 16000
+#define MIRROR_BACKLOG_BYTES 4096
+
+static mirror_enc_t enc;
+static mirror_view_t view;
+
+static struct {
+    uint32_t areas;
+    uint64_t pixels;
+    uint64_t bytes;
+    uint64_t encode_ns;
+    uint32_t refused;
+} frame_stats;
+
+static size_t backlog;      // bytes waiting, 0 and unlimited when not bounded
+static bool bounded;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Messages are applied right away, so the copy is as far as the link would get
+static bool emit(void *ctx, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    if(bounded && backlog + len + 2 > MIRROR_BACKLOG_BYTES){
+        frame_stats.refused++;
+        return false;
+    }
+    backlog += len + 2;
+    frame_stats.bytes += len;
+    if(mirror_view_apply(&view, msg, len) != MIRROR_OK){
+        printf("message the viewer cannot apply\n");
+    }
+    return true;
+}
+
+// Stands in for the Station's mirror_flush
+static void mirror_flushed(const lv_area_t *area, const lv_color_t *pixels, size_t stride, bool last)
+{
+    uint64_t start = now_ns();
+    mirror_encode(&enc, area->x1, area->y1, area->x2, area->y2, (const uint16_t *)pixels, stride, last, emit, NULL);
+    frame_stats.encode_ns += now_ns() - start;
+    frame_stats.areas++;
+    frame_stats.pixels += lv_area_get_size(area);
+}
+
+// The viewer gets LVGL's byte swapped pixels, the glass shows them in order
+static int check(const char *name)
+{
+    for(int y = 0; y < DISPLAY_VER_RES; y++){
+        for(int x = 0; x < DISPLAY_HOR_RES; x++){
+            uint16_t pixel = view.pixels[y * MIRROR_MAX_WIDTH + x];
+            if((uint16_t)(pixel >> 8 | pixel << 8) != panel_emu_pixel(x, y)){
+                printf("%s: viewer differs at %d,%d\n", name, x, y);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static uint64_t total_bytes, total_raw;
+
+static int frame(const char *name)
+{
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    backlog = 0;
+    lv_refr_now(NULL);
+    uint64_t raw = frame_stats.pixels * 2;
+    total_raw += raw;
+    total_bytes += frame_stats.bytes;
+    printf("%-16s %3u areas %6llu px %7llu raw %6llu sent %6.1fx  %6.1f us/area %5.1f ns/px  %7.1f ms at budget\n",
+           name, (unsigned)frame_stats.areas, (unsigned long long)frame_stats.pixels,
+           (unsigned long long)raw, (unsigned long long)frame_stats.bytes,
+           frame_stats.bytes > 0 ? (double)raw / frame_stats.bytes : 0.0,
+           frame_stats.areas > 0 ? frame_stats.encode_ns / 1e3 / frame_stats.areas : 0.0,
+           frame_stats.pixels > 0 ? (double)frame_stats.encode_ns / frame_stats.pixels : 0.0,
+           frame_stats.bytes * 1000.0 / MIRROR_BUDGET_BYTES_S);
+    return check(name);
+}
+
+// Redraw what the full backlog left out until nothing is, like the Station's display task
+static int catch_up(const char *name)
+{
+    mirror_rect_t dirty;
+    int rounds = 0;
+    uint64_t bytes = 0;
+    while(mirror_take_dirty(&enc, &dirty)){
+        lv_area_t area = {dirty.x1, dirty.y1, dirty.x2, dirty.y2};
+        lv_obj_invalidate_area(lv_scr_act(), &area);
+        memset(&frame_stats, 0, sizeof(frame_stats));
+        backlog = 0;
+        lv_refr_now(NULL);
+        bytes += frame_stats.bytes;
+        if(++rounds > 100){
+            printf("%s: never caught up\n", name);
+            return 1;
+        }
+    }
+    printf("%-16s caught up after %d redraws of the dropped rows, %llu bytes\n", name, rounds, (unsigned long long)bytes);
+    return check(name);
+}
+
+int main(void)
+{
+    // the Station's 320 wide rows on the glass, in the 320 rows the controller scrolls
+    panel_emu_config_t config = PANEL_EMU_CONFIG_ILI9341;
+    config.columns = 320;
+    panel_emu_init(&config);
+    display_initialize(DISPLAY_BUFFER_PINGPONG, mirror_flushed);
+    display_screen_t screen;
+    display_screen_create(&screen);
+    lv_obj_add_state(screen.text_area, LV_STATE_FOCUSED);
+    mirror_enc_init(&enc, DISPLAY_HOR_RES, DISPLAY_VER_RES);
+    mirror_view_init(&view);
+    uint8_t msg[8];
+    mirror_view_apply(&view, msg, mirror_screen_msg(&enc, msg));
+    display_set_watched(true);
+
+    int failed = frame("first_frame");
+    lv_textarea_add_text(screen.text_area, "a");
+    failed |= frame("key");
+    message_log_add("Komunikat: pomiar gotowy");
+    failed |= frame("log_line");
+    message_log_add("Drugi komunikat, dosc dlugi zeby zawinac sie do nastepnej linii logu");
+    failed |= frame("log_wrapped");
+    lv_tick_inc(500);
+    lv_timer_handler();     // cursor blink
+    failed |= frame("cursor");
+    lv_label_set_text(screen.socket_status, "soc_status: -1");
+    failed |= frame("socket_status");
+    lv_obj_invalidate(lv_scr_act());
+    failed |= frame("same_screen");
+    mirror_enc_reset(&enc);
+    lv_obj_invalidate(lv_scr_act());
+    failed |= frame("viewer_refresh");
+    printf("%-16s %llu raw, %llu sent, %.1fx\n", "all", (unsigned long long)total_raw,
+           (unsigned long long)total_bytes, (double)total_raw / total_bytes);
+
+    // unwatched only the new line is flushed, the rest moves on the glass alone
+    display_set_watched(false);
+    message_log_add("Komunikat bez lustra");
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    lv_refr_now(NULL);
+    printf("%-16s %u areas %6llu px, ", "log_unwatched", (unsigned)frame_stats.areas,
+           (unsigned long long)frame_stats.pixels);
+    if(check("log_unwatched") == 0){
+        printf("log_unwatched: viewer matches without the log redrawn, the scroll is not covered\n");
+        failed = 1;
+    }
+    display_set_watched(true);
+    lv_obj_invalidate(lv_scr_act());
+    failed |= frame("log_rewatched");
+
+    bounded = true;
+    mirror_enc_reset(&enc);
+    lv_obj_invalidate(lv_scr_act());
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    backlog = 0;
+    lv_refr_now(NULL);
+    printf("%-16s %u messages refused by a %d byte backlog\n", "slow_link", (unsigned)frame_stats.refused, MIRROR_BACKLOG_BYTES);
+    failed |= catch_up("slow_link");
+    lv_textarea_add_text(screen.text_area, "bcdefghijklmnopqrstuvwxyz0123456789");
+    message_log_add("Komunikat: drugi pomiar gotowy, wilgotnosc 45");
+    backlog = 0;
+    lv_refr_now(NULL);
+    failed |= catch_up("slow_link_text");
+    return failed;
+}
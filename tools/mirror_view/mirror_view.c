@@ -0,0 +1,137 @@
+/*
+ * Viewer of the Station's display mirror (components/terminal_link/link_mirror.h).
+ *
+ * Connects to the AP's MIRROR_VIEWER_PORT, applies the messages the AP
+ * relays to a copy of the screen and writes it as a PPM every time the
+ * Station finishes a refresh. The file is replaced in one rename, so an
+ * image viewer that reloads it (feh --reload 0.2 mirror.ppm) follows the
+ * screen. Reconnects when the AP goes away; the AP asks the Station for the
+ * whole screen whenever a viewer connects.
+ *
+ *   LINK=../../components/terminal_link
+ *   cc -O2 -I$LINK/include mirror_view.c $LINK/link_mirror.c -o mirror_view
+ *   ./mirror_view [ap_ip] [out.ppm] [scale]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "link_mirror.h"
+
+static mirror_view_t view;
+
+static int read_all(int fd, uint8_t *data, size_t len)
+{
+    while(len > 0){
+        ssize_t r = read(fd, data, len);
+        if(r <= 0){
+            return -1;
+        }
+        data += r;
+        len -= r;
+    }
+    return 0;
+}
+
+static int write_ppm(const char *path, int scale)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if(f == NULL){
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", view.width * scale, view.height * scale);
+    uint8_t *line = malloc(view.width * scale * 3);
+    for(int y = 0; y < view.height; y++){
+        for(int x = 0; x < view.width; x++){
+            // RGB565 high byte first, as the Station sends it to the panel
+            const uint8_t *p = (const uint8_t *)&view.pixels[y * MIRROR_MAX_WIDTH + x];
+            uint16_t c = p[0] << 8 | p[1];
+            uint8_t r = (c >> 11) * 255 / 31, g = (c >> 5 & 63) * 255 / 63, b = (c & 31) * 255 / 31;
+            for(int s = 0; s < scale; s++){
+                uint8_t *o = &line[(x * scale + s) * 3];
+                o[0] = r;
+                o[1] = g;
+                o[2] = b;
+            }
+        }
+        for(int s = 0; s < scale; s++){
+            fwrite(line, 3, view.width * scale, f);
+        }
+    }
+    free(line);
+    if(fclose(f) != 0){
+        return -1;
+    }
+    return rename(tmp, path);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Applies messages until the connection ends
+static void follow(int fd, const char *path, int scale)
+{
+    static uint8_t msg[65536];
+    uint64_t bytes = 0;
+    uint32_t frames = 0, errors = 0;
+    double since = now_s();
+    while(1){
+        uint8_t len[2];
+        if(read_all(fd, len, 2) != 0 || read_all(fd, msg, len[0] | len[1] << 8) != 0){
+            return;
+        }
+        size_t n = len[0] | len[1] << 8;
+        bytes += n + 2;
+        uint32_t before = view.frames;
+        if(mirror_view_apply(&view, msg, n) != MIRROR_OK){
+            errors++;
+        }
+        if(view.frames != before && view.width > 0){
+            frames++;
+            if(write_ppm(path, scale) != 0){
+                fprintf(stderr, "cannot write %s\n", path);
+            }
+        }
+        double elapsed = now_s() - since;
+        if(elapsed >= 5){
+            printf("%.0f B/s, %.1f refreshes/s, %u bad messages\n", bytes / elapsed, frames / elapsed, (unsigned)errors);
+            bytes = 0;
+            frames = 0;
+            since += elapsed;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *ip = argc > 1 ? argv[1] : "192.168.4.1";
+    const char *path = argc > 2 ? argv[2] : "mirror.ppm";
+    int scale = argc > 3 ? atoi(argv[3]) : 2;
+    struct sockaddr_in ap = { .sin_family = AF_INET, .sin_port = htons(MIRROR_VIEWER_PORT) };
+    if(scale < 1 || inet_pton(AF_INET, ip, &ap.sin_addr) != 1){
+        fprintf(stderr, "usage: %s [ap_ip] [out.ppm] [scale]\n", argv[0]);
+        return 1;
+    }
+    mirror_view_init(&view);
+    while(1){
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd >= 0 && connect(fd, (struct sockaddr *)&ap, sizeof(ap)) == 0){
+            printf("connected to %s:%d\n", ip, MIRROR_VIEWER_PORT);
+            follow(fd, path, scale);
+            printf("connection lost\n");
+        }
+        if(fd >= 0){
+            close(fd);
+        }
+        sleep(1);
+    }
+}
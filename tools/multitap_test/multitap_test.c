@@ -0,0 +1,320 @@
+/*
+ * Host test of the multi-tap text entry engine (Station/main/multitap.c).
+ *
+ * Key timelines are written as the keypad labels, with the Station's layout
+ * and timeout, and the resulting text is compared with '|' at the cursor:
+ *
+ *   2 2 2      three taps on "2def" within the timeout     e|
+ *   2 w800 2   the pause commits the first one             22|
+ *   5!         a long press                                5|
+ *
+ * Taps are 100 ms apart unless "wN" says otherwise; multitap_tick runs every
+ * 10 ms like the display task. Labels: 0-9 . + as printed, D delete, C clear,
+ * S send, N next; '!' after a label holds it past the long press time.
+ *
+ * Every edit reported through the callback is applied to a separate copy of
+ * the text, the way the text area follows along, and has to match the engine
+ * after every event. Random timelines check the same at the end.
+ *
+ *   cc -O2 -I../../Station/main multitap_test.c ../../Station/main/multitap.c \
+ *      ../../Station/main/gap_buffer.c -o multitap_test
+ *   ./multitap_test [random timelines]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "multitap.h"
+
+// Station.c settings
+#define KEYPAD_LONG_PRESS_MS 600
+#define MULTITAP_TIMEOUT_MS 800
+
+#define TAP_GAP_MS 100
+#define TAP_HOLD_MS 50
+#define TICK_MS 10
+
+static const multitap_key_t layout[KEYPAD_KEYS] = {
+    {MULTITAP_CHARS, "1abc"}, {MULTITAP_CHARS, "2def"}, {MULTITAP_CHARS, "3ghi"}, {MULTITAP_CHARS, ".,!?"},
+    {MULTITAP_CHARS, "4jkl"}, {MULTITAP_CHARS, "5mno"}, {MULTITAP_CHARS, "6pqr"}, {MULTITAP_CHARS, "+-*/"},
+    {MULTITAP_CHARS, "7stu"}, {MULTITAP_CHARS, "8vwx"}, {MULTITAP_CHARS, "9yz$"}, {MULTITAP_DELETE, NULL},
+    {MULTITAP_CLEAR, NULL},   {MULTITAP_CHARS, "0 _="}, {MULTITAP_SEND_KEY, NULL}, {MULTITAP_NEXT, NULL}
+};
+static const char labels[KEYPAD_KEYS + 1] = "123.456+789DC0SN";
+
+static uint32_t rng = 0x6C078965;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// The text as the edit callback describes it
+typedef struct {
+    char text[MULTITAP_MAX_TEXT + 1];
+    int len;
+    int cursor;
+    int errors;     // edits that made no sense at the time
+} mirror_t;
+
+static void mirror_edit(void *ctx, uint8_t edit, char c)
+{
+    mirror_t *m = ctx;
+    switch(edit){
+        case MULTITAP_EDIT_INSERT:
+            if(m->len >= MULTITAP_MAX_TEXT){
+                m->errors++;
+                return;
+            }
+            memmove(&m->text[m->cursor + 1], &m->text[m->cursor], m->len - m->cursor);
+            m->text[m->cursor++] = c;
+            m->len++;
+            break;
+        case MULTITAP_EDIT_BACKSPACE:
+            if(m->cursor == 0){
+                m->errors++;
+                return;
+            }
+            memmove(&m->text[m->cursor - 1], &m->text[m->cursor], m->len - m->cursor);
+            m->cursor--;
+            m->len--;
+            break;
+        case MULTITAP_EDIT_LEFT:
+            m->errors += m->cursor == 0;
+            m->cursor -= m->cursor > 0;
+            break;
+        case MULTITAP_EDIT_RIGHT:
+            m->errors += m->cursor == m->len;
+            m->cursor += m->cursor < m->len;
+            break;
+        case MULTITAP_EDIT_CLEAR:
+            m->len = 0;
+            m->cursor = 0;
+            break;
+    }
+    m->text[m->len] = 0;
+}
+
+typedef struct {
+    multitap_t mt;
+    mirror_t mirror;
+    uint32_t now_ms;
+    int sends;
+    int mismatches;     // engine and mirror disagreed after an event
+} rig_t;
+
+static void rig_init(rig_t *rig)
+{
+    memset(rig, 0, sizeof(*rig));
+    rig->now_ms = 10000;
+    multitap_init(&rig->mt, layout, MULTITAP_TIMEOUT_MS, mirror_edit, &rig->mirror);
+}
+
+// Engine text with '|' at the cursor
+static void rig_text(const rig_t *rig, char *out)
+{
+    char text[MULTITAP_MAX_TEXT + 1];
+    uint16_t len = multitap_text(&rig->mt, text, sizeof(text));
+    uint16_t cursor = gap_cursor(&rig->mt.text);
+    memcpy(out, text, cursor);
+    out[cursor] = '|';
+    memcpy(&out[cursor + 1], &text[cursor], len - cursor + 1);
+}
+
+static void rig_check(rig_t *rig)
+{
+    char text[MULTITAP_MAX_TEXT + 1];
+    multitap_text(&rig->mt, text, sizeof(text));
+    if(strcmp(text, rig->mirror.text) != 0 || gap_cursor(&rig->mt.text) != rig->mirror.cursor){
+        rig->mismatches++;
+    }
+}
+
+static void rig_event(rig_t *rig, uint8_t key, key_event_type_t type)
+{
+    key_event_t event = { .key = key, .type = type, .time_ms = rig->now_ms };
+    if(multitap_event(&rig->mt, &event) & MULTITAP_SEND){
+        rig->sends++;
+    }
+    rig_check(rig);
+}
+
+static void rig_wait(rig_t *rig, uint32_t ms)
+{
+    for(uint32_t end = rig->now_ms + ms; rig->now_ms < end;){
+        uint32_t step = end - rig->now_ms < TICK_MS ? end - rig->now_ms : TICK_MS;
+        rig->now_ms += step;
+        multitap_tick(&rig->mt, rig->now_ms);
+        rig_check(rig);
+    }
+}
+
+// Play a timeline, false when it does not parse
+static int rig_play(rig_t *rig, const char *timeline)
+{
+    uint32_t gap = 0;
+    for(const char *p = timeline; *p;){
+        if(*p == ' '){
+            p++;
+            continue;
+        }
+        if(*p == 'w'){
+            gap = strtoul(p + 1, (char **)&p, 10);
+            continue;
+        }
+        const char *label = strchr(labels, *p);
+        if(label == NULL){
+            return 0;
+        }
+        uint8_t key = label - labels;
+        int held = p[1] == '!';
+        p += 1 + held;
+
+        rig_wait(rig, gap);
+        rig_event(rig, key, KEY_EVENT_DOWN);
+        if(held){
+            rig_wait(rig, KEYPAD_LONG_PRESS_MS);
+            rig_event(rig, key, KEY_EVENT_LONG);
+        }
+        rig_wait(rig, TAP_HOLD_MS);
+        rig_event(rig, key, KEY_EVENT_UP);
+        gap = TAP_GAP_MS - TAP_HOLD_MS;
+    }
+    return 1;
+}
+
+typedef struct {
+    const char *timeline;
+    const char *expected;   // '|' at the cursor
+    int sends;
+} case_t;
+
+static const case_t cases[] = {
+    // cycling and committing
+    {"2", "2|", 0},
+    {"2 2", "d|", 0},
+    {"2 2 2", "e|", 0},
+    {"2 2 2 2 2", "2|", 0},         // the cycle wraps around
+    {"2 3", "23|", 0},              // another key commits
+    {"2 2 N 2", "d2|", 0},          // so does NEXT
+    {"2 w700 2", "d|", 0},          // 750 ms after the last tap, still cycling
+    {"2 w750 2", "22|", 0},         // 800 ms, the timeout committed it
+    {"2 2 w2000", "d|", 0},
+    {"0 0", " |", 0},
+    {"4 4 4 4 0 0 4 4 4", "l k|", 0},
+    // long presses
+    {"5!", "5|", 0},
+    {"5 5!", "5|", 0},              // a long press always ends on the first character
+    {"4 w900 5!", "45|", 0},
+    {"5! 5", "55|", 0},             // the long press committed
+    // cursor
+    {"2 3 N!", "2|3", 0},
+    {"2 3 N! N!", "|23", 0},
+    {"2 3 N! N! N! 4", "4|23", 0},  // nothing left of the start
+    {"2 3 N! N! N", "2|3", 0},
+    {"2 3 N N N", "23|", 0},        // nothing right of the end
+    {"2 3 N! N! 4 4 w900 N", "j2|3", 0},
+    // deleting
+    {"2 3 D", "2|", 0},
+    {"2 3 w900 D", "2|", 0},
+    {"2 3 D D D", "|", 0},
+    {"2 3 N! D", "|3", 0},
+    {"2 3 D!", "|", 0},
+    {"2 3 C", "|", 0},
+    {"2 2 D 2", "2|", 0},           // the pending 'd' went away, a new tap starts over
+    // sending
+    {"2 2 S", "d|", 1},
+    {"2 S!", "2|", 1},              // the long press of SEND does nothing more
+    {"S", "|", 1},
+};
+
+static int timelines(void)
+{
+    int failed = 0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        rig_t rig;
+        char got[MULTITAP_MAX_TEXT + 2];
+        rig_init(&rig);
+        if(!rig_play(&rig, cases[i].timeline)){
+            printf("\"%s\": does not parse\n", cases[i].timeline);
+            failed++;
+            continue;
+        }
+        rig_wait(&rig, 2 * MULTITAP_TIMEOUT_MS);
+        rig_text(&rig, got);
+        if(strcmp(got, cases[i].expected) != 0 || rig.sends != cases[i].sends){
+            printf("\"%s\": \"%s\" %d sent, expected \"%s\" %d sent\n", cases[i].timeline, got, rig.sends,
+                   cases[i].expected, cases[i].sends);
+            failed++;
+        }
+        else if(rig.mismatches > 0 || rig.mirror.errors > 0){
+            printf("\"%s\": the edit callback does not follow the text\n", cases[i].timeline);
+            failed++;
+        }
+        else if(multitap_pending(&rig.mt)){
+            printf("\"%s\": still pending after the timeout\n", cases[i].timeline);
+            failed++;
+        }
+    }
+    printf("timelines: %d cases, %d failed\n", (int)(sizeof(cases) / sizeof(cases[0])), failed);
+    return failed;
+}
+
+// The text stops at MULTITAP_MAX_TEXT characters, typing and moving on past it edits nothing
+static int full(void)
+{
+    rig_t rig;
+    rig_init(&rig);
+    for(int i = 0; i < MULTITAP_MAX_TEXT + 20; i++){
+        rig_play(&rig, i % 2 ? "2" : "3");
+    }
+    rig_play(&rig, "N! N! 4");
+    uint16_t len = multitap_length(&rig.mt);
+    if(len != MULTITAP_MAX_TEXT || rig.mismatches > 0 || rig.mirror.errors > 0){
+        printf("full: %u characters, %d mismatches\n", len, rig.mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+static int random_timeline(int n)
+{
+    rig_t rig;
+    rig_init(&rig);
+    for(int step = 0; step < 300; step++){
+        uint8_t key = next_random() % KEYPAD_KEYS;
+        // mostly characters, clearing rarely so the text grows
+        if(key == 12 && next_random() % 8 != 0){
+            continue;
+        }
+        rig_event(&rig, key, KEY_EVENT_DOWN);
+        if(next_random() % 6 == 0){
+            rig_wait(&rig, KEYPAD_LONG_PRESS_MS);
+            rig_event(&rig, key, KEY_EVENT_LONG);
+        }
+        rig_event(&rig, key, KEY_EVENT_UP);
+        rig_wait(&rig, next_random() % 3 == 0 ? MULTITAP_TIMEOUT_MS + next_random() % 200 : next_random() % 300);
+    }
+    if(rig.mismatches > 0 || rig.mirror.errors > 0){
+        printf("random: timeline %d, %d mismatches, %d impossible edits\n", n, rig.mismatches, rig.mirror.errors);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int randoms = argc > 1 ? atoi(argv[1]) : 2000;
+    int failed = timelines();
+    failed += full();
+    int random_failed = 0;
+    for(int n = 0; n < randoms; n++){
+        random_failed += random_timeline(n);
+    }
+    printf("random: %d timelines, %d failed\n", randoms, random_failed);
+    failed += random_failed;
+    printf("%s\n", failed ? "FAILED" : "all passed");
+    return failed != 0;
+}
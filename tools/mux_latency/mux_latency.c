@@ -0,0 +1,350 @@
+/*
+ * Loopback latency benchmark of the channel multiplexer (link_mux.h).
+ *
+ * A writer thread runs the Station's link_tx_task loop over a TCP loopback
+ * connection: mux_tx_prepare, write, mux_tx_commit, paced to the link rate.
+ * The main thread keeps the bulk channel busy like an outbox replay, sends a
+ * text frame every 50 ms and a sensor frame every 20 ms. A reader thread plays
+ * the AP, reassembles and takes the time from push to delivery per class.
+ * The same traffic then goes through a single channel, the one ordered stream
+ * the link was before the multiplexer.
+ *
+ * Before timing, a check runs the prepare/commit path against a link whose
+ * writes fail at random: after every failure the partial message is rewound
+ * and the receiver starts over, like a reconnect. Every message has to be
+ * delivered once and whole, in order per channel.
+ *
+ *   mux_latency [-b kbit/s] [-t seconds]
+ *
+ * Defaults: 500 kbit/s, 3 seconds per mode. Build from this directory:
+ *
+ *   cc -O2 -pthread -I../../components/terminal_link/include mux_latency.c \
+ *      ../../components/terminal_link/link_mux.c -o mux_latency
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "link_mux.h"
+
+#define SENSOR_PERIOD_US 20000
+#define TEXT_PERIOD_US 50000
+#define TEXT_LEN 200
+#define BULK_LEN 255     // JOURNAL_MAX_RECORD
+#define SAMPLES_MAX 4096
+
+enum { CLASS_SENSOR, CLASS_TEXT, CLASS_BULK, CLASSES };
+static const char *const class_names[CLASSES] = {"sensor", "text", "bulk"};
+
+typedef struct {
+    double ms[SAMPLES_MAX];
+    int n;
+    int dropped;    // did not fit the channel queue
+} samples_t;
+
+static mux_tx_t tx;
+static mux_rx_t rx;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static samples_t samples[CLASSES];
+static volatile int running;
+static volatile int bulk_pending;
+static int tx_fd, rx_fd;
+static long link_bps = 500000;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// [0xAA][0x55][type][class][push time, 8 bytes][fill]
+static size_t make_frame(uint8_t *frame, int cls, size_t len, int64_t t)
+{
+    static const uint8_t types[CLASSES] = {'0', '1', '1'};
+    frame[0] = 0xAA;
+    frame[1] = 0x55;
+    frame[2] = types[cls];
+    frame[3] = cls;
+    memcpy(&frame[4], &t, sizeof(t));
+    memset(&frame[12], 'x', len - 12);
+    return len;
+}
+
+static void delivered(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    (void)channel;
+    int64_t t;
+    if(len < 12 || msg[3] >= CLASSES){
+        return;
+    }
+    memcpy(&t, &msg[4], sizeof(t));
+    samples_t *s = &samples[msg[3]];
+    if(s->n < SAMPLES_MAX){
+        s->ms[s->n++] = (now_us() - t) / 1000.0;
+    }
+    if(msg[3] == CLASS_BULK){
+        bulk_pending = 0;
+    }
+}
+
+// link_tx_task: one fragment at a time, consumed once written, at link_bps
+static void *writer(void *arg)
+{
+    (void)arg;
+    uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
+    int64_t next_us = now_us();
+    while(running){
+        pthread_mutex_lock(&lock);
+        size_t n = 0;
+        while(running && (n = mux_tx_prepare(&tx, fragment)) == 0){
+            pthread_cond_wait(&wake, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+        if(!running){
+            break;
+        }
+        int64_t now = now_us();
+        if(next_us > now){
+            usleep(next_us - now);
+        }
+        else{
+            next_us = now;
+        }
+        next_us += (int64_t)n * 8 * 1000000 / link_bps;
+        if(write(tx_fd, fragment, n) != (ssize_t)n){
+            perror("write");
+            exit(1);
+        }
+        pthread_mutex_lock(&lock);
+        mux_tx_commit(&tx);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    (void)arg;
+    uint8_t chunk[512];
+    ssize_t r;
+    while((r = read(rx_fd, chunk, sizeof(chunk))) > 0){
+        mux_rx_feed(&rx, chunk, r);
+    }
+    return NULL;
+}
+
+static void push(int channel, int cls, size_t len)
+{
+    uint8_t frame[BULK_LEN];
+    make_frame(frame, cls, len, now_us());
+    pthread_mutex_lock(&lock);
+    if(!mux_tx_push(&tx, channel, frame, len)){
+        samples[cls].dropped++;
+    }
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const char *mode, int single, int seconds)
+{
+    pthread_t w;
+    memset(samples, 0, sizeof(samples));
+    mux_tx_init(&tx);
+    bulk_pending = 0;
+    running = 1;
+    pthread_create(&w, NULL, writer, NULL);
+
+    int64_t start = now_us(), next_sensor = start, next_text = start;
+    while(now_us() - start < seconds * 1000000LL){
+        int64_t now = now_us();
+        if(now >= next_sensor){
+            push(single ? MUX_CH_BULK : MUX_CH_CONTROL, CLASS_SENSOR, 16);
+            next_sensor += SENSOR_PERIOD_US;
+        }
+        if(now >= next_text){
+            push(single ? MUX_CH_BULK : MUX_CH_TEXT, CLASS_TEXT, TEXT_LEN);
+            next_text += TEXT_PERIOD_US;
+        }
+        // outbox_task pushes the next record once the previous one went out
+        if(!bulk_pending){
+            bulk_pending = 1;
+            push(MUX_CH_BULK, CLASS_BULK, BULK_LEN);
+        }
+        usleep(1000);
+    }
+
+    pthread_mutex_lock(&lock);
+    running = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(w, NULL);
+    usleep(100000);     // let the reader take what is on the wire
+
+    for(int c = 0; c < CLASSES; c++){
+        samples_t *s = &samples[c];
+        if(s->n == 0){
+            printf("%-8s %-6s no deliveries, %d dropped\n", mode, class_names[c], s->dropped);
+            continue;
+        }
+        qsort(s->ms, s->n, sizeof(double), compare);
+        printf("%-8s %-6s %5d  p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms  dropped %d\n", mode, class_names[c],
+               s->n, s->ms[s->n / 2], s->ms[s->n * 99 / 100], s->ms[s->n - 1], s->dropped);
+    }
+}
+
+/* Fault check: writes fail at random, every message still arrives once */
+
+static uint32_t rng = 0x1234567;
+static uint32_t expected_next[MUX_CHANNELS];
+static int fault_errors;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// [number, 4 bytes][bytes derived from it]
+static void check_delivered(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    uint32_t number;
+    memcpy(&number, msg, 4);
+    for(size_t i = 4; i < len; i++){
+        if(msg[i] != (uint8_t)(number + i)){
+            fault_errors++;
+            return;
+        }
+    }
+    if(number != expected_next[channel]){
+        fault_errors++;
+    }
+    expected_next[channel] = number + 1;
+}
+
+static int fault_check(void)
+{
+    mux_tx_t ftx;
+    mux_rx_t frx;
+    uint8_t msg[MUX_MESSAGE_MAX];
+    uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
+    uint32_t pushed[MUX_CHANNELS] = {0};
+    int failures = 0;
+
+    mux_tx_init(&ftx);
+    mux_rx_init(&frx, check_delivered, NULL);
+    for(int step = 0; step < 200000; step++){
+        uint8_t c = next_random() % MUX_CHANNELS;
+        size_t len = 4 + next_random() % 300;
+        memcpy(msg, &pushed[c], 4);
+        for(size_t i = 4; i < len; i++){
+            msg[i] = (uint8_t)(pushed[c] + i);
+        }
+        if(next_random() % 4 == 0 && mux_tx_push(&ftx, c, msg, len)){
+            pushed[c]++;
+        }
+        size_t n = mux_tx_prepare(&ftx, fragment);
+        if(n == 0){
+            continue;
+        }
+        if(next_random() % 50 == 0){
+            // the write failed, possibly after part of the fragment went out
+            mux_rx_feed(&frx, fragment, next_random() % n);
+            mux_tx_rewind(&ftx);
+            mux_rx_reset(&frx);
+            failures++;
+            continue;
+        }
+        mux_rx_feed(&frx, fragment, n);
+        mux_tx_commit(&ftx);
+    }
+    while(1){
+        size_t n = mux_tx_prepare(&ftx, fragment);
+        if(n == 0){
+            break;
+        }
+        mux_rx_feed(&frx, fragment, n);
+        mux_tx_commit(&ftx);
+    }
+    for(int c = 0; c < MUX_CHANNELS; c++){
+        if(expected_next[c] != pushed[c]){
+            fault_errors++;
+        }
+    }
+    printf("fault check: %u messages, %d failed writes, %s\n",
+           pushed[0] + pushed[1] + pushed[2] + pushed[3], failures, fault_errors ? "WRONG" : "all delivered once");
+    return fault_errors;
+}
+
+static void open_loopback(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if(server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 1) != 0
+       || getsockname(server, (struct sockaddr *)&addr, &addr_len) != 0){
+        perror("listen");
+        exit(1);
+    }
+    tx_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(connect(tx_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+        perror("connect");
+        exit(1);
+    }
+    rx_fd = accept(server, NULL, NULL);
+    close(server);
+    setsockopt(tx_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 3;
+    int opt;
+    while((opt = getopt(argc, argv, "b:t:")) != -1){
+        switch(opt){
+            case 'b':
+                link_bps = atol(optarg) * 1000;
+                break;
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b kbit/s] [-t seconds]\n", argv[0]);
+                return 2;
+        }
+    }
+    if(fault_check() != 0){
+        return 1;
+    }
+
+    pthread_t r;
+    open_loopback();
+    mux_rx_init(&rx, delivered, NULL);
+    pthread_create(&r, NULL, reader, NULL);
+    printf("link %ld kbit/s, sensor every %d ms, text every %d ms, bulk backlog\n", link_bps / 1000,
+           SENSOR_PERIOD_US / 1000, TEXT_PERIOD_US / 1000);
+    run("channels", 0, seconds);
+    run("single", 1, seconds);
+    close(tx_fd);
+    pthread_join(r, NULL);
+    return 0;
+}
@@ -0,0 +1,40 @@
+/* Host stand-in for the ESP-IDF header of the same name, pins go nowhere */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+} gpio_mode_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+static inline esp_err_t gpio_config(const gpio_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    (void)gpio;
+    (void)level;
+    return ESP_OK;
+}
+
+static inline esp_err_t gpio_reset_pin(gpio_num_t gpio)
+{
+    (void)gpio;
+    return ESP_OK;
+}
@@ -0,0 +1,74 @@
+/* Host stand-in for the ESP-IDF header of the same name, the backlight PWM goes nowhere */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum {
+    LEDC_LOW_SPEED_MODE = 0,
+} ledc_mode_t;
+
+typedef enum {
+    LEDC_TIMER_0 = 0,
+} ledc_timer_t;
+
+typedef enum {
+    LEDC_CHANNEL_0 = 0,
+} ledc_channel_t;
+
+typedef enum {
+    LEDC_TIMER_8_BIT = 8,
+} ledc_timer_bit_t;
+
+typedef enum {
+    LEDC_AUTO_CLK = 0,
+} ledc_clk_cfg_t;
+
+typedef struct {
+    ledc_mode_t speed_mode;
+    ledc_timer_bit_t duty_resolution;
+    ledc_timer_t timer_num;
+    uint32_t freq_hz;
+    ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct {
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_channel_t channel;
+    int intr_type;
+    ledc_timer_t timer_sel;
+    uint32_t duty;
+    int hpoint;
+    struct {
+        unsigned int output_invert: 1;
+    } flags;
+} ledc_channel_config_t;
+
+static inline esp_err_t ledc_timer_config(const ledc_timer_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_channel_config(const ledc_channel_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+    (void)mode;
+    (void)channel;
+    (void)duty;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    (void)mode;
+    (void)channel;
+    return ESP_OK;
+}
@@ -0,0 +1,31 @@
+/* Host stand-in for the ESP-IDF header of the same name, the bus the emulated panel hangs on */
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+    SPI1_HOST = 0,
+    SPI2_HOST = 1,
+    SPI3_HOST = 2,
+} spi_host_device_t;
+
+typedef enum {
+    SPI_DMA_DISABLED = 0,
+    SPI_DMA_CH_AUTO = 3,
+} spi_dma_chan_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    unsigned flags;
+} spi_bus_config_t;
+
+// Keeps max_transfer_sz, pixel transfers are cut into transactions of that size
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, spi_dma_chan_t dma);
+
+esp_err_t spi_bus_free(spi_host_device_t host);
@@ -0,0 +1,13 @@
+/* Host stand-in for the ESP-IDF header of the same name, every allocation can do DMA */
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+static inline void *heap_caps_malloc(size_t size, unsigned caps)
+{
+    (void)caps;
+    return malloc(size);
+}
@@ -0,0 +1,18 @@
+/* Host stand-in for the ESP-IDF header of the same name */
+#pragma once
+
+#include "esp_idf_version.h"
+#include "esp_lcd_types.h"
+
+typedef struct {
+    int reset_gpio_num;
+    union {
+        esp_lcd_color_space_t color_space;
+        lcd_rgb_endian_t rgb_endian;
+    };
+    unsigned int bits_per_pixel;
+    struct {
+        unsigned int reset_active_high: 1;
+    } flags;
+    void *vendor_config;
+} esp_lcd_panel_dev_config_t;
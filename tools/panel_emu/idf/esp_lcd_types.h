@@ -0,0 +1,19 @@
+/* Host stand-in for the ESP-IDF header of the same name */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct esp_lcd_panel_io_t *esp_lcd_panel_io_handle_t;
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+
+typedef enum {
+    LCD_RGB_ENDIAN_RGB,
+    LCD_RGB_ENDIAN_BGR,
+} lcd_rgb_endian_t;
+
+typedef enum {
+    ESP_LCD_COLOR_SPACE_RGB,
+    ESP_LCD_COLOR_SPACE_BGR,
+    ESP_LCD_COLOR_SPACE_MONOCHROME,
+} esp_lcd_color_space_t;
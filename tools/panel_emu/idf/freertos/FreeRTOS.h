@@ -0,0 +1,14 @@
+/* Host stand-in for the FreeRTOS header of the same name, at the Station's tick rate */
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define configTICK_RATE_HZ 100
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTRUE 1
+#define pdFALSE 0
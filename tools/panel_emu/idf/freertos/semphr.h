@@ -0,0 +1,38 @@
+/* Host stand-in for the FreeRTOS header of the same name, binary semaphores for one task */
+#pragma once
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct {
+    bool given;
+} *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return calloc(1, sizeof(*(SemaphoreHandle_t)NULL));
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    sem->given = true;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+// Nobody else can give it, so waiting only lets the emulator's clock run
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if(!sem->given){
+        vTaskDelay(ticks);
+        return pdFALSE;
+    }
+    sem->given = false;
+    return pdTRUE;
+}
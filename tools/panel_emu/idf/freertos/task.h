@@ -0,0 +1,6 @@
+/* Host stand-in for the FreeRTOS header of the same name, delays pass on the emulator's clock */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
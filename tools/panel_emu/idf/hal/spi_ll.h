@@ -0,0 +1,2 @@
+/* Host stand-in, esp_lcd_ili9341.h includes it for nothing the emulator needs */
+#pragma once
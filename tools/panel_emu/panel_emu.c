@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "driver/spi_master.h"
+#include "esp_lcd_panel_io_interface.h"
+#include "esp_lcd_panel_interface.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_commands.h"
+#include "panel_emu.h"
+
+#define RDID4 0xD3
+#define SPI_MAX_TRANSFER_DEFAULT 4092   // what the SPI master allows with DMA when the bus leaves it at 0
+
+typedef struct {
+    esp_lcd_panel_io_t base;
+    uint32_t pclk_hz;
+    int cmd_bytes;
+    esp_lcd_panel_io_color_trans_done_cb_t on_color_trans_done;
+    void *user_ctx;
+} emu_io_t;
+
+static struct {
+    panel_emu_config_t config;
+    uint16_t *memory;               // rows x columns, RGB565 as written
+    uint8_t madctl;
+    uint8_t colmod;
+    bool inverted;
+    bool on;
+    bool scrolling;                 // VSCRSADD seen since the last NORON
+    uint16_t sc, ec, sp, ep;        // address window from CASET and RASET
+    int x, y;                       // write and read pointer inside the window
+    uint8_t partial[3];             // bytes of a pixel split across two transactions
+    int partial_len;
+    uint16_t tfa, vsa, bfa, vsp;
+    panel_emu_stats_t stats;
+    uint64_t now_ns;
+    size_t max_transfer;
+} emu;
+
+static void registers_reset(void)
+{
+    emu.madctl = 0;
+    emu.colmod = 0x66;
+    emu.inverted = false;
+    emu.on = false;
+    emu.scrolling = false;
+    emu.sc = 0;
+    emu.ec = emu.config.columns - 1;
+    emu.sp = 0;
+    emu.ep = emu.config.rows - 1;
+    emu.tfa = 0;
+    emu.vsa = emu.config.rows;
+    emu.bfa = 0;
+    emu.vsp = 0;
+}
+
+void panel_emu_init(const panel_emu_config_t *config)
+{
+    free(emu.memory);
+    memset(&emu, 0, sizeof(emu));
+    emu.config = *config;
+    emu.memory = calloc((size_t)config->columns * config->rows, sizeof(uint16_t));
+    emu.max_transfer = SPI_MAX_TRANSFER_DEFAULT;
+    registers_reset();
+}
+
+const panel_emu_stats_t *panel_emu_stats(void)
+{
+    return &emu.stats;
+}
+
+void panel_emu_reset_stats(void)
+{
+    memset(&emu.stats, 0, sizeof(emu.stats));
+}
+
+uint64_t panel_emu_time_ns(void)
+{
+    return emu.now_ns;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    emu.now_ns += (uint64_t)ticks * 1000000000 / configTICK_RATE_HZ;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return emu.now_ns / 1000;
+}
+
+/* NVS: u32 entries by namespace and key, outside the emulator so panel_emu_init keeps them */
+
+#define NVS_ENTRIES 16
+#define NVS_NAME_MAX 16
+
+static struct {
+    char name[NVS_NAME_MAX];
+    char key[NVS_NAME_MAX];
+    uint32_t value;
+} nvs_entries[NVS_ENTRIES];
+static char nvs_names[NVS_ENTRIES][NVS_NAME_MAX];   // handle - 1 is the index
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    for(int i = 0; i < NVS_ENTRIES; i++){
+        if(nvs_names[i][0] == 0){
+            snprintf(nvs_names[i], NVS_NAME_MAX, "%s", name);
+        }
+        if(strncmp(nvs_names[i], name, NVS_NAME_MAX - 1) == 0){
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    for(int i = 0; i < NVS_ENTRIES; i++){
+        if(strcmp(nvs_entries[i].name, nvs_names[handle - 1]) == 0 && strncmp(nvs_entries[i].key, key, NVS_NAME_MAX - 1) == 0){
+            *out_value = nvs_entries[i].value;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    for(int i = 0; i < NVS_ENTRIES; i++){
+        bool same = strcmp(nvs_entries[i].name, nvs_names[handle - 1]) == 0
+                    && strncmp(nvs_entries[i].key, key, NVS_NAME_MAX - 1) == 0;
+        if(same || nvs_entries[i].name[0] == 0){
+            snprintf(nvs_entries[i].name, NVS_NAME_MAX, "%s", nvs_names[handle - 1]);
+            snprintf(nvs_entries[i].key, NVS_NAME_MAX, "%s", key);
+            nvs_entries[i].value = value;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, spi_dma_chan_t dma)
+{
+    (void)host;
+    (void)dma;
+    emu.max_transfer = config->max_transfer_sz > 0 ? (size_t)config->max_transfer_sz : SPI_MAX_TRANSFER_DEFAULT;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+    (void)host;
+    return ESP_OK;
+}
+
+/* Controller */
+
+static void window_start(void)
+{
+    emu.x = emu.sc;
+    emu.y = emu.sp;
+    emu.partial_len = 0;
+}
+
+static void window_next(void)
+{
+    if(++emu.x > emu.ec){
+        emu.x = emu.sc;
+        if(++emu.y > emu.ep){
+            emu.y = emu.sp;
+        }
+    }
+}
+
+// Memory index of the window pointer, -1 when it is outside the memory
+static long pointer_index(void)
+{
+    bool mv = emu.madctl & LCD_CMD_MV_BIT;
+    int width = mv ? emu.config.rows : emu.config.columns;
+    int height = mv ? emu.config.columns : emu.config.rows;
+    if(emu.x >= width || emu.y >= height){
+        return -1;
+    }
+    int x = emu.madctl & LCD_CMD_MX_BIT ? width - 1 - emu.x : emu.x;
+    int y = emu.madctl & LCD_CMD_MY_BIT ? height - 1 - emu.y : emu.y;
+    int column = mv ? y : x, row = mv ? x : y;
+    return (long)row * emu.config.columns + column;
+}
+
+static void memory_write(uint16_t pixel)
+{
+    long i = pointer_index();
+    if(i < 0){
+        emu.stats.ignored++;
+    }
+    else{
+        emu.memory[i] = pixel;
+        emu.stats.pixels++;
+    }
+    window_next();
+}
+
+static void memory_write_bytes(const uint8_t *data, size_t len)
+{
+    int size = (emu.colmod & 0x07) == 0x05 ? 2 : 3;   // 16 bit, otherwise 18 bit in three bytes
+    for(size_t i = 0; i < len; i++){
+        emu.partial[emu.partial_len++] = data[i];
+        if(emu.partial_len < size){
+            continue;
+        }
+        const uint8_t *p = emu.partial;
+        if(size == 2){
+            memory_write(p[0] << 8 | p[1]);
+        }
+        else{
+            memory_write((p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3);
+        }
+        emu.partial_len = 0;
+    }
+}
+
+static uint16_t param16(const uint8_t *p)
+{
+    return p[0] << 8 | p[1];
+}
+
+static void command(int cmd, const uint8_t *param, size_t len)
+{
+    switch(cmd){
+        case LCD_CMD_SWRESET: registers_reset(); break;
+        case LCD_CMD_NORON: emu.scrolling = false; break;
+        case LCD_CMD_INVOFF: emu.inverted = false; break;
+        case LCD_CMD_INVON: emu.inverted = true; break;
+        case LCD_CMD_DISPOFF: emu.on = false; break;
+        case LCD_CMD_DISPON: emu.on = true; break;
+        case LCD_CMD_CASET:
+            if(len >= 4){
+                emu.sc = param16(param);
+                emu.ec = param16(param + 2);
+            }
+            break;
+        case LCD_CMD_RASET:
+            if(len >= 4){
+                emu.sp = param16(param);
+                emu.ep = param16(param + 2);
+            }
+            break;
+        case LCD_CMD_MADCTL:
+            if(len >= 1){
+                emu.madctl = param[0];
+            }
+            break;
+        case LCD_CMD_COLMOD:
+            if(len >= 1){
+                emu.colmod = param[0];
+            }
+            break;
+        case LCD_CMD_VSCRDEF:
+            if(len >= 6){
+                emu.tfa = param16(param);
+                emu.vsa = param16(param + 2);
+                emu.bfa = param16(param + 4);
+            }
+            break;
+        case LCD_CMD_VSCSAD:
+            if(len >= 2){
+                emu.vsp = param16(param);
+                emu.scrolling = true;
+            }
+            break;
+        case LCD_CMD_RAMWR:
+            window_start();
+            memory_write_bytes(param, len);
+            break;
+        case LCD_CMD_RAMWRC:
+            memory_write_bytes(param, len);
+            break;
+        default: // power, gamma and timing settings do not change the picture here
+            break;
+    }
+}
+
+static void answer(int cmd, uint8_t *param, size_t len)
+{
+    memset(param, 0, len);
+    if(cmd == RDID4){
+        static const uint8_t id[] = {0x00, 0x00, 0x93, 0x41};  // dummy byte first
+        memcpy(param, id, len < sizeof(id) ? len : sizeof(id));
+    }
+    else if(cmd == LCD_CMD_RAMRD){
+        window_start();
+        for(size_t i = 1; i + 3 <= len; i += 3){ // dummy byte, then 6 bits per colour at the top
+            long at = pointer_index();
+            uint16_t pixel = at < 0 ? 0 : emu.memory[at];
+            param[i] = (pixel >> 11) << 3;
+            param[i + 1] = ((pixel >> 5) & 0x3F) << 2;
+            param[i + 2] = (pixel & 0x1F) << 3;
+            window_next();
+        }
+    }
+}
+
+/* Panel IO, every call stands for one or more SPI transactions */
+
+static void bus(emu_io_t *io, size_t bytes, uint32_t fixed_ns, bool polled)
+{
+    uint64_t ns = fixed_ns + (uint64_t)bytes * 8 * 1000000000 / io->pclk_hz;
+    emu.now_ns += ns;
+    emu.stats.bus_ns += ns;
+    emu.stats.cpu_ns += polled ? ns : fixed_ns;
+    emu.stats.bytes += bytes;
+    emu.stats.transactions++;
+}
+
+static esp_err_t io_rx_param(esp_lcd_panel_io_t *base, int lcd_cmd, void *param, size_t param_size)
+{
+    emu_io_t *io = __containerof(base, emu_io_t, base);
+    bus(io, io->cmd_bytes + param_size, emu.config.command_ns, true);
+    emu.stats.commands++;
+    answer(lcd_cmd, param, param_size);
+    return ESP_OK;
+}
+
+static esp_err_t io_tx_param(esp_lcd_panel_io_t *base, int lcd_cmd, const void *param, size_t param_size)
+{
+    emu_io_t *io = __containerof(base, emu_io_t, base);
+    bus(io, io->cmd_bytes + param_size, emu.config.command_ns, true);
+    emu.stats.commands++;
+    command(lcd_cmd, param, param_size);
+    return ESP_OK;
+}
+
+static esp_err_t io_tx_color(esp_lcd_panel_io_t *base, int lcd_cmd, const void *color, size_t color_size)
+{
+    emu_io_t *io = __containerof(base, emu_io_t, base);
+    bus(io, io->cmd_bytes, emu.config.command_ns, true);
+    emu.stats.commands++;
+    emu.stats.color_transfers++;
+    command(lcd_cmd, NULL, 0);
+    const uint8_t *data = color;
+    bool garbled = emu.config.max_write_hz > 0 && io->pclk_hz > emu.config.max_write_hz;
+    for(size_t done = 0; done < color_size; ){
+        size_t chunk = color_size - done < emu.max_transfer ? color_size - done : emu.max_transfer;
+        bus(io, chunk, emu.config.queue_ns, false);
+        if(garbled){
+            // too fast for the wiring: the lowest data bit does not make it
+            for(size_t i = 0; i < chunk; i++){
+                uint8_t byte = data[done + i] & 0xFE;
+                memory_write_bytes(&byte, 1);
+            }
+        }
+        else{
+            memory_write_bytes(data + done, chunk);
+        }
+        done += chunk;
+    }
+    if(io->on_color_trans_done){
+        io->on_color_trans_done(&io->base, NULL, io->user_ctx);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t io_del(esp_lcd_panel_io_t *base)
+{
+    free(__containerof(base, emu_io_t, base));
+    return ESP_OK;
+}
+
+static esp_err_t io_register_event_callbacks(esp_lcd_panel_io_t *base, const esp_lcd_panel_io_callbacks_t *cbs, void *user_ctx)
+{
+    emu_io_t *io = __containerof(base, emu_io_t, base);
+    io->on_color_trans_done = cbs->on_color_trans_done;
+    io->user_ctx = user_ctx;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_new_panel_io_spi(esp_lcd_spi_bus_handle_t bus, const esp_lcd_panel_io_spi_config_t *io_config, esp_lcd_panel_io_handle_t *ret_io)
+{
+    (void)bus;
+    if(io_config == NULL || ret_io == NULL || io_config->pclk_hz == 0){
+        return ESP_ERR_INVALID_ARG;
+    }
+    emu_io_t *io = calloc(1, sizeof(emu_io_t));
+    if(io == NULL){
+        return ESP_ERR_NO_MEM;
+    }
+    io->pclk_hz = io_config->pclk_hz;
+    io->cmd_bytes = io_config->lcd_cmd_bits > 0 ? (io_config->lcd_cmd_bits + 7) / 8 : 1;
+    io->on_color_trans_done = io_config->on_color_trans_done;
+    io->user_ctx = io_config->user_ctx;
+    io->base.rx_param = io_rx_param;
+    io->base.tx_param = io_tx_param;
+    io->base.tx_color = io_tx_color;
+    io->base.del = io_del;
+    io->base.register_event_callbacks = io_register_event_callbacks;
+    *ret_io = &io->base;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_io_rx_param(esp_lcd_panel_io_handle_t io, int lcd_cmd, void *param, size_t param_size)
+{
+    return io->rx_param ? io->rx_param(io, lcd_cmd, param, param_size) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_io_tx_param(esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *param, size_t param_size)
+{
+    return io->tx_param(io, lcd_cmd, param, param_size);
+}
+
+esp_err_t esp_lcd_panel_io_tx_color(esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *color, size_t color_size)
+{
+    return io->tx_color(io, lcd_cmd, color, color_size);
+}
+
+esp_err_t esp_lcd_panel_io_del(esp_lcd_panel_io_handle_t io)
+{
+    return io ? io->del(io) : ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_io_register_event_callbacks(esp_lcd_panel_io_handle_t io, const esp_lcd_panel_io_callbacks_t *cbs, void *user_ctx)
+{
+    return io->register_event_callbacks(io, cbs, user_ctx);
+}
+
+/* Panel operations, straight to the driver's vtable as in esp_lcd */
+
+esp_err_t esp_lcd_panel_reset(esp_lcd_panel_handle_t panel)
+{
+    return panel->reset(panel);
+}
+
+esp_err_t esp_lcd_panel_init(esp_lcd_panel_handle_t panel)
+{
+    return panel->init(panel);
+}
+
+esp_err_t esp_lcd_panel_del(esp_lcd_panel_handle_t panel)
+{
+    return panel->del(panel);
+}
+
+esp_err_t esp_lcd_panel_draw_bitmap(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, const void *color_data)
+{
+    return panel->draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data);
+}
+
+esp_err_t esp_lcd_panel_mirror(esp_lcd_panel_handle_t panel, bool mirror_x, bool mirror_y)
+{
+    return panel->mirror ? panel->mirror(panel, mirror_x, mirror_y) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_swap_xy(esp_lcd_panel_handle_t panel, bool swap_axes)
+{
+    return panel->swap_xy ? panel->swap_xy(panel, swap_axes) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_set_gap(esp_lcd_panel_handle_t panel, int x_gap, int y_gap)
+{
+    return panel->set_gap ? panel->set_gap(panel, x_gap, y_gap) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_invert_color(esp_lcd_panel_handle_t panel, bool invert_color_data)
+{
+    return panel->invert_color ? panel->invert_color(panel, invert_color_data) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_disp_on_off(esp_lcd_panel_handle_t panel, bool on_off)
+{
+    return panel->disp_on_off ? panel->disp_on_off(panel, on_off) : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_lcd_panel_disp_sleep(esp_lcd_panel_handle_t panel, bool sleep)
+{
+    return panel->disp_sleep ? panel->disp_sleep(panel, sleep) : ESP_ERR_NOT_SUPPORTED;
+}
+
+/* Glass */
+
+uint16_t panel_emu_memory(int x, int y)
+{
+    return emu.memory[(long)y * emu.config.columns + x];
+}
+
+uint16_t panel_emu_pixel(int x, int y)
+{
+    if(!emu.on){
+        return 0;
+    }
+    int row = y;
+    if(emu.scrolling && y >= emu.tfa && y < emu.tfa + emu.vsa){
+        row = emu.vsp + (y - emu.tfa);
+        if(row >= emu.tfa + emu.vsa){
+            row -= emu.vsa;
+        }
+    }
+    int column = emu.config.glass_mirror_x ? emu.config.columns - 1 - x : x;
+    uint16_t pixel = row < emu.config.rows ? panel_emu_memory(column, row) : 0;
+    if(!(emu.madctl & LCD_CMD_BGR_BIT) != !emu.config.glass_bgr){
+        pixel = (pixel & 0x1F) << 11 | (pixel & 0x07E0) | pixel >> 11;
+    }
+    return emu.inverted ? ~pixel : pixel;
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    if(crc_table[1] == 0){
+        for(uint32_t n = 0; n < 256; n++){
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++){
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            crc_table[n] = c;
+        }
+    }
+    crc = ~crc;
+    while(len--){
+        crc = crc_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void chunk(FILE *f, const char *type, const uint8_t *data, size_t len)
+{
+    uint8_t head[8];
+    put32(head, len);
+    memcpy(&head[4], type, 4);
+    fwrite(head, 1, 8, f);
+    fwrite(data, 1, len, f);
+    uint32_t crc = crc32(crc32(0, (const uint8_t *)type, 4), data, len);
+    put32(head, crc);
+    fwrite(head, 1, 4, f);
+}
+
+// 8 bit RGB, stored without compression so it needs no zlib
+int panel_emu_write_png(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if(f == NULL){
+        return -1;
+    }
+    int width = emu.config.columns, height = emu.config.rows;
+    size_t line = 1 + (size_t)width * 3;
+    size_t raw_len = line * height;
+    uint8_t *raw = malloc(raw_len);
+    size_t blocks = (raw_len + 65534) / 65535;
+    uint8_t *z = malloc(2 + raw_len + blocks * 5 + 4);
+    if(raw == NULL || z == NULL){
+        free(raw);
+        free(z);
+        fclose(f);
+        return -1;
+    }
+    for(int y = 0; y < height; y++){
+        uint8_t *p = &raw[y * line];
+        *p++ = 0; // no filter
+        for(int x = 0; x < width; x++){
+            uint16_t c = panel_emu_pixel(x, y);
+            *p++ = (c >> 11) * 255 / 31;
+            *p++ = ((c >> 5) & 0x3F) * 255 / 63;
+            *p++ = (c & 0x1F) * 255 / 31;
+        }
+    }
+    size_t n = 0;
+    z[n++] = 0x78;
+    z[n++] = 0x01;
+    uint32_t a = 1, b = 0;
+    for(size_t at = 0; at < raw_len; ){
+        size_t len = raw_len - at < 65535 ? raw_len - at : 65535;
+        z[n++] = at + len == raw_len;
+        z[n++] = len;
+        z[n++] = len >> 8;
+        z[n++] = ~len;
+        z[n++] = ~len >> 8;
+        memcpy(&z[n], &raw[at], len);
+        n += len;
+        for(size_t i = 0; i < len; i++){
+            a = (a + raw[at + i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        at += len;
+    }
+    put32(&z[n], b << 16 | a);
+    n += 4;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint8_t ihdr[13];
+    put32(ihdr, width);
+    put32(&ihdr[4], height);
+    ihdr[8] = 8;    // bits per channel
+    ihdr[9] = 2;    // RGB
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    fwrite(signature, 1, sizeof(signature), f);
+    chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    chunk(f, "IDAT", z, n);
+    chunk(f, "IEND", NULL, 0);
+    free(raw);
+    free(z);
+    return fclose(f) == 0 ? 0 : -1;
+}
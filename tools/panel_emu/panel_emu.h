@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * ILI9341 on an SPI bus, emulated on the host.
+ *
+ * esp_lcd_new_panel_io_spi hands out a panel IO that feeds the commands to
+ * a model of the controller instead of the bus: memory, address window,
+ * MADCTL mirroring and row/column exchange, COLMOD 16 bit, inversion,
+ * display on/off, vertical scrolling and the reads RDID4 and RAMRD. The
+ * esp_lcd_ili9341 driver runs unmodified on top of it, so does code that
+ * talks to the panel IO directly.
+ *
+ * Every transaction is timed on a simulated clock: the command and
+ * parameter bits at the IO's pixel clock plus a fixed cost per transaction,
+ * polled commands keep the CPU busy for all of it. Pixel data is cut into
+ * transactions of the bus's max_transfer_sz like the esp_lcd SPI driver
+ * does, and on_color_trans_done is called once the last one is through.
+ * esp_timer_get_time runs on the same clock. NVS keeps u32 entries in
+ * memory, so code that stores what it probed finds it on the next run
+ * within the process.
+ */
+
+typedef struct {
+    int columns;            // controller memory, 240 x 320 on the ILI9341
+    int rows;
+    bool glass_bgr;         // glass is wired blue first, MADCTL BGR puts red back on top
+    bool glass_mirror_x;    // source 0 is on the right, MADCTL MX puts it back on the left
+    uint32_t command_ns;    // polled command transaction on top of its bits, CPU busy
+    uint32_t queue_ns;      // queueing one pixel transaction for DMA
+    uint32_t max_write_hz;  // fastest clock the wiring carries, pixels written faster lose bit 0; 0 for any
+} panel_emu_config_t;
+
+typedef struct {
+    uint64_t bus_ns;        // SPI busy
+    uint64_t cpu_ns;        // of it spent polling commands
+    uint64_t bytes;         // commands, parameters and pixels on the wire
+    uint32_t commands;
+    uint32_t transactions;
+    uint32_t color_transfers;   // tx_color calls
+    uint64_t pixels;            // written into the memory
+    uint64_t ignored;           // written outside the memory's columns or rows
+} panel_emu_stats_t;
+
+#define PANEL_EMU_CONFIG_ILI9341 {  \
+        .columns = 240,             \
+        .rows = 320,                \
+        .glass_bgr = true,          \
+        .glass_mirror_x = true,     \
+        .command_ns = 15000,        \
+        .queue_ns = 5000,           \
+    }
+
+// Power on state, memory cleared, statistics and clock at zero
+void panel_emu_init(const panel_emu_config_t *config);
+
+const panel_emu_stats_t *panel_emu_stats(void);
+
+void panel_emu_reset_stats(void);
+
+// Simulated time, bus transactions and vTaskDelay
+uint64_t panel_emu_time_ns(void);
+
+/**
+ * What the glass shows at x, y counted from its top left corner, after
+ * scrolling, inversion and display off. RGB565 with red in the top bits.
+ */
+uint16_t panel_emu_pixel(int x, int y);
+
+// Controller memory at column x, row y, as written
+uint16_t panel_emu_memory(int x, int y);
+
+// Save what the glass shows, 0 or -1 when the file could not be written
+int panel_emu_write_png(const char *path);
@@ -0,0 +1,115 @@
+/*
+ * The Station's display code on the host, on the emulated ILI9341 of
+ * panel_emu.c.
+ *
+ * Station/main/display.c is compiled as it is: display_initialize with the
+ * pixel clock probe and its NVS entry, the unmodified esp_lcd_ili9341 driver
+ * underneath, LVGL with the Station's buffers and lvgl_flush_cb, and the
+ * main screen with the message log in the band the controller scrolls. Then
+ * plays a few frames the Station draws all the time and reports for each
+ * the flushes, SPI transactions, bytes and simulated bus time, and saves
+ * what the glass shows as a PNG.
+ *
+ *   screen_frames [-o out_dir] [-b stripe|pingpong|full] [-w max_write_mhz] [-m columns x rows]
+ *
+ * -w makes pixels written faster than that arrive wrong, so the probe has to
+ * settle below it; without it every clock reads back right. -m sets the
+ * controller memory, 240x320 for the ILI9341, and pixels written outside it
+ * are counted as ignored, the way the controller drops them.
+ *
+ *   LV=../../Station/components/lvgl-release-v8.3
+ *   ILI=../../Station/managed_components/espressif__esp_lcd_ili9341
+ *   cc -O2 -DLV_CONF_SKIP -DLV_COLOR_16_SWAP=1 -DESP_LCD_ILI9341_VER_MAJOR=1 -DESP_LCD_ILI9341_VER_MINOR=2 -DESP_LCD_ILI9341_VER_PATCH=0 \
+ *      -Iidf -I. -I../../Station/main -I$ILI/include -I$LV \
+ *      screen_frames.c panel_emu.c ../../Station/main/display.c ../../Station/main/scroll_log.c \
+ *      $ILI/esp_lcd_ili9341.c $(find $LV/src -name '*.c') -o screen_frames
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lvgl.h"
+#include "display.h"
+#include "panel_emu.h"
+
+static uint32_t flushes;
+static uint64_t flushed_px;
+
+// Stands in for the Station's mirror_flush, sees every area with its screen rows
+static void count_flushed(const lv_area_t *area, const lv_color_t *pixels, size_t stride, bool last)
+{
+    (void)pixels;
+    (void)stride;
+    (void)last;
+    flushes++;
+    flushed_px += lv_area_get_size(area);
+}
+
+static void frame(const char *out_dir, int n, const char *name)
+{
+    flushes = 0;
+    flushed_px = 0;
+    panel_emu_reset_stats();
+    lv_refr_now(NULL);
+    const panel_emu_stats_t *s = panel_emu_stats();
+    printf("%-14s %3u flushes %7llu px %5u transactions %8llu bytes  bus %7.2f ms  cpu %6.2f ms  %llu px ignored\n",
+           name, (unsigned)flushes, (unsigned long long)flushed_px, (unsigned)s->transactions,
+           (unsigned long long)s->bytes, s->bus_ns / 1e6, s->cpu_ns / 1e6, (unsigned long long)s->ignored);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%02d_%s.png", out_dir, n, name);
+    if(panel_emu_write_png(path) != 0){
+        fprintf(stderr, "cannot write %s\n", path);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_dir = ".";
+    display_buffer_mode_t mode = DISPLAY_BUFFER_PINGPONG;
+    panel_emu_config_t config = PANEL_EMU_CONFIG_ILI9341;
+    int opt;
+    while((opt = getopt(argc, argv, "o:b:w:m:")) != -1){
+        switch(opt){
+            case 'o':
+                out_dir = optarg;
+                break;
+            case 'b':
+                mode = strcmp(optarg, "stripe") == 0 ? DISPLAY_BUFFER_STRIPE
+                       : strcmp(optarg, "full") == 0 ? DISPLAY_BUFFER_FULL : DISPLAY_BUFFER_PINGPONG;
+                break;
+            case 'w':
+                config.max_write_hz = atoi(optarg) * 1000000;
+                break;
+            case 'm':
+                if(sscanf(optarg, "%dx%d", &config.columns, &config.rows) == 2){
+                    break;
+                }
+                // fall through
+            default:
+                fprintf(stderr, "usage: %s [-o out_dir] [-b stripe|pingpong|full] [-w max_write_mhz] "
+                        "[-m columns x rows]\n", argv[0]);
+                return 2;
+        }
+    }
+    panel_emu_init(&config);
+    display_initialize(mode, count_flushed);
+    printf("panel up after %.1f ms\n", panel_emu_time_ns() / 1e6);
+    display_screen_t screen;
+    display_screen_create(&screen);
+    lv_obj_add_state(screen.text_area, LV_STATE_FOCUSED);
+
+    int n = 0;
+    frame(out_dir, n++, "first_frame");
+    lv_textarea_add_text(screen.text_area, "a");
+    frame(out_dir, n++, "key");
+    message_log_add("Komunikat: pomiar gotowy");
+    frame(out_dir, n++, "message");
+    message_log_add("Drugi komunikat, dosc dlugi zeby zawinac sie do nastepnej linii logu");
+    frame(out_dir, n++, "wrapped");
+    lv_label_set_text(screen.socket_status, "soc_status: -1");
+    frame(out_dir, n++, "status");
+    lv_tick_inc(500);
+    lv_timer_handler();     // cursor blink
+    frame(out_dir, n++, "cursor");
+    return 0;
+}
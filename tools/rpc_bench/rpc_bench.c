@@ -0,0 +1,223 @@
+/*
+ * Loopback benchmark for the request/response frames (link_rpc.h).
+ *
+ * A client thread keeps up to N requests in flight, a responder thread plays
+ * the UART device and answers each request after a fixed turnaround time.
+ * Both ends talk through the channel multiplexer over a socketpair, so the
+ * numbers include framing, fragmentation and the correlation table.
+ *
+ *   rpc_bench [-r requests] [-l turnaround_us] [window...]
+ *
+ * Windows default to 1, 8 and 32 outstanding requests, turnaround to 2 ms.
+ *
+ * Build from this directory:
+ *
+ *   cc -O2 -pthread -I../../components/terminal_link/include rpc_bench.c \
+ *      ../../components/terminal_link/link_rpc.c ../../components/terminal_link/link_mux.c -o rpc_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "link_rpc.h"
+#include "link_mux.h"
+
+#define PENDING_MAX 256
+
+typedef struct {
+    int fd;
+    mux_tx_t tx;
+    mux_rx_t rx;
+} endpoint_t;
+
+typedef struct {
+    int64_t due_us;
+    uint16_t id;
+} pending_t;
+
+static int64_t turnaround_us = 2000;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void send_frame(endpoint_t *ep, const uint8_t *frame, size_t len)
+{
+    uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
+    size_t n;
+    mux_tx_push(&ep->tx, mux_channel_for_frame(frame, len), frame, len);
+    while((n = mux_tx_next(&ep->tx, fragment)) > 0){
+        if(write(ep->fd, fragment, n) != (ssize_t)n){
+            perror("write");
+            exit(1);
+        }
+    }
+}
+
+// Returns false once the other side closed
+static bool receive(endpoint_t *ep, int timeout_ms)
+{
+    uint8_t chunk[512];
+    struct pollfd pfd = { .fd = ep->fd, .events = POLLIN };
+    if(poll(&pfd, 1, timeout_ms) <= 0){
+        return true;
+    }
+    ssize_t r = read(ep->fd, chunk, sizeof(chunk));
+    if(r <= 0){
+        return false;
+    }
+    mux_rx_feed(&ep->rx, chunk, r);
+    return true;
+}
+
+/* Responder, stands in for the UART device */
+static pending_t pending[PENDING_MAX];
+static int pending_count = 0;
+
+static void on_request(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    (void)channel;
+    rpc_msg_t req;
+    if(rpc_parse(msg, len, &req) == RPC_OK && req.type == RPC_FRAME_REQUEST && pending_count < PENDING_MAX){
+        pending[pending_count].due_us = now_us() + turnaround_us;
+        pending[pending_count].id = req.id;
+        pending_count++;
+    }
+}
+
+static void *responder(void *arg)
+{
+    endpoint_t *ep = arg;
+    static const uint8_t humidity[] = "042";
+    uint8_t frame[64];
+    mux_tx_init(&ep->tx);
+    mux_rx_init(&ep->rx, on_request, NULL);
+    while(1){
+        int64_t now = now_us();
+        int i = 0;
+        while(i < pending_count){
+            if(pending[i].due_us <= now){
+                size_t n = rpc_encode_response(frame, pending[i].id, 0x00, humidity, sizeof(humidity) - 1);
+                send_frame(ep, frame, n);
+                pending[i] = pending[--pending_count];
+            }
+            else{
+                i++;
+            }
+        }
+        if(!receive(ep, pending_count > 0 ? 0 : 10)){
+            return NULL;
+        }
+    }
+}
+
+/* Client, the Station side */
+static rpc_table_t rpc;
+static long completed = 0;
+static long failed = 0;
+
+static void on_done(void *ctx, uint16_t id, int status, const uint8_t *value, size_t len)
+{
+    (void)ctx;
+    (void)id;
+    (void)value;
+    (void)len;
+    if(status == 0x00){
+        completed++;
+    }
+    else{
+        failed++;
+    }
+}
+
+static void on_response(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    (void)channel;
+    rpc_msg_t resp;
+    if(rpc_parse(msg, len, &resp) == RPC_OK && resp.type == RPC_FRAME_RESPONSE){
+        rpc_complete(&rpc, resp.id, resp.code, resp.data, resp.len);
+    }
+}
+
+static void run(endpoint_t *ep, int window, long requests)
+{
+    uint8_t frame[64];
+    long issued = 0;
+    rpc_init(&rpc);
+    completed = failed = 0;
+    mux_tx_init(&ep->tx);
+    mux_rx_init(&ep->rx, on_response, NULL);
+
+    int64_t start = now_us();
+    while(completed + failed < requests){
+        while(issued < requests && rpc.outstanding < window){
+            uint16_t id;
+            if(rpc_begin(&rpc, now_us(), 1000, on_done, NULL, &id) != RPC_OK){
+                break;
+            }
+            send_frame(ep, frame, rpc_encode_request(frame, id, '2', NULL, 0));
+            issued++;
+        }
+        receive(ep, 1);
+        rpc_expire(&rpc, now_us());
+    }
+    double seconds = (now_us() - start) / 1e6;
+    printf("window %2d: %6ld requests in %.3f s, %8.1f requests/s, %ld failed\n",
+           window, requests, seconds, requests / seconds, failed);
+}
+
+int main(int argc, char **argv)
+{
+    long requests = 2000;
+    int opt;
+    while((opt = getopt(argc, argv, "r:l:")) != -1){
+        switch(opt){
+            case 'r': requests = atol(optarg); break;
+            case 'l': turnaround_us = atol(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-r requests] [-l turnaround_us] [window...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0){
+        perror("socketpair");
+        return 1;
+    }
+    static endpoint_t station, device;
+    station.fd = fds[0];
+    device.fd = fds[1];
+    pthread_t thread;
+    pthread_create(&thread, NULL, responder, &device);
+
+    printf("turnaround %ld us\n", (long)turnaround_us);
+    if(optind < argc){
+        for(int i = optind; i < argc; i++){
+            int window = atoi(argv[i]);
+            if(window < 1 || window > RPC_MAX_OUTSTANDING){
+                fprintf(stderr, "window must be 1..%d\n", RPC_MAX_OUTSTANDING);
+                return 2;
+            }
+            run(&station, window, requests);
+        }
+    }
+    else{
+        run(&station, 1, requests);
+        run(&station, 8, requests);
+        run(&station, 32, requests);
+    }
+    close(station.fd);
+    pthread_join(thread, NULL);
+    return 0;
+}
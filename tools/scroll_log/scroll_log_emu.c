@@ -0,0 +1,209 @@
+/*
+ * Host check of the hardware scrolled message log (Station/main/scroll_log.c).
+ *
+ * Emulates the ILI9341 memory and its vertical scrolling registers the way
+ * the datasheet describes them (VSCRDEF, VSCRSADD), plays the Station's
+ * flushes into it through scroll_log_map and composites what the panel
+ * shows. After every step the picture has to match the screen LVGL would
+ * draw from scratch. Lines are added one to three at a time, between them
+ * areas crossing the band are redrawn like a focus change or a full screen
+ * refresh would. Reports the pixels sent per added line against redrawing
+ * the whole log.
+ *
+ *   cc -O2 -I../../Station/main scroll_log_emu.c ../../Station/main/scroll_log.c -o scroll_log_emu
+ *   ./scroll_log_emu
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "scroll_log.h"
+
+#define HOR_RES 320
+#define VER_RES 240
+#define MEMORY_ROWS 320         // TFT_MEMORY_ROWS
+#define STRIPE_LINES 20         // DISPLAY_BUFFER_LINES
+#define BAND_TOP 38             // message log in its box, as laid out on the Station
+#define BAND_HEIGHT 48
+#define LINE_H 16
+#define BOX_X1 20
+#define BOX_X2 299
+#define STEPS 2000
+
+typedef struct {
+    uint16_t gram[MEMORY_ROWS][HOR_RES];
+    uint16_t tfa, vsa, bfa, vsp;
+    uint64_t pixels;
+    uint32_t commands;
+} panel_t;
+
+static panel_t panel;
+static scroll_log_t log_;
+static uint16_t sent_start;
+
+static void panel_vscrdef(panel_t *p, uint16_t tfa, uint16_t vsa, uint16_t bfa)
+{
+    p->tfa = tfa;
+    p->vsa = vsa;
+    p->bfa = bfa;
+    p->vsp = tfa;
+    p->commands++;
+}
+
+static void panel_vscrsadd(panel_t *p, uint16_t vsp)
+{
+    p->vsp = vsp;
+    p->commands++;
+}
+
+// CASET, RASET and RAMWR of one rectangle
+static void panel_write(panel_t *p, int x1, int y1, int x2, int y2, const uint16_t *pixels)
+{
+    for(int y = y1; y <= y2; y++){
+        for(int x = x1; x <= x2; x++){
+            p->gram[y][x] = *pixels++;
+        }
+    }
+    p->pixels += (uint64_t)(x2 - x1 + 1) * (y2 - y1 + 1);
+    p->commands += 3;
+}
+
+// Memory row the panel shows at screen row y, straight from the datasheet's description
+static int panel_row(const panel_t *p, int y)
+{
+    if(p->vsa == 0 || y < p->tfa || y >= p->tfa + p->vsa){
+        return y;
+    }
+    int row = p->vsp + (y - p->tfa);
+    return row >= p->tfa + p->vsa ? row - p->vsa : row;
+}
+
+static uint32_t hash(const char *text, int x, int y)
+{
+    uint32_t h = 2166136261u ^ (uint32_t)(x * 31 + y);
+    while(*text){
+        h = (h ^ (uint8_t)*text++) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+/*
+ * What LVGL renders at a pixel: a pattern that changes from row to row above
+ * and below the band, the box's side borders and background beside the log,
+ * and inside it a pattern made from the text of the line shown there.
+ */
+static uint16_t scene(int x, int y)
+{
+    if(y < BAND_TOP || y >= BAND_TOP + BAND_HEIGHT){
+        return (uint16_t)(x * 7 + y * 131);
+    }
+    if(x < BOX_X1 || x > BOX_X2){
+        return 0xFFFF;
+    }
+    if(x == BOX_X1 || x == BOX_X2){
+        return 0x8410;
+    }
+    int row = (y - BAND_TOP) / LINE_H;
+    const char *text = scroll_log_line(&log_, scroll_log_rows(&log_) - 1 - row);
+    return text == NULL ? 0xFFFE : (uint16_t)hash(text, x, (y - BAND_TOP) % LINE_H);
+}
+
+// lvgl_flush_cb with the controller scrolling the band
+static void flush(int x1, int y1, int x2, int y2, const uint16_t *color_map)
+{
+    uint16_t start = scroll_log_start(&log_);
+    if(start != sent_start){
+        panel_vscrsadd(&panel, start);
+        sent_start = start;
+    }
+    scroll_piece_t piece[SCROLL_LOG_PIECES];
+    int pieces = scroll_log_map(&log_, y1, y2, piece);
+    int width = x2 - x1 + 1;
+    for(int i = 0; i < pieces; i++){
+        panel_write(&panel, x1, piece[i].mem_y, x2, piece[i].mem_y + piece[i].rows - 1, &color_map[(piece[i].y - y1) * width]);
+    }
+}
+
+// Render an invalidated area stripe by stripe and flush it, like lv_refr does
+static void refresh(int x1, int y1, int x2, int y2)
+{
+    static uint16_t buffer[HOR_RES * STRIPE_LINES];
+    int width = x2 - x1 + 1;
+    int lines = (int)(sizeof(buffer) / sizeof(buffer[0])) / width;
+    for(int top = y1; top <= y2; top += lines){
+        int bottom = top + lines - 1 < y2 ? top + lines - 1 : y2;
+        uint16_t *px = buffer;
+        for(int y = top; y <= bottom; y++){
+            for(int x = x1; x <= x2; x++){
+                *px++ = scene(x, y);
+            }
+        }
+        flush(x1, top, x2, bottom, buffer);
+    }
+}
+
+static int check(int step)
+{
+    for(int y = 0; y < VER_RES; y++){
+        for(int x = 0; x < HOR_RES; x++){
+            if(panel.gram[panel_row(&panel, y)][x] != scene(x, y)){
+                printf("step %d: pixel %d,%d differs\n", step, x, y);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    if(scroll_log_init(&log_, BAND_TOP, BAND_HEIGHT, LINE_H, MEMORY_ROWS) != SCROLL_LOG_OK){
+        printf("band does not fit\n");
+        return 1;
+    }
+    panel_vscrdef(&panel, log_.top, log_.height, scroll_log_bottom(&log_));
+    sent_start = scroll_log_start(&log_);
+    refresh(0, 0, HOR_RES - 1, VER_RES - 1);
+    if(check(0)){
+        return 1;
+    }
+
+    uint32_t seed = 1;
+    uint64_t lines = 0, appends = 0, log_pixels = 0;
+    panel.pixels = 0;
+    panel.commands = 0;
+    for(int step = 1; step <= STEPS; step++){
+        seed = seed * 1103515245 + 12345;
+        uint32_t r = seed >> 16;
+        if(r % 8 == 0){
+            // focus outline, a full screen refresh or an area ending inside the band
+            switch(r / 8 % 3){
+                case 0: refresh(BOX_X1 - 3, BAND_TOP - 8, BOX_X2 + 3, BAND_TOP + BAND_HEIGHT + 7); break;
+                case 1: refresh(0, 0, HOR_RES - 1, VER_RES - 1); break;
+                default: refresh(r % 100, BAND_TOP - 5 + (int)(r % 17), 200 + r % 100, BAND_TOP + 20 + (int)(r % 40));
+            }
+        }
+        else{
+            uint64_t before = panel.pixels;
+            int added = 1 + (int)(r % 3);
+            for(int i = 0; i < added; i++){
+                char text[32];
+                snprintf(text, sizeof(text), "message %d.%d", step, i);
+                scroll_log_add(&log_, text, strlen(text));
+            }
+            // message_log_add: only the new lines at the bottom, all of it once the band is new
+            int fresh = added < scroll_log_rows(&log_) ? added * LINE_H : log_.height;
+            refresh(BOX_X1 + 1, BAND_TOP + log_.height - fresh, BOX_X2 - 1, BAND_TOP + log_.height - 1);
+            log_pixels += panel.pixels - before;
+            lines += added;
+            appends++;
+        }
+        if(check(step)){
+            return 1;
+        }
+    }
+    uint64_t redraw = (uint64_t)(BOX_X2 - BOX_X1 - 1) * log_.height;
+    printf("%d steps, %llu lines added, panel matches the redrawn screen after every step\n", STEPS, (unsigned long long)lines);
+    printf("pixels per added line: %.0f scrolled, %.0f redrawing the log (%llu per redraw)\n",
+           (double)log_pixels / lines, (double)redraw * appends / lines, (unsigned long long)redraw);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Build the predictive text dictionary linked into the Station firmware.
+
+    build_dict.py words.txt t9.dict
+
+words.txt has one word per line, most frequent first, optionally followed by
+a count ("word 1234") which then decides the order instead. Words with
+characters that are not on the keypad are skipped.
+
+The output is a trie keyed by keypad key (see Station/main/t9.h):
+
+    header  "T9D1", u32 root node offset
+    node    u8 child count, u8 word count,
+            children: u8 key, u24 node offset (sorted by key)
+            words:    u24 word offset, most frequent first; bit 23 set marks a
+                      completion whose first <depth> letters are shown
+    word    u8 length, letters
+
+Everything is little endian. Words shared by several nodes are stored once.
+"""
+import struct
+import sys
+
+# Letters per key index (row * 4 + col), must match multitap_layout in Station.c
+KEY_LETTERS = {
+    0: "abc", 1: "def", 2: "ghi",
+    4: "jkl", 5: "mno", 6: "pqr",
+    8: "stu", 9: "vwx", 10: "yz",
+}
+LETTER_KEY = {c: k for k, letters in KEY_LETTERS.items() for c in letters}
+
+MAX_WORDS_PER_NODE = 8
+MAX_DEPTH = 32
+COMPLETION = 1 << 23
+
+
+class Node:
+    def __init__(self):
+        self.children = {}
+        self.words = []     # (rank, word)
+        self.best = None    # (rank, word) most frequent word below this node
+
+
+def load(path):
+    entries = []
+    with open(path, encoding="utf-8") as f:
+        for line_no, line in enumerate(f):
+            parts = line.split()
+            if not parts or parts[0].startswith("#"):
+                continue
+            word = parts[0].lower()
+            count = int(parts[1]) if len(parts) > 1 else None
+            entries.append((word, count, line_no))
+    # explicit counts win, otherwise the line order is the rank
+    entries.sort(key=lambda e: (-(e[1] or 0), e[2]))
+    seen = set()
+    words = []
+    for word, _, _ in entries:
+        if word in seen or len(word) > MAX_DEPTH or any(c not in LETTER_KEY for c in word):
+            continue
+        seen.add(word)
+        words.append(word)
+    return words
+
+
+def build_trie(words):
+    root = Node()
+    for rank, word in enumerate(words):
+        node = root
+        for c in word:
+            if node.best is None:
+                node.best = (rank, word)
+            node = node.children.setdefault(LETTER_KEY[c], Node())
+        if node.best is None:
+            node.best = (rank, word)
+        if len(node.words) < MAX_WORDS_PER_NODE:
+            node.words.append((rank, word))
+    return root
+
+
+def serialize(root):
+    out = bytearray(b"T9D1\0\0\0\0")
+    word_offsets = {}
+
+    def word_offset(word):
+        if word not in word_offsets:
+            word_offsets[word] = len(out)
+            data = word.encode("ascii")
+            out.extend(struct.pack("<B", len(data)) + data)
+        return word_offsets[word]
+
+    def u24(value):
+        return struct.pack("<I", value)[:3]
+
+    # children are written before their parent so every offset is known
+    def emit(node):
+        children = [(key, emit(child)) for key, child in sorted(node.children.items())]
+        entries = [word_offset(w) for _, w in sorted(node.words)]
+        if not entries and node.best is not None:
+            entries = [word_offset(node.best[1]) | COMPLETION]
+        at = len(out)
+        out.extend(struct.pack("<BB", len(children), len(entries)))
+        for key, offset in children:
+            out.extend(struct.pack("<B", key) + u24(offset))
+        for offset in entries:
+            out.extend(u24(offset))
+        if len(out) >= COMPLETION:
+            sys.exit("dictionary too large for 23 bit offsets")
+        return at
+
+    sys.setrecursionlimit(MAX_DEPTH * 4 + 100)
+    root_offset = emit(root)
+    struct.pack_into("<I", out, 4, root_offset)
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: build_dict.py words.txt t9.dict")
+    words = load(sys.argv[1])
+    data = serialize(build_trie(words))
+    with open(sys.argv[2], "wb") as f:
+        f.write(data)
+    print("t9 dictionary: %d words, %d bytes" % (len(words), len(data)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+/*
+ * Host benchmark of the predictive text lookup (Station/main/t9.c).
+ *
+ * Types every word of the list key by key, reads all candidates after each
+ * key like the candidate bar does, and reports the time per keystroke, how
+ * often the intended word is the first candidate, and the dictionary size.
+ *
+ *   python3 build_dict.py ../../Station/main/t9_words.txt t9.dict
+ *   cc -O2 -I../../Station/main t9_bench.c ../../Station/main/t9.c -o t9_bench
+ *   ./t9_bench t9.dict ../../Station/main/t9_words.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "t9.h"
+
+#define ROUNDS 200
+
+// Same letters per key index as tools/t9dict/build_dict.py
+static const char *const key_letters[16] = {
+    "abc", "def", "ghi", NULL, "jkl", "mno", "pqr", NULL,
+    "stu", "vwx", "yz", NULL, NULL, NULL, NULL, NULL
+};
+
+static int letter_key(char c)
+{
+    for(int k = 0; k < 16; k++){
+        if(key_letters[k] && strchr(key_letters[k], c)){
+            return k;
+        }
+    }
+    return -1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc != 3){
+        fprintf(stderr, "usage: %s t9.dict words.txt\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if(f == NULL){
+        perror(argv[1]);
+        return 1;
+    }
+    static uint8_t data[1 << 20];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    t9_dict_t dict;
+    if(t9_open(&dict, data, size) != T9_OK){
+        fprintf(stderr, "%s: not a t9 dictionary\n", argv[1]);
+        return 1;
+    }
+
+    static char words[4096][T9_MAX_WORD + 1];
+    int count = 0;
+    char line[128];
+    f = fopen(argv[2], "r");
+    if(f == NULL){
+        perror(argv[2]);
+        return 1;
+    }
+    while(count < 4096 && fgets(line, sizeof(line), f)){
+        if(line[0] == '#' || sscanf(line, "%32s", words[count]) != 1){
+            continue;
+        }
+        bool ok = true;
+        for(char *c = words[count]; *c; c++){
+            ok &= letter_key(*c) >= 0;
+        }
+        count += ok;
+    }
+    fclose(f);
+
+    long keystrokes = 0, first = 0, listed = 0;
+    char candidate[T9_MAX_WORD + 1];
+    volatile size_t sink = 0;
+    double start = now_s();
+    for(int round = 0; round < ROUNDS; round++){
+        for(int w = 0; w < count; w++){
+            t9_cursor_t cur;
+            t9_reset(&cur, &dict);
+            for(const char *c = words[w]; *c; c++){
+                t9_push(&cur, letter_key(*c));
+                int n = t9_count(&cur);
+                for(int i = 0; i < n; i++){
+                    sink += t9_candidate(&cur, i, candidate, sizeof(candidate));
+                }
+                keystrokes++;
+            }
+            if(round == 0){
+                int n = t9_count(&cur);
+                for(int i = 0; i < n; i++){
+                    t9_candidate(&cur, i, candidate, sizeof(candidate));
+                    if(strcmp(candidate, words[w]) == 0){
+                        first += i == 0;
+                        listed++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    double seconds = now_s() - start;
+
+    printf("dictionary: %zu bytes, %d words, %.1f bytes/word\n", size, count, (double)size / count);
+    printf("lookup: %.1f ns per keystroke (%ld keystrokes)\n", seconds * 1e9 / keystrokes, keystrokes);
+    printf("words found: %ld/%d, first candidate: %ld\n", listed, count, first);
+    return sink == 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Handshake benchmark of the TLS-PSK link layer (link_tls.h).
+ *
+ * Runs the AP side in a thread and the Station side in the main thread over a
+ * socketpair, with the same link_tls code both projects use:
+ *
+ *   full      a fresh Station context every time, ECDHE-PSK key exchange
+ *   resumed   one Station context reconnecting, the AP's session ticket
+ *             turns it into an abbreviated handshake, the Wi-Fi drop case
+ *
+ * Times are wall clock on the host, so compare the two rows rather than
+ * reading them as ESP32 numbers; the Station logs its own "TLS handshake took".
+ *
+ *   tls_bench -k psk [-i identity] [-n handshakes]
+ *
+ * -k is a key as hex, like the one provisioned in NVS (see link_tls.h).
+ * Build from this directory:
+ *
+ *   cc -O2 -pthread -I../../components/terminal_link/include tls_bench.c \
+ *      ../../components/terminal_link/link_tls.c -lmbedtls -lmbedx509 -lmbedcrypto -o tls_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "link_tls.h"
+
+static uint8_t key[LINK_TLS_PSK_MAX];
+static int key_len;
+static const char *identity = LINK_TLS_DEFAULT_IDENTITY;
+static int handshakes = 200;
+
+// AP: accepts every handshake of both runs on the sockets main() hands over
+static int ap_fds[2];
+static link_tls_t ap;
+static int ap_failed;
+
+static void *ap_task(void *arg)
+{
+    (void)arg;
+    for(int i = 0; i < 2 * handshakes; i++){
+        int fd;
+        if(read(ap_fds[1], &fd, sizeof(fd)) != sizeof(fd)){
+            break;
+        }
+        if(link_tls_handshake(&ap, fd) != 0){
+            ap_failed++;
+        }
+        // wait for the Station's close_notify before the next connection
+        uint8_t byte;
+        link_tls_read(&ap, &byte, 1);
+        link_tls_close(&ap);
+        close(fd);
+    }
+    return NULL;
+}
+
+static int compare(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// One Station context for all handshakes when resume, a new one each time otherwise
+static int run(const char *name, int resume)
+{
+    int64_t *us = calloc(handshakes, sizeof(int64_t));
+    link_tls_t station;
+    int failed = 0;
+
+    for(int i = 0; i < handshakes; i++){
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0){
+            perror("socketpair");
+            exit(1);
+        }
+        if(!resume || i == 0){
+            if(link_tls_init(&station, false, key, key_len, identity) != 0){
+                fprintf(stderr, "TLS setup failed\n");
+                exit(1);
+            }
+        }
+        if(write(ap_fds[0], &pair[1], sizeof(int)) != sizeof(int)){
+            exit(1);
+        }
+        if(link_tls_handshake(&station, pair[0]) != 0){
+            failed++;
+        }
+        us[i] = station.handshake_us;
+        link_tls_close(&station);
+        close(pair[0]);
+        if(!resume){
+            link_tls_free(&station);
+        }
+    }
+    if(resume){
+        link_tls_free(&station);
+    }
+
+    // the first resumed handshake is a full one, it made the ticket
+    int from = resume ? 1 : 0;
+    int n = handshakes - from;
+    qsort(us + from, n, sizeof(int64_t), compare);
+    int64_t sum = 0;
+    for(int i = from; i < handshakes; i++){
+        sum += us[i];
+    }
+    printf("%-8s %4d handshakes  mean %7.2f ms  p50 %7.2f ms  p99 %7.2f ms  %d failed\n", name, n,
+           sum / 1000.0 / n, us[from + n / 2] / 1000.0, us[from + n * 99 / 100] / 1000.0, failed);
+    free(us);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *psk = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "k:i:n:")) != -1){
+        switch(opt){
+            case 'k':
+                psk = optarg;
+                break;
+            case 'i':
+                identity = optarg;
+                break;
+            case 'n':
+                handshakes = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s -k psk [-i identity] [-n handshakes]\n", argv[0]);
+                return 2;
+        }
+    }
+    key_len = psk != NULL ? link_tls_parse_key(psk, key) : -1;
+    if(key_len < 0 || handshakes < 2){
+        fprintf(stderr, "usage: %s -k psk [-i identity] [-n handshakes], the key as hex\n", argv[0]);
+        return 2;
+    }
+
+    // close_notify to a Station that already hung up
+    signal(SIGPIPE, SIG_IGN);
+    pthread_t thread;
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, ap_fds) != 0 || link_tls_init(&ap, true, key, key_len, identity) != 0){
+        fprintf(stderr, "AP setup failed\n");
+        return 1;
+    }
+    pthread_create(&thread, NULL, ap_task, NULL);
+    int failed = run("full", 0);
+    failed += run("resumed", 1);
+    pthread_join(thread, NULL);
+    link_tls_free(&ap);
+    return failed > 0 || ap_failed > 0;
+}
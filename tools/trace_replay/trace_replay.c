@@ -0,0 +1,299 @@
+/*
+ * Stand-in for the AP that replays a frame trace captured on the Station.
+ *
+ * Capture: build the Station with CAPTURE_ENABLED 1 and record its capture
+ * UART (CAPTURE_TX_PIN, CAPTURE_BAUD) before resetting the board:
+ *
+ *   stty -F /dev/ttyUSB1 921600 raw && cat /dev/ttyUSB1 > session.ftr
+ *
+ * Replay: the Station connects to AP_IP:PORT, so either run this on a host
+ * serving the Terminal_AP network at 192.168.4.1 or point AP_IP at the host.
+ * Every frame the Station received in the trace is sent to it again on the
+ * channel it came in on, frames the Station sends are read and counted.
+ *
+ *   trace_replay [-p port] [-s speed] [-n loops] [-k psk] [-i identity] [-d] session.ftr
+ *
+ *   -s 1    recorded timing (default), 10 = ten times faster, 0 = no delays
+ *   -k      the link key provisioned on the Station, as hex, required with TLS
+ *   -d      print the records and exit
+ *
+ * Build from this directory. The Station uses TLS unless it was built with
+ * LINK_USE_TLS 0, so the TLS build is the usual one:
+ *
+ *   cc -O2 -DLINK_USE_TLS=1 -I../../components/terminal_link/include trace_replay.c \
+ *      ../../components/terminal_link/frame_trace.c ../../components/terminal_link/link_mux.c \
+ *      ../../components/terminal_link/link_tls.c -lmbedtls -lmbedx509 -lmbedcrypto -o trace_replay
+ *
+ *   cc -O2 -I../../components/terminal_link/include trace_replay.c \
+ *      ../../components/terminal_link/frame_trace.c ../../components/terminal_link/link_mux.c -o trace_replay
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "frame_trace.h"
+#include "link_mux.h"
+
+#ifndef LINK_USE_TLS
+#define LINK_USE_TLS 0
+#endif
+#if LINK_USE_TLS
+#include "link_tls.h"
+static link_tls_t tls;
+#endif
+
+static int conn = -1;
+static mux_tx_t link_tx;
+static mux_rx_t link_rx;
+static unsigned long station_frames = 0;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int link_write(const void *data, size_t len)
+{
+#if LINK_USE_TLS
+    return link_tls_write(&tls, data, len);
+#else
+    return write(conn, data, len);
+#endif
+}
+
+static int link_read(void *data, size_t len)
+{
+#if LINK_USE_TLS
+    return link_tls_read(&tls, data, len);
+#else
+    return read(conn, data, len);
+#endif
+}
+
+static void count_station_frame(void *ctx, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    (void)ctx;
+    (void)channel;
+    (void)msg;
+    (void)len;
+    station_frames++;
+}
+
+// Read whatever the Station sends until deadline_us, returns -1 when it disconnected
+static int pump_until(int64_t deadline_us)
+{
+    uint8_t chunk[512];
+    do{
+        int64_t left = deadline_us - now_us();
+        int timeout = left > 0 ? (int)((left + 999) / 1000) : 0;
+#if LINK_USE_TLS
+        if(link_tls_pending(&tls) > 0){
+            timeout = 0;
+        }
+#endif
+        struct pollfd pfd = { .fd = conn, .events = POLLIN };
+        if(poll(&pfd, 1, timeout) > 0){
+            int r = link_read(chunk, sizeof(chunk));
+            if(r <= 0){
+                return -1;
+            }
+            mux_rx_feed(&link_rx, chunk, r);
+        }
+    } while(now_us() < deadline_us);
+    return 0;
+}
+
+static int send_message(uint8_t channel, const uint8_t *data, size_t len)
+{
+    uint8_t fragment[MUX_HEADER_SIZE + MUX_FRAGMENT_MAX];
+    size_t n;
+    if(!mux_tx_push(&link_tx, channel, data, len)){
+        return -1;
+    }
+    while((n = mux_tx_next(&link_tx, fragment)) > 0){
+        if(link_write(fragment, n) != (int)n){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t *load(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL){
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if(data != NULL && fread(data, 1, size, f) != (size_t)size){
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = size;
+    return data;
+}
+
+static void dump(const uint8_t *trace, size_t len)
+{
+    size_t at = TRACE_HEADER_SIZE;
+    uint64_t t = 0;
+    trace_record_t rec;
+    int n;
+    while((n = trace_decode(&trace[at], len - at, &rec)) > 0){
+        t += rec.delta_us;
+        printf("%10.3f ms  %s ch%u  %4u  ", t / 1000.0, rec.dir == TRACE_DIR_TX ? "tx" : "rx",
+               rec.channel, rec.len);
+        for(int i = 0; i < rec.len && i < 32; i++){
+            putchar(rec.data[i] >= 0x20 && rec.data[i] < 0x7F ? rec.data[i] : '.');
+        }
+        putchar('\n');
+        at += n;
+    }
+    if(n < 0 || at != len){
+        printf("trace ends with %zu unreadable bytes\n", len - at);
+    }
+}
+
+static int listen_on(int port)
+{
+    int one = 1;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = INADDR_ANY };
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 1) != 0){
+        perror("listen");
+        return -1;
+    }
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int port = 12345;
+    double speed = 1.0;
+    int loops = 1;
+    int only_dump = 0;
+    const char *psk = NULL;
+    const char *identity = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "p:s:n:k:i:d")) != -1){
+        switch(opt){
+            case 'p': port = atoi(optarg); break;
+            case 's': speed = atof(optarg); break;
+            case 'n': loops = atoi(optarg); break;
+            case 'k': psk = optarg; break;
+            case 'i': identity = optarg; break;
+            case 'd': only_dump = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-s speed] [-n loops] [-k psk] [-i identity] [-d] trace\n", argv[0]);
+                return 2;
+        }
+    }
+    if(optind >= argc){
+        fprintf(stderr, "no trace given\n");
+        return 2;
+    }
+
+    size_t len;
+    uint8_t *trace = load(argv[optind], &len);
+    if(trace == NULL || trace_check_header(trace, len) != TRACE_OK){
+        fprintf(stderr, "%s: not a frame trace\n", argv[optind]);
+        return 1;
+    }
+    if(only_dump){
+        dump(trace, len);
+        return 0;
+    }
+
+#if LINK_USE_TLS
+    uint8_t key[LINK_TLS_PSK_MAX];
+    int key_len = psk != NULL ? link_tls_parse_key(psk, key) : -1;
+    if(key_len < 0){
+        fprintf(stderr, "-k: the Station's link key as hex is required\n");
+        return 2;
+    }
+    if(link_tls_init(&tls, true, key, key_len, identity != NULL ? identity : LINK_TLS_DEFAULT_IDENTITY) != 0){
+        fprintf(stderr, "TLS setup failed\n");
+        return 1;
+    }
+#else
+    (void)psk;
+    (void)identity;
+#endif
+
+    int server = listen_on(port);
+    if(server < 0){
+        return 1;
+    }
+    printf("waiting for the Station on port %d\n", port);
+    conn = accept(server, NULL, NULL);
+    if(conn < 0){
+        perror("accept");
+        return 1;
+    }
+#if LINK_USE_TLS
+    if(link_tls_handshake(&tls, conn) != 0){
+        fprintf(stderr, "TLS handshake failed\n");
+        return 1;
+    }
+#endif
+    mux_tx_init(&link_tx);
+    mux_rx_init(&link_rx, count_station_frame, NULL);
+
+    unsigned long frames = 0, bytes = 0, skipped = 0;
+    int64_t start = now_us();
+    int64_t due = start;
+    for(int loop = 0; loop < loops; loop++){
+        size_t at = TRACE_HEADER_SIZE;
+        trace_record_t rec;
+        int n;
+        while((n = trace_decode(&trace[at], len - at, &rec)) > 0){
+            at += n;
+            if(speed > 0){
+                due += (int64_t)(rec.delta_us / speed);
+            }
+            if(rec.dir != TRACE_DIR_RX){
+                continue; // the Station produces its own frames
+            }
+            if(pump_until(due) != 0){
+                fprintf(stderr, "Station disconnected\n");
+                goto done;
+            }
+            if(rec.len > MUX_MESSAGE_MAX || send_message(rec.channel, rec.data, rec.len) != 0){
+                skipped++;
+                continue;
+            }
+            frames++;
+            bytes += rec.len;
+        }
+    }
+    // give the Station a moment to answer the last frames
+    pump_until(now_us() + 500 * 1000);
+
+done:;
+    double seconds = (now_us() - start) / 1e6;
+    printf("sent %lu frames (%lu bytes) in %.3f s, %.1f frames/s\n",
+           frames, bytes, seconds, seconds > 0 ? frames / seconds : 0.0);
+    printf("received %lu frames from the Station, %lu skipped, %u link errors\n",
+           station_frames, skipped, (unsigned)link_rx.errors);
+#if LINK_USE_TLS
+    link_tls_close(&tls);
+    link_tls_free(&tls);
+#endif
+    close(conn);
+    close(server);
+    free(trace);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Host stress test of the label update board (Station/main/ui_board.c).
+ *
+ * Producer threads post sets, appends and status codes to random labels
+ * under one mutex, like the socket, RPC and keepalive tasks do, while a
+ * consumer thread takes the updates and applies them to model labels, like
+ * the display task does. Every post is also applied straight to a second set
+ * of labels, and at the end both sets have to match. Reports posts per second
+ * and how many label updates were left after coalescing.
+ *
+ *   cc -O2 -pthread -I../../Station/main ui_stress.c ../../Station/main/ui_board.c -o ui_stress
+ *   ./ui_stress [producers] [seconds]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ui_board.h"
+
+#define LABELS 4
+#define APPLY_PERIOD_US 1000    // display task passes
+
+typedef struct {
+    char text[UI_TEXT_MAX + 1];
+} label_t;
+
+static ui_board_t board;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static label_t shown[LABELS];       // what the consumer applied
+static label_t expected[LABELS];    // every post applied in lock order
+static unsigned long applied = 0;
+static volatile int running = 1;
+
+static void label_set(label_t *label, const char *text)
+{
+    snprintf(label->text, sizeof(label->text), "%s", text);
+}
+
+// lv_label_ins_text at the end, cut like the board cuts
+static void label_append(label_t *label, const char *text)
+{
+    size_t len = strlen(label->text);
+    snprintf(&label->text[len], sizeof(label->text) - len, "%s", text);
+}
+
+static void *producer(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    unsigned long n = 0;
+    char text[64];
+    while(running){
+        int slot = rand_r(&seed) % LABELS;
+        int op = rand_r(&seed) % 8;
+        snprintf(text, sizeof(text), "p%u-%lu ", (unsigned)(size_t)arg, n++);
+        pthread_mutex_lock(&lock);
+        if(op == 0){
+            ui_board_append(&board, slot, text);
+            label_append(&expected[slot], text);
+        }
+        else if(op == 1){
+            uint8_t code = rand_r(&seed);
+            ui_board_status(&board, slot, code);
+            snprintf(expected[slot].text, sizeof(expected[slot].text), "0x%02X", code);
+        }
+        else{
+            ui_board_set(&board, slot, text);
+            label_set(&expected[slot], text);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+static void apply_all(void)
+{
+    static ui_update_t update;
+    while(1){
+        pthread_mutex_lock(&lock);
+        int slot = ui_board_take(&board, &update);
+        pthread_mutex_unlock(&lock);
+        if(slot < 0){
+            return;
+        }
+        if(update.op == UI_OP_SET){
+            label_set(&shown[slot], update.text);
+        }
+        else{
+            label_append(&shown[slot], update.text);
+        }
+        applied++;
+    }
+}
+
+static void *consumer(void *arg)
+{
+    (void)arg;
+    while(running){
+        apply_all();
+        usleep(APPLY_PERIOD_US);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+
+    // a burst to one label is a single update
+    ui_update_t update;
+    ui_board_init(&board);
+    for(int i = 0; i < 100; i++){
+        ui_board_status(&board, 1, i);
+    }
+    int burst = 0;
+    while(ui_board_take(&board, &update) >= 0){
+        burst++;
+    }
+    printf("100 updates to one label: %d taken, shows %s\n", burst, update.text);
+
+    ui_board_init(&board);
+    pthread_t threads[producers + 1];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&threads[producers], NULL, consumer, NULL);
+    for(int i = 0; i < producers; i++){
+        pthread_create(&threads[i], NULL, producer, (void *)(size_t)(i + 1));
+    }
+    sleep(seconds);
+    running = 0;
+    for(int i = 0; i <= producers; i++){
+        pthread_join(threads[i], NULL);
+    }
+    apply_all();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    int wrong = 0;
+    for(int i = 0; i < LABELS; i++){
+        if(strcmp(shown[i].text, expected[i].text) != 0){
+            printf("label %d shows \"%s\", expected \"%s\"\n", i, shown[i].text, expected[i].text);
+            wrong++;
+        }
+    }
+    printf("%d producers, %.2f M posts/s, %lu label updates applied (%.0f posts each)\n", producers,
+           board.posted / s / 1e6, applied, (double)board.posted / applied);
+    printf("final state %s\n", wrong ? "WRONG" : "matches");
+    return wrong != 0 || burst != 1;
+}